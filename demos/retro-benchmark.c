@@ -0,0 +1,156 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#include <retro-gtk.h>
+#include <stdlib.h>
+
+static gint64 n_frames = 1000;
+static gboolean consume_video = FALSE;
+static gboolean consume_audio = FALSE;
+static gboolean show_histogram = FALSE;
+
+static GOptionEntry entries[] = {
+  { "frames", 'n', 0, G_OPTION_ARG_INT64, &n_frames, "Number of frames to run", "N" },
+  { "video", 'v', 0, G_OPTION_ARG_NONE, &consume_video, "Copy the video frames", NULL },
+  { "audio", 'a', 0, G_OPTION_ARG_NONE, &consume_audio, "Resample the audio", NULL },
+  { "histogram", 'H', 0, G_OPTION_ARG_NONE, &show_histogram, "Print the frame time histogram", NULL },
+  { NULL }
+};
+
+static void
+crashed_cb (RetroCore   *core,
+            const gchar *message)
+{
+  g_printerr ("The core crashed: %s\n", message);
+
+  exit (EXIT_FAILURE);
+}
+
+static gdouble
+get_percentile (GArray  *histogram,
+                gdouble  percentile)
+{
+  return retro_frame_histogram_get_percentile ((guint32 *) histogram->data,
+                                               histogram->len,
+                                               percentile);
+}
+
+static void
+print_time (const gchar *name,
+            gdouble      time,
+            gdouble      total_time)
+{
+  g_print ("%-6s %10.3f s  %5.1f %%  %8.3f ms/frame\n",
+           name, time,
+           total_time > 0.0 ? time * 100.0 / total_time : 0.0,
+           time * 1000.0 / n_frames);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_autoptr (GOptionContext) context = NULL;
+  g_autoptr (RetroCore) core = NULL;
+  g_autoptr (GArray) histogram = NULL;
+  g_autoptr (GError) error = NULL;
+  g_autoptr (GFile) file = NULL;
+  g_autofree gchar *module_path = NULL;
+  RetroBenchmarkFlags flags = RETRO_BENCHMARK_FLAGS_NONE;
+  gdouble total_time, core_time, video_time, audio_time;
+  guint64 max_count = 0;
+
+  g_set_prgname ("retro-benchmark");
+
+  context = g_option_context_new ("CORE [MEDIA…]");
+  g_option_context_set_summary (context,
+                                "Runs frames of a Libretro core as fast as "
+                                "possible and reports how long they took.");
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error)) {
+    g_printerr ("%s\n", error->message);
+
+    return EXIT_FAILURE;
+  }
+
+  if (argc < 2 || n_frames <= 0) {
+    g_autofree gchar *help = g_option_context_get_help (context, TRUE, NULL);
+
+    g_printerr ("%s", help);
+
+    return EXIT_FAILURE;
+  }
+
+  file = g_file_new_for_commandline_arg (argv[1]);
+  module_path = g_file_get_path (file);
+  core = retro_core_new (module_path);
+
+  g_signal_connect (core, "crashed", G_CALLBACK (crashed_cb), NULL);
+
+  if (argc > 2) {
+    g_auto (GStrv) medias = g_new0 (gchar *, argc - 1);
+
+    for (gint i = 2; i < argc; i++) {
+      g_autoptr (GFile) media = g_file_new_for_commandline_arg (argv[i]);
+
+      medias[i - 2] = g_file_get_uri (media);
+    }
+
+    retro_core_set_medias (core, (const gchar *const *) medias);
+  }
+
+  retro_core_boot (core, &error);
+  if (error != NULL) {
+    g_printerr ("Couldn't boot the core: %s\n", error->message);
+
+    return EXIT_FAILURE;
+  }
+
+  if (consume_video)
+    flags |= RETRO_BENCHMARK_FLAGS_VIDEO;
+
+  if (consume_audio)
+    flags |= RETRO_BENCHMARK_FLAGS_AUDIO;
+
+  if (!retro_core_benchmark (core, n_frames, flags,
+                             &total_time, &core_time, &video_time, &audio_time,
+                             &histogram, &error)) {
+    g_printerr ("Couldn't benchmark the core: %s\n", error->message);
+
+    return EXIT_FAILURE;
+  }
+
+  g_print ("Frames %10" G_GINT64_FORMAT "\n", n_frames);
+  g_print ("FPS    %10.1f (nominal %.1f)\n",
+           total_time > 0.0 ? n_frames / total_time : 0.0,
+           retro_core_get_frames_per_second (core));
+  print_time ("Total", total_time, total_time);
+  print_time ("Core", core_time, total_time);
+  print_time ("Video", video_time, total_time);
+  print_time ("Audio", audio_time, total_time);
+  g_print ("Frame time: p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+           get_percentile (histogram, 50.0),
+           get_percentile (histogram, 90.0),
+           get_percentile (histogram, 99.0),
+           get_percentile (histogram, 100.0));
+
+  if (!show_histogram)
+    return EXIT_SUCCESS;
+
+  for (gsize i = 0; i < histogram->len; i++)
+    max_count = MAX (max_count, g_array_index (histogram, guint32, i));
+
+  for (gsize i = 0; i < histogram->len; i++) {
+    guint32 count = g_array_index (histogram, guint32, i);
+    g_autofree gchar *bar = NULL;
+
+    if (count == 0)
+      continue;
+
+    bar = g_strnfill ((gsize) (count * 50 / max_count) + 1, '#');
+    g_print ("%6.1f ms %10u %s\n",
+             i * RETRO_FRAME_HISTOGRAM_BUCKET_USEC / 1000.0, count, bar);
+  }
+
+  return EXIT_SUCCESS;
+}
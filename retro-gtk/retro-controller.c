@@ -9,10 +9,13 @@
 
 #include "retro-controller.h"
 
+#include "retro-input-private.h"
+
 G_DEFINE_INTERFACE (RetroController, retro_controller, G_TYPE_OBJECT);
 
 enum {
   SIGNAL_STATE_CHANGED,
+  SIGNAL_INPUT_CHANGED,
   N_SIGNALS,
 };
 
@@ -21,6 +24,14 @@ static guint signals[N_SIGNALS];
 static void
 retro_controller_default_init (RetroControllerInterface *iface)
 {
+  /**
+   * RetroController::state-changed:
+   * @self: the #RetroController
+   *
+   * The ::state-changed signal is emitted when any input of the controller may
+   * have changed, or when its capabilities changed. Listeners have to query
+   * every input again.
+   */
   signals[SIGNAL_STATE_CHANGED] =
     g_signal_new ("state-changed",
                   G_TYPE_FROM_INTERFACE (iface),
@@ -29,6 +40,25 @@ retro_controller_default_init (RetroControllerInterface *iface)
                   NULL, NULL, NULL,
                   G_TYPE_NONE,
                   0);
+
+  /**
+   * RetroController::input-changed:
+   * @self: the #RetroController
+   * @input: the #RetroInput that changed
+   *
+   * The ::input-changed signal is emitted when the state of a single input of
+   * the controller changed. Listeners only have to query @input again, which
+   * is much cheaper than handling #RetroController::state-changed.
+   */
+  signals[SIGNAL_INPUT_CHANGED] =
+    g_signal_new ("input-changed",
+                  G_TYPE_FROM_INTERFACE (iface),
+                  G_SIGNAL_RUN_FIRST,
+                  0,
+                  NULL, NULL, NULL,
+                  G_TYPE_NONE,
+                  1,
+                  RETRO_TYPE_INPUT | G_SIGNAL_TYPE_STATIC_SCOPE);
 }
 
 /**
@@ -174,6 +204,13 @@ retro_controller_set_rumble_state (RetroController   *self,
   iface->set_rumble_state (self, effect, strength);
 }
 
+/**
+ * retro_controller_emit_state_changed:
+ * @self: a #RetroController
+ *
+ * Emits #RetroController::state-changed. Prefer
+ * retro_controller_emit_input_changed() when the changed input is known.
+ */
 void
 retro_controller_emit_state_changed (RetroController *self)
 {
@@ -181,3 +218,27 @@ retro_controller_emit_state_changed (RetroController *self)
 
   g_signal_emit (self, signals[SIGNAL_STATE_CHANGED], 0);
 }
+
+/**
+ * retro_controller_emit_input_changed:
+ * @self: a #RetroController
+ * @controller_type: the #RetroControllerType of the input
+ * @id: the id of the input
+ * @index: the index of the input
+ *
+ * Emits #RetroController::input-changed for the given input.
+ */
+void
+retro_controller_emit_input_changed (RetroController     *self,
+                                     RetroControllerType  controller_type,
+                                     guint                id,
+                                     guint                index)
+{
+  RetroInput input;
+
+  g_return_if_fail (RETRO_IS_CONTROLLER (self));
+
+  retro_input_init (&input, controller_type, id, index);
+
+  g_signal_emit (self, signals[SIGNAL_INPUT_CHANGED], 0, &input);
+}
@@ -52,5 +52,9 @@ void retro_controller_set_rumble_state (RetroController   *self,
                                         RetroRumbleEffect  effect,
                                         guint16            strength);
 void retro_controller_emit_state_changed (RetroController *self);
+void retro_controller_emit_input_changed (RetroController     *self,
+                                          RetroControllerType  controller_type,
+                                          guint                id,
+                                          guint                index);
 
 G_END_DECLS
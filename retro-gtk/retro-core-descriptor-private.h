@@ -0,0 +1,20 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#pragma once
+
+#include "retro-core-descriptor.h"
+
+G_BEGIN_DECLS
+
+/* The type, name, icon, module and Libretro version, the platforms with their
+ * MIME types and firmwares, and the firmwares with their path, MD5, SHA-512
+ * and whether they are mandatory. */
+#define RETRO_CORE_DESCRIPTOR_VARIANT_TYPE "(msmsmsmsmsa(smasmas)a(smsmsmsy))"
+
+RetroCoreDescriptor *retro_core_descriptor_new_from_variant (const gchar *filename,
+                                                             GVariant    *variant) G_GNUC_WARN_UNUSED_RESULT;
+GVariant *retro_core_descriptor_serialize (RetroCoreDescriptor *self);
+const gchar *retro_core_descriptor_get_filename (RetroCoreDescriptor *self);
+gchar **retro_core_descriptor_get_platforms (RetroCoreDescriptor *self) G_GNUC_WARN_UNUSED_RESULT;
+
+G_END_DECLS
@@ -7,15 +7,49 @@
  * @See_also: #RetroCore
  */
 
-#include "retro-core-descriptor.h"
+#include "retro-core-descriptor-private.h"
 
 #include "retro-error-private.h"
-
+#include <string.h>
+
+typedef enum {
+  RETRO_CORE_DESCRIPTOR_BOOLEAN_MISSING,
+  RETRO_CORE_DESCRIPTOR_BOOLEAN_INVALID,
+  RETRO_CORE_DESCRIPTOR_BOOLEAN_FALSE,
+  RETRO_CORE_DESCRIPTOR_BOOLEAN_TRUE,
+} RetroCoreDescriptorBoolean;
+
+typedef struct {
+  const gchar *name;
+  const gchar **mime_types;
+  const gchar **firmwares;
+} RetroCoreDescriptorPlatform;
+
+typedef struct {
+  const gchar *name;
+  gchar *path;
+  gchar *md5;
+  gchar *sha512;
+  RetroCoreDescriptorBoolean mandatory;
+} RetroCoreDescriptorFirmware;
+
+/* The core descriptor is parsed once into these immutable fields, a missing
+ * key is %NULL. The strings shared by many cores like the type, platform names,
+ * MIME types and firmware names are interned, so they can be compared by
+ * address. */
 struct _RetroCoreDescriptor
 {
   GObject parent_instance;
   gchar *filename;
-  GKeyFile *key_file;
+  const gchar *type;
+  gchar *name;
+  gchar *icon;
+  gchar *module;
+  gchar *libretro_version;
+  RetroCoreDescriptorPlatform *platforms;
+  gsize n_platforms;
+  RetroCoreDescriptorFirmware *firmwares;
+  gsize n_firmwares;
 };
 
 G_DEFINE_TYPE (RetroCoreDescriptor, retro_core_descriptor, G_TYPE_OBJECT)
@@ -59,7 +93,23 @@ retro_core_descriptor_finalize (GObject *object)
   RetroCoreDescriptor *self = RETRO_CORE_DESCRIPTOR (object);
 
   g_free (self->filename);
-  g_key_file_unref (self->key_file);
+  g_free (self->name);
+  g_free (self->icon);
+  g_free (self->module);
+  g_free (self->libretro_version);
+
+  for (gsize i = 0; i < self->n_platforms; i++) {
+    g_free (self->platforms[i].mime_types);
+    g_free (self->platforms[i].firmwares);
+  }
+  g_free (self->platforms);
+
+  for (gsize i = 0; i < self->n_firmwares; i++) {
+    g_free (self->firmwares[i].path);
+    g_free (self->firmwares[i].md5);
+    g_free (self->firmwares[i].sha512);
+  }
+  g_free (self->firmwares);
 
   G_OBJECT_CLASS (retro_core_descriptor_parent_class)->finalize (object);
 }
@@ -77,106 +127,141 @@ retro_core_descriptor_init (RetroCoreDescriptor *self)
 {
 }
 
-static gboolean
-has_group_prefixed (RetroCoreDescriptor *self,
-                    const gchar         *group_prefix,
-                    const gchar         *group_suffix)
+static const gchar *
+try_intern (const gchar *string)
 {
-  g_autofree gchar *group = NULL;
-  gboolean has_group;
-
-  g_assert (group_prefix != NULL);
-  g_assert (group_suffix != NULL);
+  GQuark quark;
 
-  group = g_strconcat (group_prefix, group_suffix, NULL);
-  has_group = g_key_file_has_group (self->key_file, group);
+  /* A string which was never interned can't match any interned one, don't
+   * intern it to avoid leaking arbitrary strings. */
+  quark = g_quark_try_string (string);
 
-  return has_group;
+  return quark != 0 ? g_quark_to_string (quark) : NULL;
 }
 
-static gboolean
-has_key_prefixed (RetroCoreDescriptor  *self,
-                  const gchar          *group_prefix,
-                  const gchar          *group_suffix,
-                  const gchar          *key,
-                  GError              **error)
+static const gchar **
+intern_strv (const gchar * const *strv)
 {
-  g_autofree gchar *group = NULL;
-  gboolean has_key;
+  const gchar **interned;
+  gsize length;
 
-  g_assert (group_prefix != NULL);
-  g_assert (group_suffix != NULL);
-  g_assert (key != NULL);
+  if (strv == NULL)
+    return NULL;
 
-  group = g_strconcat (group_prefix, group_suffix, NULL);
-  retro_try_propagate_val ({
-    has_key = g_key_file_has_key (self->key_file,
-                                  group,
-                                  key,
-                                  &catch);
-  }, catch, error, FALSE);
+  length = g_strv_length ((gchar **) strv);
+  interned = g_new (const gchar *, length + 1);
+  for (gsize i = 0; i < length; i++)
+    interned[i] = g_intern_string (strv[i]);
+  interned[length] = NULL;
 
-  return has_key;
+  return interned;
 }
 
-static gchar *
-get_string_prefixed (RetroCoreDescriptor  *self,
-                     const gchar          *group_prefix,
-                     const gchar          *group_suffix,
-                     const gchar          *key,
-                     GError              **error)
+static void
+set_group_not_found (GError      **error,
+                     const gchar  *group_prefix,
+                     const gchar  *group_suffix)
 {
-  g_autofree gchar *group = NULL;
-  g_autofree gchar *string = NULL;
+  g_set_error (error,
+               G_KEY_FILE_ERROR,
+               G_KEY_FILE_ERROR_GROUP_NOT_FOUND,
+               "Key file does not have group “%s%s”",
+               group_prefix,
+               group_suffix);
+}
 
-  g_assert (group_prefix != NULL);
-  g_assert (group_suffix != NULL);
-  g_assert (key != NULL);
+static void
+set_key_not_found (GError      **error,
+                   const gchar  *group_prefix,
+                   const gchar  *group_suffix,
+                   const gchar  *key)
+{
+  g_set_error (error,
+               G_KEY_FILE_ERROR,
+               G_KEY_FILE_ERROR_KEY_NOT_FOUND,
+               "Key file does not have key “%s” in group “%s%s”",
+               key,
+               group_prefix,
+               group_suffix);
+}
 
-  group = g_strconcat (group_prefix, group_suffix, NULL);
+static gchar *
+dup_string (const gchar  *string,
+            const gchar  *group_prefix,
+            const gchar  *group_suffix,
+            const gchar  *key,
+            GError      **error)
+{
+  if (string == NULL) {
+    set_key_not_found (error, group_prefix, group_suffix, key);
 
-  retro_try ({
-    string = g_key_file_get_string (self->key_file,
-                                    group,
-                                    key,
-                                    &catch);
-  }, catch, {
     return NULL;
-  });
+  }
 
-  return g_steal_pointer (&string);
+  return g_strdup (string);
 }
 
 static gchar **
-get_string_list_prefixed (RetroCoreDescriptor  *self,
-                          const gchar          *group_prefix,
-                          const gchar          *group_suffix,
-                          const gchar          *key,
-                          gsize                *length,
-                          GError              **error)
-{
-  g_autofree gchar *group = NULL;
-  g_auto (GStrv) list = NULL;
-
-  g_assert (group_prefix != NULL);
-  g_assert (group_suffix != NULL);
-  g_assert (key != NULL);
-  g_assert (length != NULL);
+dup_string_list (const gchar * const  *list,
+                 const gchar          *group_prefix,
+                 const gchar          *group_suffix,
+                 const gchar          *key,
+                 gsize                *length,
+                 GError              **error)
+{
+  if (list == NULL) {
+    set_key_not_found (error, group_prefix, group_suffix, key);
 
-  group = g_strconcat (group_prefix, group_suffix, NULL);
-  retro_try_propagate_val ({
-    list = g_key_file_get_string_list (self->key_file,
-                                       group,
-                                       key,
-                                       length,
-                                       &catch);
-  }, catch, error, NULL);
+    return NULL;
+  }
+
+  if (length != NULL)
+    *length = g_strv_length ((gchar **) list);
+
+  return g_strdupv ((gchar **) list);
+}
 
-  return g_steal_pointer (&list);
+static RetroCoreDescriptorPlatform *
+lookup_platform (RetroCoreDescriptor  *self,
+                 const gchar          *platform,
+                 GError              **error)
+{
+  const gchar *name;
+
+  g_assert (platform != NULL);
+
+  name = try_intern (platform);
+  for (gsize i = 0; name != NULL && i < self->n_platforms; i++)
+    if (self->platforms[i].name == name)
+      return &self->platforms[i];
+
+  set_group_not_found (error, PLATFORM_GROUP_PREFIX, platform);
+
+  return NULL;
+}
+
+static RetroCoreDescriptorFirmware *
+lookup_firmware (RetroCoreDescriptor  *self,
+                 const gchar          *firmware,
+                 GError              **error)
+{
+  const gchar *name;
+
+  g_assert (firmware != NULL);
+
+  name = try_intern (firmware);
+  for (gsize i = 0; name != NULL && i < self->n_firmwares; i++)
+    if (self->firmwares[i].name == name)
+      return &self->firmwares[i];
+
+  set_group_not_found (error, FIRMWARE_GROUP_PREFIX, firmware);
+
+  return NULL;
 }
 
 static void
 check_has_required_key (RetroCoreDescriptor  *self,
+                        GKeyFile             *key_file,
                         const gchar          *group,
                         const gchar          *key,
                         GError              **error)
@@ -187,7 +272,7 @@ check_has_required_key (RetroCoreDescriptor  *self,
   g_assert (key != NULL);
 
   retro_try_propagate ({
-    has_key = g_key_file_has_key (self->key_file,
+    has_key = g_key_file_has_key (key_file,
                                   LIBRETRO_GROUP,
                                   TYPE_KEY,
                                   &catch);
@@ -206,10 +291,12 @@ check_has_required_key (RetroCoreDescriptor  *self,
 
 static void
 check_libretro_group (RetroCoreDescriptor  *self,
+                      GKeyFile             *key_file,
                       GError              **error)
 {
   retro_try_propagate ({
     check_has_required_key (self,
+                            key_file,
                             LIBRETRO_GROUP,
                             TYPE_KEY,
                             &catch);
@@ -217,6 +304,7 @@ check_libretro_group (RetroCoreDescriptor  *self,
 
   retro_try_propagate ({
     check_has_required_key (self,
+                            key_file,
                             LIBRETRO_GROUP,
                             NAME_KEY,
                             &catch);
@@ -224,6 +312,7 @@ check_libretro_group (RetroCoreDescriptor  *self,
 
   retro_try_propagate ({
     check_has_required_key (self,
+                            key_file,
                             LIBRETRO_GROUP,
                             MODULE_KEY,
                             &catch);
@@ -231,6 +320,7 @@ check_libretro_group (RetroCoreDescriptor  *self,
 
   retro_try_propagate ({
     check_has_required_key (self,
+                            key_file,
                             LIBRETRO_GROUP,
                             LIBRETRO_VERSION_KEY,
                             &catch);
@@ -239,6 +329,7 @@ check_libretro_group (RetroCoreDescriptor  *self,
 
 static void
 check_platform_group (RetroCoreDescriptor  *self,
+                      GKeyFile             *key_file,
                       const gchar          *group,
                       GError              **error)
 {
@@ -249,13 +340,14 @@ check_platform_group (RetroCoreDescriptor  *self,
 
   retro_try_propagate ({
     check_has_required_key (self,
+                            key_file,
                             group,
                             PLATFORM_MIME_TYPE_KEY,
                             &catch);
   }, catch, error);
 
   retro_try_propagate ({
-    has_key = g_key_file_has_key (self->key_file,
+    has_key = g_key_file_has_key (key_file,
                                   group,
                                   PLATFORM_FIRMWARES_KEY,
                                   &catch);
@@ -265,7 +357,7 @@ check_platform_group (RetroCoreDescriptor  *self,
     return;
 
   retro_try_propagate ({
-    firmwares = g_key_file_get_string_list (self->key_file,
+    firmwares = g_key_file_get_string_list (key_file,
                                             group,
                                             PLATFORM_FIRMWARES_KEY,
                                             NULL,
@@ -276,7 +368,7 @@ check_platform_group (RetroCoreDescriptor  *self,
     g_autofree gchar *firmware_group = NULL;
 
     firmware_group = g_strconcat (FIRMWARE_GROUP_PREFIX, *firmware_p, NULL);
-    if (!g_key_file_has_group (self->key_file, firmware_group)) {
+    if (!g_key_file_has_group (key_file, firmware_group)) {
       g_set_error (error,
                    RETRO_CORE_DESCRIPTOR_ERROR,
                    RETRO_CORE_DESCRIPTOR_ERROR_FIRMWARE_NOT_FOUND,
@@ -293,6 +385,7 @@ check_platform_group (RetroCoreDescriptor  *self,
 
 static void
 check_firmware_group (RetroCoreDescriptor  *self,
+                      GKeyFile             *key_file,
                       const gchar          *group,
                       GError              **error)
 {
@@ -300,6 +393,7 @@ check_firmware_group (RetroCoreDescriptor  *self,
 
   retro_try_propagate ({
     check_has_required_key (self,
+                            key_file,
                             group,
                             FIRMWARE_PATH_KEY,
                             &catch);
@@ -307,12 +401,114 @@ check_firmware_group (RetroCoreDescriptor  *self,
 
   retro_try_propagate ({
     check_has_required_key (self,
+                            key_file,
                             group,
                             FIRMWARE_MANDATORY_KEY,
                             &catch);
   }, catch, error);
 }
 
+static RetroCoreDescriptorBoolean
+parse_boolean (GKeyFile    *key_file,
+               const gchar *group,
+               const gchar *key)
+{
+  g_autoptr (GError) error = NULL;
+  gboolean value;
+
+  value = g_key_file_get_boolean (key_file, group, key, &error);
+  if (error == NULL)
+    return value ? RETRO_CORE_DESCRIPTOR_BOOLEAN_TRUE : RETRO_CORE_DESCRIPTOR_BOOLEAN_FALSE;
+
+  if (g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE))
+    return RETRO_CORE_DESCRIPTOR_BOOLEAN_INVALID;
+
+  return RETRO_CORE_DESCRIPTOR_BOOLEAN_MISSING;
+}
+
+static void
+parse_key_file (RetroCoreDescriptor *self,
+                GKeyFile            *key_file)
+{
+  g_auto (GStrv) groups = NULL;
+  g_autofree gchar *type = NULL;
+  g_autoptr (GArray) platforms = NULL;
+  g_autoptr (GArray) firmwares = NULL;
+
+  type = g_key_file_get_string (key_file, LIBRETRO_GROUP, TYPE_KEY, NULL);
+  self->type = type != NULL ? g_intern_string (type) : NULL;
+  self->name = g_key_file_get_string (key_file, LIBRETRO_GROUP, NAME_KEY, NULL);
+  self->icon = g_key_file_get_string (key_file, LIBRETRO_GROUP, ICON_KEY, NULL);
+  self->module = g_key_file_get_string (key_file, LIBRETRO_GROUP, MODULE_KEY, NULL);
+  self->libretro_version = g_key_file_get_string (key_file, LIBRETRO_GROUP,
+                                                  LIBRETRO_VERSION_KEY, NULL);
+
+  platforms = g_array_new (FALSE, FALSE, sizeof (RetroCoreDescriptorPlatform));
+  firmwares = g_array_new (FALSE, FALSE, sizeof (RetroCoreDescriptorFirmware));
+
+  groups = g_key_file_get_groups (key_file, NULL);
+  for (gsize i = 0; groups[i] != NULL; i++) {
+    if (g_str_has_prefix (groups[i], PLATFORM_GROUP_PREFIX)) {
+      g_auto (GStrv) mime_types = NULL;
+      g_auto (GStrv) platform_firmwares = NULL;
+      RetroCoreDescriptorPlatform platform;
+
+      mime_types = g_key_file_get_string_list (key_file, groups[i],
+                                               PLATFORM_MIME_TYPE_KEY,
+                                               NULL, NULL);
+      platform_firmwares = g_key_file_get_string_list (key_file, groups[i],
+                                                       PLATFORM_FIRMWARES_KEY,
+                                                       NULL, NULL);
+
+      platform.name = g_intern_string (groups[i] + strlen (PLATFORM_GROUP_PREFIX));
+      platform.mime_types = intern_strv ((const gchar * const *) mime_types);
+      platform.firmwares = intern_strv ((const gchar * const *) platform_firmwares);
+      g_array_append_val (platforms, platform);
+    }
+    else if (g_str_has_prefix (groups[i], FIRMWARE_GROUP_PREFIX)) {
+      RetroCoreDescriptorFirmware firmware;
+
+      firmware.name = g_intern_string (groups[i] + strlen (FIRMWARE_GROUP_PREFIX));
+      firmware.path = g_key_file_get_string (key_file, groups[i],
+                                             FIRMWARE_PATH_KEY, NULL);
+      firmware.md5 = g_key_file_get_string (key_file, groups[i],
+                                            FIRMWARE_MD5_KEY, NULL);
+      firmware.sha512 = g_key_file_get_string (key_file, groups[i],
+                                               FIRMWARE_SHA512_KEY, NULL);
+      firmware.mandatory = parse_boolean (key_file, groups[i],
+                                          FIRMWARE_MANDATORY_KEY);
+      g_array_append_val (firmwares, firmware);
+    }
+  }
+
+  self->n_platforms = platforms->len;
+  self->platforms = (RetroCoreDescriptorPlatform *) g_array_free (g_steal_pointer (&platforms), FALSE);
+  self->n_firmwares = firmwares->len;
+  self->firmwares = (RetroCoreDescriptorFirmware *) g_array_free (g_steal_pointer (&firmwares), FALSE);
+}
+
+static GVariant *
+new_maybe_string_list (const gchar * const *list)
+{
+  GVariant *child = list != NULL ? g_variant_new_strv (list, -1) : NULL;
+
+  return g_variant_new_maybe (G_VARIANT_TYPE_STRING_ARRAY, child);
+}
+
+static const gchar **
+intern_maybe_string_list (GVariant *maybe)
+{
+  g_autoptr (GVariant) child = g_variant_get_maybe (maybe);
+  g_autofree const gchar **list = NULL;
+
+  if (child == NULL)
+    return NULL;
+
+  list = g_variant_get_strv (child, NULL);
+
+  return intern_strv (list);
+}
+
 /* Public */
 
 /**
@@ -324,22 +520,12 @@ check_firmware_group (RetroCoreDescriptor  *self,
  *
  * Returns: whether the core has an icon
  */
-gboolean
 retro_core_descriptor_has_icon (RetroCoreDescriptor  *self,
                                 GError              **error)
 {
-  gboolean has_icon;
-
   g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (self), FALSE);
 
-  retro_try_propagate_val ({
-    has_icon = g_key_file_has_key (self->key_file,
-                                   LIBRETRO_GROUP,
-                                   ICON_KEY,
-                                   &catch);
-  }, catch, error, FALSE);
-
-  return has_icon;
+  return self->icon != NULL;
 }
 
 /**
@@ -389,25 +575,18 @@ retro_core_descriptor_get_id (RetroCoreDescriptor *self)
  *
  * Returns: whether the core is a game
  */
-gboolean
 retro_core_descriptor_get_is_game (RetroCoreDescriptor  *self,
                                    GError              **error)
 {
-  g_autofree gchar *type = NULL;
-  gboolean is_game;
-
   g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (self), FALSE);
 
-  retro_try_propagate_val ({
-    type = g_key_file_get_string (self->key_file,
-                                  LIBRETRO_GROUP,
-                                  TYPE_KEY,
-                                  &catch);
-  }, catch, error, FALSE);
+  if (self->type == NULL) {
+    set_key_not_found (error, LIBRETRO_GROUP, "", TYPE_KEY);
 
-  is_game = g_strcmp0 (type, TYPE_GAME) == 0;
+    return FALSE;
+  }
 
-  return is_game;
+  return g_str_equal (self->type, TYPE_GAME);
 }
 
 /**
@@ -419,25 +598,18 @@ retro_core_descriptor_get_is_game (RetroCoreDescriptor  *self,
  *
  * Returns: whether the core is an emulator
  */
-gboolean
 retro_core_descriptor_get_is_emulator (RetroCoreDescriptor  *self,
                                        GError              **error)
 {
-  g_autofree gchar *type = NULL;
-  gboolean is_emulator;
-
   g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (self), FALSE);
 
-  retro_try_propagate_val ({
-    type = g_key_file_get_string (self->key_file,
-                                  LIBRETRO_GROUP,
-                                  TYPE_KEY,
-                                  &catch);
-  }, catch, error, FALSE);
+  if (self->type == NULL) {
+    set_key_not_found (error, LIBRETRO_GROUP, "", TYPE_KEY);
 
-  is_emulator = g_strcmp0 (type, TYPE_EMULATOR) == 0;
+    return FALSE;
+  }
 
-  return is_emulator;
+  return g_str_equal (self->type, TYPE_EMULATOR);
 }
 
 /**
@@ -449,16 +621,12 @@ retro_core_descriptor_get_is_emulator (RetroCoreDescriptor  *self,
  *
  * Returns: (nullable) (transfer full): a string or %NULL, free it with g_free()
  */
-gchar *
 retro_core_descriptor_get_name (RetroCoreDescriptor  *self,
                                 GError              **error)
 {
   g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (self), NULL);
 
-  return g_key_file_get_string (self->key_file,
-                                LIBRETRO_GROUP,
-                                NAME_KEY,
-                                error);
+  return dup_string (self->name, LIBRETRO_GROUP, "", NAME_KEY, error);
 }
 
 /**
@@ -470,25 +638,18 @@ retro_core_descriptor_get_name (RetroCoreDescriptor  *self,
  *
  * Returns: (nullable) (transfer full): a #GIcon or %NULL
  */
-GIcon *
 retro_core_descriptor_get_icon (RetroCoreDescriptor  *self,
                                 GError              **error)
 {
-  g_autofree gchar *icon_name = NULL;
-  GIcon *icon;
-
   g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (self), NULL);
 
-  retro_try_propagate_val ({
-    icon_name = g_key_file_get_string (self->key_file,
-                                       LIBRETRO_GROUP,
-                                       ICON_KEY,
-                                       &catch);
-  }, catch, error, NULL);
+  if (self->icon == NULL) {
+    set_key_not_found (error, LIBRETRO_GROUP, "", ICON_KEY);
 
-  icon = G_ICON (g_themed_icon_new (icon_name));
+    return NULL;
+  }
 
-  return icon;
+  return G_ICON (g_themed_icon_new (self->icon));
 }
 
 /**
@@ -500,16 +661,12 @@ retro_core_descriptor_get_icon (RetroCoreDescriptor  *self,
  *
  * Returns: (nullable) (transfer full): a string or %NULL, free it with g_free()
  */
-char *
 retro_core_descriptor_get_module (RetroCoreDescriptor  *self,
                                   GError              **error)
 {
   g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (self), FALSE);
 
-  return g_key_file_get_string (self->key_file,
-                                LIBRETRO_GROUP,
-                                MODULE_KEY,
-                                error);
+  return dup_string (self->module, LIBRETRO_GROUP, "", MODULE_KEY, error);
 }
 
 /**
@@ -557,15 +714,12 @@ retro_core_descriptor_get_module_file (RetroCoreDescriptor  *self,
  *
  * Returns: whether the core descriptor declares the given platform
  */
-gboolean
 retro_core_descriptor_has_platform (RetroCoreDescriptor *self,
                                     const gchar         *platform)
 {
   g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (self), FALSE);
 
-  return has_group_prefixed (self,
-                           PLATFORM_GROUP_PREFIX,
-                           platform);
+  return lookup_platform (self, platform, NULL) != NULL;
 }
 
 /**
@@ -578,18 +732,17 @@ retro_core_descriptor_has_platform (RetroCoreDescriptor *self,
  *
  * Returns: whether the platform has associated firmwares
  */
-gboolean
 retro_core_descriptor_has_firmwares (RetroCoreDescriptor  *self,
                                      const gchar          *platform,
                                      GError              **error)
 {
+  RetroCoreDescriptorPlatform *platform_p;
+
   g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (self), FALSE);
 
-  return has_key_prefixed (self,
-                           PLATFORM_GROUP_PREFIX,
-                           platform,
-                           PLATFORM_FIRMWARES_KEY,
-                           error);
+  platform_p = lookup_platform (self, platform, error);
+
+  return platform_p != NULL && platform_p->firmwares != NULL;
 }
 
 /**
@@ -602,18 +755,17 @@ retro_core_descriptor_has_firmwares (RetroCoreDescriptor  *self,
  *
  * Returns: whether the firmware declares its MD5 fingerprint
  */
-gboolean
 retro_core_descriptor_has_firmware_md5 (RetroCoreDescriptor  *self,
                                         const gchar          *firmware,
                                         GError              **error)
 {
+  RetroCoreDescriptorFirmware *firmware_p;
+
   g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (self), FALSE);
 
-  return has_key_prefixed (self,
-                           FIRMWARE_GROUP_PREFIX,
-                           firmware,
-                           FIRMWARE_MD5_KEY,
-                           error);
+  firmware_p = lookup_firmware (self, firmware, error);
+
+  return firmware_p != NULL && firmware_p->md5 != NULL;
 }
 
 /**
@@ -626,18 +778,17 @@ retro_core_descriptor_has_firmware_md5 (RetroCoreDescriptor  *self,
  *
  * Returns: whether the firmware declares its SHA512 fingerprint
  */
-gboolean
 retro_core_descriptor_has_firmware_sha512 (RetroCoreDescriptor  *self,
                                            const gchar          *firmware,
                                            GError              **error)
 {
+  RetroCoreDescriptorFirmware *firmware_p;
+
   g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (self), FALSE);
 
-  return has_key_prefixed (self,
-                           FIRMWARE_GROUP_PREFIX,
-                           firmware,
-                           FIRMWARE_SHA512_KEY,
-                           error);
+  firmware_p = lookup_firmware (self, firmware, error);
+
+  return firmware_p != NULL && firmware_p->sha512 != NULL;
 }
 
 /**
@@ -654,20 +805,25 @@ retro_core_descriptor_has_firmware_sha512 (RetroCoreDescriptor  *self,
  * (transfer full): a %NULL-terminated string array or %NULL, the array should
  * be freed with g_strfreev()
  */
-gchar **
 retro_core_descriptor_get_mime_type (RetroCoreDescriptor  *self,
                                      const gchar          *platform,
                                      gsize                *length,
                                      GError              **error)
 {
+  RetroCoreDescriptorPlatform *platform_p;
+
   g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (self), NULL);
 
-  return get_string_list_prefixed (self,
-                                   PLATFORM_GROUP_PREFIX,
-                                   platform,
-                                   PLATFORM_MIME_TYPE_KEY,
-                                   length,
-                                   error);
+  platform_p = lookup_platform (self, platform, error);
+  if (platform_p == NULL)
+    return NULL;
+
+  return dup_string_list (platform_p->mime_types,
+                          PLATFORM_GROUP_PREFIX,
+                          platform,
+                          PLATFORM_MIME_TYPE_KEY,
+                          length,
+                          error);
 }
 
 /**
@@ -684,20 +840,25 @@ retro_core_descriptor_get_mime_type (RetroCoreDescriptor  *self,
  * (transfer full): a %NULL-terminated string array or %NULL, the array should
  * be freed with g_strfreev()
  */
-gchar **
 retro_core_descriptor_get_firmwares (RetroCoreDescriptor  *self,
                                      const gchar          *platform,
                                      gsize                *length,
                                      GError              **error)
 {
+  RetroCoreDescriptorPlatform *platform_p;
+
   g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (self), NULL);
 
-  return get_string_list_prefixed (self,
-                                   PLATFORM_GROUP_PREFIX,
-                                   platform,
-                                   PLATFORM_FIRMWARES_KEY,
-                                   length,
-                                   error);
+  platform_p = lookup_platform (self, platform, error);
+  if (platform_p == NULL)
+    return NULL;
+
+  return dup_string_list (platform_p->firmwares,
+                          PLATFORM_GROUP_PREFIX,
+                          platform,
+                          PLATFORM_FIRMWARES_KEY,
+                          length,
+                          error);
 }
 
 /**
@@ -710,18 +871,23 @@ retro_core_descriptor_get_firmwares (RetroCoreDescriptor  *self,
  *
  * Returns: (nullable) (transfer full): a string or %NULL, free it with g_free()
  */
-gchar *
 retro_core_descriptor_get_firmware_path (RetroCoreDescriptor  *self,
                                          const gchar          *firmware,
                                          GError              **error)
 {
+  RetroCoreDescriptorFirmware *firmware_p;
+
   g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (self), NULL);
 
-  return get_string_prefixed (self,
-                              FIRMWARE_GROUP_PREFIX,
-                              firmware,
-                              FIRMWARE_PATH_KEY,
-                              error);
+  firmware_p = lookup_firmware (self, firmware, error);
+  if (firmware_p == NULL)
+    return NULL;
+
+  return dup_string (firmware_p->path,
+                     FIRMWARE_GROUP_PREFIX,
+                     firmware,
+                     FIRMWARE_PATH_KEY,
+                     error);
 }
 
 /**
@@ -734,18 +900,23 @@ retro_core_descriptor_get_firmware_path (RetroCoreDescriptor  *self,
  *
  * Returns: (nullable) (transfer full): a string or %NULL, free it with g_free()
  */
-gchar *
 retro_core_descriptor_get_firmware_md5 (RetroCoreDescriptor  *self,
                                         const gchar          *firmware,
                                         GError              **error)
 {
+  RetroCoreDescriptorFirmware *firmware_p;
+
   g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (self), NULL);
 
-  return get_string_prefixed (self,
-                              FIRMWARE_GROUP_PREFIX,
-                              firmware,
-                              FIRMWARE_MD5_KEY,
-                              error);
+  firmware_p = lookup_firmware (self, firmware, error);
+  if (firmware_p == NULL)
+    return NULL;
+
+  return dup_string (firmware_p->md5,
+                     FIRMWARE_GROUP_PREFIX,
+                     firmware,
+                     FIRMWARE_MD5_KEY,
+                     error);
 }
 
 /**
@@ -758,18 +929,23 @@ retro_core_descriptor_get_firmware_md5 (RetroCoreDescriptor  *self,
  *
  * Returns: (nullable) (transfer full): a string or %NULL, free it with g_free()
  */
-gchar *
 retro_core_descriptor_get_firmware_sha512 (RetroCoreDescriptor  *self,
                                            const gchar          *firmware,
                                            GError              **error)
 {
+  RetroCoreDescriptorFirmware *firmware_p;
+
   g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (self), NULL);
 
-  return get_string_prefixed (self,
-                              FIRMWARE_GROUP_PREFIX,
-                              firmware,
-                              FIRMWARE_SHA512_KEY,
-                              error);
+  firmware_p = lookup_firmware (self, firmware, error);
+  if (firmware_p == NULL)
+    return NULL;
+
+  return dup_string (firmware_p->sha512,
+                     FIRMWARE_GROUP_PREFIX,
+                     firmware,
+                     FIRMWARE_SHA512_KEY,
+                     error);
 }
 
 /**
@@ -782,27 +958,41 @@ retro_core_descriptor_get_firmware_sha512 (RetroCoreDescriptor  *self,
  *
  * Returns: whether the firmware is mandatory for the core to function
  */
-gboolean
 retro_core_descriptor_get_is_firmware_mandatory (RetroCoreDescriptor  *self,
                                                  const gchar          *firmware,
                                                  GError              **error)
 {
-  g_autofree gchar *group = NULL;
-  gboolean is_mandatory;
+  RetroCoreDescriptorFirmware *firmware_p;
 
   g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (self), FALSE);
   g_return_val_if_fail (firmware != NULL, FALSE);
 
-  group = g_strconcat (FIRMWARE_GROUP_PREFIX, firmware, NULL);
+  firmware_p = lookup_firmware (self, firmware, error);
+  if (firmware_p == NULL)
+    return FALSE;
 
-  retro_try_propagate_val ({
-    is_mandatory = g_key_file_get_boolean (self->key_file,
-                                           group,
-                                           FIRMWARE_MANDATORY_KEY,
-                                           &catch);
-  }, catch, error, FALSE);
-
-  return is_mandatory;
+  switch (firmware_p->mandatory) {
+  case RETRO_CORE_DESCRIPTOR_BOOLEAN_TRUE:
+    return TRUE;
+  case RETRO_CORE_DESCRIPTOR_BOOLEAN_FALSE:
+    return FALSE;
+  case RETRO_CORE_DESCRIPTOR_BOOLEAN_INVALID:
+    g_set_error (error,
+                 G_KEY_FILE_ERROR,
+                 G_KEY_FILE_ERROR_INVALID_VALUE,
+                 "Key file contains key “%s” in group “%s%s” which has a value "
+                 "that cannot be interpreted.",
+                 FIRMWARE_MANDATORY_KEY,
+                 FIRMWARE_GROUP_PREFIX,
+                 firmware);
+
+    return FALSE;
+  default:
+    set_key_not_found (error, FIRMWARE_GROUP_PREFIX, firmware,
+                       FIRMWARE_MANDATORY_KEY);
+
+    return FALSE;
+  }
 }
 
 /**
@@ -816,31 +1006,42 @@ retro_core_descriptor_get_is_firmware_mandatory (RetroCoreDescriptor  *self,
  *
  * Returns: whether the platform supports all of the given MIME types
  */
-gboolean
 retro_core_descriptor_get_platform_supports_mime_types (RetroCoreDescriptor  *self,
                                                         const gchar          *platform,
                                                         const gchar * const  *mime_types,
                                                         GError              **error)
 {
-  g_auto (GStrv) supported_mime_types = NULL;
-  gsize supported_mime_types_length;
+  RetroCoreDescriptorPlatform *platform_p;
 
   g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (self), FALSE);
   g_return_val_if_fail (platform != NULL, FALSE);
   g_return_val_if_fail (mime_types != NULL, FALSE);
 
-  retro_try_propagate_val ({
-    supported_mime_types =
-      retro_core_descriptor_get_mime_type (self,
-                                           platform,
-                                           &supported_mime_types_length,
-                                           &catch);
-  }, catch, error, FALSE);
-
-  for (; *mime_types != NULL; mime_types++)
-    if (!g_strv_contains ((const char * const *) supported_mime_types,
-                          *mime_types))
+  platform_p = lookup_platform (self, platform, error);
+  if (platform_p == NULL)
+    return FALSE;
+
+  if (platform_p->mime_types == NULL) {
+    set_key_not_found (error, PLATFORM_GROUP_PREFIX, platform,
+                       PLATFORM_MIME_TYPE_KEY);
+
+    return FALSE;
+  }
+
+  for (; *mime_types != NULL; mime_types++) {
+    const gchar *mime_type = try_intern (*mime_types);
+    gboolean supported = FALSE;
+
+    for (gsize i = 0; mime_type != NULL && platform_p->mime_types[i] != NULL; i++)
+      if (platform_p->mime_types[i] == mime_type) {
+        supported = TRUE;
+
+        break;
+      }
+
+    if (!supported)
       return FALSE;
+  }
 
   return TRUE;
 }
@@ -854,11 +1055,11 @@ retro_core_descriptor_get_platform_supports_mime_types (RetroCoreDescriptor  *se
  *
  * Returns: (transfer full): a new #RetroCoreDescriptor
  */
-RetroCoreDescriptor *
 retro_core_descriptor_new (const gchar  *filename,
                            GError      **error)
 {
   g_autoptr (RetroCoreDescriptor) self = NULL;
+  g_autoptr (GKeyFile) key_file = NULL;
   g_auto (GStrv) groups = NULL;
   gsize groups_length;
 
@@ -866,33 +1067,183 @@ retro_core_descriptor_new (const gchar  *filename,
 
   self =  g_object_new (RETRO_TYPE_CORE_DESCRIPTOR, NULL);
   self->filename = g_strdup (filename);
-  self->key_file = g_key_file_new ();
+  key_file = g_key_file_new ();
   retro_try_propagate_val ({
-    g_key_file_load_from_file (self->key_file,
+    g_key_file_load_from_file (key_file,
                                filename,
                                G_KEY_FILE_NONE,
                                &catch);
   }, catch, error, NULL);
 
   retro_try_propagate_val ({
-    check_libretro_group (self, &catch);
+    check_libretro_group (self, key_file, &catch);
   }, catch, error, NULL);
 
-  groups = g_key_file_get_groups (self->key_file, &groups_length);
+  groups = g_key_file_get_groups (key_file, &groups_length);
   for (gsize i = 0; i < groups_length; i++) {
     if (g_str_has_prefix (groups[i],
                           PLATFORM_GROUP_PREFIX)) {
       retro_try_propagate_val ({
-        check_platform_group (self, groups[i], &catch);
+        check_platform_group (self, key_file, groups[i], &catch);
       }, catch, error, NULL);
     }
     else if (g_str_has_prefix (groups[i],
                                FIRMWARE_GROUP_PREFIX)) {
       retro_try_propagate_val ({
-        check_firmware_group (self, groups[i], &catch);
+        check_firmware_group (self, key_file, groups[i], &catch);
       }, catch, error, NULL);
     }
   }
 
+  parse_key_file (self, key_file);
+
+  return g_steal_pointer (&self);
+}
+
+/**
+ * retro_core_descriptor_new_from_variant:
+ * @filename: the file name of the core descriptor
+ * @variant: a #GVariant returned by retro_core_descriptor_serialize()
+ *
+ * Creates a new #RetroCoreDescriptor from a serialized valid one, it isn't
+ * validated again.
+ *
+ * Returns: (transfer full): a new #RetroCoreDescriptor
+ */
+RetroCoreDescriptor *
+retro_core_descriptor_new_from_variant (const gchar *filename,
+                                        GVariant    *variant)
+{
+  g_autoptr (RetroCoreDescriptor) self = NULL;
+  g_autoptr (GVariantIter) platforms = NULL;
+  g_autoptr (GVariantIter) firmwares = NULL;
+  const gchar *type;
+  const gchar *name, *icon, *module, *libretro_version;
+  const gchar *path, *md5, *sha512;
+  GVariant *mime_types, *platform_firmwares;
+  guint8 mandatory;
+  gsize i;
+
+  g_return_val_if_fail (filename != NULL, NULL);
+  g_return_val_if_fail (variant != NULL, NULL);
+  g_return_val_if_fail (g_variant_is_of_type (variant, G_VARIANT_TYPE (RETRO_CORE_DESCRIPTOR_VARIANT_TYPE)), NULL);
+
+  self = g_object_new (RETRO_TYPE_CORE_DESCRIPTOR, NULL);
+  self->filename = g_strdup (filename);
+
+  g_variant_get (variant, "(m&sm&sm&sm&sm&sa(s@mas@mas)a(sm&sm&sm&sy))",
+                 &type, &name, &icon, &module, &libretro_version,
+                 &platforms, &firmwares);
+
+  self->type = type != NULL ? g_intern_string (type) : NULL;
+  self->name = g_strdup (name);
+  self->icon = g_strdup (icon);
+  self->module = g_strdup (module);
+  self->libretro_version = g_strdup (libretro_version);
+
+  self->n_platforms = g_variant_iter_n_children (platforms);
+  self->platforms = g_new0 (RetroCoreDescriptorPlatform, self->n_platforms);
+  for (i = 0; g_variant_iter_loop (platforms, "(&s@mas@mas)",
+                                   &name, &mime_types, &platform_firmwares); i++) {
+    self->platforms[i].name = g_intern_string (name);
+    self->platforms[i].mime_types = intern_maybe_string_list (mime_types);
+    self->platforms[i].firmwares = intern_maybe_string_list (platform_firmwares);
+  }
+
+  self->n_firmwares = g_variant_iter_n_children (firmwares);
+  self->firmwares = g_new0 (RetroCoreDescriptorFirmware, self->n_firmwares);
+  for (i = 0; g_variant_iter_next (firmwares, "(&sm&sm&sm&sy)",
+                                   &name, &path, &md5, &sha512, &mandatory); i++) {
+    self->firmwares[i].name = g_intern_string (name);
+    self->firmwares[i].path = g_strdup (path);
+    self->firmwares[i].md5 = g_strdup (md5);
+    self->firmwares[i].sha512 = g_strdup (sha512);
+    self->firmwares[i].mandatory = MIN (mandatory, RETRO_CORE_DESCRIPTOR_BOOLEAN_TRUE);
+  }
+
   return g_steal_pointer (&self);
 }
+
+/**
+ * retro_core_descriptor_serialize:
+ * @self: a #RetroCoreDescriptor
+ *
+ * Serializes @self so it can be recreated with
+ * retro_core_descriptor_new_from_variant().
+ *
+ * Returns: (transfer floating): a #GVariant of type
+ * %RETRO_CORE_DESCRIPTOR_VARIANT_TYPE
+ */
+GVariant *
+retro_core_descriptor_serialize (RetroCoreDescriptor *self)
+{
+  GVariantBuilder platforms;
+  GVariantBuilder firmwares;
+
+  g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (self), NULL);
+
+  g_variant_builder_init (&platforms, G_VARIANT_TYPE ("a(smasmas)"));
+  for (gsize i = 0; i < self->n_platforms; i++)
+    g_variant_builder_add (&platforms, "(s@mas@mas)",
+                           self->platforms[i].name,
+                           new_maybe_string_list (self->platforms[i].mime_types),
+                           new_maybe_string_list (self->platforms[i].firmwares));
+
+  g_variant_builder_init (&firmwares, G_VARIANT_TYPE ("a(smsmsmsy)"));
+  for (gsize i = 0; i < self->n_firmwares; i++)
+    g_variant_builder_add (&firmwares, "(smsmsmsy)",
+                           self->firmwares[i].name,
+                           self->firmwares[i].path,
+                           self->firmwares[i].md5,
+                           self->firmwares[i].sha512,
+                           (guint8) self->firmwares[i].mandatory);
+
+  return g_variant_new ("(msmsmsmsms@a(smasmas)@a(smsmsmsy))",
+                        self->type,
+                        self->name,
+                        self->icon,
+                        self->module,
+                        self->libretro_version,
+                        g_variant_builder_end (&platforms),
+                        g_variant_builder_end (&firmwares));
+}
+
+/**
+ * retro_core_descriptor_get_platforms:
+ * @self: a #RetroCoreDescriptor
+ *
+ * Gets the names of the platforms supported by the core.
+ *
+ * Returns: (array zero-terminated=1) (element-type utf8) (transfer full): a
+ * %NULL-terminated string array, free it with g_strfreev()
+ */
+gchar **
+retro_core_descriptor_get_platforms (RetroCoreDescriptor *self)
+{
+  gchar **platforms;
+
+  g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (self), NULL);
+
+  platforms = g_new (gchar *, self->n_platforms + 1);
+  for (gsize i = 0; i < self->n_platforms; i++)
+    platforms[i] = g_strdup (self->platforms[i].name);
+  platforms[self->n_platforms] = NULL;
+
+  return platforms;
+}
+
+/**
+ * retro_core_descriptor_get_filename:
+ * @self: a #RetroCoreDescriptor
+ *
+ * Gets the file name of @self.
+ *
+ * Returns: the file name of @self
+ */
+const gchar *
+retro_core_descriptor_get_filename (RetroCoreDescriptor *self)
+{
+  g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (self), NULL);
+
+  return self->filename;
+}
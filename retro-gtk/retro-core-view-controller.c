@@ -3,6 +3,7 @@
 #include "retro-core-view-controller-private.h"
 
 #include "retro-controller.h"
+#include "retro-input-private.h"
 
 struct _RetroCoreViewController
 {
@@ -108,6 +109,19 @@ retro_controller_interface_init (RetroControllerInterface *iface)
   iface->set_rumble_state = retro_core_view_controller_set_rumble_state;
 }
 
+static void
+input_changed_cb (RetroCoreViewController *self,
+                  RetroInput              *input)
+{
+  if (retro_input_get_controller_type (input) != self->controller_type)
+    return;
+
+  retro_controller_emit_input_changed (RETRO_CONTROLLER (self),
+                                       input->any.type,
+                                       input->any.id,
+                                       input->any.index);
+}
+
 /* Public */
 
 RetroCoreViewController *
@@ -127,6 +141,11 @@ retro_core_view_controller_new (RetroCoreView       *view,
                            G_CALLBACK (retro_controller_emit_state_changed),
                            self,
                            G_CONNECT_SWAPPED);
+  g_signal_connect_object (view,
+                           "controller-input-changed",
+                           G_CALLBACK (input_changed_cb),
+                           self,
+                           G_CONNECT_SWAPPED);
 
   return self;
 }
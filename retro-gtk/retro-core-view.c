@@ -12,6 +12,7 @@
 #include "retro-gl-display-private.h"
 #include "retro-controller-codes-private.h"
 #include "retro-core-view-controller-private.h"
+#include "retro-debug-private.h"
 #include "retro-input-private.h"
 #include "retro-keyboard-private.h"
 
@@ -39,6 +40,8 @@ struct _RetroCoreView
   gdouble pointer_x;
   gdouble pointer_y;
   gboolean dragging;
+  GtkWidget *statistics_label;
+  guint statistics_timeout_id;
 };
 
 G_DEFINE_TYPE (RetroCoreView, retro_core_view, GTK_TYPE_WIDGET)
@@ -53,6 +56,7 @@ static GParamSpec *properties [N_PROPS];
 
 enum {
   SIGNAL_CONTROLLER_STATE_CHANGED,
+  SIGNAL_CONTROLLER_INPUT_CHANGED,
   N_SIGNALS,
 };
 
@@ -146,6 +150,31 @@ ungrab (RetroCoreView *self)
 static gboolean get_key_state (RetroCoreView *self,
                                guint16        hardware_keycode);
 
+/* A key only affects the keyboard key it types and the joypad buttons it is
+ * mapped to, so only these inputs are reported as changed. */
+static void
+emit_key_changed (RetroCoreView *self,
+                  guint          keyval,
+                  guint          keycode)
+{
+  RetroKeyboardKey key;
+  RetroInput input;
+
+  key = retro_keyboard_key_converter (keyval);
+  if (key != RETRO_KEYBOARD_KEY_UNKNOWN) {
+    retro_input_init (&input, RETRO_CONTROLLER_TYPE_KEYBOARD, key, 0);
+    g_signal_emit (self, signals[SIGNAL_CONTROLLER_INPUT_CHANGED], 0, &input);
+  }
+
+  for (RetroJoypadId button = 0; button < RETRO_JOYPAD_ID_COUNT; button++) {
+    if (retro_key_joypad_mapping_get_button_key (self->key_joypad_mapping, button) != keycode)
+      continue;
+
+    retro_input_init (&input, RETRO_CONTROLLER_TYPE_JOYPAD, button, 0);
+    g_signal_emit (self, signals[SIGNAL_CONTROLLER_INPUT_CHANGED], 0, &input);
+  }
+}
+
 static gboolean
 key_pressed_cb (RetroCoreView   *self,
                 guint            keyval,
@@ -165,7 +194,7 @@ key_pressed_cb (RetroCoreView   *self,
   set_input_pressed (self->keyval_state, keyval);
 
   if (changed)
-    g_signal_emit (self, signals[SIGNAL_CONTROLLER_STATE_CHANGED], 0);
+    emit_key_changed (self, keyval, keycode);
 
   return FALSE;
 }
@@ -179,7 +208,7 @@ key_released_cb (RetroCoreView   *self,
   set_input_released (self->key_state, keycode);
   set_input_released (self->keyval_state, keyval);
 
-  g_signal_emit (self, signals[SIGNAL_CONTROLLER_STATE_CHANGED], 0);
+  emit_key_changed (self, keyval, keycode);
 }
 
 static void
@@ -347,11 +376,86 @@ get_keyboard_key_state (RetroCoreView *self,
   return get_input_state (self->keyval_state, keyval);
 }
 
+static const gchar *
+get_pipeline_stage_name (RetroPipelineStage stage)
+{
+  switch (stage) {
+  case RETRO_PIPELINE_STAGE_RUN:
+    return "Run";
+  case RETRO_PIPELINE_STAGE_VIDEO_REFRESH:
+    return "Video";
+  case RETRO_PIPELINE_STAGE_FRAMEBUFFER_LOCK:
+    return "FB lock";
+  case RETRO_PIPELINE_STAGE_AUDIO_RESAMPLE:
+    return "Resample";
+  case RETRO_PIPELINE_STAGE_AUDIO_WRITE:
+    return "Audio";
+  default:
+    g_assert_not_reached ();
+  }
+}
+
+static gboolean
+update_statistics_cb (RetroCoreView *self)
+{
+  g_autoptr (GString) text = NULL;
+  guint64 count;
+  gdouble mean, p99, max;
+
+  if (self->core == NULL || !retro_core_get_is_initiated (self->core)) {
+    gtk_widget_set_visible (self->statistics_label, FALSE);
+
+    return G_SOURCE_CONTINUE;
+  }
+
+  text = g_string_new (NULL);
+
+  /* Only read the statistics mapped from the runner, a D-Bus call would block
+   * the UI every time. */
+  for (RetroPipelineStage stage = RETRO_PIPELINE_STAGE_RUN;
+       stage <= RETRO_PIPELINE_STAGE_AUDIO_WRITE;
+       stage++) {
+    retro_core_get_pipeline_statistics (self->core, stage, &count, &mean, &p99, &max);
+    g_string_append_printf (text,
+                            "%-8s %8" G_GUINT64_FORMAT " %7.2f %7.2f %7.2f\n",
+                            get_pipeline_stage_name (stage),
+                            count, mean, p99, max);
+  }
+
+  g_string_truncate (text, text->len - 1);
+
+  gtk_label_set_text (GTK_LABEL (self->statistics_label), text->str);
+  gtk_widget_set_visible (self->statistics_label, TRUE);
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* With RETRO_DEBUG=1, show the statistics of the pipeline over the display,
+ * the run stage counting the frames. The columns are the count, the mean, the
+ * 99th percentile and the maximum duration in milliseconds. */
+static void
+setup_statistics_overlay (RetroCoreView *self)
+{
+  self->statistics_label = gtk_label_new (NULL);
+  gtk_widget_add_css_class (self->statistics_label, "monospace");
+  gtk_widget_add_css_class (self->statistics_label, "osd");
+  gtk_widget_set_halign (self->statistics_label, GTK_ALIGN_START);
+  gtk_widget_set_valign (self->statistics_label, GTK_ALIGN_START);
+  gtk_widget_set_can_target (self->statistics_label, FALSE);
+  gtk_widget_set_visible (self->statistics_label, FALSE);
+  gtk_widget_set_parent (self->statistics_label, GTK_WIDGET (self));
+
+  self->statistics_timeout_id =
+    g_timeout_add_seconds (1, (GSourceFunc) update_statistics_cb, self);
+}
+
 static void
 retro_core_view_dispose (GObject *object)
 {
   RetroCoreView *self = RETRO_CORE_VIEW (object);
 
+  g_clear_handle_id (&self->statistics_timeout_id, g_source_remove);
+  g_clear_pointer (&self->statistics_label, gtk_widget_unparent);
   g_clear_pointer ((GtkWidget **) &self->display, gtk_widget_unparent);
 
   g_clear_object (&self->grabbed_device);
@@ -477,6 +581,28 @@ retro_core_view_class_init (RetroCoreViewClass *klass)
                   G_TYPE_NONE,
                   0);
 
+  /**
+   * RetroCoreView::controller-input-changed:
+   * @self: the #RetroCoreView
+   * @input: the #RetroInput that changed
+   *
+   * The ::controller-input-changed signal is emitted when a key is pressed or
+   * released, once for each input it affects.
+   *
+   * Applications should not connect to it.
+   *
+   * Stability: Private
+   */
+  signals[SIGNAL_CONTROLLER_INPUT_CHANGED] =
+    g_signal_new ("controller-input-changed",
+                  RETRO_TYPE_CORE_VIEW,
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL,
+                  NULL,
+                  G_TYPE_NONE,
+                  1,
+                  RETRO_TYPE_INPUT | G_SIGNAL_TYPE_STATIC_SCOPE);
+
   gtk_widget_class_set_layout_manager_type (widget_class, GTK_TYPE_BIN_LAYOUT);
 
   gtk_widget_class_set_css_name (widget_class, "retrocoreview");
@@ -493,6 +619,9 @@ retro_core_view_init (RetroCoreView *self)
   gtk_widget_set_can_focus (GTK_WIDGET (self->display), FALSE);
   gtk_widget_set_parent (GTK_WIDGET (self->display), GTK_WIDGET (self));
 
+  if (G_UNLIKELY (retro_is_debug ()))
+    setup_statistics_overlay (self);
+
   g_object_bind_property (G_OBJECT (self), "sensitive",
                           G_OBJECT (self->display), "sensitive",
                           G_BINDING_BIDIRECTIONAL |
@@ -10,9 +10,11 @@
 #include "retro-core.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/mman.h>
 #include <gio/gunixfdlist.h>
 #include <string.h>
+#include <unistd.h>
 #include "retro-controller-codes.h"
 #include "retro-controller-iterator-private.h"
 #include "retro-controller-state-private.h"
@@ -20,6 +22,8 @@
 #include "retro-core-error-private.h"
 #include "retro-error-private.h"
 #include "retro-framebuffer-private.h"
+#include "retro-pipeline-stats-private.h"
+#include "retro-profiler-private.h"
 #include "retro-input-private.h"
 #include "retro-keyboard-private.h"
 #include "retro-memfd-private.h"
@@ -27,6 +31,7 @@
 #include "retro-option-private.h"
 #include "retro-pixel-format-private.h"
 #include "retro-pixdata-private.h"
+#include "retro-runner-pool-private.h"
 #include "retro-runner-process-private.h"
 
 #define RETRO_CONTROLLER_TYPE_COUNT (RETRO_CONTROLLER_TYPE_POINTER + 1)
@@ -35,6 +40,7 @@ typedef struct {
   RetroController *controller;
   guint port;
   gulong state_changed_id;
+  gulong input_changed_id;
   RetroControllerState *state;
 } RetroCoreControllerInfo;
 
@@ -42,6 +48,7 @@ typedef struct {
   RetroController *controller;
   RetroControllerType type;
   gulong state_changed_id;
+  gulong input_changed_id;
   RetroControllerState *state;
 } RetroCoreDefaultControllerInfo;
 
@@ -50,6 +57,7 @@ struct _RetroCore
   GObject parent_instance;
 
   RetroRunnerProcess *process;
+  RetroRunnerPool *runner_pool;
 
   gchar *filename;
   gchar *system_directory;
@@ -58,6 +66,7 @@ struct _RetroCore
   gchar *user_name;
 
   gchar **media_uris;
+  GArray *media_fds;
   gdouble frames_per_second;
   gboolean game_loaded;
   gboolean support_no_game;
@@ -65,17 +74,19 @@ struct _RetroCore
   GHashTable *options;
   GHashTable *option_overrides;
 
-  RetroControllerState *default_controller_state;
+  RetroControllerState *controller_state;
   RetroCoreDefaultControllerInfo *default_controllers[RETRO_CONTROLLER_TYPE_COUNT];
   GHashTable *controllers;
 
   gdouble runahead;
   gdouble speed_rate;
+  gdouble display_refresh_rate;
 
   GtkWidget *keyboard_widget;
   GtkEventController *key_controller;
 
   RetroFramebuffer *framebuffer;
+  RetroPipelineStats *pipeline_stats;
 };
 
 G_DEFINE_TYPE (RetroCore, retro_core, G_TYPE_OBJECT)
@@ -94,6 +105,8 @@ enum {
   PROP_FRAMES_PER_SECOND,
   PROP_RUNAHEAD,
   PROP_SPEED_RATE,
+  PROP_DISPLAY_REFRESH_RATE,
+  PROP_RUNNER_POOL,
   N_PROPS,
 };
 
@@ -117,6 +130,8 @@ static void exit_cb (RetroRunnerProcess *process,
                      gboolean            success,
                      gchar              *error,
                      RetroCore          *self);
+static void set_runner (RetroCore          *self,
+                        RetroRunnerProcess *process);
 
 /* Private */
 
@@ -124,8 +139,8 @@ static void
 free_controller_info (RetroCoreControllerInfo *info)
 {
   g_signal_handler_disconnect(info->controller, info->state_changed_id);
+  g_signal_handler_disconnect(info->controller, info->input_changed_id);
   g_object_unref (info->controller);
-  g_object_unref (info->state);
   g_free (info);
 }
 
@@ -133,6 +148,7 @@ static void
 free_default_controller_info (RetroCoreDefaultControllerInfo *info)
 {
   g_signal_handler_disconnect(info->controller, info->state_changed_id);
+  g_signal_handler_disconnect(info->controller, info->input_changed_id);
   g_object_unref (info->controller);
   g_free (info);
 }
@@ -141,12 +157,13 @@ static void
 retro_core_constructed (GObject *object)
 {
   RetroCore *self = RETRO_CORE (object);
+  g_autoptr (RetroRunnerProcess) process = NULL;
 
   if (G_UNLIKELY (!self->filename))
     g_error ("A RetroCore’s “filename” property must be set when constructing it.");
 
-  self->process = retro_runner_process_new (self->filename);
-  g_signal_connect_object (self->process, "exit", G_CALLBACK (exit_cb), self, 0);
+  process = retro_runner_process_new (self->filename);
+  set_runner (self, process);
 
   G_OBJECT_CLASS (retro_core_parent_class)->constructed (object);
 }
@@ -157,21 +174,24 @@ retro_core_finalize (GObject *object)
   RetroCore *self = RETRO_CORE (object);
 
   retro_core_set_keyboard (self, NULL);
-  g_object_unref (self->framebuffer);
+  g_clear_object (&self->framebuffer);
+  g_clear_object (&self->pipeline_stats);
 
   if (self->media_uris != NULL)
     g_strfreev (self->media_uris);
+  g_clear_pointer (&self->media_fds, g_array_unref);
 
   for (gsize i = 0; i < RETRO_CONTROLLER_TYPE_COUNT; i++)
     if (self->default_controllers[i])
       free_default_controller_info (self->default_controllers[i]);
-  g_object_unref (self->default_controller_state);
-
   g_hash_table_unref (self->controllers);
+  g_object_unref (self->controller_state);
+
   g_hash_table_unref (self->options);
   g_hash_table_unref (self->option_overrides);
 
   g_object_unref (self->process);
+  g_clear_object (&self->runner_pool);
   g_free (self->filename);
   g_free (self->system_directory);
   g_free (self->core_assets_directory);
@@ -237,6 +257,14 @@ retro_core_get_property (GObject    *object,
   case PROP_SPEED_RATE:
     g_value_set_double (value, retro_core_get_speed_rate (self));
 
+    break;
+  case PROP_DISPLAY_REFRESH_RATE:
+    g_value_set_double (value, retro_core_get_display_refresh_rate (self));
+
+    break;
+  case PROP_RUNNER_POOL:
+    g_value_set_object (value, retro_core_get_runner_pool (self));
+
     break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -281,6 +309,14 @@ retro_core_set_property (GObject      *object,
   case PROP_SPEED_RATE:
     retro_core_set_speed_rate (self, g_value_get_double (value));
 
+    break;
+  case PROP_DISPLAY_REFRESH_RATE:
+    retro_core_set_display_refresh_rate (self, g_value_get_double (value));
+
+    break;
+  case PROP_RUNNER_POOL:
+    retro_core_set_runner_pool (self, g_value_get_object (value));
+
     break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -493,6 +529,39 @@ retro_core_class_init (RetroCoreClass *klass)
                          G_PARAM_STATIC_NICK |
                          G_PARAM_STATIC_BLURB);
 
+  /**
+   * RetroCore:display-refresh-rate:
+   *
+   * The refresh rate of the display the core is shown on, or 0 if unknown. If
+   * the core runs close enough to it, its frames will be paced at the display
+   * refresh rate to avoid judder.
+   */
+  properties[PROP_DISPLAY_REFRESH_RATE] =
+    g_param_spec_double ("display-refresh-rate",
+                         "Display refresh rate",
+                         "The refresh rate of the display",
+                         0.0, G_MAXDOUBLE, 0.0,
+                         G_PARAM_READWRITE |
+                         G_PARAM_STATIC_NAME |
+                         G_PARAM_STATIC_NICK |
+                         G_PARAM_STATIC_BLURB);
+
+  /**
+   * RetroCore:runner-pool:
+   *
+   * The pool to claim a runner process from when booting the core, or %NULL
+   * to always start a new one.
+   */
+  properties[PROP_RUNNER_POOL] =
+    g_param_spec_object ("runner-pool",
+                         "Runner pool",
+                         "The pool to claim a runner process from",
+                         RETRO_TYPE_RUNNER_POOL,
+                         G_PARAM_READWRITE |
+                         G_PARAM_STATIC_NAME |
+                         G_PARAM_STATIC_NICK |
+                         G_PARAM_STATIC_BLURB);
+
   g_object_class_install_properties (G_OBJECT_CLASS (klass), N_PROPS, properties);
 
   /**
@@ -597,8 +666,8 @@ retro_core_init (RetroCore *self)
   self->controllers = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
                                              (GDestroyNotify) free_controller_info);
 
-  fd = retro_memfd_create ("[retro-runner default controller]");
-  self->default_controller_state = retro_controller_state_new (fd);
+  fd = retro_memfd_create ("[retro-runner controllers]");
+  self->controller_state = retro_controller_state_new (fd);
 
   self->speed_rate = 1;
 }
@@ -647,6 +716,32 @@ exit_cb (RetroRunnerProcess *process,
     g_signal_emit (self, signals[SIGNAL_CRASHED], 0, error);
 }
 
+static void
+save_state_cb (IpcRunner    *proxy,
+               GAsyncResult *result,
+               GTask        *task)
+{
+  g_autoptr (GTask) owned_task = task;
+  RetroCore *self = g_task_get_source_object (task);
+  GError *error = NULL;
+
+  if (ipc_runner_call_save_state_finish (proxy, result, &error)) {
+    g_task_return_boolean (task, TRUE);
+
+    return;
+  }
+
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ||
+      g_dbus_error_strip_remote_error (error)) {
+    g_task_return_error (task, error);
+
+    return;
+  }
+
+  crash (self, error);
+  g_task_return_error (task, error);
+}
+
 static gboolean
 key_event (RetroCore       *self,
            guint            keyval,
@@ -656,8 +751,6 @@ key_event (RetroCore       *self,
   RetroKeyboardKey retro_key;
   RetroKeyboardModifierKey retro_modifier_key;
   guint32 character;
-  g_autoptr(GError) error = NULL;
-  IpcRunner *proxy;
 
   if (!retro_core_get_is_initiated (self))
     return FALSE;
@@ -666,11 +759,13 @@ key_event (RetroCore       *self,
   retro_modifier_key = retro_keyboard_modifier_key_converter (keyval, state);
   character = gdk_keyval_to_unicode (keyval);
 
-  proxy = retro_runner_process_get_proxy (self->process);
-  if (!ipc_runner_call_key_event_sync (proxy, pressed, retro_key,
-                                       character, retro_modifier_key, NULL,
-                                       &error))
-    crash (self, error);
+  /* The runner drains the queue when the core polls its input, so this never
+   * waits for it. It drops the events queued while the core wasn't running
+   * when it runs again or resets. */
+  if (!retro_controller_state_push_keyboard_event (self->controller_state,
+                                                   pressed, retro_key,
+                                                   character, retro_modifier_key))
+    g_debug ("Dropped a keyboard event: the queue is full");
 
   return FALSE;
 }
@@ -974,6 +1069,7 @@ video_output_cb (IpcRunner *runner,
   guint width, height;
   gdouble aspect_ratio;
   gconstpointer pixels;
+  gint64 begin_time = retro_profiler_get_time ();
 
   retro_framebuffer_lock (self->framebuffer);
 
@@ -996,6 +1092,8 @@ video_output_cb (IpcRunner *runner,
   g_signal_emit (self, signals[SIGNAL_VIDEO_OUTPUT], 0, &pixdata);
 
   retro_framebuffer_unlock (self->framebuffer);
+
+  retro_profiler_add_mark (begin_time, "Video output", NULL);
 }
 
 static void
@@ -1100,32 +1198,16 @@ serialize_option_overrides (RetroCore *self)
 
 // FIXME Merge this into retro_core_set_controller().
 static void
-set_controller_port_device (RetroCore               *self,
-                            guint                    port,
-                            RetroControllerType      controller_type,
-                            RetroCoreControllerInfo *info)
+set_controller_port_device (RetroCore           *self,
+                            guint                port,
+                            RetroControllerType  controller_type)
 {
   g_autoptr(GError) error = NULL;
-  g_autoptr(GUnixFDList) fd_list = NULL;
-  gint handle;
   IpcRunner *proxy;
 
-  fd_list = g_unix_fd_list_new ();
-  if (info) {
-    gint fd = retro_controller_state_get_fd (info->state);
-    handle = g_unix_fd_list_append (fd_list, fd, &error);
-    if (handle == -1) {
-      crash (self, error);
-      return;
-    }
-  }
-  else
-    handle = -1;
-
   proxy = retro_runner_process_get_proxy (self->process);
   if (!ipc_runner_call_set_controller_sync (proxy, port, controller_type,
-                                            g_variant_new ("h", handle),
-                                            fd_list, NULL, NULL, &error))
+                                            NULL, &error))
     crash (self, error);
 }
 
@@ -1164,39 +1246,290 @@ notify_support_no_game_cb (IpcRunner  *proxy,
   g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_SUPPORT_NO_GAME]);
 }
 
-/**
- * retro_core_boot:
- * @self: a #RetroCore
- * @error: return location for a #GError, or %NULL
- *
- * This initializes @self, loads its available options and loads the medias. You
- * need to boot @self before using some of its methods.
- */
-void
-retro_core_boot (RetroCore  *self,
-                 GError    **error)
+static void
+set_runner (RetroCore          *self,
+            RetroRunnerProcess *process)
 {
-  RetroControllerType controller_type;
+  if (self->process != NULL)
+    g_signal_handlers_disconnect_by_func (self->process, exit_cb, self);
+
+  g_set_object (&self->process, process);
+  g_signal_connect_object (self->process, "exit", G_CALLBACK (exit_cb), self, 0);
+}
+
+static gboolean
+claim_runner (RetroCore *self)
+{
+  g_autoptr (RetroRunnerProcess) process = NULL;
+
+  if (self->runner_pool == NULL)
+    return FALSE;
+
+  process = retro_runner_pool_claim (self->runner_pool, self->filename);
+  if (process == NULL)
+    return FALSE;
+
+  set_runner (self, process);
+
+  return TRUE;
+}
+
+typedef struct {
+  GVariant *variables;
+  GArray *controllers;
+  guint next_controller;
+  gboolean crashed;
+} RetroCoreBootData;
+
+typedef struct {
+  guint port;
+  RetroControllerType type;
+} RetroCoreBootController;
+
+static void
+free_boot_data (RetroCoreBootData *data)
+{
+  g_clear_pointer (&data->variables, g_variant_unref);
+  g_clear_pointer (&data->controllers, g_array_unref);
+  g_free (data);
+}
+
+static GTask *
+new_boot_task (RetroCore           *self,
+               GCancellable        *cancellable,
+               GAsyncReadyCallback  callback,
+               gpointer             user_data)
+{
+  GTask *task;
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, retro_core_boot_async);
+  g_task_set_task_data (task, g_new0 (RetroCoreBootData, 1),
+                        (GDestroyNotify) free_boot_data);
+
+  return task;
+}
+
+static void
+boot_failed (GTask  *task,
+             GError *error)
+{
+  g_autoptr (GTask) owned_task = task;
+  RetroCore *self = g_task_get_source_object (task);
+  RetroCoreBootData *data = g_task_get_task_data (task);
+  g_autoptr (RetroRunnerProcess) process = NULL;
+
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+    /* Drop the half booted runner so @self can be booted again. */
+    process = retro_runner_process_new (self->filename);
+    set_runner (self, process);
+    g_clear_object (&self->framebuffer);
+    g_clear_object (&self->pipeline_stats);
+  } else if (!g_dbus_error_strip_remote_error (error)) {
+    data->crashed = TRUE;
+    crash (self, error);
+  }
+
+  g_task_return_error (task, error);
+}
+
+static gint
+get_handle_fd (GVariant     *variant,
+               GUnixFDList  *fd_list,
+               GError      **error)
+{
+  gint handle;
+
+  g_variant_get (variant, "h", &handle);
+  if (G_UNLIKELY (fd_list == NULL || handle >= g_unix_fd_list_get_length (fd_list))) {
+    g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                 "Invalid FD handle value");
+
+    return -1;
+  }
+
+  return g_unix_fd_list_get (fd_list, handle, error);
+}
+
+static void
+get_properties_cb (IpcRunner    *proxy,
+                   GAsyncResult *result,
+                   GTask        *task)
+{
+  g_autoptr (GTask) owned_task = task;
+  RetroCore *self = g_task_get_source_object (task);
+  RetroCoreBootData *data = g_task_get_task_data (task);
+  GError *error = NULL;
+
+  if (!ipc_runner_call_get_properties_finish (proxy,
+                                              &self->game_loaded,
+                                              &self->frames_per_second,
+                                              &self->support_no_game,
+                                              result, &error)) {
+    boot_failed (g_steal_pointer (&owned_task), error);
+
+    return;
+  }
+
+  g_signal_connect_object (proxy, "notify::api-version", G_CALLBACK (notify_api_version_cb), self, 0);
+  g_signal_connect_object (proxy, "notify::game-loaded", G_CALLBACK (notify_game_loaded_cb), self, 0);
+  g_signal_connect_object (proxy, "notify::frames-per-second", G_CALLBACK (notify_frames_per_second_cb), self, 0);
+  g_signal_connect_object (proxy, "notify::support-no-game", G_CALLBACK (notify_support_no_game_cb), self, 0);
+
+  variables_set_cb (proxy, data->variables, self);
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_IS_INITIATED]);
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_API_VERSION]);
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_GAME_LOADED]);
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_FRAMES_PER_SECOND]);
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_SUPPORT_NO_GAME]);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void set_next_controller (GTask *task);
+
+static void
+set_controller_cb (IpcRunner    *proxy,
+                   GAsyncResult *result,
+                   GTask        *task)
+{
+  RetroCoreBootData *data = g_task_get_task_data (task);
+  GError *error = NULL;
+
+  if (!ipc_runner_call_set_controller_finish (proxy, result, &error)) {
+    boot_failed (task, error);
+
+    return;
+  }
+
+  data->next_controller++;
+  set_next_controller (task);
+}
+
+static void
+set_next_controller (GTask *task)
+{
+  RetroCore *self = g_task_get_source_object (task);
+  RetroCoreBootData *data = g_task_get_task_data (task);
+  RetroCoreBootController *controller;
+  IpcRunner *proxy;
+
+  proxy = retro_runner_process_get_proxy (self->process);
+
+  if (data->next_controller >= data->controllers->len) {
+    ipc_runner_call_get_properties (proxy, g_task_get_cancellable (task),
+                                    (GAsyncReadyCallback) get_properties_cb,
+                                    task);
+
+    return;
+  }
+
+  controller = &g_array_index (data->controllers, RetroCoreBootController,
+                               data->next_controller);
+  ipc_runner_call_set_controller (proxy, controller->port, controller->type,
+                                  g_task_get_cancellable (task),
+                                  (GAsyncReadyCallback) set_controller_cb,
+                                  task);
+}
+
+static void
+get_pipeline_statistics_cb (IpcRunner    *proxy,
+                            GAsyncResult *result,
+                            GTask        *task)
+{
+  RetroCore *self = g_task_get_source_object (task);
+  RetroCoreBootData *data = g_task_get_task_data (task);
+  g_autoptr(GVariant) statistics_variant = NULL;
+  g_autoptr(GUnixFDList) out_fd_list = NULL;
   GHashTableIter iter;
   RetroCoreControllerInfo *info;
-  g_autoptr (GPtrArray) medias_array = NULL;
-  gint length;
-  GError *tmp_error = NULL;
-  IpcRunner *proxy;
-  GVariant *variables;
+  GError *error = NULL;
+  gint fd;
+
+  if (!ipc_runner_call_get_pipeline_statistics_finish (proxy,
+                                                       &statistics_variant,
+                                                       &out_fd_list,
+                                                       result, &error)) {
+    boot_failed (task, error);
+
+    return;
+  }
+
+  fd = get_handle_fd (statistics_variant, out_fd_list, &error);
+  if (fd < 0) {
+    boot_failed (task, error);
+
+    return;
+  }
+
+  g_clear_object (&self->pipeline_stats);
+  self->pipeline_stats = retro_pipeline_stats_new (fd);
+
+  data->controllers = g_array_new (FALSE, FALSE, sizeof (RetroCoreBootController));
+  g_hash_table_iter_init (&iter, self->controllers);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &info)) {
+    RetroCoreBootController controller = {
+      info->port,
+      retro_controller_get_controller_type (info->controller),
+    };
+
+    g_array_append_val (data->controllers, controller);
+  }
+
+  set_next_controller (task);
+}
+
+static void
+boot_cb (IpcRunner    *proxy,
+         GAsyncResult *result,
+         GTask        *task)
+{
+  RetroCore *self = g_task_get_source_object (task);
+  RetroCoreBootData *data = g_task_get_task_data (task);
   g_autoptr(GVariant) framebuffer_variant = NULL;
-  g_autoptr(GUnixFDList) fd_list = NULL;
   g_autoptr(GUnixFDList) out_fd_list = NULL;
-  gint fd, handle;
+  GError *error = NULL;
+  gint fd;
 
-  g_return_if_fail (RETRO_IS_CORE (self));
+  if (!ipc_runner_call_boot_finish (proxy,
+                                    &data->variables,
+                                    &framebuffer_variant,
+                                    &out_fd_list,
+                                    result, &error)) {
+    boot_failed (task, error);
 
-  retro_try ({
-    retro_runner_process_start (self->process, &catch);
-  }, catch, {
-    crash (self, catch);
     return;
-  });
+  }
+
+  fd = get_handle_fd (framebuffer_variant, out_fd_list, &error);
+  if (fd < 0) {
+    boot_failed (task, error);
+
+    return;
+  }
+
+  g_clear_object (&self->framebuffer);
+  self->framebuffer = retro_framebuffer_new (fd);
+
+  ipc_runner_call_get_pipeline_statistics (proxy, NULL,
+                                           g_task_get_cancellable (task),
+                                           (GAsyncReadyCallback) get_pipeline_statistics_cb,
+                                           task);
+}
+
+/* Boots the started runner. Every step is a D-Bus call made asynchronously
+ * and cancellably, the runner loading the content doesn't block the caller. */
+static void
+boot_runner (GTask *task)
+{
+  RetroCore *self = g_task_get_source_object (task);
+  g_autoptr (GPtrArray) medias_array = NULL;
+  g_autoptr(GUnixFDList) fd_list = NULL;
+  GVariantBuilder media_fds;
+  GError *error = NULL;
+  IpcRunner *proxy;
+  gint handle;
 
   proxy = retro_runner_process_get_proxy (self->process);
   g_signal_connect_object (proxy, "variables-set", G_CALLBACK (variables_set_cb), self, 0);
@@ -1220,101 +1553,300 @@ retro_core_boot (RetroCore  *self,
   g_object_bind_property (self,  "runahead",
                           proxy, "runahead",
                           G_BINDING_SYNC_CREATE | G_BINDING_BIDIRECTIONAL);
+  g_object_bind_property (self,  "display-refresh-rate",
+                          proxy, "display-refresh-rate",
+                          G_BINDING_SYNC_CREATE | G_BINDING_BIDIRECTIONAL);
 
   medias_array = g_ptr_array_new ();
   if (self->media_uris) {
-    length = g_strv_length (self->media_uris);
+    gsize length = g_strv_length (self->media_uris);
+
     for (gsize i = 0; i < length; i++)
       g_ptr_array_add (medias_array, self->media_uris[i]);
   }
   g_ptr_array_add (medias_array, NULL);
 
   fd_list = g_unix_fd_list_new ();
-  fd = retro_controller_state_get_fd (self->default_controller_state);
-  handle = g_unix_fd_list_append (fd_list, fd, &tmp_error);
-  if (handle == -1) {
-    crash (self, tmp_error);
-    return;
-  }
 
-  if (!ipc_runner_call_boot_sync (proxy,
-                                  serialize_option_overrides (self),
-                                  (const gchar * const *) medias_array->pdata,
-                                  g_variant_new ("h", handle), fd_list,
-                                  &variables,
-                                  &framebuffer_variant, &out_fd_list,
-                                  NULL, &tmp_error)) {
-    crash_or_propagate_error (self, tmp_error, error);
-    return;
-  }
+  g_variant_builder_init (&media_fds, G_VARIANT_TYPE ("ah"));
+  for (gsize i = 0; self->media_fds != NULL && i < self->media_fds->len; i++) {
+    gint fd = g_array_index (self->media_fds, gint, i);
+
+    handle = fd < 0 ? -1 : g_unix_fd_list_append (fd_list, fd, &error);
+    if (fd >= 0 && handle == -1) {
+      g_variant_builder_clear (&media_fds);
+      boot_failed (task, error);
 
-  g_variant_get (framebuffer_variant, "h", &handle);
-  if (G_LIKELY (handle < g_unix_fd_list_get_length (out_fd_list))) {
-    retro_try ({
-      fd = g_unix_fd_list_get (out_fd_list, handle, &catch);
-    }, catch, {
-      crash (self, catch);
       return;
-    });
-  } else {
-    g_critical ("Invalid framebuffer handle");
-    return;
+    }
+
+    g_variant_builder_add (&media_fds, "h", handle);
   }
 
-  self->framebuffer = retro_framebuffer_new (fd);
+  handle = g_unix_fd_list_append (fd_list,
+                                  retro_controller_state_get_fd (self->controller_state),
+                                  &error);
+  if (handle == -1) {
+    g_variant_builder_clear (&media_fds);
+    boot_failed (task, error);
 
-  g_hash_table_iter_init (&iter, self->controllers);
-  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &info)) {
-    controller_type = retro_controller_get_controller_type (info->controller);
-    set_controller_port_device (self, info->port, controller_type, info);
+    return;
   }
 
-  if (!ipc_runner_call_get_properties_sync (proxy,
-                                            &self->game_loaded,
-                                            &self->frames_per_second,
-                                            &self->support_no_game,
-                                            NULL, &tmp_error)) {
-    crash_or_propagate_error (self, tmp_error, error);
+  ipc_runner_call_boot (proxy,
+                        serialize_option_overrides (self),
+                        (const gchar * const *) medias_array->pdata,
+                        g_variant_builder_end (&media_fds),
+                        g_variant_new ("h", handle), fd_list,
+                        g_task_get_cancellable (task),
+                        (GAsyncReadyCallback) boot_cb, task);
+}
+
+static void
+start_runner_cb (RetroRunnerProcess *process,
+                 GAsyncResult       *result,
+                 GTask              *task)
+{
+  GError *error = NULL;
+
+  if (!retro_runner_process_start_finish (process, result, &error)) {
+    boot_failed (task, error);
+
     return;
   }
 
-  g_signal_connect_object (proxy, "notify::api-version", G_CALLBACK (notify_api_version_cb), self, 0);
-  g_signal_connect_object (proxy, "notify::game-loaded", G_CALLBACK (notify_game_loaded_cb), self, 0);
-  g_signal_connect_object (proxy, "notify::frames-per-second", G_CALLBACK (notify_frames_per_second_cb), self, 0);
-  g_signal_connect_object (proxy, "notify::support-no-game", G_CALLBACK (notify_support_no_game_cb), self, 0);
-
-  variables_set_cb (proxy, variables, self);
+  boot_runner (task);
+}
 
-  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_IS_INITIATED]);
-  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_API_VERSION]);
-  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_GAME_LOADED]);
-  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_FRAMES_PER_SECOND]);
-  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_SUPPORT_NO_GAME]);
+static void
+boot_sync_cb (RetroCore     *self,
+              GAsyncResult  *result,
+              GAsyncResult **result_pointer)
+{
+  *result_pointer = g_object_ref (result);
 }
 
 /**
- * retro_core_set_medias:
+ * retro_core_boot:
  * @self: a #RetroCore
- * @uris: (array zero-terminated=1) (element-type utf8)
- * (transfer none): the URIs
+ * @error: return location for a #GError, or %NULL
  *
- * Sets the medias to load into the core.
+ * This initializes @self, loads its available options and loads the medias. You
+ * need to boot @self before using some of its methods.
  *
- * You can use this before booting the core.
+ * If #RetroCore:runner-pool is set and has an idle runner for @self's core,
+ * that runner is used instead of starting a new one.
+ *
+ * This blocks until the medias are loaded, see retro_core_boot_async() to boot
+ * @self without blocking.
  */
 void
-retro_core_set_medias (RetroCore           *self,
-                       const gchar * const *uris)
+retro_core_boot (RetroCore  *self,
+                 GError    **error)
+{
+  g_autoptr (GMainContext) context = NULL;
+  g_autoptr (GAsyncResult) result = NULL;
+  RetroCoreBootData *data;
+  GError *tmp_error = NULL;
+
+  g_return_if_fail (RETRO_IS_CORE (self));
+
+  /* Start the runner from the caller's context, the proxy emits its signals
+   * in the context it was created in. */
+  if (!claim_runner (self))
+    retro_try ({
+      retro_runner_process_start (self->process, &catch);
+    }, catch, {
+      crash (self, catch);
+      return;
+    });
+
+  context = g_main_context_new ();
+  g_main_context_push_thread_default (context);
+
+  boot_runner (new_boot_task (self, NULL,
+                              (GAsyncReadyCallback) boot_sync_cb, &result));
+
+  while (result == NULL)
+    g_main_context_iteration (context, TRUE);
+
+  g_main_context_pop_thread_default (context);
+
+  if (retro_core_boot_finish (self, result, &tmp_error))
+    return;
+
+  /* The crash was already reported via RetroCore::crashed. */
+  data = g_task_get_task_data (G_TASK (result));
+  if (data->crashed) {
+    g_error_free (tmp_error);
+
+    return;
+  }
+
+  g_propagate_error (error, tmp_error);
+}
+
+/**
+ * retro_core_boot_async:
+ * @self: a #RetroCore
+ * @cancellable: (nullable): a #GCancellable
+ * @callback: a #GAsyncReadyCallback to call when @self is booted
+ * @user_data: the data to pass to @callback
+ *
+ * Asynchronously boots @self, see retro_core_boot(). Starting the runner
+ * process and loading the medias don't block the caller, so the UI keeps
+ * running while large medias are loaded.
+ *
+ * If the operation is cancelled, the runner process is stopped and @self can
+ * be booted again.
+ *
+ * Call retro_core_boot_finish() from @callback to get the result.
+ */
+void
+retro_core_boot_async (RetroCore           *self,
+                       GCancellable        *cancellable,
+                       GAsyncReadyCallback  callback,
+                       gpointer             user_data)
+{
+  GTask *task;
+
+  g_return_if_fail (RETRO_IS_CORE (self));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  task = new_boot_task (self, cancellable, callback, user_data);
+
+  if (claim_runner (self)) {
+    boot_runner (task);
+
+    return;
+  }
+
+  retro_runner_process_start_async (self->process, cancellable,
+                                    (GAsyncReadyCallback) start_runner_cb,
+                                    task);
+}
+
+/**
+ * retro_core_boot_finish:
+ * @self: a #RetroCore
+ * @result: a #GAsyncResult
+ * @error: return location for a #GError, or %NULL
+ *
+ * Finishes an operation started with retro_core_boot_async().
+ *
+ * Returns: whether @self was booted
+ */
+gboolean
+retro_core_boot_finish (RetroCore     *self,
+                        GAsyncResult  *result,
+                        GError       **error)
+{
+  g_return_val_if_fail (RETRO_IS_CORE (self), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * retro_core_set_medias:
+ * @self: a #RetroCore
+ * @uris: (array zero-terminated=1) (element-type utf8)
+ * (transfer none): the URIs
+ *
+ * Sets the medias to load into the core.
+ *
+ * If retro-gtk is built with archive support, a member of an archive can be
+ * loaded by naming it in the fragment of the archive's URI, e.g.
+ * `file:///games/game.zip#game.sfc`. The member is decompressed in memory. If
+ * the `RETRO_CONTENT_CACHE_SIZE` environment variable is set to a size in MiB,
+ * decompressed members are cached in the user's cache directory, the least
+ * recently used ones are removed to fit in that size.
+ *
+ * You can use this before booting the core.
+ */
+void
+retro_core_set_medias (RetroCore           *self,
+                       const gchar * const *uris)
 {
   g_return_if_fail (RETRO_IS_CORE (self));
   g_return_if_fail (!retro_core_get_is_initiated (self));
 
   if (self->media_uris != NULL)
     g_strfreev (self->media_uris);
+  g_clear_pointer (&self->media_fds, g_array_unref);
 
   self->media_uris = g_strdupv ((gchar **) uris);
 }
 
+static void
+close_media_fd (gint *fd)
+{
+  if (*fd >= 0)
+    close (*fd);
+}
+
+/**
+ * retro_core_set_media_fd:
+ * @self: a #RetroCore
+ * @media_index: the media index
+ * @fd: a file descriptor holding the media, or -1 to unset it
+ * @error: return location for a #GError, or %NULL
+ *
+ * Sets the file descriptor the media at @media_index is read from, instead of
+ * the runner process opening its URI. The URI still names the media, e.g. its
+ * extension can be used by the core. This lets you load media you decompressed
+ * or downloaded into a memfd without writing it to a temporary file.
+ *
+ * @fd is duplicated, you keep ownership of it. It must be seekable and
+ * mappable, like a regular file or a memfd. Cores needing the full path of
+ * their medias get a link to the file descriptor named after the URI's
+ * basename, in a private temporary directory removed when the media is
+ * unloaded.
+ *
+ * You can use this before booting the core, after setting the medias.
+ */
+void
+retro_core_set_media_fd (RetroCore  *self,
+                         guint       media_index,
+                         gint        fd,
+                         GError    **error)
+{
+  gint *media_fd;
+  gint new_fd = -1;
+
+  g_return_if_fail (RETRO_IS_CORE (self));
+  g_return_if_fail (!retro_core_get_is_initiated (self));
+  g_return_if_fail (self->media_uris != NULL);
+  g_return_if_fail (media_index < g_strv_length (self->media_uris));
+
+  if (fd >= 0) {
+    new_fd = fcntl (fd, F_DUPFD_CLOEXEC, 3);
+    if (new_fd < 0) {
+      int errsv = errno;
+
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   "Couldn't duplicate the media file descriptor: %s",
+                   g_strerror (errsv));
+
+      return;
+    }
+  }
+
+  if (self->media_fds == NULL) {
+    gint no_fd = -1;
+
+    self->media_fds = g_array_new (FALSE, FALSE, sizeof (gint));
+    g_array_set_clear_func (self->media_fds, (GDestroyNotify) close_media_fd);
+
+    for (gsize i = g_strv_length (self->media_uris); i > 0; i--)
+      g_array_append_val (self->media_fds, no_fd);
+  }
+
+  media_fd = &g_array_index (self->media_fds, gint, media_index);
+  close_media_fd (media_fd);
+  *media_fd = new_fd;
+}
+
 /**
  * retro_core_set_current_media:
  * @self: a #RetroCore
@@ -1421,12 +1953,14 @@ retro_core_iteration (RetroCore *self)
 {
   g_autoptr(GError) error = NULL;
   IpcRunner *proxy;
+  gint64 begin_time;
 
   g_return_if_fail (RETRO_IS_CORE (self));
   g_return_if_fail (retro_core_get_is_initiated (self));
 
   proxy = retro_runner_process_get_proxy (self->process);
 
+  begin_time = retro_profiler_get_time ();
   if (!ipc_runner_call_iteration_sync (proxy, NULL, &error)) {
     crash (self, error);
     return;
@@ -1438,6 +1972,8 @@ retro_core_iteration (RetroCore *self)
    * here and runner process will know not to emit the signal this time.
    * See usage of the block_video_signal field in retro-runner/ipc-runner-impl.c */
   video_output_cb (proxy, self);
+
+  retro_profiler_add_mark (begin_time, "Iteration", NULL);
 }
 
 /**
@@ -1490,6 +2026,64 @@ retro_core_save_state (RetroCore    *self,
     crash_or_propagate_error (self, tmp_error, error);
 }
 
+/**
+ * retro_core_save_state_async:
+ * @self: a #RetroCore
+ * @filename: the file to save the state to
+ * @cancellable: (nullable): a #GCancellable
+ * @callback: a #GAsyncReadyCallback to call when the state is saved
+ * @user_data: the data to pass to @callback
+ *
+ * Asynchronously saves the state of @self. The state is serialized right away
+ * and written in the background, neither the emulation nor the caller are
+ * blocked by the file I/O.
+ *
+ * Call retro_core_save_state_finish() from @callback to get the result.
+ */
+void
+retro_core_save_state_async (RetroCore           *self,
+                             const gchar         *filename,
+                             GCancellable        *cancellable,
+                             GAsyncReadyCallback  callback,
+                             gpointer             user_data)
+{
+  GTask *task;
+  IpcRunner *proxy;
+
+  g_return_if_fail (RETRO_IS_CORE (self));
+  g_return_if_fail (filename != NULL);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+  g_return_if_fail (retro_core_get_is_initiated (self));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, retro_core_save_state_async);
+
+  proxy = retro_runner_process_get_proxy (self->process);
+  ipc_runner_call_save_state (proxy, filename, cancellable,
+                              (GAsyncReadyCallback) save_state_cb, task);
+}
+
+/**
+ * retro_core_save_state_finish:
+ * @self: a #RetroCore
+ * @result: a #GAsyncResult
+ * @error: return location for a #GError, or %NULL
+ *
+ * Finishes an operation started with retro_core_save_state_async().
+ *
+ * Returns: whether the state was saved
+ */
+gboolean
+retro_core_save_state_finish (RetroCore     *self,
+                              GAsyncResult  *result,
+                              GError       **error)
+{
+  g_return_val_if_fail (RETRO_IS_CORE (self), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
 /**
  * retro_core_load_state:
  * @self: a #RetroCore
@@ -1597,14 +2191,81 @@ retro_core_load_memory (RetroCore        *self,
     crash_or_propagate_error (self, tmp_error, error);
 }
 
+/**
+ * retro_core_set_memory_mirror:
+ * @self: a #RetroCore
+ * @memory_type: the type of memory
+ * @filename: (nullable): a file to mirror the data to, or %NULL to disable
+ * @error: return location for a #GError, or %NULL
+ *
+ * Continuously mirrors a memory region of @self to @filename. The region is
+ * first loaded from @filename if it exists, then its changes are written to
+ * the file as they happen, so they persist even if the core crashes.
+ *
+ * This is typically used for battery-backed save RAM.
+ */
+void
+retro_core_set_memory_mirror (RetroCore        *self,
+                              RetroMemoryType   memory_type,
+                              const gchar      *filename,
+                              GError          **error)
+{
+  GError *tmp_error = NULL;
+  IpcRunner *proxy;
+
+  g_return_if_fail (RETRO_IS_CORE (self));
+  g_return_if_fail (retro_core_get_is_initiated (self));
+
+  proxy = retro_runner_process_get_proxy (self->process);
+  if (!ipc_runner_call_set_memory_mirror_sync (proxy, memory_type,
+                                               filename ? filename : "",
+                                               NULL, &tmp_error))
+    crash_or_propagate_error (self, tmp_error, error);
+}
+
+/**
+ * retro_core_set_memory_autosave:
+ * @self: a #RetroCore
+ * @memory_type: the type of memory
+ * @filename: (nullable): a file to save the data to, or %NULL to disable
+ * @interval: the interval between saves in seconds, or 0 to disable
+ * @error: return location for a #GError, or %NULL
+ *
+ * Periodically saves a memory region of @self to @filename, e.g. to avoid
+ * losing the save RAM if the application crashes. The file is only written if
+ * the region changed since it was last saved to or loaded from it.
+ *
+ * Saving a memory region with retro_core_save_memory() is also skipped if it
+ * didn't change.
+ */
+void
+retro_core_set_memory_autosave (RetroCore        *self,
+                                RetroMemoryType   memory_type,
+                                const gchar      *filename,
+                                guint             interval,
+                                GError          **error)
+{
+  GError *tmp_error = NULL;
+  IpcRunner *proxy;
+
+  g_return_if_fail (RETRO_IS_CORE (self));
+  g_return_if_fail (retro_core_get_is_initiated (self));
+
+  proxy = retro_runner_process_get_proxy (self->process);
+  if (!ipc_runner_call_set_memory_autosave_sync (proxy, memory_type,
+                                                 filename ? filename : "",
+                                                 interval, NULL, &tmp_error))
+    crash_or_propagate_error (self, tmp_error, error);
+}
+
 static void
 sync_controller_for_type (RetroControllerState *state,
+                          guint                 port,
                           RetroController      *controller,
                           RetroControllerType   type)
 {
   RetroInput input;
-  g_autofree gint16 *data = NULL;
-  gint max_id, max_index, next;
+  gint max_id, max_index;
 
   if (!retro_controller_has_capability (controller, type))
     return;
@@ -1612,26 +2273,48 @@ sync_controller_for_type (RetroControllerState *state,
   max_id = retro_controller_type_get_id_count (type);
   max_index = retro_controller_type_get_index_count (type);
 
-  data = g_new (gint16, max_index * max_id);
-  next = 0;
-
   for (gint index = 0; index < max_index; index++) {
     for (gint id = 0; id < max_id; id++) {
       retro_input_init (&input, type, id, index);
-      data[next++] = retro_controller_get_input_state (controller, &input);
+      retro_controller_state_set_input (state, port, &input,
+                                        retro_controller_get_input_state (controller, &input));
     }
   }
+}
 
-  retro_controller_state_set_for_type (state, type, data, max_index * max_id);
+static void
+sync_controller_input (RetroControllerState *state,
+                       guint                 port,
+                       RetroController      *controller,
+                       RetroInput           *input)
+{
+  gint16 value = retro_controller_get_input_state (controller, input);
+
+  retro_controller_state_begin_update (state, port);
+  retro_controller_state_set_input (state, port, input, value);
+  retro_controller_state_end_update (state, port);
 }
 
 static void
 default_controller_state_changed_cb (RetroController                *controller,
                                      RetroCoreDefaultControllerInfo *info)
 {
-  retro_controller_state_lock (info->state);
-  sync_controller_for_type (info->state, controller, info->type);
-  retro_controller_state_unlock (info->state);
+  retro_controller_state_begin_update (info->state, RETRO_CONTROLLER_STATE_DEFAULT_PORT);
+  sync_controller_for_type (info->state, RETRO_CONTROLLER_STATE_DEFAULT_PORT,
+                            controller, info->type);
+  retro_controller_state_end_update (info->state, RETRO_CONTROLLER_STATE_DEFAULT_PORT);
+}
+
+static void
+default_controller_input_changed_cb (RetroController                *controller,
+                                     RetroInput                     *input,
+                                     RetroCoreDefaultControllerInfo *info)
+{
+  if (retro_input_get_controller_type (input) != info->type)
+    return;
+
+  sync_controller_input (info->state, RETRO_CONTROLLER_STATE_DEFAULT_PORT,
+                         controller, input);
 }
 
 static void
@@ -1640,17 +2323,29 @@ controller_state_changed_cb (RetroController         *controller,
 {
   gboolean rumble = retro_controller_get_supports_rumble (info->controller);
 
-  retro_controller_state_lock (info->state);
+  retro_controller_state_begin_update (info->state, info->port);
 
-  retro_controller_state_set_supports_rumble (info->state, rumble);
+  retro_controller_state_set_supports_rumble (info->state, info->port, rumble);
 
   for (gsize type = 1; type < RETRO_CONTROLLER_TYPE_COUNT; type++)
     if (retro_controller_has_capability (info->controller, type))
-      sync_controller_for_type (info->state, info->controller, type);
+      sync_controller_for_type (info->state, info->port, info->controller, type);
     else
-      retro_controller_state_clear_type (info->state, type);
+      retro_controller_state_clear_type (info->state, info->port, type);
 
-  retro_controller_state_unlock (info->state);
+  retro_controller_state_end_update (info->state, info->port);
+}
+
+static void
+controller_input_changed_cb (RetroController         *controller,
+                             RetroInput              *input,
+                             RetroCoreControllerInfo *info)
+{
+  if (!retro_controller_has_capability (controller,
+                                        retro_input_get_controller_type (input)))
+    return;
+
+  sync_controller_input (info->state, info->port, controller, input);
 }
 
 /**
@@ -1682,18 +2377,24 @@ retro_core_set_default_controller (RetroCore           *self,
 
     info->controller = g_object_ref (controller);
     info->type = controller_type;
-    info->state = self->default_controller_state;
+    info->state = self->controller_state;
     info->state_changed_id =
       g_signal_connect (controller, "state-changed",
                         G_CALLBACK (default_controller_state_changed_cb), info);
+    info->input_changed_id =
+      g_signal_connect (controller, "input-changed",
+                        G_CALLBACK (default_controller_input_changed_cb), info);
     default_controller_state_changed_cb (info->controller, info);
   }
   else {
     info = NULL;
-    retro_controller_state_lock (self->default_controller_state);
-    retro_controller_state_clear_type (self->default_controller_state,
+    retro_controller_state_begin_update (self->controller_state,
+                                         RETRO_CONTROLLER_STATE_DEFAULT_PORT);
+    retro_controller_state_clear_type (self->controller_state,
+                                       RETRO_CONTROLLER_STATE_DEFAULT_PORT,
                                        controller_type);
-    retro_controller_state_unlock (self->default_controller_state);
+    retro_controller_state_end_update (self->controller_state,
+                                       RETRO_CONTROLLER_STATE_DEFAULT_PORT);
   }
 
   self->default_controllers[controller_type] = info;
@@ -1705,7 +2406,8 @@ retro_core_set_default_controller (RetroCore           *self,
  * @port: the port number
  * @controller: (nullable): a #RetroController
  *
- * Plugs @controller into the specified port number of @self.
+ * Plugs @controller into the specified port number of @self. Ports range from
+ * 0 to 31.
  */
 void
 retro_core_set_controller (RetroCore       *self,
@@ -1716,37 +2418,37 @@ retro_core_set_controller (RetroCore       *self,
   RetroCoreControllerInfo *info;
 
   g_return_if_fail (RETRO_IS_CORE (self));
+  g_return_if_fail (port < RETRO_CONTROLLER_STATE_N_PORTS);
   g_return_if_fail (controller == NULL || RETRO_IS_CONTROLLER (controller));
 
   if (controller != NULL) {
     info = g_new0 (RetroCoreControllerInfo, 1);
-    gint fd;
-    g_autofree gchar *name = NULL;
-
-    name = g_strdup_printf ("[retro-runner controller %u]", port);
-    fd = retro_memfd_create (name);
 
     info->controller = g_object_ref (controller);
     info->port = port;
-    info->state = retro_controller_state_new (fd);
+    info->state = self->controller_state;
     info->state_changed_id =
       g_signal_connect (controller, "state-changed",
                         G_CALLBACK (controller_state_changed_cb), info);
+    info->input_changed_id =
+      g_signal_connect (controller, "input-changed",
+                        G_CALLBACK (controller_input_changed_cb), info);
     controller_state_changed_cb (info->controller, info);
 
     g_hash_table_insert (self->controllers, GUINT_TO_POINTER (port), info);
+    retro_controller_state_set_port_plugged (self->controller_state, port, TRUE);
     controller_type = retro_controller_get_controller_type (controller);
   }
   else {
-    info = NULL;
     g_hash_table_remove (self->controllers, GUINT_TO_POINTER (port));
+    retro_controller_state_set_port_plugged (self->controller_state, port, FALSE);
     controller_type = RETRO_CONTROLLER_TYPE_NONE;
   }
 
   if (!retro_core_get_is_initiated (self))
     return;
 
-  set_controller_port_device (self, port, controller_type, info);
+  set_controller_port_device (self, port, controller_type);
 }
 
 static void
@@ -1875,6 +2577,252 @@ retro_core_set_speed_rate (RetroCore *self,
   g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_SPEED_RATE]);
 }
 
+/**
+ * retro_core_get_display_refresh_rate:
+ * @self: a #RetroCore
+ *
+ * Gets the refresh rate of the display @self is shown on, or 0 if unknown.
+ *
+ * Returns: the display refresh rate
+ */
+gdouble
+retro_core_get_display_refresh_rate (RetroCore *self)
+{
+  g_return_val_if_fail (RETRO_IS_CORE (self), 0.0);
+
+  return self->display_refresh_rate;
+}
+
+/**
+ * retro_core_set_display_refresh_rate:
+ * @self: a #RetroCore
+ * @display_refresh_rate: a refresh rate, or 0 if unknown
+ *
+ * Sets the refresh rate of the display @self is shown on. If @self runs close
+ * enough to it, its frames will be paced at the display refresh rate to avoid
+ * judder, e.g. when running 59.94 Hz content on a 60 Hz display.
+ */
+void
+retro_core_set_display_refresh_rate (RetroCore *self,
+                                     gdouble    display_refresh_rate)
+{
+  g_return_if_fail (RETRO_IS_CORE (self));
+  g_return_if_fail (display_refresh_rate >= 0.0);
+
+  if (self->display_refresh_rate == display_refresh_rate)
+    return;
+
+  self->display_refresh_rate = display_refresh_rate;
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_DISPLAY_REFRESH_RATE]);
+}
+
+/**
+ * retro_core_get_runner_pool:
+ * @self: a #RetroCore
+ *
+ * Gets the pool @self claims its runner process from when booting.
+ *
+ * Returns: (transfer none) (nullable): a #RetroRunnerPool, or %NULL
+ */
+RetroRunnerPool *
+retro_core_get_runner_pool (RetroCore *self)
+{
+  g_return_val_if_fail (RETRO_IS_CORE (self), NULL);
+
+  return self->runner_pool;
+}
+
+/**
+ * retro_core_set_runner_pool:
+ * @self: a #RetroCore
+ * @runner_pool: (nullable): a #RetroRunnerPool, or %NULL
+ *
+ * Sets the pool @self claims its runner process from when booting. Booting
+ * from a pool prepared for @self's core skips spawning the runner, connecting
+ * to it and loading the core.
+ *
+ * You can use this before booting the core.
+ */
+void
+retro_core_set_runner_pool (RetroCore       *self,
+                            RetroRunnerPool *runner_pool)
+{
+  g_return_if_fail (RETRO_IS_CORE (self));
+  g_return_if_fail (runner_pool == NULL || RETRO_IS_RUNNER_POOL (runner_pool));
+
+  if (!g_set_object (&self->runner_pool, runner_pool))
+    return;
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_RUNNER_POOL]);
+}
+
+/**
+ * retro_core_get_frame_statistics:
+ * @self: a #RetroCore
+ * @n_frames: (out) (optional): return location for the number of frames
+ * @mean: (out) (optional): return location for the mean frame time
+ * @p99: (out) (optional): return location for the 99th percentile frame time
+ * @missed_deadlines: (out) (optional): return location for the number of
+ *   frames which missed their deadline
+ *
+ * Gets the statistics of the frames run by @self since it was booted. Frame
+ * times are in milliseconds.
+ */
+void
+retro_core_get_frame_statistics (RetroCore *self,
+                                 guint64   *n_frames,
+                                 gdouble   *mean,
+                                 gdouble   *p99,
+                                 guint64   *missed_deadlines)
+{
+  g_autoptr(GError) error = NULL;
+  guint64 tmp_n_frames = 0, tmp_missed_deadlines = 0;
+  gdouble tmp_mean = 0.0, tmp_p99 = 0.0;
+  IpcRunner *proxy;
+
+  g_return_if_fail (RETRO_IS_CORE (self));
+  g_return_if_fail (retro_core_get_is_initiated (self));
+
+  proxy = retro_runner_process_get_proxy (self->process);
+  if (!ipc_runner_call_get_frame_statistics_sync (proxy, &tmp_n_frames,
+                                                  &tmp_mean, &tmp_p99,
+                                                  &tmp_missed_deadlines,
+                                                  NULL, &error))
+    crash (self, error);
+
+  if (n_frames)
+    *n_frames = tmp_n_frames;
+
+  if (mean)
+    *mean = tmp_mean;
+
+  if (p99)
+    *p99 = tmp_p99;
+
+  if (missed_deadlines)
+    *missed_deadlines = tmp_missed_deadlines;
+}
+
+/**
+ * retro_core_get_pipeline_statistics:
+ * @self: a #RetroCore
+ * @stage: the stage of the pipeline
+ * @count: (out) (optional): return location for the number of times @stage ran
+ * @mean: (out) (optional): return location for the mean duration
+ * @p99: (out) (optional): return location for the 99th percentile duration
+ * @max: (out) (optional): return location for the longest duration
+ *
+ * Gets how long @stage of the pipeline running @self took since it was booted.
+ * Durations are in milliseconds, the 99th percentile is approximated to the
+ * next power of two microseconds.
+ *
+ * This only reads memory shared with the runner process, so it is cheap
+ * enough to be called every frame.
+ */
+void
+retro_core_get_pipeline_statistics (RetroCore          *self,
+                                    RetroPipelineStage  stage,
+                                    guint64            *count,
+                                    gdouble            *mean,
+                                    gdouble            *p99,
+                                    gdouble            *max)
+{
+  g_return_if_fail (RETRO_IS_CORE (self));
+  g_return_if_fail (retro_core_get_is_initiated (self));
+  g_return_if_fail (self->pipeline_stats != NULL);
+
+  retro_pipeline_stats_get (self->pipeline_stats, stage, count, mean, p99, max);
+}
+
+/**
+ * retro_core_benchmark:
+ * @self: a #RetroCore
+ * @n_frames: the number of frames to run
+ * @flags: the outputs of the core to consume
+ * @total_time: (out) (optional): return location for the total time
+ * @core_time: (out) (optional): return location for the time spent running the
+ *   core
+ * @video_time: (out) (optional): return location for the time spent copying
+ *   the video
+ * @audio_time: (out) (optional): return location for the time spent resampling
+ *   the audio
+ * @histogram: (out) (optional) (transfer full) (element-type guint32): return
+ *   location for the histogram of the frame times
+ * @error: return location for a #GError, or %NULL
+ *
+ * Runs @n_frames frames of @self back to back, as fast as possible, and
+ * measures how long they take. The video isn't displayed and the audio isn't
+ * played while benchmarking, @flags sets whether they are still processed. This
+ * blocks until all the frames ran.
+ *
+ * Times are in seconds. The histogram counts the frames by frame time in
+ * buckets of %RETRO_FRAME_HISTOGRAM_BUCKET_USEC microseconds, the last bucket
+ * also counting any slower frame, see retro_frame_histogram_get_percentile().
+ *
+ * Returns: whether the benchmark ran
+ */
+gboolean
+retro_core_benchmark (RetroCore            *self,
+                      guint64               n_frames,
+                      RetroBenchmarkFlags   flags,
+                      gdouble              *total_time,
+                      gdouble              *core_time,
+                      gdouble              *video_time,
+                      gdouble              *audio_time,
+                      GArray              **histogram,
+                      GError              **error)
+{
+  g_autoptr(GVariant) buckets = NULL;
+  GError *tmp_error = NULL;
+  gdouble tmp_total_time, tmp_core_time, tmp_video_time, tmp_audio_time;
+  IpcRunner *proxy;
+  gint timeout;
+  gboolean success;
+
+  g_return_val_if_fail (RETRO_IS_CORE (self), FALSE);
+  g_return_val_if_fail (retro_core_get_is_initiated (self), FALSE);
+
+  proxy = retro_runner_process_get_proxy (self->process);
+
+  /* Benchmarks can take longer than the default D-Bus timeout. */
+  timeout = g_dbus_proxy_get_default_timeout (G_DBUS_PROXY (proxy));
+  g_dbus_proxy_set_default_timeout (G_DBUS_PROXY (proxy), G_MAXINT);
+  success = ipc_runner_call_benchmark_sync (proxy, n_frames, flags,
+                                            &tmp_total_time, &tmp_core_time,
+                                            &tmp_video_time, &tmp_audio_time,
+                                            &buckets, NULL, &tmp_error);
+  g_dbus_proxy_set_default_timeout (G_DBUS_PROXY (proxy), timeout);
+
+  if (!success) {
+    crash_or_propagate_error (self, tmp_error, error);
+
+    return FALSE;
+  }
+
+  if (total_time)
+    *total_time = tmp_total_time;
+
+  if (core_time)
+    *core_time = tmp_core_time;
+
+  if (video_time)
+    *video_time = tmp_video_time;
+
+  if (audio_time)
+    *audio_time = tmp_audio_time;
+
+  if (histogram) {
+    gsize n_buckets;
+    const guint32 *data = g_variant_get_fixed_array (buckets, &n_buckets, sizeof (guint32));
+
+    *histogram = g_array_sized_new (FALSE, FALSE, sizeof (guint32), n_buckets);
+    g_array_append_vals (*histogram, data, n_buckets);
+  }
+
+  return TRUE;
+}
+
 /**
  * retro_core_has_option:
  * @self: a #RetroCore
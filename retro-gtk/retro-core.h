@@ -7,9 +7,13 @@
 #endif
 
 #include <gtk/gtk.h>
+#include "retro-benchmark-flags.h"
+#include "retro-frame-histogram.h"
 #include "retro-controller-iterator.h"
 #include "retro-memory-type.h"
 #include "retro-option-iterator.h"
+#include "retro-pipeline-stage.h"
+#include "retro-runner-pool.h"
 
 G_BEGIN_DECLS
 
@@ -38,8 +42,19 @@ gboolean retro_core_get_support_no_game (RetroCore *self);
 gdouble retro_core_get_frames_per_second (RetroCore *self);
 void retro_core_boot (RetroCore  *self,
                       GError    **error);
+void retro_core_boot_async (RetroCore           *self,
+                            GCancellable        *cancellable,
+                            GAsyncReadyCallback  callback,
+                            gpointer             user_data);
+gboolean retro_core_boot_finish (RetroCore     *self,
+                                 GAsyncResult  *result,
+                                 GError       **error);
 void retro_core_set_medias (RetroCore           *self,
                             const gchar * const *uris);
+void retro_core_set_media_fd (RetroCore  *self,
+                              guint       media_index,
+                              gint        fd,
+                              GError    **error);
 void retro_core_set_current_media (RetroCore  *self,
                                    guint       media_index,
                                    GError    **error);
@@ -51,6 +66,14 @@ gboolean retro_core_get_can_access_state (RetroCore *self);
 void retro_core_save_state (RetroCore    *self,
                             const gchar  *filename,
                             GError      **error);
+void retro_core_save_state_async (RetroCore           *self,
+                                  const gchar         *filename,
+                                  GCancellable        *cancellable,
+                                  GAsyncReadyCallback  callback,
+                                  gpointer             user_data);
+gboolean retro_core_save_state_finish (RetroCore     *self,
+                                       GAsyncResult  *result,
+                                       GError       **error);
 void retro_core_load_state (RetroCore    *self,
                             const gchar  *filename,
                             GError      **error);
@@ -64,6 +87,15 @@ void retro_core_load_memory (RetroCore        *self,
                              RetroMemoryType   memory_type,
                              const gchar      *filename,
                              GError          **error);
+void retro_core_set_memory_mirror (RetroCore        *self,
+                                   RetroMemoryType   memory_type,
+                                   const gchar      *filename,
+                                   GError          **error);
+void retro_core_set_memory_autosave (RetroCore        *self,
+                                     RetroMemoryType   memory_type,
+                                     const gchar      *filename,
+                                     guint             interval,
+                                     GError          **error);
 void retro_core_set_default_controller (RetroCore           *self,
                                         RetroControllerType  controller_type,
                                         RetroController     *controller);
@@ -79,6 +111,32 @@ void retro_core_set_runahead (RetroCore *self,
 gdouble retro_core_get_speed_rate (RetroCore *self);
 void retro_core_set_speed_rate (RetroCore *self,
                                 gdouble    speed_rate);
+gdouble retro_core_get_display_refresh_rate (RetroCore *self);
+void retro_core_set_display_refresh_rate (RetroCore *self,
+                                          gdouble    display_refresh_rate);
+RetroRunnerPool *retro_core_get_runner_pool (RetroCore *self);
+void retro_core_set_runner_pool (RetroCore       *self,
+                                 RetroRunnerPool *runner_pool);
+void retro_core_get_frame_statistics (RetroCore *self,
+                                      guint64   *n_frames,
+                                      gdouble   *mean,
+                                      gdouble   *p99,
+                                      guint64   *missed_deadlines);
+void retro_core_get_pipeline_statistics (RetroCore          *self,
+                                         RetroPipelineStage  stage,
+                                         guint64            *count,
+                                         gdouble            *mean,
+                                         gdouble            *p99,
+                                         gdouble            *max);
+gboolean retro_core_benchmark (RetroCore            *self,
+                               guint64               n_frames,
+                               RetroBenchmarkFlags   flags,
+                               gdouble              *total_time,
+                               gdouble              *core_time,
+                               gdouble              *video_time,
+                               gdouble              *audio_time,
+                               GArray              **histogram,
+                               GError              **error);
 gboolean retro_core_has_option (RetroCore   *self,
                                 const gchar *key);
 RetroOption *retro_core_get_option (RetroCore   *self,
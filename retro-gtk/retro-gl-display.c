@@ -15,6 +15,7 @@
 #include "retro-glsl-filter-private.h"
 #include "retro-pixbuf.h"
 #include "retro-pixdata.h"
+#include "retro-profiler-private.h"
 
 #define RETRO_VIDEO_FILTER_COUNT (RETRO_VIDEO_FILTER_CRT + 1)
 
@@ -292,6 +293,7 @@ render (RetroGLDisplay *self)
   RetroVideoFilter filter;
   gint texture_width;
   gint texture_height;
+  gint64 begin_time = retro_profiler_get_time ();
 
   glClear (GL_COLOR_BUFFER_BIT);
 
@@ -306,6 +308,8 @@ render (RetroGLDisplay *self)
 
   draw_texture (self, self->glsl_filter[filter], texture_width, texture_height);
 
+  retro_profiler_add_mark (begin_time, "Render", NULL);
+
   return FALSE;
 }
 
@@ -4,6 +4,7 @@
 
 #define __RETRO_GTK_INSIDE__
 
+#include "retro-benchmark-flags.h"
 #include "retro-controller.h"
 #include "retro-controller-codes.h"
 #include "retro-controller-iterator.h"
@@ -11,6 +12,7 @@
 #include "retro-core.h"
 #include "retro-core-descriptor.h"
 #include "retro-core-view.h"
+#include "retro-frame-histogram.h"
 #include "retro-gtk-version.h"
 #include "retro-input.h"
 #include "retro-key-joypad-mapping.h"
@@ -20,9 +22,11 @@
 #include "retro-module-query.h"
 #include "retro-option.h"
 #include "retro-option-iterator.h"
+#include "retro-pipeline-stage.h"
 #include "retro-pixbuf.h"
 #include "retro-pixdata.h"
 #include "retro-rumble-effect.h"
+#include "retro-runner-pool.h"
 #include "retro-video-filter.h"
 
 #undef __RETRO_GTK_INSIDE__
@@ -0,0 +1,48 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#pragma once
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include "retro-core-descriptor.h"
+
+G_BEGIN_DECLS
+
+#define RETRO_TYPE_MODULE_INDEX (retro_module_index_get_type())
+
+G_DECLARE_FINAL_TYPE (RetroModuleIndex, retro_module_index, RETRO, MODULE_INDEX, GObject)
+
+RetroModuleIndex *retro_module_index_new (const gchar *filename) G_GNUC_WARN_UNUSED_RESULT;
+void retro_module_index_begin (RetroModuleIndex *self);
+void retro_module_index_end (RetroModuleIndex *self,
+                             gboolean          complete);
+gboolean retro_module_index_lookup_directory (RetroModuleIndex   *self,
+                                              const gchar        *path,
+                                              GStatBuf           *buf,
+                                              gchar            ***descriptors,
+                                              gchar            ***sub_directories);
+void retro_module_index_add_directory (RetroModuleIndex    *self,
+                                       const gchar         *path,
+                                       GStatBuf            *buf,
+                                       const gchar * const *descriptors,
+                                       const gchar * const *sub_directories);
+gboolean retro_module_index_lookup_descriptor (RetroModuleIndex     *self,
+                                               const gchar          *path,
+                                               GStatBuf             *buf,
+                                               RetroCoreDescriptor **descriptor);
+void retro_module_index_add_descriptor (RetroModuleIndex    *self,
+                                        const gchar         *path,
+                                        GStatBuf            *buf,
+                                        RetroCoreDescriptor *descriptor);
+void retro_module_index_remove_descriptor (RetroModuleIndex *self,
+                                           const gchar      *path);
+void retro_module_index_save (RetroModuleIndex *self);
+gboolean retro_module_index_list_directory (RetroModuleIndex   *self,
+                                            const gchar        *path,
+                                            gchar            ***descriptors,
+                                            gchar            ***sub_directories,
+                                            GError            **error);
+RetroCoreDescriptor *retro_module_index_load_descriptor (RetroModuleIndex *self,
+                                                         const gchar      *path) G_GNUC_WARN_UNUSED_RESULT;
+
+G_END_DECLS
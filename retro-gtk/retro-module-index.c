@@ -0,0 +1,599 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#include "retro-module-index-private.h"
+
+#include <errno.h>
+#include "retro-core-descriptor-private.h"
+#include "retro-error-private.h"
+
+/* The index maps the path of each visited directory to its modification time,
+ * inode, and the core descriptors and sub-directories it contains, and the
+ * path of each core descriptor to its modification time, inode, size and
+ * parsed data, or nothing if the descriptor is invalid. A directory's or
+ * descriptor's entry is reused only if its file didn't change. */
+#define RETRO_MODULE_INDEX_VERSION 2
+#define RETRO_MODULE_INDEX_DIRECTORY_TYPE "(xtasas)"
+#define RETRO_MODULE_INDEX_DESCRIPTOR_TYPE "(xttm" RETRO_CORE_DESCRIPTOR_VARIANT_TYPE ")"
+#define RETRO_MODULE_INDEX_TYPE "(ua{s" RETRO_MODULE_INDEX_DIRECTORY_TYPE "}a{s" RETRO_MODULE_INDEX_DESCRIPTOR_TYPE "})"
+
+struct _RetroModuleIndex
+{
+  GObject parent_instance;
+  gchar *filename;
+  GVariant *cached_directories;
+  GVariant *cached_descriptors;
+  GHashTable *directories;
+  GHashTable *descriptors;
+  gboolean changed;
+  guint n_walks;
+  gboolean complete;
+  /* Protects everything but the filename, the walks run on several threads. */
+  GMutex mutex;
+};
+
+G_DEFINE_TYPE (RetroModuleIndex, retro_module_index, G_TYPE_OBJECT)
+
+/* Private */
+
+static void
+retro_module_index_finalize (GObject *object)
+{
+  RetroModuleIndex *self = RETRO_MODULE_INDEX (object);
+
+  g_free (self->filename);
+  g_clear_pointer (&self->cached_directories, g_variant_unref);
+  g_clear_pointer (&self->cached_descriptors, g_variant_unref);
+  g_hash_table_unref (self->directories);
+  g_hash_table_unref (self->descriptors);
+  g_mutex_clear (&self->mutex);
+
+  G_OBJECT_CLASS (retro_module_index_parent_class)->finalize (object);
+}
+
+static void
+retro_module_index_class_init (RetroModuleIndexClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = retro_module_index_finalize;
+}
+
+static void
+retro_module_index_init (RetroModuleIndex *self)
+{
+  self->directories = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                             g_free, (GDestroyNotify) g_variant_unref);
+  self->descriptors = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                             g_free, (GDestroyNotify) g_variant_unref);
+  g_mutex_init (&self->mutex);
+}
+
+static gint64
+get_mtime (GStatBuf *buf)
+{
+  return (gint64) buf->st_mtim.tv_sec * G_GINT64_CONSTANT (1000000000) +
+         buf->st_mtim.tv_nsec;
+}
+
+static void
+load (RetroModuleIndex *self)
+{
+  g_autoptr (GMappedFile) mapped_file = NULL;
+  g_autoptr (GBytes) bytes = NULL;
+  g_autoptr (GVariant) index = NULL;
+  guint32 version;
+
+  mapped_file = g_mapped_file_new (self->filename, FALSE, NULL);
+  if (mapped_file == NULL)
+    return;
+
+  /* The variant keeps the mapping alive. */
+  bytes = g_mapped_file_get_bytes (mapped_file);
+  index = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (RETRO_MODULE_INDEX_TYPE),
+                                                        bytes, FALSE));
+
+  g_variant_get_child (index, 0, "u", &version);
+  if (version != RETRO_MODULE_INDEX_VERSION)
+    return;
+
+  self->cached_directories = g_variant_get_child_value (index, 1);
+  self->cached_descriptors = g_variant_get_child_value (index, 2);
+}
+
+static GVariant *
+build_dictionary (GHashTable  *table,
+                  const gchar *value_type)
+{
+  g_autofree gchar *type = g_strdup_printf ("a{s%s}", value_type);
+  GVariantBuilder builder;
+  GHashTableIter iter;
+  const gchar *path;
+  GVariant *value;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE (type));
+  g_hash_table_iter_init (&iter, table);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &path, (gpointer *) &value))
+    g_variant_builder_add (&builder, "{s@*}", path, value);
+
+  return g_variant_builder_end (&builder);
+}
+
+static gsize
+get_n_cached (GVariant *dictionary)
+{
+  return dictionary != NULL ? g_variant_n_children (dictionary) : 0;
+}
+
+/* The cached entries are replaced when saving, keep them alive while using
+ * them. */
+static GVariant *
+ref_cached (RetroModuleIndex  *self,
+            GVariant         **cached)
+{
+  g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&self->mutex);
+
+  return *cached != NULL ? g_variant_ref (*cached) : NULL;
+}
+
+/* Public */
+
+/**
+ * retro_module_index_begin:
+ * @self: a #RetroModuleIndex
+ *
+ * Starts a new walk through the lookup paths, the entries visited during it
+ * will be saved by retro_module_index_save(). The walks running at once share
+ * the visited entries. Each walk must be ended by retro_module_index_end().
+ */
+void
+retro_module_index_begin (RetroModuleIndex *self)
+{
+  g_return_if_fail (RETRO_IS_MODULE_INDEX (self));
+
+  g_mutex_lock (&self->mutex);
+  if (self->n_walks++ == 0) {
+    g_hash_table_remove_all (self->directories);
+    g_hash_table_remove_all (self->descriptors);
+    self->changed = FALSE;
+    self->complete = FALSE;
+  }
+  g_mutex_unlock (&self->mutex);
+}
+
+/**
+ * retro_module_index_end:
+ * @self: a #RetroModuleIndex
+ * @complete: whether all the lookup paths were walked through
+ *
+ * Ends a walk started by retro_module_index_begin().
+ */
+void
+retro_module_index_end (RetroModuleIndex *self,
+                        gboolean          complete)
+{
+  g_return_if_fail (RETRO_IS_MODULE_INDEX (self));
+
+  g_mutex_lock (&self->mutex);
+  g_assert (self->n_walks > 0);
+  self->n_walks--;
+  if (complete)
+    self->complete = TRUE;
+  g_mutex_unlock (&self->mutex);
+}
+
+/**
+ * retro_module_index_lookup_directory:
+ * @self: a #RetroModuleIndex
+ * @path: the path of a directory
+ * @buf: the status of the directory
+ * @descriptors: (out) (transfer full): return location for the core
+ *   descriptors in the directory
+ * @sub_directories: (out) (transfer full): return location for the
+ *   sub-directories of the directory
+ *
+ * Gets the content of the directory at @path, if it didn't change since it was
+ * indexed.
+ *
+ * Returns: whether the directory was indexed and didn't change
+ */
+gboolean
+retro_module_index_lookup_directory (RetroModuleIndex   *self,
+                                     const gchar        *path,
+                                     GStatBuf           *buf,
+                                     gchar            ***descriptors,
+                                     gchar            ***sub_directories)
+{
+  g_autoptr (GVariant) cached = NULL;
+  g_autoptr (GVariant) entry = NULL;
+  gint64 mtime;
+  guint64 inode;
+
+  g_return_val_if_fail (RETRO_IS_MODULE_INDEX (self), FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+  g_return_val_if_fail (buf != NULL, FALSE);
+  g_return_val_if_fail (descriptors != NULL, FALSE);
+  g_return_val_if_fail (sub_directories != NULL, FALSE);
+
+  cached = ref_cached (self, &self->cached_directories);
+  if (cached == NULL)
+    return FALSE;
+
+  entry = g_variant_lookup_value (cached, path,
+                                  G_VARIANT_TYPE (RETRO_MODULE_INDEX_DIRECTORY_TYPE));
+  if (entry == NULL)
+    return FALSE;
+
+  g_variant_get_child (entry, 0, "x", &mtime);
+  g_variant_get_child (entry, 1, "t", &inode);
+  if (mtime != get_mtime (buf) || inode != buf->st_ino)
+    return FALSE;
+
+  g_variant_get_child (entry, 2, "^as", descriptors);
+  g_variant_get_child (entry, 3, "^as", sub_directories);
+
+  g_mutex_lock (&self->mutex);
+  g_hash_table_insert (self->directories, g_strdup (path), g_steal_pointer (&entry));
+  g_mutex_unlock (&self->mutex);
+
+  return TRUE;
+}
+
+/**
+ * retro_module_index_add_directory:
+ * @self: a #RetroModuleIndex
+ * @path: the path of a directory
+ * @buf: the status of the directory
+ * @descriptors: the core descriptors in the directory
+ * @sub_directories: the sub-directories of the directory
+ *
+ * Indexes the content of the directory at @path.
+ */
+void
+retro_module_index_add_directory (RetroModuleIndex    *self,
+                                  const gchar         *path,
+                                  GStatBuf            *buf,
+                                  const gchar * const *descriptors,
+                                  const gchar * const *sub_directories)
+{
+  GVariant *entry;
+
+  g_return_if_fail (RETRO_IS_MODULE_INDEX (self));
+  g_return_if_fail (path != NULL);
+  g_return_if_fail (buf != NULL);
+  g_return_if_fail (descriptors != NULL);
+  g_return_if_fail (sub_directories != NULL);
+
+  entry = g_variant_new ("(xt^as^as)",
+                         get_mtime (buf), (guint64) buf->st_ino,
+                         descriptors, sub_directories);
+
+  g_mutex_lock (&self->mutex);
+  g_hash_table_insert (self->directories, g_strdup (path), g_variant_ref_sink (entry));
+  self->changed = TRUE;
+  g_mutex_unlock (&self->mutex);
+}
+
+/**
+ * retro_module_index_lookup_descriptor:
+ * @self: a #RetroModuleIndex
+ * @path: the path of a core descriptor
+ * @buf: the status of the core descriptor
+ * @descriptor: (out) (transfer full) (nullable): return location for the
+ *   core descriptor, or %NULL if it is invalid
+ *
+ * Gets the core descriptor at @path, if it didn't change since it was indexed.
+ *
+ * Returns: whether the core descriptor was indexed and didn't change
+ */
+gboolean
+retro_module_index_lookup_descriptor (RetroModuleIndex     *self,
+                                      const gchar          *path,
+                                      GStatBuf             *buf,
+                                      RetroCoreDescriptor **descriptor)
+{
+  g_autoptr (GVariant) cached = NULL;
+  g_autoptr (GVariant) entry = NULL;
+  g_autoptr (GVariant) maybe_data = NULL;
+  g_autoptr (GVariant) data = NULL;
+  gint64 mtime;
+  guint64 inode, size;
+
+  g_return_val_if_fail (RETRO_IS_MODULE_INDEX (self), FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+  g_return_val_if_fail (buf != NULL, FALSE);
+  g_return_val_if_fail (descriptor != NULL, FALSE);
+
+  cached = ref_cached (self, &self->cached_descriptors);
+  if (cached == NULL)
+    return FALSE;
+
+  entry = g_variant_lookup_value (cached, path,
+                                  G_VARIANT_TYPE (RETRO_MODULE_INDEX_DESCRIPTOR_TYPE));
+  if (entry == NULL)
+    return FALSE;
+
+  g_variant_get (entry, "(xtt@m*)", &mtime, &inode, &size, &maybe_data);
+  if (mtime != get_mtime (buf) || inode != buf->st_ino || size != buf->st_size)
+    return FALSE;
+
+  data = g_variant_get_maybe (maybe_data);
+  *descriptor = data != NULL ? retro_core_descriptor_new_from_variant (path, data) : NULL;
+
+  g_mutex_lock (&self->mutex);
+  g_hash_table_insert (self->descriptors, g_strdup (path), g_steal_pointer (&entry));
+  g_mutex_unlock (&self->mutex);
+
+  return TRUE;
+}
+
+/**
+ * retro_module_index_add_descriptor:
+ * @self: a #RetroModuleIndex
+ * @path: the path of a core descriptor
+ * @buf: the status of the core descriptor
+ * @descriptor: (nullable): the core descriptor, or %NULL if it is invalid
+ *
+ * Indexes the core descriptor at @path.
+ */
+void
+retro_module_index_add_descriptor (RetroModuleIndex    *self,
+                                   const gchar         *path,
+                                   GStatBuf            *buf,
+                                   RetroCoreDescriptor *descriptor)
+{
+  GVariant *data = NULL;
+  GVariant *entry;
+
+  g_return_if_fail (RETRO_IS_MODULE_INDEX (self));
+  g_return_if_fail (path != NULL);
+  g_return_if_fail (buf != NULL);
+  g_return_if_fail (descriptor == NULL || RETRO_IS_CORE_DESCRIPTOR (descriptor));
+
+  if (descriptor != NULL)
+    data = retro_core_descriptor_serialize (descriptor);
+
+  entry = g_variant_new ("(xtt@m*)",
+                         get_mtime (buf), (guint64) buf->st_ino,
+                         (guint64) buf->st_size,
+                         g_variant_new_maybe (G_VARIANT_TYPE (RETRO_CORE_DESCRIPTOR_VARIANT_TYPE),
+                                              data));
+
+  g_mutex_lock (&self->mutex);
+  g_hash_table_insert (self->descriptors, g_strdup (path), g_variant_ref_sink (entry));
+  self->changed = TRUE;
+  g_mutex_unlock (&self->mutex);
+}
+
+/**
+ * retro_module_index_remove_descriptor:
+ * @self: a #RetroModuleIndex
+ * @path: the path of a core descriptor
+ *
+ * Removes the core descriptor at @path from the index.
+ */
+void
+retro_module_index_remove_descriptor (RetroModuleIndex *self,
+                                      const gchar      *path)
+{
+  g_return_if_fail (RETRO_IS_MODULE_INDEX (self));
+  g_return_if_fail (path != NULL);
+
+  g_mutex_lock (&self->mutex);
+  if (g_hash_table_remove (self->descriptors, path))
+    self->changed = TRUE;
+  g_mutex_unlock (&self->mutex);
+}
+
+/**
+ * retro_module_index_save:
+ * @self: a #RetroModuleIndex
+ *
+ * Saves the entries visited since retro_module_index_begin() if anything
+ * changed, forgetting the directories and core descriptors which weren't
+ * visited.
+ *
+ * Nothing is saved while walking or if no walk completed since the entries
+ * were cleared, as the unvisited entries would be dropped. The walk saves
+ * the index once complete.
+ */
+void
+retro_module_index_save (RetroModuleIndex *self)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+  g_autoptr (GVariant) index = NULL;
+  g_autoptr (GError) error = NULL;
+  g_autofree gchar *directory = NULL;
+
+  g_return_if_fail (RETRO_IS_MODULE_INDEX (self));
+
+  locker = g_mutex_locker_new (&self->mutex);
+
+  if (self->n_walks > 0 || !self->complete)
+    return;
+
+  if (!self->changed &&
+      g_hash_table_size (self->directories) == get_n_cached (self->cached_directories) &&
+      g_hash_table_size (self->descriptors) == get_n_cached (self->cached_descriptors))
+    return;
+
+  g_clear_pointer (&self->cached_directories, g_variant_unref);
+  g_clear_pointer (&self->cached_descriptors, g_variant_unref);
+  self->cached_directories =
+    g_variant_ref_sink (build_dictionary (self->directories,
+                                          RETRO_MODULE_INDEX_DIRECTORY_TYPE));
+  self->cached_descriptors =
+    g_variant_ref_sink (build_dictionary (self->descriptors,
+                                          RETRO_MODULE_INDEX_DESCRIPTOR_TYPE));
+  self->changed = FALSE;
+
+  index = g_variant_ref_sink (g_variant_new ("(u@a{s" RETRO_MODULE_INDEX_DIRECTORY_TYPE "}"
+                                             "@a{s" RETRO_MODULE_INDEX_DESCRIPTOR_TYPE "})",
+                                             RETRO_MODULE_INDEX_VERSION,
+                                             self->cached_directories,
+                                             self->cached_descriptors));
+
+  directory = g_path_get_dirname (self->filename);
+  if (g_mkdir_with_parents (directory, 0755) != 0 ||
+      !g_file_set_contents (self->filename,
+                            g_variant_get_data (index),
+                            g_variant_get_size (index),
+                            &error))
+    g_debug ("Couldn't save the module index: %s",
+             error != NULL ? error->message : g_strerror (errno));
+}
+
+/**
+ * retro_module_index_list_directory:
+ * @self: (nullable): a #RetroModuleIndex, or %NULL
+ * @path: the path of a directory
+ * @descriptors: (out) (transfer full): return location for the core
+ *   descriptors in the directory
+ * @sub_directories: (out) (transfer full): return location for the
+ *   sub-directories of the directory
+ * @error: return location for a #GError, or %NULL
+ *
+ * Lists the core descriptors and sub-directories in the directory at @path,
+ * reusing and updating @self if not %NULL. Symbolic links to directories
+ * aren't listed as sub-directories.
+ *
+ * This can be called from any thread.
+ *
+ * Returns: whether the directory could be listed
+ */
+gboolean
+retro_module_index_list_directory (RetroModuleIndex   *self,
+                                   const gchar        *path,
+                                   gchar            ***descriptors,
+                                   gchar            ***sub_directories,
+                                   GError            **error)
+{
+  g_autoptr (GFile) directory = NULL;
+  g_autoptr (GFileEnumerator) file_enumerator = NULL;
+  g_autoptr (GPtrArray) descriptor_names = NULL;
+  g_autoptr (GPtrArray) sub_directory_names = NULL;
+  GStatBuf buf;
+  gboolean indexed;
+
+  g_return_val_if_fail (self == NULL || RETRO_IS_MODULE_INDEX (self), FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+  g_return_val_if_fail (descriptors != NULL, FALSE);
+  g_return_val_if_fail (sub_directories != NULL, FALSE);
+
+  indexed = self != NULL && g_stat (path, &buf) == 0;
+
+  if (indexed &&
+      retro_module_index_lookup_directory (self, path, &buf,
+                                           descriptors, sub_directories))
+    return TRUE;
+
+  directory = g_file_new_for_path (path);
+
+  retro_try_propagate_val ({
+    file_enumerator =
+      g_file_enumerate_children (directory,
+                                 G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                 G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                                 G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                 NULL,
+                                 &catch);
+  }, catch, error, FALSE);
+
+  descriptor_names = g_ptr_array_new_with_free_func (g_free);
+  sub_directory_names = g_ptr_array_new_with_free_func (g_free);
+
+  while (TRUE) {
+    g_autoptr (GFileInfo) info = NULL;
+    const gchar *name;
+
+    retro_try_propagate_val ({
+      info = g_file_enumerator_next_file (file_enumerator, NULL, &catch);
+    }, catch, error, FALSE);
+
+    if (info == NULL)
+      break;
+
+    name = g_file_info_get_name (info);
+
+    if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+      g_ptr_array_add (sub_directory_names, g_strdup (name));
+    else if (g_str_has_suffix (name, ".libretro"))
+      g_ptr_array_add (descriptor_names, g_strdup (name));
+  }
+
+  g_ptr_array_add (descriptor_names, NULL);
+  g_ptr_array_add (sub_directory_names, NULL);
+  *descriptors = (gchar **) g_ptr_array_free (g_steal_pointer (&descriptor_names), FALSE);
+  *sub_directories = (gchar **) g_ptr_array_free (g_steal_pointer (&sub_directory_names), FALSE);
+
+  if (indexed)
+    retro_module_index_add_directory (self, path, &buf,
+                                      (const gchar * const *) *descriptors,
+                                      (const gchar * const *) *sub_directories);
+
+  return TRUE;
+}
+
+/**
+ * retro_module_index_load_descriptor:
+ * @self: (nullable): a #RetroModuleIndex, or %NULL
+ * @path: the path of a core descriptor
+ *
+ * Loads the core descriptor at @path, reusing and updating @self if not
+ * %NULL.
+ *
+ * This can be called from any thread.
+ *
+ * Returns: (transfer full) (nullable): a #RetroCoreDescriptor, or %NULL if it
+ * is invalid
+ */
+RetroCoreDescriptor *
+retro_module_index_load_descriptor (RetroModuleIndex *self,
+                                    const gchar      *path)
+{
+  RetroCoreDescriptor *core_descriptor = NULL;
+  GStatBuf buf;
+  gboolean indexed;
+
+  g_return_val_if_fail (self == NULL || RETRO_IS_MODULE_INDEX (self), NULL);
+  g_return_val_if_fail (path != NULL, NULL);
+
+  indexed = self != NULL && g_stat (path, &buf) == 0;
+
+  if (indexed &&
+      retro_module_index_lookup_descriptor (self, path, &buf, &core_descriptor))
+    return core_descriptor;
+
+  retro_try ({
+    core_descriptor = retro_core_descriptor_new (path, &catch);
+  }, catch, {
+    g_debug ("%s", catch->message);
+  });
+
+  if (indexed)
+    retro_module_index_add_descriptor (self, path, &buf, core_descriptor);
+
+  return core_descriptor;
+}
+
+/**
+ * retro_module_index_new:
+ * @filename: the file to save the index to
+ *
+ * Creates a new #RetroModuleIndex, loading the index saved in @filename if
+ * any.
+ *
+ * Returns: (transfer full): a new #RetroModuleIndex
+ */
+RetroModuleIndex *
+retro_module_index_new (const gchar *filename)
+{
+  RetroModuleIndex *self;
+
+  g_return_val_if_fail (filename != NULL, NULL);
+
+  self = g_object_new (RETRO_TYPE_MODULE_INDEX, NULL);
+  self->filename = g_strdup (filename);
+  load (self);
+
+  return self;
+}
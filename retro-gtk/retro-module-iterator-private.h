@@ -0,0 +1,14 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#pragma once
+
+#include "retro-module-iterator.h"
+#include "retro-module-index-private.h"
+
+G_BEGIN_DECLS
+
+RetroModuleIterator *retro_module_iterator_new_with_index (const gchar * const *lookup_paths,
+                                                           gboolean             recursive,
+                                                           RetroModuleIndex    *index) G_GNUC_WARN_UNUSED_RESULT;
+
+G_END_DECLS
@@ -7,7 +7,7 @@
  * @See_also: #RetroCoreDescriptor, #RetroModuleQuery
  */
 
-#include "retro-module-iterator.h"
+#include "retro-module-iterator-private.h"
 
 #include "retro-error-private.h"
 
@@ -17,7 +17,13 @@ struct _RetroModuleIterator
   gchar **directories;
   gboolean recursive;
   gint current_directory;
-  GFileEnumerator *file_enumerator;
+  RetroModuleIndex *index;
+  gboolean walking;
+  gchar *current_path;
+  gchar **descriptor_names;
+  gchar **sub_directory_names;
+  gsize next_descriptor;
+  gsize next_sub_directory;
   RetroCoreDescriptor *core_descriptor;
   RetroModuleIterator *sub_directory;
   GHashTable *visited;
@@ -27,13 +33,26 @@ G_DEFINE_TYPE (RetroModuleIterator, retro_module_iterator, G_TYPE_OBJECT)
 
 /* Private */
 
+static void
+clear_current_path (RetroModuleIterator *self)
+{
+  g_clear_pointer (&self->current_path, g_free);
+  g_clear_pointer (&self->descriptor_names, g_strfreev);
+  g_clear_pointer (&self->sub_directory_names, g_strfreev);
+  self->next_descriptor = 0;
+  self->next_sub_directory = 0;
+}
+
 static void
 retro_module_iterator_finalize (GObject *object)
 {
   RetroModuleIterator *self = RETRO_MODULE_ITERATOR (object);
 
   g_strfreev (self->directories);
-  g_clear_object (&self->file_enumerator);
+  clear_current_path (self);
+  if (self->walking)
+    retro_module_index_end (self->index, FALSE);
+  g_clear_object (&self->index);
   g_clear_object (&self->core_descriptor);
   g_clear_object (&self->sub_directory);
   g_hash_table_unref (self->visited);
@@ -55,8 +74,9 @@ retro_module_iterator_init (RetroModuleIterator *self)
 }
 
 static RetroModuleIterator *
-new_for_subdirectory (const gchar *lookup_path,
-                      GHashTable  *visited_paths)
+new_for_subdirectory (const gchar      *lookup_path,
+                      GHashTable       *visited_paths,
+                      RetroModuleIndex *index)
 {
   RetroModuleIterator *self;
 
@@ -68,33 +88,36 @@ new_for_subdirectory (const gchar *lookup_path,
   self->directories[0] = g_strdup (lookup_path);
   self->recursive = TRUE;
   self->visited = g_hash_table_ref (visited_paths);
+  if (index != NULL)
+    self->index = g_object_ref (index);
 
   return self;
 }
 
+static gchar *
+get_current_directory_path (RetroModuleIterator *self)
+{
+  g_autoptr (GFile) current_directory_file = NULL;
+
+  current_directory_file = g_file_new_for_path (self->directories[self->current_directory]);
+
+  return g_file_get_path (current_directory_file);
+}
+
 static gboolean
 was_current_directory_visited (RetroModuleIterator *self)
 {
-  g_autoptr (GFile) current_directory_file = NULL;
   g_autofree gchar *current_directory_path = NULL;
-  gboolean result;
 
-  current_directory_file = g_file_new_for_path (self->directories[self->current_directory]);
-  current_directory_path = g_file_get_path (current_directory_file);
-  result = g_hash_table_contains (self->visited, current_directory_path);
+  current_directory_path = get_current_directory_path (self);
 
-  return result;
+  return g_hash_table_contains (self->visited, current_directory_path);
 }
 
 static void
 set_current_directory_as_visited (RetroModuleIterator *self)
 {
-  g_autoptr (GFile) current_directory_file = NULL;
-  g_autofree gchar *current_directory_path = NULL;
-
-  current_directory_file = g_file_new_for_path (self->directories[self->current_directory]);
-  current_directory_path = g_file_get_path (current_directory_file);
-  g_hash_table_add (self->visited, g_steal_pointer (&current_directory_path));
+  g_hash_table_add (self->visited, get_current_directory_path (self));
 }
 
 static gboolean
@@ -112,108 +135,60 @@ next_in_sub_directory (RetroModuleIterator *self)
   return FALSE;
 }
 
-static gboolean
-iterate_next_in_current_path (RetroModuleIterator  *self,
-                              GFile                *directory,
-                              GFileInfo            *info,
-                              GError              **error)
-{
-  const gchar *core_descriptor_basename;
-  g_autoptr (GFile) core_descriptor_file = NULL;
-  g_autofree gchar *core_descriptor_path = NULL;
-  RetroCoreDescriptor *core_descriptor;
-
-  g_assert (G_IS_FILE (directory));
-  g_assert (G_IS_FILE_INFO (info));
-
-  if (self->recursive &&
-      g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY &&
-      self->sub_directory == NULL) {
-    const gchar *sub_directory_basename;
-    g_autoptr (GFile) sub_directory_file = NULL;
-    g_autofree gchar *sub_directory_path = NULL;
-
-    sub_directory_basename = g_file_info_get_name (info);
-    sub_directory_file = g_file_get_child (directory, sub_directory_basename);
-    sub_directory_path = g_file_get_path (sub_directory_file);
-
-    if (g_hash_table_contains (self->visited, sub_directory_path))
-      return FALSE;
-
-    self->sub_directory = new_for_subdirectory (sub_directory_path, self->visited);
-
-    return next_in_sub_directory (self);
-  }
-
-  core_descriptor_basename = g_file_info_get_name (info);
-  if (!g_str_has_suffix (core_descriptor_basename, ".libretro"))
-    return FALSE;
-
-  core_descriptor_file = g_file_get_child (directory, core_descriptor_basename);
-  core_descriptor_path = g_file_get_path (core_descriptor_file);
-  retro_try ({
-    core_descriptor = retro_core_descriptor_new (core_descriptor_path, &catch);
-  }, catch, {
-    g_debug ("%s", catch->message);
-
-    return FALSE;
-  });
-
-  g_clear_object (&self->core_descriptor);
-  self->core_descriptor = core_descriptor;
-
-  return TRUE;
-}
-
 static gboolean
 next_in_current_path (RetroModuleIterator  *self,
                       GError              **error)
 {
-  g_autoptr (GFile) directory = NULL;
-  gboolean found = FALSE;
-
   if (self->sub_directory != NULL && next_in_sub_directory (self))
     return TRUE;
 
-  directory = g_file_new_for_path (self->directories[self->current_directory]);
-
-  if (self->file_enumerator == NULL) {
-    g_autoptr (GFileEnumerator) file_enumerator = NULL;
+  if (self->current_path == NULL) {
+    self->current_path = get_current_directory_path (self);
 
     retro_try_propagate_val ({
-      file_enumerator =
-        g_file_enumerate_children (directory,
-                                   "",
-                                   G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
-                                   NULL,
-                                   &catch);
+      retro_module_index_list_directory (self->index,
+                                         self->current_path,
+                                         &self->descriptor_names,
+                                         &self->sub_directory_names,
+                                         &catch);
     }, catch, error, FALSE);
-
-    self->file_enumerator = g_steal_pointer (&file_enumerator);
   }
 
-  if (self->file_enumerator == NULL)
-    return FALSE;
+  while (self->descriptor_names[self->next_descriptor] != NULL) {
+    const gchar *name = self->descriptor_names[self->next_descriptor++];
+    g_autofree gchar *core_descriptor_path = NULL;
+    RetroCoreDescriptor *core_descriptor;
 
-  while (TRUE) {
-    g_autoptr (GFileInfo) info = NULL;
+    core_descriptor_path = g_build_filename (self->current_path, name, NULL);
+    core_descriptor = retro_module_index_load_descriptor (self->index,
+                                                          core_descriptor_path);
+    if (core_descriptor == NULL)
+      continue;
 
-    retro_try_propagate_val ({
-      info = g_file_enumerator_next_file (self->file_enumerator, NULL, &catch);
-    }, catch, error, FALSE);
+    g_clear_object (&self->core_descriptor);
+    self->core_descriptor = core_descriptor;
+
+    return TRUE;
+  }
 
-    if (info == NULL)
-      break;
+  while (self->recursive &&
+         self->sub_directory_names[self->next_sub_directory] != NULL) {
+    const gchar *name = self->sub_directory_names[self->next_sub_directory++];
+    g_autofree gchar *sub_directory_path = NULL;
 
-    retro_try_propagate_val ({
-      found = iterate_next_in_current_path (self, directory, info, &catch);
-    }, catch, error, FALSE);
+    sub_directory_path = g_build_filename (self->current_path, name, NULL);
+    if (g_hash_table_contains (self->visited, sub_directory_path))
+      continue;
 
-    if (found)
+    self->sub_directory = new_for_subdirectory (sub_directory_path,
+                                                self->visited,
+                                                self->index);
+
+    if (next_in_sub_directory (self))
       return TRUE;
   }
 
-  g_clear_object (&self->file_enumerator);
+  clear_current_path (self);
 
   return FALSE;
 }
@@ -261,6 +236,7 @@ retro_module_iterator_next (RetroModuleIterator *self)
       found_next_in_current_path = next_in_current_path (self, &catch);
     }, catch, {
       g_debug ("%s", catch->message);
+      clear_current_path (self);
       found_next_in_current_path = FALSE;
     });
 
@@ -272,10 +248,18 @@ retro_module_iterator_next (RetroModuleIterator *self)
       self->current_directory++;
   }
 
-  g_clear_object (&self->file_enumerator);
+  clear_current_path (self);
   g_clear_object (&self->core_descriptor);
   g_clear_object (&self->sub_directory);
 
+  /* Only save the index once all the lookup paths have been walked through,
+   * so directories which weren't visited yet aren't dropped from it. */
+  if (self->walking) {
+    self->walking = FALSE;
+    retro_module_index_end (self->index, TRUE);
+    retro_module_index_save (self->index);
+  }
+
   return FALSE;
 }
 
@@ -304,3 +288,34 @@ retro_module_iterator_new (const gchar * const *lookup_paths,
 
   return self;
 }
+
+/**
+ * retro_module_iterator_new_with_index:
+ * @lookup_paths: (array zero-terminated=1): paths where to look for Libretro
+ * cores
+ * @recursive: whether to run the query in sub-directories
+ * @index: a #RetroModuleIndex
+ *
+ * Creates a new #RetroModuleIterator reusing the directories and core
+ * descriptors of @index which didn't change, and saving @index when reaching
+ * the end.
+ *
+ * Returns: (transfer full): a new #RetroModuleIterator
+ */
+RetroModuleIterator *
+retro_module_iterator_new_with_index (const gchar * const *lookup_paths,
+                                      gboolean             recursive,
+                                      RetroModuleIndex    *index)
+{
+  RetroModuleIterator *self;
+
+  g_return_val_if_fail (lookup_paths != NULL, NULL);
+  g_return_val_if_fail (RETRO_IS_MODULE_INDEX (index), NULL);
+
+  self = retro_module_iterator_new (lookup_paths, recursive);
+  self->index = g_object_ref (index);
+  self->walking = TRUE;
+  retro_module_index_begin (index);
+
+  return self;
+}
@@ -0,0 +1,24 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#pragma once
+
+#include <gio/gio.h>
+#include "retro-core-descriptor.h"
+
+G_BEGIN_DECLS
+
+#define RETRO_TYPE_MODULE_LOOKUP (retro_module_lookup_get_type())
+
+G_DECLARE_FINAL_TYPE (RetroModuleLookup, retro_module_lookup, RETRO, MODULE_LOOKUP, GObject)
+
+RetroModuleLookup *retro_module_lookup_new (GListModel  *descriptors,
+                                            const gchar *system_directory) G_GNUC_WARN_UNUSED_RESULT;
+GListModel *retro_module_lookup_for_mime_type (RetroModuleLookup *self,
+                                               const gchar       *mime_type) G_GNUC_WARN_UNUSED_RESULT;
+GListModel *retro_module_lookup_for_platform (RetroModuleLookup *self,
+                                              const gchar       *platform) G_GNUC_WARN_UNUSED_RESULT;
+gboolean retro_module_lookup_get_is_ready (RetroModuleLookup   *self,
+                                           RetroCoreDescriptor *descriptor,
+                                           const gchar         *platform);
+
+G_END_DECLS
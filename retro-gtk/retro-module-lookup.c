@@ -0,0 +1,363 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#include "retro-module-lookup-private.h"
+
+#include "retro-core-descriptor-private.h"
+
+/* Maps MIME types and platforms to the core descriptors supporting them,
+ * ranked so the ones whose mandatory firmwares are all present come first,
+ * then sorted by name. */
+
+typedef struct {
+  RetroCoreDescriptor *descriptor;
+  gchar *platform;
+  gchar *collate_key;
+  gboolean is_ready;
+} RetroModuleLookupEntry;
+
+struct _RetroModuleLookup
+{
+  GObject parent_instance;
+  gchar *system_directory;
+  GPtrArray *entries;
+  GHashTable *by_descriptor;
+  GHashTable *by_mime_type;
+  GHashTable *by_platform;
+  GHashTable *firmwares;
+};
+
+G_DEFINE_TYPE (RetroModuleLookup, retro_module_lookup, G_TYPE_OBJECT)
+
+/* Private */
+
+static void
+free_entry (RetroModuleLookupEntry *entry)
+{
+  g_object_unref (entry->descriptor);
+  g_free (entry->platform);
+  g_free (entry->collate_key);
+  g_free (entry);
+}
+
+static void
+retro_module_lookup_finalize (GObject *object)
+{
+  RetroModuleLookup *self = RETRO_MODULE_LOOKUP (object);
+
+  g_free (self->system_directory);
+  g_clear_pointer (&self->by_descriptor, g_hash_table_unref);
+  g_clear_pointer (&self->by_mime_type, g_hash_table_unref);
+  g_clear_pointer (&self->by_platform, g_hash_table_unref);
+  g_hash_table_unref (self->firmwares);
+  g_ptr_array_unref (self->entries);
+
+  G_OBJECT_CLASS (retro_module_lookup_parent_class)->finalize (object);
+}
+
+static void
+retro_module_lookup_class_init (RetroModuleLookupClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = retro_module_lookup_finalize;
+}
+
+static void
+retro_module_lookup_init (RetroModuleLookup *self)
+{
+  self->entries = g_ptr_array_new_with_free_func ((GDestroyNotify) free_entry);
+  self->by_descriptor = g_hash_table_new_full (NULL, NULL, NULL,
+                                               (GDestroyNotify) g_ptr_array_unref);
+  self->firmwares = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+}
+
+static gboolean
+get_firmware_exists (RetroModuleLookup   *self,
+                     RetroCoreDescriptor *descriptor,
+                     const gchar         *firmware)
+{
+  g_autofree gchar *path = NULL;
+  gpointer exists;
+
+  path = retro_core_descriptor_get_firmware_path (descriptor, firmware, NULL);
+  if (path == NULL)
+    return FALSE;
+
+  if (!g_path_is_absolute (path)) {
+    g_autofree gchar *relative_path = g_steal_pointer (&path);
+
+    if (self->system_directory == NULL)
+      return FALSE;
+
+    path = g_build_filename (self->system_directory, relative_path, NULL);
+  }
+
+  /* Many cores share the same firmwares, only check each file once. */
+  if (g_hash_table_lookup_extended (self->firmwares, path, NULL, &exists))
+    return GPOINTER_TO_INT (exists);
+
+  exists = GINT_TO_POINTER (g_file_test (path, G_FILE_TEST_EXISTS));
+  g_hash_table_insert (self->firmwares, g_steal_pointer (&path), exists);
+
+  return GPOINTER_TO_INT (exists);
+}
+
+static gboolean
+get_is_ready (RetroModuleLookup   *self,
+              RetroCoreDescriptor *descriptor,
+              const gchar         *platform)
+{
+  g_auto (GStrv) firmwares = NULL;
+  gsize length;
+
+  if (!retro_core_descriptor_has_firmwares (descriptor, platform, NULL))
+    return TRUE;
+
+  firmwares = retro_core_descriptor_get_firmwares (descriptor, platform,
+                                                   &length, NULL);
+  if (firmwares == NULL)
+    return TRUE;
+
+  for (gsize i = 0; i < length; i++)
+    if (retro_core_descriptor_get_is_firmware_mandatory (descriptor, firmwares[i], NULL) &&
+        !get_firmware_exists (self, descriptor, firmwares[i]))
+      return FALSE;
+
+  return TRUE;
+}
+
+static void
+add_to_table (GHashTable             *table,
+              gchar                  *key,
+              RetroModuleLookupEntry *entry)
+{
+  GPtrArray *entries = g_hash_table_lookup (table, key);
+
+  if (entries == NULL) {
+    entries = g_ptr_array_new ();
+    g_hash_table_insert (table, key, entries);
+  }
+  else
+    g_free (key);
+
+  g_ptr_array_add (entries, entry);
+}
+
+static void
+add_descriptor (RetroModuleLookup   *self,
+                RetroCoreDescriptor *descriptor,
+                GHashTable          *by_mime_type,
+                GHashTable          *by_platform)
+{
+  g_auto (GStrv) platforms = NULL;
+  g_autofree gchar *name = NULL;
+  GPtrArray *descriptor_entries;
+
+  platforms = retro_core_descriptor_get_platforms (descriptor);
+  name = retro_core_descriptor_get_name (descriptor, NULL);
+  descriptor_entries = g_ptr_array_new ();
+  g_hash_table_insert (self->by_descriptor, descriptor, descriptor_entries);
+
+  for (gsize i = 0; platforms[i] != NULL; i++) {
+    g_auto (GStrv) mime_types = NULL;
+    RetroModuleLookupEntry *entry;
+    gsize length;
+
+    entry = g_new0 (RetroModuleLookupEntry, 1);
+    entry->descriptor = g_object_ref (descriptor);
+    entry->platform = g_strdup (platforms[i]);
+    entry->collate_key = g_utf8_collate_key (name != NULL ? name : "", -1);
+    entry->is_ready = get_is_ready (self, descriptor, platforms[i]);
+    g_ptr_array_add (self->entries, entry);
+    g_ptr_array_add (descriptor_entries, entry);
+
+    add_to_table (by_platform, g_strdup (platforms[i]), entry);
+
+    mime_types = retro_core_descriptor_get_mime_type (descriptor, platforms[i],
+                                                      &length, NULL);
+    for (gsize j = 0; j < length; j++)
+      add_to_table (by_mime_type, g_ascii_strdown (mime_types[j], -1), entry);
+  }
+}
+
+static gint
+compare_entries (RetroModuleLookupEntry **a,
+                 RetroModuleLookupEntry **b)
+{
+  if ((*a)->is_ready != (*b)->is_ready)
+    return (*a)->is_ready ? -1 : 1;
+
+  return g_strcmp0 ((*a)->collate_key, (*b)->collate_key);
+}
+
+/* Maps each key to its core descriptors, the best ranked first. */
+static GHashTable *
+build_rankings (GHashTable *table)
+{
+  GHashTable *rankings;
+  GHashTableIter iter;
+  gchar *key;
+  GPtrArray *entries;
+
+  rankings = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                    g_free, (GDestroyNotify) g_ptr_array_unref);
+
+  g_hash_table_iter_init (&iter, table);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &key, (gpointer *) &entries)) {
+    g_autoptr (GHashTable) seen = g_hash_table_new (NULL, NULL);
+    GPtrArray *ranking = g_ptr_array_new_with_free_func (g_object_unref);
+
+    g_ptr_array_sort (entries, (GCompareFunc) compare_entries);
+
+    /* A core can support a MIME type through several platforms, keep its
+     * best ranked one. */
+    for (gsize i = 0; i < entries->len; i++) {
+      RetroModuleLookupEntry *entry = g_ptr_array_index (entries, i);
+
+      if (g_hash_table_add (seen, entry->descriptor))
+        g_ptr_array_add (ranking, g_object_ref (entry->descriptor));
+    }
+
+    g_hash_table_iter_steal (&iter);
+    g_hash_table_insert (rankings, key, ranking);
+    g_ptr_array_unref (entries);
+  }
+
+  return rankings;
+}
+
+/* Each caller gets its own store, so it can't alter the rankings. */
+static GListModel *
+lookup_store (GHashTable  *rankings,
+              const gchar *key)
+{
+  GPtrArray *ranking = g_hash_table_lookup (rankings, key);
+  GListStore *store = g_list_store_new (RETRO_TYPE_CORE_DESCRIPTOR);
+
+  if (ranking != NULL)
+    g_list_store_splice (store, 0, 0, ranking->pdata, ranking->len);
+
+  return G_LIST_MODEL (store);
+}
+
+/* Public */
+
+/**
+ * retro_module_lookup_for_mime_type:
+ * @self: a #RetroModuleLookup
+ * @mime_type: a MIME type
+ *
+ * Gets the core descriptors supporting @mime_type, the best ranked first.
+ *
+ * Returns: (transfer full): a #GListModel of #RetroCoreDescriptor
+ */
+GListModel *
+retro_module_lookup_for_mime_type (RetroModuleLookup *self,
+                                   const gchar       *mime_type)
+{
+  g_autofree gchar *key = NULL;
+
+  g_return_val_if_fail (RETRO_IS_MODULE_LOOKUP (self), NULL);
+  g_return_val_if_fail (mime_type != NULL, NULL);
+
+  key = g_ascii_strdown (mime_type, -1);
+
+  return lookup_store (self->by_mime_type, key);
+}
+
+/**
+ * retro_module_lookup_for_platform:
+ * @self: a #RetroModuleLookup
+ * @platform: a platform name
+ *
+ * Gets the core descriptors supporting @platform, the best ranked first.
+ *
+ * Returns: (transfer full): a #GListModel of #RetroCoreDescriptor
+ */
+GListModel *
+retro_module_lookup_for_platform (RetroModuleLookup *self,
+                                  const gchar       *platform)
+{
+  g_return_val_if_fail (RETRO_IS_MODULE_LOOKUP (self), NULL);
+  g_return_val_if_fail (platform != NULL, NULL);
+
+  return lookup_store (self->by_platform, platform);
+}
+
+/**
+ * retro_module_lookup_get_is_ready:
+ * @self: a #RetroModuleLookup
+ * @descriptor: a #RetroCoreDescriptor
+ * @platform: a platform name
+ *
+ * Gets whether all the mandatory firmwares of @platform for @descriptor were
+ * present when @self was built.
+ *
+ * Returns: whether the core is ready to run games of @platform
+ */
+gboolean
+retro_module_lookup_get_is_ready (RetroModuleLookup   *self,
+                                  RetroCoreDescriptor *descriptor,
+                                  const gchar         *platform)
+{
+  GPtrArray *entries;
+
+  g_return_val_if_fail (RETRO_IS_MODULE_LOOKUP (self), FALSE);
+  g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (descriptor), FALSE);
+  g_return_val_if_fail (platform != NULL, FALSE);
+
+  entries = g_hash_table_lookup (self->by_descriptor, descriptor);
+  if (entries == NULL)
+    return get_is_ready (self, descriptor, platform);
+
+  for (gsize i = 0; i < entries->len; i++) {
+    RetroModuleLookupEntry *entry = g_ptr_array_index (entries, i);
+
+    if (g_strcmp0 (entry->platform, platform) == 0)
+      return entry->is_ready;
+  }
+
+  return FALSE;
+}
+
+/**
+ * retro_module_lookup_new:
+ * @descriptors: a #GListModel of #RetroCoreDescriptor
+ * @system_directory: (nullable): the directory relative firmware paths are
+ *   resolved from, or %NULL
+ *
+ * Creates a new #RetroModuleLookup indexing @descriptors.
+ *
+ * Returns: (transfer full): a new #RetroModuleLookup
+ */
+RetroModuleLookup *
+retro_module_lookup_new (GListModel  *descriptors,
+                         const gchar *system_directory)
+{
+  g_autoptr (GHashTable) by_mime_type = NULL;
+  g_autoptr (GHashTable) by_platform = NULL;
+  RetroModuleLookup *self;
+  guint n_items;
+
+  g_return_val_if_fail (G_IS_LIST_MODEL (descriptors), NULL);
+
+  self = g_object_new (RETRO_TYPE_MODULE_LOOKUP, NULL);
+  self->system_directory = g_strdup (system_directory);
+
+  by_mime_type = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                        (GDestroyNotify) g_ptr_array_unref);
+  by_platform = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                       (GDestroyNotify) g_ptr_array_unref);
+
+  n_items = g_list_model_get_n_items (descriptors);
+  for (guint i = 0; i < n_items; i++) {
+    g_autoptr (RetroCoreDescriptor) descriptor = g_list_model_get_item (descriptors, i);
+
+    add_descriptor (self, descriptor, by_mime_type, by_platform);
+  }
+
+  self->by_mime_type = build_rankings (by_mime_type);
+  self->by_platform = build_rankings (by_platform);
+
+  return self;
+}
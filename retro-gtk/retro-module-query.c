@@ -5,41 +5,268 @@
  * @short_description: An object to query the available Libretro cores
  * @title: RetroModuleQuery
  * @See_also: #RetroCoreDescriptor, #RetroModuleIterator
+ *
+ * To pick a core for a game, retro_module_query_lookup_for_mime_type() and
+ * retro_module_query_lookup_for_platform() look the cores up in an index built
+ * from the last complete query, instead of going through every
+ * #RetroCoreDescriptor. The cores whose mandatory firmwares are all present in
+ * #RetroModuleQuery:system-directory are ranked first.
+ *
+ * When #RetroModuleQuery:monitored is %TRUE, the lookup paths are monitored
+ * and the cores installed or removed while running are reported by the
+ * #RetroModuleQuery::core-added and #RetroModuleQuery::core-removed signals,
+ * so the available cores never have to be queried again.
  */
 
 #include "retro-module-query.h"
 
 #include "../retro-gtk-config.h"
+#include "retro-error-private.h"
+#include "retro-module-iterator-private.h"
+#include "retro-module-lookup-private.h"
+
+typedef struct {
+  gchar *path;
+  gboolean is_directory;
+} RetroModuleQueryJob;
+
+/* A walk through the lookup paths, shared by the queries started while it
+ * runs. It is cancelled once all of them are, unless it is required to
+ * monitor the lookup paths. */
+typedef struct {
+  GMutex mutex;
+  GThreadPool *pool;
+  RetroModuleQuery *query;
+  GListStore *store;
+  RetroModuleIndex *index;
+  gboolean recursive;
+  GHashTable *visited;
+  guint n_pending;
+  GPtrArray *found;
+  gboolean flush_scheduled;
+  GMainContext *context;
+  GPtrArray *tasks;
+  gboolean required;
+  gboolean cancelled;
+} RetroModuleQueryFindData;
 
 struct _RetroModuleQuery
 {
   GObject parent_instance;
   gboolean recursive;
+  gchar *system_directory;
+  RetroModuleIndex *index;
+  GListStore *descriptors;
+  GListStore *model;
+  RetroModuleLookup *lookup;
+  GHashTable *roots;
+  GHashTable *monitors;
+  guint save_index_id;
+  RetroModuleQueryFindData *find_data;
+  GListStore *next_store;
+  GPtrArray *next_tasks;
+  gboolean next_required;
+  GHashTable *changed_files;
 };
 
 G_DEFINE_TYPE (RetroModuleQuery, retro_module_query, G_TYPE_OBJECT)
 
+enum {
+  PROP_0,
+  PROP_SYSTEM_DIRECTORY,
+  PROP_MONITORED,
+  PROP_DESCRIPTORS,
+  N_PROPS,
+};
+
+static GParamSpec *properties [N_PROPS];
+
+enum {
+  SIGNAL_CORE_ADDED,
+  SIGNAL_CORE_REMOVED,
+  N_SIGNALS,
+};
+
+static guint signals[N_SIGNALS];
+
 #define RETRO_MODULE_QUERY_ENV_PLUGIN_PATH "LIBRETRO_PLUGIN_PATH"
+#define RETRO_MODULE_QUERY_INDEX_FILENAME "modules.index"
+/* How long to wait for more changes before saving the index, in seconds. */
+#define RETRO_MODULE_QUERY_SAVE_INDEX_DELAY 5
 
 /* Private */
 
 static void
 retro_module_query_finalize (GObject *object)
 {
+  RetroModuleQuery *self = RETRO_MODULE_QUERY (object);
+
+  g_clear_pointer (&self->monitors, g_hash_table_unref);
+  g_clear_pointer (&self->roots, g_hash_table_unref);
+  if (self->save_index_id != 0) {
+    g_clear_handle_id (&self->save_index_id, g_source_remove);
+    retro_module_index_save (self->index);
+  }
+
+  g_free (self->system_directory);
+  g_clear_object (&self->index);
+  g_clear_object (&self->descriptors);
+  g_clear_object (&self->model);
+  g_clear_object (&self->lookup);
+  g_clear_object (&self->next_store);
+  g_clear_pointer (&self->next_tasks, g_ptr_array_unref);
+  g_hash_table_unref (self->changed_files);
+
   G_OBJECT_CLASS (retro_module_query_parent_class)->finalize (object);
 }
 
+static void
+retro_module_query_get_property (GObject    *object,
+                                 guint       prop_id,
+                                 GValue     *value,
+                                 GParamSpec *pspec)
+{
+  RetroModuleQuery *self = RETRO_MODULE_QUERY (object);
+
+  switch (prop_id) {
+  case PROP_SYSTEM_DIRECTORY:
+    g_value_set_string (value, retro_module_query_get_system_directory (self));
+
+    break;
+  case PROP_MONITORED:
+    g_value_set_boolean (value, retro_module_query_get_monitored (self));
+
+    break;
+  case PROP_DESCRIPTORS:
+    g_value_set_object (value, retro_module_query_get_descriptors (self));
+
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+
+    break;
+  }
+}
+
+static void
+retro_module_query_set_property (GObject      *object,
+                                 guint         prop_id,
+                                 const GValue *value,
+                                 GParamSpec   *pspec)
+{
+  RetroModuleQuery *self = RETRO_MODULE_QUERY (object);
+
+  switch (prop_id) {
+  case PROP_SYSTEM_DIRECTORY:
+    retro_module_query_set_system_directory (self, g_value_get_string (value));
+
+    break;
+  case PROP_MONITORED:
+    retro_module_query_set_monitored (self, g_value_get_boolean (value));
+
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+
+    break;
+  }
+}
+
 static void
 retro_module_query_class_init (RetroModuleQueryClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
   object_class->finalize = retro_module_query_finalize;
+  object_class->get_property = retro_module_query_get_property;
+  object_class->set_property = retro_module_query_set_property;
+
+  /**
+   * RetroModuleQuery:system-directory:
+   *
+   * The system directory the relative firmware paths are resolved from, it
+   * should be the one of the #RetroCore the cores will be booted with.
+   */
+  properties[PROP_SYSTEM_DIRECTORY] =
+    g_param_spec_string ("system-directory",
+                         "System directory",
+                         "The system directory the firmwares are looked up in",
+                         NULL,
+                         G_PARAM_READWRITE |
+                         G_PARAM_STATIC_NAME |
+                         G_PARAM_STATIC_NICK |
+                         G_PARAM_STATIC_BLURB);
+
+  /**
+   * RetroModuleQuery:monitored:
+   *
+   * Whether the lookup paths are monitored for installed and removed cores.
+   */
+  properties[PROP_MONITORED] =
+    g_param_spec_boolean ("monitored",
+                          "Monitored",
+                          "Whether the lookup paths are monitored",
+                          FALSE,
+                          G_PARAM_READWRITE |
+                          G_PARAM_STATIC_NAME |
+                          G_PARAM_STATIC_NICK |
+                          G_PARAM_STATIC_BLURB);
+
+  /**
+   * RetroModuleQuery:descriptors:
+   *
+   * The core descriptors found by the last retro_module_query_find_async().
+   */
+  properties[PROP_DESCRIPTORS] =
+    g_param_spec_object ("descriptors",
+                         "Descriptors",
+                         "The core descriptors found by the last query",
+                         G_TYPE_LIST_MODEL,
+                         G_PARAM_READABLE |
+                         G_PARAM_STATIC_NAME |
+                         G_PARAM_STATIC_NICK |
+                         G_PARAM_STATIC_BLURB);
+
+  g_object_class_install_properties (object_class, N_PROPS, properties);
+
+  /**
+   * RetroModuleQuery::core-added:
+   * @self: the #RetroModuleQuery
+   * @descriptor: the #RetroCoreDescriptor of the core
+   *
+   * The ::core-added signal is emitted when a core is installed while @self
+   * is monitored. A modified core descriptor is removed and added again.
+   */
+  signals[SIGNAL_CORE_ADDED] =
+    g_signal_new ("core-added", RETRO_TYPE_MODULE_QUERY, G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL,
+                  NULL,
+                  G_TYPE_NONE,
+                  1,
+                  RETRO_TYPE_CORE_DESCRIPTOR);
+
+  /**
+   * RetroModuleQuery::core-removed:
+   * @self: the #RetroModuleQuery
+   * @descriptor: the #RetroCoreDescriptor of the core
+   *
+   * The ::core-removed signal is emitted when a core is removed while @self
+   * is monitored.
+   */
+  signals[SIGNAL_CORE_REMOVED] =
+    g_signal_new ("core-removed", RETRO_TYPE_MODULE_QUERY, G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL,
+                  NULL,
+                  G_TYPE_NONE,
+                  1,
+                  RETRO_TYPE_CORE_DESCRIPTOR);
 }
 
 static void
 retro_module_query_init (RetroModuleQuery *self)
 {
+  self->changed_files = g_hash_table_new_full (g_file_hash, (GEqualFunc) g_file_equal,
+                                               g_object_unref, NULL);
 }
 
 static gchar **
@@ -59,6 +286,630 @@ get_plugin_lookup_paths (void)
   return g_strsplit (full_plugin_path, ":", 0);
 }
 
+static RetroModuleIndex *
+ensure_index (RetroModuleQuery *self)
+{
+  g_autofree gchar *filename = NULL;
+
+  if (self->index != NULL)
+    return self->index;
+
+  filename = g_build_filename (g_get_user_cache_dir (),
+                               "retro-gtk",
+                               RETRO_MODULE_QUERY_INDEX_FILENAME,
+                               NULL);
+  self->index = retro_module_index_new (filename);
+
+  return self->index;
+}
+
+static void
+set_descriptors (RetroModuleQuery *self,
+                 GListStore       *descriptors)
+{
+  g_set_object (&self->descriptors, descriptors);
+  g_clear_object (&self->lookup);
+}
+
+static RetroModuleLookup *
+ensure_lookup (RetroModuleQuery *self)
+{
+  g_autoptr (GListStore) descriptors = NULL;
+
+  if (self->lookup != NULL)
+    return self->lookup;
+
+  /* Don't walk through the lookup paths on the caller's thread, nothing is
+   * found until a query completes. */
+  if (self->descriptors != NULL)
+    descriptors = g_object_ref (self->descriptors);
+  else
+    descriptors = g_list_store_new (RETRO_TYPE_CORE_DESCRIPTOR);
+
+  self->lookup = retro_module_lookup_new (G_LIST_MODEL (descriptors),
+                                          self->system_directory);
+
+  return self->lookup;
+}
+
+static gboolean
+save_index_cb (RetroModuleQuery *self)
+{
+  self->save_index_id = 0;
+  retro_module_index_save (self->index);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+descriptors_changed (RetroModuleQuery *self)
+{
+  g_clear_object (&self->lookup);
+
+  if (self->save_index_id == 0)
+    self->save_index_id =
+      g_timeout_add_seconds (RETRO_MODULE_QUERY_SAVE_INDEX_DELAY,
+                             (GSourceFunc) save_index_cb, self);
+}
+
+static void
+remove_descriptors (RetroModuleQuery *self,
+                    const gchar      *path,
+                    gboolean          is_directory)
+{
+  g_autofree gchar *prefix = NULL;
+  guint n_items;
+
+  if (is_directory)
+    prefix = g_strconcat (path, G_DIR_SEPARATOR_S, NULL);
+
+  n_items = g_list_model_get_n_items (G_LIST_MODEL (self->descriptors));
+  for (guint i = n_items; i > 0; i--) {
+    g_autoptr (RetroCoreDescriptor) descriptor = NULL;
+    const gchar *filename;
+
+    descriptor = g_list_model_get_item (G_LIST_MODEL (self->descriptors), i - 1);
+    filename = retro_core_descriptor_get_filename (descriptor);
+    if (is_directory ? !g_str_has_prefix (filename, prefix) : !g_str_equal (filename, path))
+      continue;
+
+    g_list_store_remove (self->descriptors, i - 1);
+    retro_module_index_remove_descriptor (self->index, filename);
+    descriptors_changed (self);
+    g_signal_emit (self, signals[SIGNAL_CORE_REMOVED], 0, descriptor);
+  }
+}
+
+static void
+update_descriptor (RetroModuleQuery *self,
+                   const gchar      *path)
+{
+  g_autoptr (RetroCoreDescriptor) descriptor = NULL;
+
+  remove_descriptors (self, path, FALSE);
+
+  descriptor = retro_module_index_load_descriptor (self->index, path);
+  if (descriptor == NULL)
+    return;
+
+  g_list_store_append (self->descriptors, descriptor);
+  descriptors_changed (self);
+  g_signal_emit (self, signals[SIGNAL_CORE_ADDED], 0, descriptor);
+}
+
+static void changed_cb (RetroModuleQuery  *self,
+                        GFile             *file,
+                        GFile             *other_file,
+                        GFileMonitorEvent  event_type,
+                        GFileMonitor      *monitor);
+
+static void
+release_monitor (GFileMonitor *monitor)
+{
+  g_signal_handlers_disconnect_matched (monitor, G_SIGNAL_MATCH_FUNC,
+                                        0, 0, NULL, changed_cb, NULL);
+  g_file_monitor_cancel (monitor);
+  g_object_unref (monitor);
+}
+
+static void
+add_directory (RetroModuleQuery *self,
+               const gchar      *path,
+               gboolean          load_descriptors)
+{
+  g_autoptr (GFile) directory = NULL;
+  g_autoptr (GFileMonitor) monitor = NULL;
+  g_auto (GStrv) descriptors = NULL;
+  g_auto (GStrv) sub_directories = NULL;
+
+  /* A monitored lookup path was created, only list it. */
+  if (g_hash_table_contains (self->monitors, path)) {
+    if (!load_descriptors || !g_hash_table_contains (self->roots, path))
+      return;
+  }
+  else {
+    directory = g_file_new_for_path (path);
+    retro_try ({
+      monitor = g_file_monitor_directory (directory,
+                                          G_FILE_MONITOR_WATCH_MOVES,
+                                          NULL,
+                                          &catch);
+    }, catch, {
+      g_debug ("Couldn't monitor %s: %s", path, catch->message);
+
+      return;
+    });
+
+    g_signal_connect_object (monitor, "changed",
+                             G_CALLBACK (changed_cb), self,
+                             G_CONNECT_SWAPPED);
+    g_hash_table_insert (self->monitors, g_strdup (path), g_steal_pointer (&monitor));
+  }
+
+  /* The directory may not exist yet, it will be reported once created. */
+  if (!retro_module_index_list_directory (self->index, path,
+                                          &descriptors, &sub_directories,
+                                          NULL))
+    return;
+
+  if (load_descriptors)
+    for (gsize i = 0; descriptors[i] != NULL; i++) {
+      g_autofree gchar *descriptor_path = g_build_filename (path, descriptors[i], NULL);
+
+      update_descriptor (self, descriptor_path);
+    }
+
+  if (self->recursive)
+    for (gsize i = 0; sub_directories[i] != NULL; i++) {
+      g_autofree gchar *sub_directory_path = g_build_filename (path, sub_directories[i], NULL);
+
+      add_directory (self, sub_directory_path, load_descriptors);
+    }
+}
+
+static void
+remove_directory (RetroModuleQuery *self,
+                  const gchar      *path)
+{
+  g_autofree gchar *prefix = g_strconcat (path, G_DIR_SEPARATOR_S, NULL);
+  GHashTableIter iter;
+  const gchar *monitored_path;
+
+  /* Keep monitoring the lookup paths, to notice when they are created again. */
+  g_hash_table_iter_init (&iter, self->monitors);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &monitored_path, NULL))
+    if ((g_str_equal (monitored_path, path) || g_str_has_prefix (monitored_path, prefix)) &&
+        !g_hash_table_contains (self->roots, monitored_path))
+      g_hash_table_iter_remove (&iter);
+
+  remove_descriptors (self, path, TRUE);
+}
+
+/* The changes are applied to the cores found by the last complete walk, the
+ * ones notified while walking are applied once it ends, as it would override
+ * them. */
+static gboolean
+defer_change (RetroModuleQuery *self,
+              GFile            *file)
+{
+  if (self->find_data == NULL && self->descriptors != NULL)
+    return FALSE;
+
+  g_hash_table_add (self->changed_files, g_object_ref (file));
+
+  return TRUE;
+}
+
+static void
+file_added (RetroModuleQuery *self,
+            GFile            *file)
+{
+  g_autofree gchar *path = NULL;
+
+  if (defer_change (self, file))
+    return;
+
+  path = g_file_get_path (file);
+  if (path == NULL)
+    return;
+
+  if (g_file_query_file_type (file, G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL) == G_FILE_TYPE_DIRECTORY) {
+    if (self->recursive || g_hash_table_contains (self->roots, path))
+      add_directory (self, path, TRUE);
+
+    return;
+  }
+
+  if (g_str_has_suffix (path, ".libretro"))
+    update_descriptor (self, path);
+}
+
+static void
+file_removed (RetroModuleQuery *self,
+              GFile            *file)
+{
+  g_autofree gchar *path = NULL;
+
+  if (defer_change (self, file))
+    return;
+
+  path = g_file_get_path (file);
+  if (path == NULL)
+    return;
+
+  if (g_hash_table_contains (self->monitors, path))
+    remove_directory (self, path);
+  else if (g_str_has_suffix (path, ".libretro"))
+    remove_descriptors (self, path, FALSE);
+}
+
+static void
+changed_cb (RetroModuleQuery  *self,
+            GFile             *file,
+            GFile             *other_file,
+            GFileMonitorEvent  event_type,
+            GFileMonitor      *monitor)
+{
+  switch (event_type) {
+  case G_FILE_MONITOR_EVENT_CREATED:
+    /* Wait for the files to be written, but directories are complete. */
+    if (g_file_query_file_type (file, G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL) == G_FILE_TYPE_DIRECTORY)
+      file_added (self, file);
+
+    break;
+  case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+  case G_FILE_MONITOR_EVENT_MOVED_IN:
+    file_added (self, file);
+
+    break;
+  case G_FILE_MONITOR_EVENT_DELETED:
+  case G_FILE_MONITOR_EVENT_MOVED_OUT:
+    file_removed (self, file);
+
+    break;
+  case G_FILE_MONITOR_EVENT_RENAMED:
+    file_removed (self, file);
+    file_added (self, other_file);
+
+    break;
+  default:
+    break;
+  }
+}
+
+static void
+apply_changes (RetroModuleQuery *self)
+{
+  g_autoptr (GHashTable) changed_files = NULL;
+  GHashTableIter iter;
+  GFile *file;
+
+  changed_files = g_steal_pointer (&self->changed_files);
+  self->changed_files = g_hash_table_new_full (g_file_hash, (GEqualFunc) g_file_equal,
+                                               g_object_unref, NULL);
+
+  if (self->descriptors == NULL || self->monitors == NULL)
+    return;
+
+  /* Only the final state of the files matters. */
+  g_hash_table_iter_init (&iter, changed_files);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &file, NULL))
+    if (g_file_query_exists (file, NULL))
+      file_added (self, file);
+    else
+      file_removed (self, file);
+}
+
+static void
+free_job (RetroModuleQueryJob *job)
+{
+  g_free (job->path);
+  g_free (job);
+}
+
+static void
+free_find_data (RetroModuleQueryFindData *data)
+{
+  g_assert (data->pool == NULL);
+
+  g_mutex_clear (&data->mutex);
+  g_object_unref (data->query);
+  g_object_unref (data->store);
+  g_object_unref (data->index);
+  g_hash_table_unref (data->visited);
+  g_ptr_array_unref (data->found);
+  g_ptr_array_unref (data->tasks);
+  g_main_context_unref (data->context);
+  g_free (data);
+}
+
+/* Must be called with the mutex held. Once cancelled, the walk can't be
+ * shared anymore as it skipped some jobs. */
+static gboolean
+is_cancelled (RetroModuleQueryFindData *data)
+{
+  if (data->cancelled)
+    return TRUE;
+
+  if (data->required || data->tasks->len == 0)
+    return FALSE;
+
+  for (gsize i = 0; i < data->tasks->len; i++) {
+    GTask *task = g_ptr_array_index (data->tasks, i);
+
+    if (!g_cancellable_is_cancelled (g_task_get_cancellable (task)))
+      return FALSE;
+  }
+
+  data->cancelled = TRUE;
+
+  return TRUE;
+}
+
+/* Must be called with the mutex held. */
+static void
+push_job (RetroModuleQueryFindData *data,
+          gchar                    *path,
+          gboolean                  is_directory)
+{
+  RetroModuleQueryJob *job = g_new0 (RetroModuleQueryJob, 1);
+
+  job->path = path;
+  job->is_directory = is_directory;
+
+  data->n_pending++;
+  g_thread_pool_push (data->pool, job, NULL);
+}
+
+/* Must be called with the mutex held. */
+static void
+push_directory_job (RetroModuleQueryFindData *data,
+                    gchar                    *path)
+{
+  if (g_hash_table_contains (data->visited, path)) {
+    g_free (path);
+
+    return;
+  }
+
+  g_hash_table_add (data->visited, g_strdup (path));
+  push_job (data, path, TRUE);
+}
+
+static void start_walk (RetroModuleQuery *self,
+                        GListStore       *store,
+                        GPtrArray        *tasks,
+                        gboolean          required);
+
+static gboolean
+flush_cb (RetroModuleQueryFindData *data)
+{
+  RetroModuleQuery *self = data->query;
+  g_autoptr (GPtrArray) found = NULL;
+  gboolean done;
+
+  g_mutex_lock (&data->mutex);
+  found = g_steal_pointer (&data->found);
+  data->found = g_ptr_array_new_with_free_func (g_object_unref);
+  data->flush_scheduled = FALSE;
+  done = data->n_pending == 0;
+  g_mutex_unlock (&data->mutex);
+
+  g_list_store_splice (data->store,
+                       g_list_model_get_n_items (G_LIST_MODEL (data->store)),
+                       0, found->pdata, found->len);
+
+  if (!done)
+    return G_SOURCE_REMOVE;
+
+  g_thread_pool_free (g_steal_pointer (&data->pool), FALSE, TRUE);
+  self->find_data = NULL;
+  retro_module_index_end (data->index, !data->cancelled);
+
+  /* Only save complete walks, so the unvisited entries aren't dropped. */
+  if (!data->cancelled) {
+    retro_module_index_save (data->index);
+    set_descriptors (self, data->store);
+  }
+
+  /* The queries started once the walk got cancelled waited for it to end. */
+  if (self->next_store != NULL)
+    start_walk (self,
+                g_steal_pointer (&self->next_store),
+                g_steal_pointer (&self->next_tasks),
+                self->next_required);
+  else
+    apply_changes (self);
+
+  /* The callbacks may start new queries, which join the next walk. */
+  for (gsize i = 0; i < data->tasks->len; i++) {
+    GTask *task = g_ptr_array_index (data->tasks, i);
+
+    if (!g_task_return_error_if_cancelled (task))
+      g_task_return_boolean (task, TRUE);
+  }
+
+  free_find_data (data);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Must be called with the mutex held. */
+static void
+schedule_flush (RetroModuleQueryFindData *data)
+{
+  g_autoptr (GSource) source = NULL;
+
+  if (data->flush_scheduled)
+    return;
+
+  data->flush_scheduled = TRUE;
+
+  source = g_idle_source_new ();
+  g_source_set_callback (source, (GSourceFunc) flush_cb, data, NULL);
+  g_source_attach (source, data->context);
+}
+
+static void
+find_in_directory (RetroModuleQueryFindData *data,
+                   const gchar              *path)
+{
+  g_auto (GStrv) descriptors = NULL;
+  g_auto (GStrv) sub_directories = NULL;
+
+  retro_try ({
+    retro_module_index_list_directory (data->index, path,
+                                       &descriptors, &sub_directories,
+                                       &catch);
+  }, catch, {
+    g_debug ("%s", catch->message);
+
+    return;
+  });
+
+  g_mutex_lock (&data->mutex);
+
+  for (gsize i = 0; descriptors[i] != NULL; i++)
+    push_job (data, g_build_filename (path, descriptors[i], NULL), FALSE);
+
+  if (data->recursive)
+    for (gsize i = 0; sub_directories[i] != NULL; i++)
+      push_directory_job (data, g_build_filename (path, sub_directories[i], NULL));
+
+  g_mutex_unlock (&data->mutex);
+}
+
+static void
+find_descriptor (RetroModuleQueryFindData *data,
+                 const gchar              *path)
+{
+  RetroCoreDescriptor *core_descriptor;
+
+  core_descriptor = retro_module_index_load_descriptor (data->index, path);
+  if (core_descriptor == NULL)
+    return;
+
+  g_mutex_lock (&data->mutex);
+  g_ptr_array_add (data->found, core_descriptor);
+  schedule_flush (data);
+  g_mutex_unlock (&data->mutex);
+}
+
+static void
+run_job (RetroModuleQueryJob      *job,
+         RetroModuleQueryFindData *data)
+{
+  gboolean cancelled;
+
+  g_mutex_lock (&data->mutex);
+  cancelled = is_cancelled (data);
+  g_mutex_unlock (&data->mutex);
+
+  if (!cancelled) {
+    if (job->is_directory)
+      find_in_directory (data, job->path);
+    else
+      find_descriptor (data, job->path);
+  }
+
+  g_mutex_lock (&data->mutex);
+  if (--data->n_pending == 0)
+    schedule_flush (data);
+  g_mutex_unlock (&data->mutex);
+
+  free_job (job);
+}
+
+/* Walks through the lookup paths, filling @store with the core descriptors
+ * found. The walk keeps @self alive until it ends. */
+static void
+start_walk (RetroModuleQuery *self,
+            GListStore       *store,
+            GPtrArray        *tasks,
+            gboolean          required)
+{
+  g_auto (GStrv) paths = NULL;
+  RetroModuleQueryFindData *data;
+
+  g_assert (self->find_data == NULL);
+
+  data = g_new0 (RetroModuleQueryFindData, 1);
+  g_mutex_init (&data->mutex);
+  data->pool = g_thread_pool_new ((GFunc) run_job, data,
+                                  g_get_num_processors (), FALSE, NULL);
+  data->query = g_object_ref (self);
+  data->store = store;
+  data->index = g_object_ref (ensure_index (self));
+  data->recursive = self->recursive;
+  data->visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  data->found = g_ptr_array_new_with_free_func (g_object_unref);
+  data->context = g_main_context_ref_thread_default ();
+  data->tasks = tasks != NULL ? tasks : g_ptr_array_new_with_free_func (g_object_unref);
+  data->required = required;
+  self->find_data = data;
+
+  retro_module_index_begin (data->index);
+
+  paths = get_plugin_lookup_paths ();
+
+  /* Hold the lock so the walk can't end before all the paths are pushed. */
+  g_mutex_lock (&data->mutex);
+
+  for (gsize i = 0; paths[i] != NULL; i++) {
+    g_autoptr (GFile) directory = g_file_new_for_path (paths[i]);
+
+    push_directory_job (data, g_file_get_path (directory));
+  }
+
+  if (data->n_pending == 0)
+    schedule_flush (data);
+
+  g_mutex_unlock (&data->mutex);
+}
+
+/* Makes @task wait for the running walk, or for the next one if the running
+ * one got cancelled, starting one if needed. The lookup paths are never walked
+ * through twice at once, as the walks share the index. If @task is %NULL, the
+ * walk is required to complete.
+ *
+ * Returns: (transfer full): the store the walk fills */
+static GListStore *
+join_walk (RetroModuleQuery *self,
+           GTask            *task)
+{
+  RetroModuleQueryFindData *data;
+  gboolean joined;
+
+  if (self->find_data == NULL)
+    start_walk (self, g_list_store_new (RETRO_TYPE_CORE_DESCRIPTOR), NULL, FALSE);
+
+  data = self->find_data;
+
+  g_mutex_lock (&data->mutex);
+  joined = !data->cancelled;
+  if (joined && task != NULL)
+    g_ptr_array_add (data->tasks, task);
+  else if (joined)
+    data->required = TRUE;
+  g_mutex_unlock (&data->mutex);
+
+  if (joined)
+    return g_object_ref (data->store);
+
+  if (self->next_store == NULL) {
+    self->next_store = g_list_store_new (RETRO_TYPE_CORE_DESCRIPTOR);
+    self->next_tasks = g_ptr_array_new_with_free_func (g_object_unref);
+    self->next_required = FALSE;
+  }
+
+  if (task != NULL)
+    g_ptr_array_add (self->next_tasks, task);
+  else
+    self->next_required = TRUE;
+
+  return g_object_ref (self->next_store);
+}
+
 /* Public */
 
 /**
@@ -67,6 +918,10 @@ get_plugin_lookup_paths (void)
  *
  * Creates a new #RetroModuleIterator.
  *
+ * The core descriptors found are cached in an index in the user's cache
+ * directory, so only the directories and core descriptors which changed since
+ * the last query have to be read again.
+ *
  * Returns: (transfer full): a new #RetroModuleIterator
  */
 RetroModuleIterator *
@@ -78,8 +933,280 @@ retro_module_query_iterator (RetroModuleQuery *self)
 
   paths = get_plugin_lookup_paths ();
 
-  return retro_module_iterator_new ((const gchar * const *) paths,
-                                    self->recursive);
+  return retro_module_iterator_new_with_index ((const gchar * const *) paths,
+                                               self->recursive,
+                                               ensure_index (self));
+}
+
+/**
+ * retro_module_query_find_async:
+ * @self: a #RetroModuleQuery
+ * @cancellable: (nullable): a #GCancellable
+ * @callback: (scope async): a #GAsyncReadyCallback to call when all the
+ *   Libretro cores have been found
+ * @user_data: (closure): the data to pass to @callback
+ *
+ * Asynchronously looks for the available Libretro cores. The lookup paths are
+ * walked concurrently and the core descriptors are parsed in parallel on a
+ * pool of threads, so they are found in no particular order.
+ *
+ * The cores are found into #RetroModuleQuery:descriptors, which is set to the
+ * model of this operation before this returns. It fills in progressively, the
+ * core descriptors are added to it in the thread-default main context of the
+ * caller as they are found. Once complete, it keeps being updated while
+ * #RetroModuleQuery:monitored is %TRUE.
+ *
+ * The lookup paths are walked through once at a time: if cores are already
+ * being looked for, the model is kept and @callback is called when the running
+ * walk completes. The walk is stopped only once all the operations sharing it
+ * are cancelled.
+ */
+void
+retro_module_query_find_async (RetroModuleQuery    *self,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data)
+{
+  g_autoptr (GListStore) store = NULL;
+  GTask *task;
+
+  g_return_if_fail (RETRO_IS_MODULE_QUERY (self));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, retro_module_query_find_async);
+
+  store = join_walk (self, task);
+  if (g_set_object (&self->model, store))
+    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_DESCRIPTORS]);
+}
+
+/**
+ * retro_module_query_find_finish:
+ * @self: a #RetroModuleQuery
+ * @result: a #GAsyncResult
+ * @error: return location for a #GError, or %NULL
+ *
+ * Finishes an operation started with retro_module_query_find_async().
+ *
+ * Returns: whether all the lookup paths were walked through
+ */
+gboolean
+retro_module_query_find_finish (RetroModuleQuery  *self,
+                                GAsyncResult      *result,
+                                GError           **error)
+{
+  g_return_val_if_fail (RETRO_IS_MODULE_QUERY (self), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * retro_module_query_get_descriptors:
+ * @self: a #RetroModuleQuery
+ *
+ * Gets the core descriptors found by the last
+ * retro_module_query_find_async(), which may still be filling in.
+ *
+ * Returns: (transfer none) (nullable): a #GListModel of #RetroCoreDescriptor,
+ *   or %NULL if no cores were looked for
+ */
+GListModel *
+retro_module_query_get_descriptors (RetroModuleQuery *self)
+{
+  g_return_val_if_fail (RETRO_IS_MODULE_QUERY (self), NULL);
+
+  return G_LIST_MODEL (self->model);
+}
+
+/**
+ * retro_module_query_lookup_for_mime_type:
+ * @self: a #RetroModuleQuery
+ * @mime_type: a MIME type
+ *
+ * Gets the cores supporting @mime_type, the ones whose mandatory firmwares are
+ * all present first, then sorted by name.
+ *
+ * The lookup is done in an index built from the cores found by the last
+ * complete retro_module_query_find_async(), no core is found before it
+ * completes.
+ *
+ * Returns: (transfer full): a #GListModel of #RetroCoreDescriptor
+ */
+GListModel *
+retro_module_query_lookup_for_mime_type (RetroModuleQuery *self,
+                                         const gchar      *mime_type)
+{
+  g_return_val_if_fail (RETRO_IS_MODULE_QUERY (self), NULL);
+  g_return_val_if_fail (mime_type != NULL, NULL);
+
+  return retro_module_lookup_for_mime_type (ensure_lookup (self), mime_type);
+}
+
+/**
+ * retro_module_query_lookup_for_platform:
+ * @self: a #RetroModuleQuery
+ * @platform: a platform name
+ *
+ * Gets the cores supporting @platform, ranked like in
+ * retro_module_query_lookup_for_mime_type().
+ *
+ * Returns: (transfer full): a #GListModel of #RetroCoreDescriptor
+ */
+GListModel *
+retro_module_query_lookup_for_platform (RetroModuleQuery *self,
+                                        const gchar      *platform)
+{
+  g_return_val_if_fail (RETRO_IS_MODULE_QUERY (self), NULL);
+  g_return_val_if_fail (platform != NULL, NULL);
+
+  return retro_module_lookup_for_platform (ensure_lookup (self), platform);
+}
+
+/**
+ * retro_module_query_get_is_platform_ready:
+ * @self: a #RetroModuleQuery
+ * @descriptor: a #RetroCoreDescriptor
+ * @platform: a platform name
+ *
+ * Gets whether all the mandatory firmwares @descriptor requires for @platform
+ * are present. The presence of the firmware files is cached until
+ * #RetroModuleQuery:system-directory changes or the cores are queried again.
+ *
+ * Returns: whether the core is ready to run games of @platform
+ */
+gboolean
+retro_module_query_get_is_platform_ready (RetroModuleQuery    *self,
+                                          RetroCoreDescriptor *descriptor,
+                                          const gchar         *platform)
+{
+  g_return_val_if_fail (RETRO_IS_MODULE_QUERY (self), FALSE);
+  g_return_val_if_fail (RETRO_IS_CORE_DESCRIPTOR (descriptor), FALSE);
+  g_return_val_if_fail (platform != NULL, FALSE);
+
+  return retro_module_lookup_get_is_ready (ensure_lookup (self),
+                                           descriptor, platform);
+}
+
+/**
+ * retro_module_query_get_system_directory:
+ * @self: a #RetroModuleQuery
+ *
+ * Gets the system directory the firmwares are looked up in.
+ *
+ * Returns: (nullable): the system directory
+ */
+const gchar *
+retro_module_query_get_system_directory (RetroModuleQuery *self)
+{
+  g_return_val_if_fail (RETRO_IS_MODULE_QUERY (self), NULL);
+
+  return self->system_directory;
+}
+
+/**
+ * retro_module_query_set_system_directory:
+ * @self: a #RetroModuleQuery
+ * @system_directory: (nullable): the system directory
+ *
+ * Sets the system directory the firmwares are looked up in, it should be the
+ * one of the #RetroCore the cores will be booted with.
+ */
+void
+retro_module_query_set_system_directory (RetroModuleQuery *self,
+                                         const gchar      *system_directory)
+{
+  g_return_if_fail (RETRO_IS_MODULE_QUERY (self));
+
+  if (g_strcmp0 (system_directory, self->system_directory) == 0)
+    return;
+
+  g_free (self->system_directory);
+  self->system_directory = g_strdup (system_directory);
+  g_clear_object (&self->lookup);
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_SYSTEM_DIRECTORY]);
+}
+
+/**
+ * retro_module_query_get_monitored:
+ * @self: a #RetroModuleQuery
+ *
+ * Gets whether the lookup paths are monitored for installed and removed cores.
+ *
+ * Returns: whether @self is monitored
+ */
+gboolean
+retro_module_query_get_monitored (RetroModuleQuery *self)
+{
+  g_return_val_if_fail (RETRO_IS_MODULE_QUERY (self), FALSE);
+
+  return self->monitors != NULL;
+}
+
+/**
+ * retro_module_query_set_monitored:
+ * @self: a #RetroModuleQuery
+ * @monitored: whether to monitor the lookup paths
+ *
+ * Sets whether the lookup paths are monitored for installed and removed
+ * cores.
+ *
+ * Starting to monitor them looks for the available cores asynchronously if
+ * they weren't yet, the changes are reported once they are found. While
+ * monitored, the changes are reported by the
+ * #RetroModuleQuery::core-added and #RetroModuleQuery::core-removed signals,
+ * applied to #RetroModuleQuery:descriptors, and applied to the lookups.
+ */
+void
+retro_module_query_set_monitored (RetroModuleQuery *self,
+                                  gboolean          monitored)
+{
+  g_return_if_fail (RETRO_IS_MODULE_QUERY (self));
+
+  monitored = !!monitored;
+
+  if (retro_module_query_get_monitored (self) == monitored)
+    return;
+
+  if (monitored) {
+    g_auto (GStrv) paths = get_plugin_lookup_paths ();
+
+    ensure_index (self);
+
+    if (self->descriptors == NULL)
+      g_object_unref (join_walk (self, NULL));
+
+    self->roots = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    self->monitors = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                            g_free, (GDestroyNotify) release_monitor);
+
+    for (gsize i = 0; paths[i] != NULL; i++) {
+      g_autoptr (GFile) directory = g_file_new_for_path (paths[i]);
+
+      g_hash_table_add (self->roots, g_file_get_path (directory));
+    }
+
+    for (gsize i = 0; paths[i] != NULL; i++) {
+      g_autoptr (GFile) directory = g_file_new_for_path (paths[i]);
+      g_autofree gchar *path = g_file_get_path (directory);
+
+      add_directory (self, path, FALSE);
+    }
+  }
+  else {
+    g_clear_pointer (&self->monitors, g_hash_table_unref);
+    g_clear_pointer (&self->roots, g_hash_table_unref);
+    g_hash_table_remove_all (self->changed_files);
+
+    if (self->save_index_id != 0) {
+      g_clear_handle_id (&self->save_index_id, g_source_remove);
+      retro_module_index_save (self->index);
+    }
+  }
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_MONITORED]);
 }
 
 /**
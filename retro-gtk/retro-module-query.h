@@ -6,7 +6,7 @@
 # error "Only <retro-gtk.h> can be included directly."
 #endif
 
-#include <glib-object.h>
+#include <gio/gio.h>
 #include "retro-module-iterator.h"
 
 G_BEGIN_DECLS
@@ -17,5 +17,26 @@ G_DECLARE_FINAL_TYPE (RetroModuleQuery, retro_module_query, RETRO, MODULE_QUERY,
 
 RetroModuleQuery *retro_module_query_new (gboolean recursive) G_GNUC_WARN_UNUSED_RESULT;
 RetroModuleIterator *retro_module_query_iterator (RetroModuleQuery *self) G_GNUC_WARN_UNUSED_RESULT;
+void retro_module_query_find_async (RetroModuleQuery    *self,
+                                    GCancellable        *cancellable,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             user_data);
+gboolean retro_module_query_find_finish (RetroModuleQuery  *self,
+                                         GAsyncResult      *result,
+                                         GError           **error);
+GListModel *retro_module_query_get_descriptors (RetroModuleQuery *self);
+GListModel *retro_module_query_lookup_for_mime_type (RetroModuleQuery *self,
+                                                     const gchar      *mime_type) G_GNUC_WARN_UNUSED_RESULT;
+GListModel *retro_module_query_lookup_for_platform (RetroModuleQuery *self,
+                                                    const gchar      *platform) G_GNUC_WARN_UNUSED_RESULT;
+gboolean retro_module_query_get_is_platform_ready (RetroModuleQuery    *self,
+                                                   RetroCoreDescriptor *descriptor,
+                                                   const gchar         *platform);
+const gchar *retro_module_query_get_system_directory (RetroModuleQuery *self);
+void retro_module_query_set_system_directory (RetroModuleQuery *self,
+                                              const gchar      *system_directory);
+gboolean retro_module_query_get_monitored (RetroModuleQuery *self);
+void retro_module_query_set_monitored (RetroModuleQuery *self,
+                                       gboolean          monitored);
 
 G_END_DECLS
@@ -0,0 +1,13 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#pragma once
+
+#include "retro-runner-pool.h"
+#include "retro-runner-process-private.h"
+
+G_BEGIN_DECLS
+
+RetroRunnerProcess *retro_runner_pool_claim (RetroRunnerPool *self,
+                                             const gchar     *filename) G_GNUC_WARN_UNUSED_RESULT;
+
+G_END_DECLS
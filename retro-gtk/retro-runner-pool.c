@@ -0,0 +1,420 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+/**
+ * SECTION:retro-runner-pool
+ * @short_description: A pool of runner processes ready to boot a core
+ * @title: RetroRunnerPool
+ * @See_also: #RetroCore
+ *
+ * Booting a #RetroCore spawns a runner process, connects to it and loads the
+ * Libretro core into it before the game can be loaded, which takes a
+ * noticeable time. A #RetroRunnerPool keeps idle runner processes for the
+ * cores it prepared, already connected and with the core loaded, so a
+ * #RetroCore using the pool only has to initialize the core and load the
+ * game.
+ *
+ * The core isn't initialized ahead of time as it can query the directories
+ * and options set on the #RetroCore while doing so.
+ *
+ * Claiming a runner for a core automatically prepares the pool for it, so
+ * switching back and forth between the same cores is fast after the first
+ * boot.
+ */
+
+#include "retro-runner-pool-private.h"
+
+typedef struct {
+  gchar *filename;
+  GQueue idle;
+  guint n_starting;
+} RetroRunnerPoolEntry;
+
+struct _RetroRunnerPool
+{
+  GObject parent_instance;
+
+  guint n_runners;
+  GHashTable *entries;
+  GCancellable *cancellable;
+};
+
+G_DEFINE_TYPE (RetroRunnerPool, retro_runner_pool, G_TYPE_OBJECT)
+
+enum {
+  PROP_0,
+  PROP_N_RUNNERS,
+  N_PROPS,
+};
+
+static GParamSpec *properties [N_PROPS];
+
+static void idle_exit_cb (RetroRunnerProcess *process,
+                          gboolean            success,
+                          const gchar        *message,
+                          RetroRunnerPool    *self);
+
+/* Private */
+
+static void
+release_process (RetroRunnerProcess *process)
+{
+  g_signal_handlers_disconnect_matched (process, G_SIGNAL_MATCH_FUNC,
+                                        0, 0, NULL, idle_exit_cb, NULL);
+  g_object_unref (process);
+}
+
+static void
+free_entry (RetroRunnerPoolEntry *entry)
+{
+  g_queue_clear_full (&entry->idle, (GDestroyNotify) release_process);
+  g_free (entry->filename);
+  g_free (entry);
+}
+
+static RetroRunnerPoolEntry *
+ensure_entry (RetroRunnerPool *self,
+              const gchar     *filename)
+{
+  RetroRunnerPoolEntry *entry;
+
+  entry = g_hash_table_lookup (self->entries, filename);
+  if (entry != NULL)
+    return entry;
+
+  entry = g_new0 (RetroRunnerPoolEntry, 1);
+  entry->filename = g_strdup (filename);
+  g_queue_init (&entry->idle);
+
+  g_hash_table_insert (self->entries, entry->filename, entry);
+
+  return entry;
+}
+
+static void
+idle_exit_cb (RetroRunnerProcess *process,
+              gboolean            success,
+              const gchar        *message,
+              RetroRunnerPool    *self)
+{
+  GHashTableIter iter;
+  RetroRunnerPoolEntry *entry;
+
+  /* The idle process stopped on its own, e.g. because it crashed while
+   * loading the core, so it can't be claimed anymore. */
+  g_hash_table_iter_init (&iter, self->entries);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry)) {
+    if (!g_queue_remove (&entry->idle, process))
+      continue;
+
+    release_process (process);
+
+    return;
+  }
+}
+
+static void
+start_cb (RetroRunnerProcess *process,
+          GAsyncResult       *result,
+          RetroRunnerPool    *self)
+{
+  g_autoptr (RetroRunnerPool) owned_self = self;
+  g_autoptr (RetroRunnerProcess) owned_process = process;
+  g_autofree gchar *filename = NULL;
+  g_autoptr (GError) error = NULL;
+  RetroRunnerPoolEntry *entry;
+  gboolean success;
+
+  success = retro_runner_process_start_finish (process, result, &error);
+
+  /* The pool was cleared, the entry doesn't exist anymore. */
+  if (error && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    return;
+
+  g_object_get (process, "filename", &filename, NULL);
+  entry = g_hash_table_lookup (self->entries, filename);
+
+  /* The pool was cleared and the core prepared again while this was starting,
+   * the new entry doesn't count this start. */
+  if (entry == NULL || entry->n_starting == 0)
+    return;
+
+  entry->n_starting--;
+
+  /* Don't try to start another one, it would likely fail the same way. */
+  if (!success) {
+    g_warning ("Couldn't start a runner for %s: %s", filename, error->message);
+
+    return;
+  }
+
+  if (g_queue_get_length (&entry->idle) >= self->n_runners)
+    return;
+
+  g_signal_connect_object (process, "exit", G_CALLBACK (idle_exit_cb), self, 0);
+  g_queue_push_tail (&entry->idle, g_steal_pointer (&owned_process));
+}
+
+static void
+fill_entry (RetroRunnerPool      *self,
+            RetroRunnerPoolEntry *entry)
+{
+  while (g_queue_get_length (&entry->idle) > self->n_runners)
+    release_process (g_queue_pop_tail (&entry->idle));
+
+  while (g_queue_get_length (&entry->idle) + entry->n_starting < self->n_runners) {
+    RetroRunnerProcess *process = retro_runner_process_new (entry->filename);
+
+    entry->n_starting++;
+    retro_runner_process_start_async (process, self->cancellable,
+                                      (GAsyncReadyCallback) start_cb,
+                                      g_object_ref (self));
+  }
+}
+
+static void
+retro_runner_pool_dispose (GObject *object)
+{
+  RetroRunnerPool *self = (RetroRunnerPool *)object;
+
+  if (self->entries)
+    retro_runner_pool_clear (self);
+
+  g_clear_pointer (&self->entries, g_hash_table_unref);
+  g_clear_object (&self->cancellable);
+
+  G_OBJECT_CLASS (retro_runner_pool_parent_class)->dispose (object);
+}
+
+static void
+retro_runner_pool_get_property (GObject    *object,
+                                guint       prop_id,
+                                GValue     *value,
+                                GParamSpec *pspec)
+{
+  RetroRunnerPool *self = RETRO_RUNNER_POOL (object);
+
+  switch (prop_id) {
+  case PROP_N_RUNNERS:
+    g_value_set_uint (value, retro_runner_pool_get_n_runners (self));
+
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+
+    break;
+  }
+}
+
+static void
+retro_runner_pool_set_property (GObject      *object,
+                                guint         prop_id,
+                                const GValue *value,
+                                GParamSpec   *pspec)
+{
+  RetroRunnerPool *self = RETRO_RUNNER_POOL (object);
+
+  switch (prop_id) {
+  case PROP_N_RUNNERS:
+    retro_runner_pool_set_n_runners (self, g_value_get_uint (value));
+
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+
+    break;
+  }
+}
+
+static void
+retro_runner_pool_class_init (RetroRunnerPoolClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = retro_runner_pool_dispose;
+  object_class->get_property = retro_runner_pool_get_property;
+  object_class->set_property = retro_runner_pool_set_property;
+
+  /**
+   * RetroRunnerPool:n-runners:
+   *
+   * The number of idle runner processes to keep for each prepared core.
+   */
+  properties[PROP_N_RUNNERS] =
+    g_param_spec_uint ("n-runners",
+                       "Number of runners",
+                       "The number of idle runner processes to keep for each prepared core",
+                       0,
+                       G_MAXUINT,
+                       1,
+                       G_PARAM_READWRITE |
+                       G_PARAM_CONSTRUCT |
+                       G_PARAM_STATIC_NAME |
+                       G_PARAM_STATIC_NICK |
+                       G_PARAM_STATIC_BLURB);
+
+  g_object_class_install_properties (object_class, N_PROPS, properties);
+}
+
+static void
+retro_runner_pool_init (RetroRunnerPool *self)
+{
+  self->entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                         NULL, (GDestroyNotify) free_entry);
+  self->cancellable = g_cancellable_new ();
+}
+
+/* Public */
+
+/**
+ * retro_runner_pool_get_n_runners:
+ * @self: a #RetroRunnerPool
+ *
+ * Gets the number of idle runner processes @self keeps for each prepared
+ * core.
+ *
+ * Returns: the number of idle runners per core
+ */
+guint
+retro_runner_pool_get_n_runners (RetroRunnerPool *self)
+{
+  g_return_val_if_fail (RETRO_IS_RUNNER_POOL (self), 0);
+
+  return self->n_runners;
+}
+
+/**
+ * retro_runner_pool_set_n_runners:
+ * @self: a #RetroRunnerPool
+ * @n_runners: the number of idle runners per core
+ *
+ * Sets the number of idle runner processes @self keeps for each prepared core,
+ * starting or stopping runners as needed.
+ */
+void
+retro_runner_pool_set_n_runners (RetroRunnerPool *self,
+                                 guint            n_runners)
+{
+  GHashTableIter iter;
+  RetroRunnerPoolEntry *entry;
+
+  g_return_if_fail (RETRO_IS_RUNNER_POOL (self));
+
+  if (self->n_runners == n_runners)
+    return;
+
+  self->n_runners = n_runners;
+
+  g_hash_table_iter_init (&iter, self->entries);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+    fill_entry (self, entry);
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_RUNNERS]);
+}
+
+/**
+ * retro_runner_pool_prepare:
+ * @self: a #RetroRunnerPool
+ * @filename: the filename of a Libretro core
+ *
+ * Asynchronously starts idle runner processes for the core at @filename, until
+ * there are #RetroRunnerPool:n-runners of them. @filename must be the one the
+ * #RetroCore using @self will be created with.
+ */
+void
+retro_runner_pool_prepare (RetroRunnerPool *self,
+                           const gchar     *filename)
+{
+  g_return_if_fail (RETRO_IS_RUNNER_POOL (self));
+  g_return_if_fail (filename != NULL);
+
+  fill_entry (self, ensure_entry (self, filename));
+}
+
+/**
+ * retro_runner_pool_get_n_idle:
+ * @self: a #RetroRunnerPool
+ * @filename: the filename of a Libretro core
+ *
+ * Gets the number of idle runner processes ready to boot the core at
+ * @filename.
+ *
+ * Returns: the number of idle runners for the core
+ */
+guint
+retro_runner_pool_get_n_idle (RetroRunnerPool *self,
+                              const gchar     *filename)
+{
+  RetroRunnerPoolEntry *entry;
+
+  g_return_val_if_fail (RETRO_IS_RUNNER_POOL (self), 0);
+  g_return_val_if_fail (filename != NULL, 0);
+
+  entry = g_hash_table_lookup (self->entries, filename);
+
+  return entry != NULL ? g_queue_get_length (&entry->idle) : 0;
+}
+
+/**
+ * retro_runner_pool_clear:
+ * @self: a #RetroRunnerPool
+ *
+ * Stops all the idle runner processes of @self and forgets the cores it
+ * prepared.
+ */
+void
+retro_runner_pool_clear (RetroRunnerPool *self)
+{
+  g_return_if_fail (RETRO_IS_RUNNER_POOL (self));
+
+  g_cancellable_cancel (self->cancellable);
+  g_object_unref (self->cancellable);
+  self->cancellable = g_cancellable_new ();
+
+  g_hash_table_remove_all (self->entries);
+}
+
+/**
+ * retro_runner_pool_claim:
+ * @self: a #RetroRunnerPool
+ * @filename: the filename of a Libretro core
+ *
+ * Takes an idle runner process ready to boot the core at @filename out of
+ * @self, and starts a new one in the background to replace it.
+ *
+ * Returns: (transfer full) (nullable): a started #RetroRunnerProcess, or %NULL
+ * if none is ready
+ */
+RetroRunnerProcess *
+retro_runner_pool_claim (RetroRunnerPool *self,
+                         const gchar     *filename)
+{
+  RetroRunnerPoolEntry *entry;
+  RetroRunnerProcess *process;
+
+  g_return_val_if_fail (RETRO_IS_RUNNER_POOL (self), NULL);
+  g_return_val_if_fail (filename != NULL, NULL);
+
+  entry = ensure_entry (self, filename);
+  process = g_queue_pop_head (&entry->idle);
+  if (process != NULL)
+    g_signal_handlers_disconnect_by_func (process, idle_exit_cb, self);
+
+  fill_entry (self, entry);
+
+  return process;
+}
+
+/**
+ * retro_runner_pool_new:
+ * @n_runners: the number of idle runners per core
+ *
+ * Creates a new #RetroRunnerPool keeping @n_runners idle runner processes for
+ * each core it prepares.
+ *
+ * Returns: (transfer full): a new #RetroRunnerPool
+ */
+RetroRunnerPool *
+retro_runner_pool_new (guint n_runners)
+{
+  return g_object_new (RETRO_TYPE_RUNNER_POOL, "n-runners", n_runners, NULL);
+}
@@ -0,0 +1,27 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#pragma once
+
+#if !defined(__RETRO_GTK_INSIDE__) && !defined(RETRO_GTK_COMPILATION)
+# error "Only <retro-gtk.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define RETRO_TYPE_RUNNER_POOL (retro_runner_pool_get_type())
+
+G_DECLARE_FINAL_TYPE (RetroRunnerPool, retro_runner_pool, RETRO, RUNNER_POOL, GObject)
+
+RetroRunnerPool *retro_runner_pool_new (guint n_runners) G_GNUC_WARN_UNUSED_RESULT;
+guint retro_runner_pool_get_n_runners (RetroRunnerPool *self);
+void retro_runner_pool_set_n_runners (RetroRunnerPool *self,
+                                      guint            n_runners);
+void retro_runner_pool_prepare (RetroRunnerPool *self,
+                                const gchar     *filename);
+guint retro_runner_pool_get_n_idle (RetroRunnerPool *self,
+                                    const gchar     *filename);
+void retro_runner_pool_clear (RetroRunnerPool *self);
+
+G_END_DECLS
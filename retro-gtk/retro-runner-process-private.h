@@ -16,6 +16,13 @@ RetroRunnerProcess *retro_runner_process_new (const gchar *filename) G_GNUC_WARN
 
 void retro_runner_process_start (RetroRunnerProcess  *self,
                                  GError             **error);
+void retro_runner_process_start_async (RetroRunnerProcess  *self,
+                                       GCancellable        *cancellable,
+                                       GAsyncReadyCallback  callback,
+                                       gpointer             user_data);
+gboolean retro_runner_process_start_finish (RetroRunnerProcess  *self,
+                                            GAsyncResult        *result,
+                                            GError             **error);
 IpcRunner *retro_runner_process_get_proxy (RetroRunnerProcess *self);
 void retro_runner_process_stop (RetroRunnerProcess  *self,
                                 GError             **error);
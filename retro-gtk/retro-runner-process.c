@@ -7,6 +7,7 @@
 #include <glib-unix.h>
 #include <gio/gunixconnection.h>
 #include <sys/socket.h>
+#include <unistd.h>
 #include "retro-error-private.h"
 
 struct _RetroRunnerProcess
@@ -219,6 +220,37 @@ create_connection (GSubprocessLauncher  *launcher,
   return connection;
 }
 
+#ifdef SYSPROF_ENABLED
+/* When profiled by Sysprof, pass the control socket to the runner so its marks
+ * are collected along the ones of this process. */
+static void
+forward_sysprof_control_fd (GSubprocessLauncher *launcher,
+                            gint                 subprocess_fd)
+{
+  const gchar *control_fd_string;
+  g_autofree gchar *subprocess_fd_string = NULL;
+  gint control_fd;
+
+  control_fd_string = g_getenv ("SYSPROF_CONTROL_FD");
+  if (control_fd_string == NULL)
+    return;
+
+  control_fd = (gint) g_ascii_strtoll (control_fd_string, NULL, 10);
+  if (control_fd <= 2)
+    return;
+
+  control_fd = dup (control_fd);
+  if (control_fd < 0)
+    return;
+
+  g_subprocess_launcher_take_fd (launcher, control_fd, subprocess_fd);
+
+  subprocess_fd_string = g_strdup_printf ("%d", subprocess_fd);
+  g_subprocess_launcher_setenv (launcher, "SYSPROF_CONTROL_FD",
+                                subprocess_fd_string, TRUE);
+}
+#endif
+
 static gchar *
 get_runner_path (void)
 {
@@ -233,6 +265,65 @@ get_runner_path (void)
   return g_strdup (RETRO_RUNNER_PATH);
 }
 
+static GSubprocess *
+spawn_runner (RetroRunnerProcess  *self,
+              GSocketConnection  **connection,
+              GError             **error)
+{
+  g_autoptr(GSubprocessLauncher) launcher = NULL;
+  g_autofree gchar *runner_path = NULL;
+  g_autoptr(GSocketConnection) tmp_connection = NULL;
+  GSubprocess *process;
+
+  launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_NONE);
+
+  if (!(tmp_connection = create_connection (launcher, 3, error)))
+    return NULL;
+
+#ifdef SYSPROF_ENABLED
+  forward_sysprof_control_fd (launcher, 4);
+#endif
+
+  runner_path = get_runner_path ();
+
+  process = g_subprocess_launcher_spawn (launcher, error,
+                                         runner_path,
+                                         g_get_application_name (),
+                                         self->filename, NULL);
+  if (!process)
+    return NULL;
+
+  *connection = g_steal_pointer (&tmp_connection);
+
+  return process;
+}
+
+static void
+watch_runner (RetroRunnerProcess *self,
+              GSubprocess        *process)
+{
+  g_dbus_connection_start_message_processing (self->connection);
+
+  self->cancellable = g_cancellable_new ();
+  g_subprocess_wait_check_async (process, self->cancellable,
+                                 (GAsyncReadyCallback) wait_check_cb, self);
+}
+
+/* The runner was spawned but couldn't be connected to, so nothing would ever
+ * stop it: disconnect from it and kill it. */
+static void
+kill_runner (RetroRunnerProcess *self,
+             GSubprocess        *process)
+{
+  g_cancellable_cancel (self->cancellable);
+
+  g_clear_object (&self->proxy);
+  g_clear_object (&self->connection);
+  g_clear_object (&self->cancellable);
+
+  g_subprocess_force_exit (process);
+}
+
 /**
  * retro_runner_process_start:
  * @self: a #RetroRunnerProcess
@@ -246,46 +337,152 @@ retro_runner_process_start (RetroRunnerProcess  *self,
                             GError             **error)
 {
   g_autoptr(GSocketConnection) connection = NULL;
-  g_autoptr(GSubprocessLauncher) launcher = NULL;
-  g_autofree gchar *runner_path = NULL;
   g_autoptr(GSubprocess) process = NULL;
 
   g_return_if_fail (RETRO_IS_RUNNER_PROCESS (self));
   g_return_if_fail (!G_IS_DBUS_CONNECTION (self->connection));
 
-  launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_NONE);
-
-  if (!(connection = create_connection (launcher, 3, error)))
-    return;
-
-  runner_path = get_runner_path ();
-
   retro_try_propagate ({
-    process = g_subprocess_launcher_spawn (launcher, &catch,
-                                           runner_path,
-                                           g_get_application_name (),
-                                           self->filename, NULL);
+    process = spawn_runner (self, &connection, &catch);
   }, catch, error);
 
-  retro_try_propagate ({
+  retro_try ({
     self->connection = g_dbus_connection_new_sync (G_IO_STREAM (connection),
                                                    NULL,
                                                    G_DBUS_CONNECTION_FLAGS_DELAY_MESSAGE_PROCESSING |
                                                    G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT,
                                                    NULL, NULL, &catch);
-  }, catch, error);
+  }, catch, {
+    kill_runner (self, process);
+    g_propagate_error (error, g_steal_pointer (&catch));
 
-  g_dbus_connection_start_message_processing (self->connection);
+    return;
+  });
 
-  self->cancellable = g_cancellable_new ();
-  g_subprocess_wait_check_async (process, self->cancellable,
-                                 (GAsyncReadyCallback) wait_check_cb, self);
+  watch_runner (self, process);
 
-  retro_try_propagate ({
+  retro_try ({
     self->proxy = ipc_runner_proxy_new_sync (self->connection, 0, NULL,
                                              "/org/gnome/Retro/Runner", NULL,
                                              &catch);
-  }, catch, error);
+  }, catch, {
+    kill_runner (self, process);
+    g_propagate_error (error, g_steal_pointer (&catch));
+
+    return;
+  });
+}
+
+static void
+proxy_new_cb (GObject      *source_object,
+              GAsyncResult *result,
+              GTask        *task)
+{
+  g_autoptr (GTask) owned_task = task;
+  RetroRunnerProcess *self = g_task_get_source_object (task);
+  GSubprocess *process = g_task_get_task_data (task);
+  GError *error = NULL;
+
+  self->proxy = ipc_runner_proxy_new_finish (result, &error);
+  if (!self->proxy) {
+    kill_runner (self, process);
+    g_task_return_error (task, error);
+
+    return;
+  }
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+connection_new_cb (GObject      *source_object,
+                   GAsyncResult *result,
+                   GTask        *task)
+{
+  RetroRunnerProcess *self = g_task_get_source_object (task);
+  GSubprocess *process = g_task_get_task_data (task);
+  GError *error = NULL;
+
+  self->connection = g_dbus_connection_new_finish (result, &error);
+  if (!self->connection) {
+    kill_runner (self, process);
+    g_task_return_error (task, error);
+    g_object_unref (task);
+
+    return;
+  }
+
+  watch_runner (self, process);
+
+  ipc_runner_proxy_new (self->connection, 0, NULL,
+                        "/org/gnome/Retro/Runner",
+                        g_task_get_cancellable (task),
+                        (GAsyncReadyCallback) proxy_new_cb, task);
+}
+
+/**
+ * retro_runner_process_start_async:
+ * @self: a #RetroRunnerProcess
+ * @cancellable: (nullable): a #GCancellable
+ * @callback: a #GAsyncReadyCallback to call when the process is started
+ * @user_data: the data to pass to @callback
+ *
+ * Asynchronously starts the remote process. Only spawning it blocks, the D-Bus
+ * authentication and the creation of the proxy don't.
+ */
+void
+retro_runner_process_start_async (RetroRunnerProcess  *self,
+                                  GCancellable        *cancellable,
+                                  GAsyncReadyCallback  callback,
+                                  gpointer             user_data)
+{
+  g_autoptr(GSocketConnection) connection = NULL;
+  GSubprocess *process;
+  GTask *task;
+  GError *error = NULL;
+
+  g_return_if_fail (RETRO_IS_RUNNER_PROCESS (self));
+  g_return_if_fail (!G_IS_DBUS_CONNECTION (self->connection));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, retro_runner_process_start_async);
+
+  process = spawn_runner (self, &connection, &error);
+  if (!process) {
+    g_task_return_error (task, error);
+    g_object_unref (task);
+
+    return;
+  }
+
+  g_task_set_task_data (task, process, g_object_unref);
+
+  g_dbus_connection_new (G_IO_STREAM (connection), NULL,
+                         G_DBUS_CONNECTION_FLAGS_DELAY_MESSAGE_PROCESSING |
+                         G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT,
+                         NULL, cancellable,
+                         (GAsyncReadyCallback) connection_new_cb, task);
+}
+
+/**
+ * retro_runner_process_start_finish:
+ * @self: a #RetroRunnerProcess
+ * @result: a #GAsyncResult
+ * @error: return location for a #GError, or %NULL
+ *
+ * Finishes an operation started with retro_runner_process_start_async().
+ *
+ * Returns: whether the process was started
+ */
+gboolean
+retro_runner_process_start_finish (RetroRunnerProcess  *self,
+                                   GAsyncResult        *result,
+                                   GError             **error)
+{
+  g_return_val_if_fail (RETRO_IS_RUNNER_PROCESS (self), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
 }
 
 /**
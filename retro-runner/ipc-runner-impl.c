@@ -46,13 +46,16 @@ ipc_runner_impl_handle_boot (IpcRunner             *runner,
                              GUnixFDList           *fd_list,
                              GVariant              *defaults,
                              const gchar * const   *medias,
-                             GVariant              *default_controller)
+                             GVariant              *media_fds,
+                             GVariant              *controllers)
 {
   IpcRunnerImpl *self = IPC_RUNNER_IMPL (runner);
   g_autoptr(GUnixFDList) out_fd_list = NULL;
   g_autoptr (GVariantIter) iter = NULL;
+  g_autoptr (GVariantIter) media_fds_iter = NULL;
   gchar *key, *value;
   gint handle, fd;
+  guint media_index = 0;
 
   g_variant_get (defaults, "a(ss)", &iter);
 
@@ -61,7 +64,32 @@ ipc_runner_impl_handle_boot (IpcRunner             *runner,
 
   retro_core_set_medias (self->core, medias);
 
-  g_variant_get (default_controller, "h", &handle);
+  /* -1 means the media has no file descriptor and must be opened from its
+   * URI. */
+  g_variant_get (media_fds, "ah", &media_fds_iter);
+  while (g_variant_iter_next (media_fds_iter, "h", &handle)) {
+    if (handle >= 0) {
+      if (G_UNLIKELY (handle >= g_unix_fd_list_get_length (fd_list) ||
+                      media_index >= g_strv_length ((gchar **) medias))) {
+        g_dbus_method_invocation_return_error (g_steal_pointer (&invocation),
+                                               G_DBUS_ERROR,
+                                               G_DBUS_ERROR_INVALID_ARGS,
+                                               "Invalid FD handle value");
+
+        return TRUE;
+      }
+
+      retro_try_propagate_dbus ({
+        fd = g_unix_fd_list_get (fd_list, handle, &catch);
+      }, catch, invocation);
+
+      retro_core_set_media_fd (self->core, media_index, fd);
+    }
+
+    media_index++;
+  }
+
+  g_variant_get (controllers, "h", &handle);
   if (G_LIKELY (handle < g_unix_fd_list_get_length (fd_list))) {
     retro_try_propagate_dbus ({
       fd = g_unix_fd_list_get (fd_list, handle, &catch);
@@ -75,7 +103,7 @@ ipc_runner_impl_handle_boot (IpcRunner             *runner,
     return TRUE;
   }
 
-  retro_core_set_default_controller (self->core, fd);
+  retro_core_set_controller_state (self->core, fd);
   retro_try ({
     retro_core_boot (self->core, &catch);
   }, catch, {
@@ -186,6 +214,75 @@ ipc_runner_impl_handle_iteration (IpcRunner             *runner,
   return TRUE;
 }
 
+static gboolean
+ipc_runner_impl_handle_get_frame_statistics (IpcRunner             *runner,
+                                             GDBusMethodInvocation *invocation)
+{
+  IpcRunnerImpl *self = IPC_RUNNER_IMPL (runner);
+  guint64 n_frames, missed_deadlines;
+  gdouble mean, p99;
+
+  retro_core_get_frame_statistics (self->core, &n_frames, &mean, &p99,
+                                   &missed_deadlines);
+
+  ipc_runner_complete_get_frame_statistics (runner, invocation, n_frames,
+                                            mean, p99, missed_deadlines);
+
+  return TRUE;
+}
+
+static gboolean
+ipc_runner_impl_handle_get_pipeline_statistics (IpcRunner             *runner,
+                                                GDBusMethodInvocation *invocation,
+                                                GUnixFDList           *fd_list)
+{
+  IpcRunnerImpl *self = IPC_RUNNER_IMPL (runner);
+  g_autoptr(GUnixFDList) out_fd_list = NULL;
+  gint fd, handle;
+
+  out_fd_list = g_unix_fd_list_new ();
+  fd = retro_core_get_pipeline_stats_fd (self->core);
+  retro_try_propagate_dbus ({
+    handle = g_unix_fd_list_append (out_fd_list, fd, &catch);
+  }, catch, invocation);
+
+  ipc_runner_complete_get_pipeline_statistics (runner, invocation, out_fd_list,
+                                               g_variant_new ("h", handle));
+
+  return TRUE;
+}
+
+static gboolean
+ipc_runner_impl_handle_benchmark (IpcRunner             *runner,
+                                 GDBusMethodInvocation *invocation,
+                                 guint64                n_frames,
+                                 guint                  flags)
+{
+  IpcRunnerImpl *self = IPC_RUNNER_IMPL (runner);
+  g_autofree RetroBenchmark *benchmark = g_new (RetroBenchmark, 1);
+  g_autoptr (GVariantBuilder) builder = NULL;
+  gsize n_buckets = RETRO_FRAME_HISTOGRAM_N_BUCKETS;
+
+  retro_core_benchmark (self->core, n_frames, flags, benchmark);
+
+  /* Don't send the empty buckets of the slowest frame times. */
+  while (n_buckets > 0 && benchmark->frame_times.buckets[n_buckets - 1] == 0)
+    n_buckets--;
+
+  builder = g_variant_builder_new (G_VARIANT_TYPE ("au"));
+  for (gsize i = 0; i < n_buckets; i++)
+    g_variant_builder_add (builder, "u", benchmark->frame_times.buckets[i]);
+
+  ipc_runner_complete_benchmark (runner, invocation,
+                                 benchmark->total_time / 1e9,
+                                 benchmark->core_time / 1e9,
+                                 benchmark->video_time / 1e9,
+                                 benchmark->audio_time / 1e9,
+                                 g_variant_builder_end (builder));
+
+  return TRUE;
+}
+
 static gboolean
 ipc_runner_impl_handle_get_can_access_state (IpcRunner             *runner,
                                              GDBusMethodInvocation *invocation)
@@ -200,6 +297,23 @@ ipc_runner_impl_handle_get_can_access_state (IpcRunner             *runner,
   return TRUE;
 }
 
+static void
+save_state_cb (RetroCore             *core,
+               GAsyncResult          *result,
+               GDBusMethodInvocation *invocation)
+{
+  IpcRunner *runner = IPC_RUNNER (g_dbus_method_invocation_get_user_data (invocation));
+  GError *error = NULL;
+
+  if (!retro_core_save_state_finish (core, result, &error)) {
+    g_dbus_method_invocation_take_error (invocation, error);
+
+    return;
+  }
+
+  ipc_runner_complete_save_state (runner, invocation);
+}
+
 static gboolean
 ipc_runner_impl_handle_save_state (IpcRunner             *runner,
                                    GDBusMethodInvocation *invocation,
@@ -207,11 +321,11 @@ ipc_runner_impl_handle_save_state (IpcRunner             *runner,
 {
   IpcRunnerImpl *self = IPC_RUNNER_IMPL (runner);
 
-  retro_try_propagate_dbus ({
-    retro_core_save_state (self->core, filename, &catch);
-  }, catch, invocation);
-
-  ipc_runner_complete_save_state (runner, invocation);
+  /* The invocation is completed once the state is written, the state is
+   * serialized right away so the emulation doesn't wait for the disk. */
+  retro_core_save_state_async (self->core, filename, NULL,
+                               (GAsyncReadyCallback) save_state_cb,
+                               invocation);
 
   return TRUE;
 }
@@ -282,71 +396,75 @@ ipc_runner_impl_handle_load_memory (IpcRunner             *runner,
 }
 
 static gboolean
-ipc_runner_impl_handle_update_variable (IpcRunner             *runner,
-                                        GDBusMethodInvocation *invocation,
-                                        const gchar           *key,
-                                        const gchar           *value)
+ipc_runner_impl_handle_set_memory_mirror (IpcRunner             *runner,
+                                          GDBusMethodInvocation *invocation,
+                                          RetroMemoryType        memory_type,
+                                          const gchar           *filename)
 {
   IpcRunnerImpl *self = IPC_RUNNER_IMPL (runner);
 
-  retro_core_update_variable (self->core, key, value);
+  /* DBus doesn't support nulls, an empty filename disables the mirror */
+  if (*filename == '\0')
+    filename = NULL;
 
-  ipc_runner_complete_update_variable (runner, invocation);
+  retro_try_propagate_dbus ({
+    retro_core_set_memory_mirror (self->core, memory_type, filename, &catch);
+  }, catch, invocation);
+
+  ipc_runner_complete_set_memory_mirror (runner, invocation);
 
   return TRUE;
 }
 
 static gboolean
-ipc_runner_handle_set_controller (IpcRunner             *runner,
-                                  GDBusMethodInvocation *invocation,
-                                  GUnixFDList           *fd_list,
-                                  guint                  port,
-                                  RetroControllerType    type,
-                                  GVariant              *data_handle)
+ipc_runner_impl_handle_set_memory_autosave (IpcRunner             *runner,
+                                            GDBusMethodInvocation *invocation,
+                                            RetroMemoryType        memory_type,
+                                            const gchar           *filename,
+                                            guint                  interval)
 {
   IpcRunnerImpl *self = IPC_RUNNER_IMPL (runner);
-  gint fd;
 
-  if (type != RETRO_CONTROLLER_TYPE_NONE) {
-    gint handle;
+  /* DBus doesn't support nulls, an empty filename disables the autosave */
+  if (*filename == '\0')
+    filename = NULL;
 
-    g_variant_get (data_handle, "h", &handle);
-    if (G_LIKELY (handle < g_unix_fd_list_get_length (fd_list))) {
-      retro_try_propagate_dbus ({
-        fd = g_unix_fd_list_get (fd_list, handle, &catch);
-      }, catch, invocation);
-    } else {
-      g_dbus_method_invocation_return_error (g_steal_pointer (&invocation),
-                                             G_DBUS_ERROR,
-                                             G_DBUS_ERROR_INVALID_ARGS,
-                                             "Invalid FD handle value");
+  retro_try_propagate_dbus ({
+    retro_core_set_memory_autosave (self->core, memory_type, filename,
+                                    interval, &catch);
+  }, catch, invocation);
 
-      return TRUE;
-    }
-  }
-  else
-    fd = -1;
+  ipc_runner_complete_set_memory_autosave (runner, invocation);
+
+  return TRUE;
+}
+
+static gboolean
+ipc_runner_impl_handle_update_variable (IpcRunner             *runner,
+                                        GDBusMethodInvocation *invocation,
+                                        const gchar           *key,
+                                        const gchar           *value)
+{
+  IpcRunnerImpl *self = IPC_RUNNER_IMPL (runner);
 
-  retro_core_set_controller (self->core, port, type, fd);
+  retro_core_update_variable (self->core, key, value);
 
-  ipc_runner_complete_set_controller (runner, invocation, NULL);
+  ipc_runner_complete_update_variable (runner, invocation);
 
   return TRUE;
 }
 
 static gboolean
-ipc_runner_impl_handle_key_event (IpcRunner                *runner,
-                                  GDBusMethodInvocation    *invocation,
-                                  gboolean                  pressed,
-                                  RetroKeyboardKey          keycode,
-                                  guint32                   character,
-                                  RetroKeyboardModifierKey  modifiers)
+ipc_runner_handle_set_controller (IpcRunner             *runner,
+                                  GDBusMethodInvocation *invocation,
+                                  guint                  port,
+                                  RetroControllerType    type)
 {
   IpcRunnerImpl *self = IPC_RUNNER_IMPL (runner);
 
-  retro_core_send_input_key_event (self->core, pressed, keycode, character, modifiers);
+  retro_core_set_controller (self->core, port, type);
 
-  ipc_runner_complete_key_event (runner, invocation);
+  ipc_runner_complete_set_controller (runner, invocation);
 
   return TRUE;
 }
@@ -456,6 +574,176 @@ set_rumble_state_cb (RetroCore         *core,
   ipc_runner_emit_set_rumble_state (IPC_RUNNER (self), port, effect, strength);
 }
 
+/* Method calls and property writes are received by the thread owning the
+ * D-Bus connection. They are queued in order to the context of the thread
+ * running the core, where they are dispatched between frames, so the core is
+ * only ever called from its own thread.
+ */
+static GDBusInterfaceVTable *parent_vtable = NULL;
+
+typedef struct {
+  GWeakRef skeleton;
+  GDBusConnection *connection;
+  gchar *sender;
+  gchar *object_path;
+  gchar *interface_name;
+  gchar *property_name;
+  GVariant *value;
+} SetPropertyData;
+
+static void
+free_set_property_data (SetPropertyData *data)
+{
+  g_weak_ref_clear (&data->skeleton);
+  g_object_unref (data->connection);
+  g_free (data->sender);
+  g_free (data->object_path);
+  g_free (data->interface_name);
+  g_free (data->property_name);
+  g_variant_unref (data->value);
+  g_free (data);
+}
+
+static void
+queue_to_core (IpcRunnerImpl  *self,
+               GSourceFunc     function,
+               gpointer        data,
+               GDestroyNotify  notify)
+{
+  g_autoptr (GSource) source = NULL;
+
+  /* The frames are dispatched with a higher priority, so queued calls never
+   * delay them. */
+  source = g_idle_source_new ();
+  g_source_set_priority (source, G_PRIORITY_DEFAULT);
+  g_source_set_callback (source, function, data, notify);
+  g_source_attach (source, retro_core_get_main_context (self->core));
+}
+
+static gboolean
+dispatch_method_call_cb (GDBusMethodInvocation *invocation)
+{
+  parent_vtable->method_call (g_dbus_method_invocation_get_connection (invocation),
+                              g_dbus_method_invocation_get_sender (invocation),
+                              g_dbus_method_invocation_get_object_path (invocation),
+                              g_dbus_method_invocation_get_interface_name (invocation),
+                              g_dbus_method_invocation_get_method_name (invocation),
+                              g_dbus_method_invocation_get_parameters (invocation),
+                              invocation,
+                              g_dbus_method_invocation_get_user_data (invocation));
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+handle_method_call (GDBusConnection       *connection,
+                    const gchar           *sender,
+                    const gchar           *object_path,
+                    const gchar           *interface_name,
+                    const gchar           *method_name,
+                    GVariant              *parameters,
+                    GDBusMethodInvocation *invocation,
+                    gpointer               user_data)
+{
+  IpcRunnerImpl *self = IPC_RUNNER_IMPL (user_data);
+
+  queue_to_core (self, (GSourceFunc) dispatch_method_call_cb, invocation, NULL);
+}
+
+static gboolean
+dispatch_set_property_cb (SetPropertyData *data)
+{
+  g_autoptr (GDBusInterfaceSkeleton) skeleton = NULL;
+  g_autoptr (GError) error = NULL;
+
+  skeleton = g_weak_ref_get (&data->skeleton);
+  if (skeleton == NULL)
+    return G_SOURCE_REMOVE;
+
+  if (!parent_vtable->set_property (data->connection,
+                                    data->sender,
+                                    data->object_path,
+                                    data->interface_name,
+                                    data->property_name,
+                                    data->value,
+                                    &error,
+                                    skeleton))
+    g_critical ("Couldn't set property %s: %s", data->property_name, error->message);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+handle_set_property (GDBusConnection  *connection,
+                     const gchar      *sender,
+                     const gchar      *object_path,
+                     const gchar      *interface_name,
+                     const gchar      *property_name,
+                     GVariant         *value,
+                     GError          **error,
+                     gpointer          user_data)
+{
+  IpcRunnerImpl *self = IPC_RUNNER_IMPL (user_data);
+  GDBusInterfaceInfo *info;
+  GDBusPropertyInfo *property_info;
+  SetPropertyData *data;
+
+  /* The property is bound to the core, so it must be set from its thread too.
+   * Waiting for it would stall the connection behind a long frame or a
+   * benchmark, so only check what can be checked here and reply right away. */
+  info = g_dbus_interface_skeleton_get_info (G_DBUS_INTERFACE_SKELETON (self));
+  property_info = g_dbus_interface_info_lookup_property (info, property_name);
+  if (property_info == NULL ||
+      !(property_info->flags & G_DBUS_PROPERTY_INFO_FLAGS_WRITABLE)) {
+    g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                 "No writable property %s", property_name);
+
+    return FALSE;
+  }
+
+  if (!g_variant_is_of_type (value, G_VARIANT_TYPE (property_info->signature))) {
+    g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                 "Expected type %s for property %s, got %s",
+                 property_info->signature, property_name,
+                 g_variant_get_type_string (value));
+
+    return FALSE;
+  }
+
+  data = g_new0 (SetPropertyData, 1);
+  g_weak_ref_init (&data->skeleton, self);
+  data->connection = g_object_ref (connection);
+  data->sender = g_strdup (sender);
+  data->object_path = g_strdup (object_path);
+  data->interface_name = g_strdup (interface_name);
+  data->property_name = g_strdup (property_name);
+  data->value = g_variant_ref (value);
+
+  /* The source owns the data, so it is freed even if the core's loop quit,
+   * and doesn't keep the core alive past its thread. */
+  queue_to_core (self,
+                 (GSourceFunc) dispatch_set_property_cb, data,
+                 (GDestroyNotify) free_set_property_data);
+
+  return TRUE;
+}
+
+static GDBusInterfaceVTable *
+ipc_runner_impl_get_vtable (GDBusInterfaceSkeleton *skeleton)
+{
+  static GDBusInterfaceVTable vtable;
+
+  if (parent_vtable == NULL) {
+    parent_vtable = G_DBUS_INTERFACE_SKELETON_CLASS (ipc_runner_impl_parent_class)->get_vtable (skeleton);
+
+    vtable = *parent_vtable;
+    vtable.method_call = handle_method_call;
+    vtable.set_property = handle_set_property;
+  }
+
+  return &vtable;
+}
+
 static void
 ipc_runner_impl_constructed (GObject *object)
 {
@@ -496,6 +784,9 @@ ipc_runner_impl_constructed (GObject *object)
   g_object_bind_property (self->core, "runahead",
                           self,       "runahead",
                           G_BINDING_SYNC_CREATE | G_BINDING_BIDIRECTIONAL);
+  g_object_bind_property (self->core, "display-refresh-rate",
+                          self,       "display-refresh-rate",
+                          G_BINDING_SYNC_CREATE | G_BINDING_BIDIRECTIONAL);
 
   g_signal_connect (self->core, "message",
                     G_CALLBACK (message_cb), self);
@@ -537,17 +828,22 @@ ipc_runner_iface_init (IpcRunnerIface *iface)
   iface->handle_reset = ipc_runner_impl_handle_reset;
   iface->handle_iteration = ipc_runner_impl_handle_iteration;
 
+  iface->handle_get_frame_statistics = ipc_runner_impl_handle_get_frame_statistics;
+  iface->handle_get_pipeline_statistics = ipc_runner_impl_handle_get_pipeline_statistics;
+  iface->handle_benchmark = ipc_runner_impl_handle_benchmark;
+
   iface->handle_get_can_access_state = ipc_runner_impl_handle_get_can_access_state;
   iface->handle_save_state = ipc_runner_impl_handle_save_state;
   iface->handle_load_state = ipc_runner_impl_handle_load_state;
   iface->handle_get_memory_size = ipc_runner_impl_handle_get_memory_size;
   iface->handle_save_memory = ipc_runner_impl_handle_save_memory;
   iface->handle_load_memory = ipc_runner_impl_handle_load_memory;
+  iface->handle_set_memory_mirror = ipc_runner_impl_handle_set_memory_mirror;
+  iface->handle_set_memory_autosave = ipc_runner_impl_handle_set_memory_autosave;
 
   iface->handle_update_variable = ipc_runner_impl_handle_update_variable;
 
   iface->handle_set_controller = ipc_runner_handle_set_controller;
-  iface->handle_key_event = ipc_runner_impl_handle_key_event;
 
   iface->handle_get_properties = ipc_runner_impl_handle_get_properties;
 }
@@ -556,12 +852,15 @@ static void
 ipc_runner_impl_class_init (IpcRunnerImplClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GDBusInterfaceSkeletonClass *skeleton_class = G_DBUS_INTERFACE_SKELETON_CLASS (klass);
 
   object_class->constructed = ipc_runner_impl_constructed;
   object_class->finalize = ipc_runner_impl_finalize;
   object_class->get_property = ipc_runner_impl_get_property;
   object_class->set_property = ipc_runner_impl_set_property;
 
+  skeleton_class->get_vtable = ipc_runner_impl_get_vtable;
+
   properties [PROP_CORE] =
     g_param_spec_object ("core",
                          "Core",
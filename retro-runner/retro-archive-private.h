@@ -0,0 +1,17 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#pragma once
+
+#if !defined(__RETRO_GTK_INSIDE__) && !defined(RETRO_GTK_COMPILATION)
+# error "Only <retro-gtk.h> can be included directly."
+#endif
+
+#include <glib-2.0/glib.h>
+
+G_BEGIN_DECLS
+
+gint retro_archive_open_member (const gchar  *archive_path,
+                                const gchar  *member,
+                                GError      **error);
+
+G_END_DECLS
@@ -0,0 +1,387 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#include "retro-archive-private.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef LIBARCHIVE_ENABLED
+#include <archive.h>
+#include <archive_entry.h>
+#include "retro-memfd-private.h"
+
+/* The size of the buffer members are decompressed through, the whole member
+ * is never held in the heap. */
+#define RETRO_ARCHIVE_BUFFER_SIZE (64 * 1024)
+
+/* The size in MiB of the cache of decompressed members, it is disabled if
+ * unset or 0. */
+#define RETRO_ARCHIVE_ENV_CACHE_SIZE "RETRO_CONTENT_CACHE_SIZE"
+
+typedef struct archive RetroArchive;
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (RetroArchive, archive_read_free)
+
+typedef struct {
+  gchar *name;
+  gint64 mtime;
+  guint64 size;
+} RetroArchiveCacheEntry;
+
+static guint64
+get_cache_size (void)
+{
+  const gchar *size = g_getenv (RETRO_ARCHIVE_ENV_CACHE_SIZE);
+
+  if (size == NULL)
+    return 0;
+
+  return g_ascii_strtoull (size, NULL, 10) * 1024 * 1024;
+}
+
+/* Identifies a member of a given version of an archive. */
+static gchar *
+get_member_key (const gchar *archive_path,
+                GStatBuf    *archive_stat,
+                const gchar *member)
+{
+  g_autofree gchar *key = NULL;
+
+  key = g_strdup_printf ("%s\n%" G_GINT64_FORMAT "\n%" G_GINT64_FORMAT "\n%s",
+                         archive_path,
+                         (gint64) archive_stat->st_size,
+                         (gint64) archive_stat->st_mtime,
+                         member);
+
+  return g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+}
+
+/* The cache holds the decompressed members named by the hash of their content,
+ * and the keys/ directory maps member keys to them with symbolic links. The
+ * modification time of the members is their last use. */
+static gint
+lookup_cache (const gchar *cache_dir,
+              const gchar *key)
+{
+  g_autofree gchar *key_path = g_build_filename (cache_dir, "keys", key, NULL);
+  gint fd;
+
+  fd = g_open (key_path, O_RDONLY | O_CLOEXEC, 0);
+  if (fd < 0) {
+    /* The link is dangling if the content was evicted. */
+    g_unlink (key_path);
+
+    return -1;
+  }
+
+  if (futimens (fd, NULL) != 0)
+    g_debug ("Couldn't mark the cached content as used: %s", g_strerror (errno));
+
+  return fd;
+}
+
+static gint
+compare_cache_entries (const RetroArchiveCacheEntry *a,
+                       const RetroArchiveCacheEntry *b)
+{
+  return (a->mtime > b->mtime) - (a->mtime < b->mtime);
+}
+
+static void
+clear_cache_entry (RetroArchiveCacheEntry *entry)
+{
+  g_free (entry->name);
+}
+
+/* Removes the links of keys/ to evicted contents. Links are otherwise only
+ * removed when looked up, and most keys are never looked up again. */
+static void
+prune_keys (const gchar *cache_dir)
+{
+  g_autofree gchar *keys_dir = g_build_filename (cache_dir, "keys", NULL);
+  g_autoptr (GDir) dir = NULL;
+  const gchar *name;
+
+  dir = g_dir_open (keys_dir, 0, NULL);
+  if (dir == NULL)
+    return;
+
+  while ((name = g_dir_read_name (dir)) != NULL) {
+    g_autofree gchar *path = g_build_filename (keys_dir, name, NULL);
+    GStatBuf buf;
+
+    if (g_stat (path, &buf) != 0 && errno == ENOENT)
+      g_unlink (path);
+  }
+}
+
+/* Removes the least recently used contents until the cache fits in
+ * @cache_size, except @keep. */
+static void
+evict_cache (const gchar *cache_dir,
+             guint64      cache_size,
+             const gchar *keep)
+{
+  g_autoptr (GDir) dir = NULL;
+  g_autoptr (GArray) entries = NULL;
+  const gchar *name;
+  guint64 total_size = 0;
+
+  dir = g_dir_open (cache_dir, 0, NULL);
+  if (dir == NULL)
+    return;
+
+  entries = g_array_new (FALSE, FALSE, sizeof (RetroArchiveCacheEntry));
+  g_array_set_clear_func (entries, (GDestroyNotify) clear_cache_entry);
+
+  while ((name = g_dir_read_name (dir)) != NULL) {
+    g_autofree gchar *path = g_build_filename (cache_dir, name, NULL);
+    RetroArchiveCacheEntry entry;
+    GStatBuf buf;
+
+    if (g_lstat (path, &buf) != 0 || !S_ISREG (buf.st_mode))
+      continue;
+
+    entry.name = g_strdup (name);
+    entry.mtime = buf.st_mtime;
+    entry.size = buf.st_size;
+    g_array_append_val (entries, entry);
+
+    total_size += buf.st_size;
+  }
+
+  g_array_sort (entries, (GCompareFunc) compare_cache_entries);
+
+  for (gsize i = 0; i < entries->len && total_size > cache_size; i++) {
+    RetroArchiveCacheEntry *entry = &g_array_index (entries, RetroArchiveCacheEntry, i);
+    g_autofree gchar *path = NULL;
+
+    if (g_strcmp0 (entry->name, keep) == 0)
+      continue;
+
+    path = g_build_filename (cache_dir, entry->name, NULL);
+    if (g_unlink (path) == 0)
+      total_size -= entry->size;
+  }
+
+  prune_keys (cache_dir);
+}
+
+static void
+add_to_cache (const gchar *cache_dir,
+              const gchar *key,
+              const gchar *tmp_path,
+              const gchar *content_hash,
+              guint64      cache_size)
+{
+  g_autofree gchar *content_path = g_build_filename (cache_dir, content_hash, NULL);
+  g_autofree gchar *keys_dir = g_build_filename (cache_dir, "keys", NULL);
+  g_autofree gchar *key_path = g_build_filename (keys_dir, key, NULL);
+  g_autofree gchar *tmp_key_path = g_strconcat (key_path, ".tmp", NULL);
+  g_autofree gchar *target = g_build_filename ("..", content_hash, NULL);
+
+  if (g_rename (tmp_path, content_path) != 0) {
+    g_unlink (tmp_path);
+
+    return;
+  }
+
+  /* Replace the link atomically, other runners may be looking it up. */
+  if (g_mkdir_with_parents (keys_dir, 0700) != 0 ||
+      symlink (target, tmp_key_path) != 0 ||
+      g_rename (tmp_key_path, key_path) != 0) {
+    g_debug ("Couldn't add the content to the cache: %s", g_strerror (errno));
+    g_unlink (tmp_key_path);
+  }
+
+  evict_cache (cache_dir, cache_size, content_hash);
+}
+
+static gboolean
+write_all (gint           fd,
+           const guint8  *data,
+           gsize          size,
+           GError       **error)
+{
+  while (size > 0) {
+    gssize written = write (fd, data, size);
+
+    if (written < 0 && errno == EINTR)
+      continue;
+
+    if (written < 0) {
+      int errsv = errno;
+
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   "Couldn't write the content: %s", g_strerror (errsv));
+
+      return FALSE;
+    }
+
+    data += written;
+    size -= written;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+find_member (struct archive  *archive,
+             const gchar     *member,
+             GError         **error)
+{
+  struct archive_entry *entry;
+  gint result;
+
+  while ((result = archive_read_next_header (archive, &entry)) == ARCHIVE_OK)
+    if (g_strcmp0 (archive_entry_pathname (entry), member) == 0)
+      return TRUE;
+
+  if (result == ARCHIVE_EOF)
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                 "The archive has no member %s", member);
+  else
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                 "Couldn't read the archive: %s", archive_error_string (archive));
+
+  return FALSE;
+}
+
+/**
+ * retro_archive_open_member:
+ * @archive_path: the path of an archive
+ * @member: the path of a member of the archive
+ * @error: return location for a #GError, or %NULL
+ *
+ * Decompresses @member into a memfd, streaming it from the archive. If the
+ * content cache is enabled, the decompressed member is also saved in the
+ * cache, and later calls open it from there instead.
+ *
+ * Returns: a file descriptor holding the member, or -1 on error
+ */
+gint
+retro_archive_open_member (const gchar  *archive_path,
+                           const gchar  *member,
+                           GError      **error)
+{
+  g_autoptr (RetroArchive) archive = NULL;
+  g_autoptr (GChecksum) checksum = NULL;
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *key = NULL;
+  g_autofree gchar *cache_dir = NULL;
+  g_autofree gchar *tmp_path = NULL;
+  g_autofree guint8 *buffer = NULL;
+  guint64 cache_size;
+  gint fd, cache_fd = -1;
+  gssize size;
+
+  g_return_val_if_fail (archive_path != NULL, -1);
+  g_return_val_if_fail (member != NULL, -1);
+
+  path = g_canonicalize_filename (archive_path, NULL);
+
+  cache_size = get_cache_size ();
+  if (cache_size > 0) {
+    GStatBuf buf;
+
+    if (g_stat (path, &buf) == 0) {
+      cache_dir = g_build_filename (g_get_user_cache_dir (), "retro-gtk", "content", NULL);
+      key = get_member_key (path, &buf, member);
+
+      fd = lookup_cache (cache_dir, key);
+      if (fd >= 0)
+        return fd;
+    }
+  }
+
+  archive = archive_read_new ();
+  archive_read_support_filter_all (archive);
+  archive_read_support_format_all (archive);
+
+  if (archive_read_open_filename (archive, path, RETRO_ARCHIVE_BUFFER_SIZE) != ARCHIVE_OK) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                 "Couldn't open the archive: %s", archive_error_string (archive));
+
+    return -1;
+  }
+
+  if (!find_member (archive, member, error))
+    return -1;
+
+  fd = retro_memfd_create ("[retro-runner content]");
+  if (fd < 0) {
+    int errsv = errno;
+
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                 "Couldn't create a memfd: %s", g_strerror (errsv));
+
+    return -1;
+  }
+
+  /* Caching is best effort, loading the content doesn't fail because of it. */
+  if (key != NULL && g_mkdir_with_parents (cache_dir, 0700) == 0) {
+    tmp_path = g_build_filename (cache_dir, "tmp-XXXXXX", NULL);
+    cache_fd = g_mkstemp_full (tmp_path, O_WRONLY | O_CLOEXEC, 0600);
+    checksum = g_checksum_new (G_CHECKSUM_SHA1);
+  }
+
+  buffer = g_malloc (RETRO_ARCHIVE_BUFFER_SIZE);
+  while ((size = archive_read_data (archive, buffer, RETRO_ARCHIVE_BUFFER_SIZE)) > 0) {
+    if (!write_all (fd, buffer, size, error))
+      break;
+
+    if (cache_fd < 0)
+      continue;
+
+    g_checksum_update (checksum, buffer, size);
+    if (!write_all (cache_fd, buffer, size, NULL)) {
+      g_close (cache_fd, NULL);
+      g_unlink (tmp_path);
+      cache_fd = -1;
+    }
+  }
+
+  if (size < 0)
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                 "Couldn't decompress %s: %s", member, archive_error_string (archive));
+
+  if (size != 0) {
+    if (cache_fd >= 0) {
+      g_close (cache_fd, NULL);
+      g_unlink (tmp_path);
+    }
+    g_close (fd, NULL);
+
+    return -1;
+  }
+
+  if (cache_fd >= 0) {
+    if (g_close (cache_fd, NULL))
+      add_to_cache (cache_dir, key, tmp_path,
+                    g_checksum_get_string (checksum), cache_size);
+    else
+      g_unlink (tmp_path);
+  }
+
+  return fd;
+}
+
+#else
+
+gint
+retro_archive_open_member (const gchar  *archive_path,
+                           const gchar  *member,
+                           GError      **error)
+{
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+               "Couldn't open %s from %s: archives aren't supported",
+               member, archive_path);
+
+  return -1;
+}
+
+#endif
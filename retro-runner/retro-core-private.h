@@ -6,13 +6,16 @@
 # error "Only <retro-gtk.h> can be included directly."
 #endif
 
+#include "retro-benchmark-flags.h"
 #include "retro-controller-state-private.h"
 #include "retro-core.h"
 #include "retro-disk-control-callback-private.h"
+#include "retro-frame-times-private.h"
 #include "retro-framebuffer-private.h"
 #include "retro-input.h"
 #include "retro-input-descriptor-private.h"
 #include "retro-module-private.h"
+#include "retro-pipeline-stats-private.h"
 #include "retro-pixel-format-private.h"
 #include "retro-renderer-private.h"
 #include "retro-rotation-private.h"
@@ -20,10 +23,39 @@
 
 G_BEGIN_DECLS
 
+#define RETRO_MEMORY_TYPE_COUNT (RETRO_MEMORY_TYPE_VIDEO_RAM + 1)
+
 typedef struct {
   void (*callback) (bool down, guint keycode, guint32 character, guint16 key_modifiers);
 } RetroKeyboardCallback;
 
+typedef struct {
+  RetroCore *core;
+  RetroMemoryType memory_type;
+  /* The file last written or read, and a copy of its content. */
+  gchar *filename;
+  guint8 *shadow;
+  gsize size;
+  gchar *autosave_filename;
+  guint autosave_id;
+  /* The mapped file continuously mirroring the region. */
+  gchar *mirror_filename;
+  guint8 *mirror;
+  gsize mirror_size;
+  gboolean mirror_dirty;
+} RetroSavedMemory;
+
+/* Times are in nanoseconds, the core time excludes the time spent consuming
+ * the video and audio output. */
+typedef struct {
+  RetroBenchmarkFlags flags;
+  gint64 total_time;
+  gint64 core_time;
+  gint64 video_time;
+  gint64 audio_time;
+  RetroFrameTimes frame_times;
+} RetroBenchmark;
+
 struct _RetroCore
 {
   GObject parent_instance;
@@ -41,6 +73,7 @@ struct _RetroCore
   RetroModule *module;
   RetroDiskControlCallback *disk_control_callback;
   gchar **media_uris;
+  GArray *media_fds;
   RetroSystemInfo *system_info;
   gfloat aspect_ratio;
   gboolean overscan;
@@ -49,23 +82,36 @@ struct _RetroCore
   gdouble sample_rate;
 
   RetroFramebuffer *framebuffer;
+  RetroPipelineStats *pipeline_stats;
   RetroRenderer *renderer;
   RetroKeyboardCallback keyboard_callback;
-  RetroControllerState *default_controller;
-  GHashTable *controllers;
+  RetroControllerState *controller_state;
   GHashTable *variables;
   GHashTable *variable_overrides;
   gboolean variable_updated;
   guint runahead;
   gssize run_remaining;
   gdouble speed_rate;
+  gdouble display_refresh_rate;
+  GMainContext *context;
+  GThread *thread;
   glong main_loop;
+  RetroFrameTimes frame_times;
 
   gboolean has_run;
   gboolean block_video_signal;
+  RetroBenchmark *benchmark;
+
+  RetroGameInfo *content;
+  gchar *content_hash;
+  guint64 frame_count;
+  GByteArray *state_buffer;
+  RetroSavedMemory saved_memory[RETRO_MEMORY_TYPE_COUNT];
+  guint memory_mirror_sync_id;
 };
 
 RetroCore *retro_core_get_instance (void);
+GMainContext *retro_core_get_main_context (RetroCore *self);
 const gchar *retro_core_get_libretro_path (RetroCore *self);
 void retro_core_set_support_no_game (RetroCore *self,
                                      gboolean   support_no_game);
@@ -75,6 +121,8 @@ void retro_core_set_system_av_info (RetroCore         *self,
 void retro_core_set_geometry (RetroCore         *self,
                               RetroGameGeometry *geometry);
 void retro_core_poll_controllers (RetroCore *self);
+guint16 retro_core_get_controller_joypad_mask (RetroCore *self,
+                                               guint      port);
 gint16 retro_core_get_controller_input_state (RetroCore  *self,
                                               uint        port,
                                               RetroInput *input);
@@ -89,5 +137,11 @@ gboolean retro_core_get_variable_update (RetroCore *self);
 gdouble retro_core_get_sample_rate (RetroCore *self);
 
 gint retro_core_get_framebuffer_fd (RetroCore *self);
+gint retro_core_get_pipeline_stats_fd (RetroCore *self);
+
+void retro_core_benchmark (RetroCore           *self,
+                           guint64              n_frames,
+                           RetroBenchmarkFlags  flags,
+                           RetroBenchmark      *benchmark);
 
 G_END_DECLS
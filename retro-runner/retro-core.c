@@ -2,15 +2,25 @@
 
 #include "retro-core-private.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <math.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "retro-core-error-private.h"
+#include "retro-debug-private.h"
 #include "retro-error-private.h"
 #include "retro-environment-private.h"
 #include "retro-input-private.h"
 #include "retro-main-loop-source-private.h"
 #include "retro-memfd-private.h"
+#include "retro-profiler-private.h"
 #include "retro-rumble-effect.h"
+#include "retro-state-private.h"
 
 G_DEFINE_QUARK (retro-core-error, retro_core_error)
 
@@ -30,6 +40,7 @@ enum {
   PROP_FRAMES_PER_SECOND,
   PROP_RUNAHEAD,
   PROP_SPEED_RATE,
+  PROP_DISPLAY_REFRESH_RATE,
   N_PROPS,
 };
 
@@ -49,10 +60,33 @@ enum {
 
 static guint signals[N_SIGNALS];
 
+/* Mirrored memory regions are compared and copied by chunks so only the pages
+ * that changed are written back. */
+#define MEMORY_MIRROR_CHUNK_SIZE 4096
+#define MEMORY_MIRROR_SYNC_INTERVAL 1
+
+/* Content running close enough to the display refresh rate is paced at the
+ * display refresh rate to avoid judder, e.g. 59.94 Hz content on a 60 Hz
+ * display. */
+#define MAX_DISPLAY_REFRESH_RATE_DEVIATION 0.01
+
+/* The content is identified in the saved states by its size and the hash of
+ * its head and tail, hashing a whole disc image would stall the emulation. */
+#define CONTENT_HASH_SAMPLE_SIZE (1024 * 1024)
+
 static RetroCore *retro_core_instance = NULL;
 
 static void set_filename (RetroCore   *self,
                           const gchar *filename);
+static void saved_memory_clear (RetroSavedMemory *saved);
+static gboolean autosave_memory_cb (RetroSavedMemory *saved);
+static void update_memory_mirror (RetroCore        *self,
+                                  RetroSavedMemory *saved);
+
+/* Libretro cores are not thread-safe, every call into the module must happen
+ * on the thread that created the core. */
+#define retro_core_assert_thread(self) \
+  g_assert ((self)->thread == g_thread_self ())
 
 /* Private */
 
@@ -64,6 +98,46 @@ retro_core_get_instance (void)
   return retro_core_instance;
 }
 
+GMainContext *
+retro_core_get_main_context (RetroCore *self)
+{
+  g_return_val_if_fail (RETRO_IS_CORE (self), NULL);
+
+  return self->context;
+}
+
+/* The sources are attached to the context of the thread running the core
+ * rather than to the global default context, which is busy with D-Bus. */
+static guint
+add_timeout_seconds (RetroCore   *self,
+                     guint        interval,
+                     GSourceFunc  function,
+                     gpointer     data)
+{
+  g_autoptr (GSource) source = NULL;
+
+  source = g_timeout_source_new_seconds (interval);
+  g_source_set_callback (source, function, data, NULL);
+
+  return g_source_attach (source, self->context);
+}
+
+static void
+remove_source (RetroCore *self,
+               guint     *id)
+{
+  GSource *source;
+
+  if (*id == 0)
+    return;
+
+  source = g_main_context_find_source_by_id (self->context, *id);
+  if (source != NULL)
+    g_source_destroy (source);
+
+  *id = 0;
+}
+
 static void
 retro_core_constructed (GObject *object)
 {
@@ -86,6 +160,9 @@ retro_core_constructed (GObject *object)
   memfd = retro_memfd_create ("[retro-runner framebuffer]");
   self->framebuffer = retro_framebuffer_new (memfd);
 
+  memfd = retro_memfd_create ("[retro-runner pipeline statistics]");
+  self->pipeline_stats = retro_pipeline_stats_new (memfd);
+
   G_OBJECT_CLASS (retro_core_parent_class)->constructed (object);
 }
 
@@ -98,6 +175,20 @@ retro_core_finalize (GObject *object)
 
   retro_core_stop (self);
 
+  for (RetroMemoryType type = 0; type < RETRO_MEMORY_TYPE_COUNT; type++) {
+    RetroSavedMemory *saved = &self->saved_memory[type];
+
+    /* Don't lose what changed since the last autosave. */
+    if (saved->autosave_id != 0)
+      autosave_memory_cb (saved);
+
+    if (saved->mirror != NULL)
+      update_memory_mirror (self, saved);
+
+    saved_memory_clear (saved);
+  }
+  remove_source (self, &self->memory_mirror_sync_id);
+
   if (retro_core_get_game_loaded (self)) {
     unload_game = retro_module_get_unload_game (self->module);
     unload_game ();
@@ -106,11 +197,13 @@ retro_core_finalize (GObject *object)
   deinit ();
 
   g_clear_pointer (&self->media_uris, g_strfreev);
+  g_clear_pointer (&self->media_fds, g_array_unref);
 
+  g_main_context_unref (self->context);
   g_object_unref (self->module);
   g_object_unref (self->framebuffer);
-  g_clear_object (&self->default_controller);
-  g_hash_table_unref (self->controllers);
+  g_object_unref (self->pipeline_stats);
+  g_clear_object (&self->controller_state);
   g_hash_table_unref (self->variables);
   g_hash_table_unref (self->variable_overrides);
 
@@ -120,6 +213,9 @@ retro_core_finalize (GObject *object)
   g_free (self->core_assets_directory);
   g_free (self->save_directory);
   g_clear_object (&self->renderer);
+  g_clear_pointer (&self->content, retro_game_info_unref);
+  g_free (self->content_hash);
+  g_clear_pointer (&self->state_buffer, g_byte_array_unref);
 
   G_OBJECT_CLASS (retro_core_parent_class)->finalize (object);
 }
@@ -176,6 +272,10 @@ retro_core_get_property (GObject    *object,
   case PROP_SPEED_RATE:
     g_value_set_double (value, retro_core_get_speed_rate (self));
 
+    break;
+  case PROP_DISPLAY_REFRESH_RATE:
+    g_value_set_double (value, retro_core_get_display_refresh_rate (self));
+
     break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -220,6 +320,10 @@ retro_core_set_property (GObject      *object,
   case PROP_SPEED_RATE:
     retro_core_set_speed_rate (self, g_value_get_double (value));
 
+    break;
+  case PROP_DISPLAY_REFRESH_RATE:
+    retro_core_set_display_refresh_rate (self, g_value_get_double (value));
+
     break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -432,6 +536,21 @@ retro_core_class_init (RetroCoreClass *klass)
                          G_PARAM_STATIC_NICK |
                          G_PARAM_STATIC_BLURB);
 
+  /**
+   * RetroCore:display-refresh-rate:
+   *
+   * The refresh rate of the display, or 0 if unknown.
+   */
+  properties[PROP_DISPLAY_REFRESH_RATE] =
+    g_param_spec_double ("display-refresh-rate",
+                         "Display refresh rate",
+                         "The refresh rate of the display",
+                         0.0, G_MAXDOUBLE, 0.0,
+                         G_PARAM_READWRITE |
+                         G_PARAM_STATIC_NAME |
+                         G_PARAM_STATIC_NICK |
+                         G_PARAM_STATIC_BLURB);
+
   g_object_class_install_properties (G_OBJECT_CLASS (klass), N_PROPS, properties);
 
   /**
@@ -584,11 +703,16 @@ retro_core_init (RetroCore *self)
   self->variable_overrides = g_hash_table_new_full (g_str_hash, g_str_equal,
                                                     g_free, g_free);
 
-  self->controllers = g_hash_table_new_full (g_direct_hash, g_direct_equal,
-                                             NULL, g_object_unref);
-
   self->main_loop = -1;
   self->speed_rate = 1;
+
+  self->context = g_main_context_ref_thread_default ();
+  self->thread = g_thread_self ();
+
+  for (RetroMemoryType type = 0; type < RETRO_MEMORY_TYPE_COUNT; type++) {
+    self->saved_memory[type].core = self;
+    self->saved_memory[type].memory_type = type;
+  }
 }
 
 static void
@@ -823,6 +947,24 @@ add_disk_image_index (RetroCore  *self,
   return add_image_index ();
 }
 
+static RetroGameInfo *
+open_media (RetroCore  *self,
+            guint       index,
+            gboolean    needs_full_path,
+            GError    **error)
+{
+  gint fd = -1;
+
+  if (self->media_fds != NULL && index < self->media_fds->len)
+    fd = g_array_index (self->media_fds, gint, index);
+
+  if (fd >= 0)
+    return retro_game_info_new_for_fd (self->media_uris[index], fd,
+                                       needs_full_path, error);
+
+  return retro_game_info_new (self->media_uris[index], needs_full_path, error);
+}
+
 static void
 load_discs (RetroCore  *self,
             GError    **error)
@@ -848,9 +990,7 @@ load_discs (RetroCore  *self,
     g_autoptr (RetroGameInfo) game_info = NULL;
 
     retro_try_propagate ({
-      game_info = retro_game_info_new (self->media_uris[index],
-                                       fullpath,
-                                       &catch);
+      game_info = open_media (self, index, fullpath, &catch);
     }, catch, error);
 
     retro_try_propagate ({
@@ -925,11 +1065,15 @@ load_medias (RetroCore  *self,
   }
 
   retro_try_propagate ({
-    game_info = retro_game_info_new (self->media_uris[0],
-                                     get_needs_full_path (self),
-                                     &catch);
+    game_info = open_media (self, 0, get_needs_full_path (self), &catch);
   }, catch, error);
 
+  /* Keep the content to identify it in the saved states, it is hashed only
+   * when needed. */
+  g_clear_pointer (&self->content, retro_game_info_unref);
+  g_clear_pointer (&self->content_hash, g_free);
+  self->content = retro_game_info_ref (game_info);
+
   retro_try_propagate ({
     load_game (self, game_info, &catch);
   }, catch, error);
@@ -940,6 +1084,345 @@ load_medias (RetroCore  *self,
     }, catch, error);
 }
 
+typedef struct {
+  gchar *filename;
+  RetroStateHeader header;
+  GByteArray *data;
+} SaveStateData;
+
+static void
+save_state_data_free (SaveStateData *data)
+{
+  g_free (data->filename);
+  retro_state_header_clear (&data->header);
+  g_clear_pointer (&data->data, g_byte_array_unref);
+  g_free (data);
+}
+
+/* Identifies the content in the saved states. Cores needing the full path
+ * don't get the data, use the name instead of reading the file. */
+static const gchar *
+get_content_hash (RetroCore *self)
+{
+  g_autoptr (GChecksum) checksum = NULL;
+  const guint8 *data;
+  gsize size;
+  guint64 size_le;
+
+  if (self->content_hash != NULL || self->content == NULL)
+    return self->content_hash;
+
+  if (self->content->size == 0 && self->content->name == NULL)
+    return NULL;
+
+  if (self->content->size == 0) {
+    self->content_hash = g_compute_checksum_for_string (G_CHECKSUM_SHA1,
+                                                        self->content->name, -1);
+
+    return self->content_hash;
+  }
+
+  data = self->content->data;
+  size = self->content->size;
+  size_le = GUINT64_TO_LE ((guint64) size);
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA1);
+  g_checksum_update (checksum, (const guint8 *) &size_le, sizeof (size_le));
+  if (size <= 2 * CONTENT_HASH_SAMPLE_SIZE)
+    g_checksum_update (checksum, data, size);
+  else {
+    g_checksum_update (checksum, data, CONTENT_HASH_SAMPLE_SIZE);
+    g_checksum_update (checksum, data + size - CONTENT_HASH_SAMPLE_SIZE,
+                       CONTENT_HASH_SAMPLE_SIZE);
+  }
+
+  self->content_hash = g_strdup (g_checksum_get_string (checksum));
+
+  return self->content_hash;
+}
+
+static void
+get_state_header (RetroCore        *self,
+                  RetroStateHeader *header)
+{
+  RetroSystemInfo system_info = { 0 };
+
+  get_system_info (self, &system_info);
+
+  header->core_name = g_strdup (system_info.library_name);
+  header->core_version = g_strdup (system_info.library_version);
+  header->content_hash = g_strdup (get_content_hash (self));
+  header->frame_count = self->frame_count;
+  header->timestamp = g_get_real_time () / G_USEC_PER_SEC;
+}
+
+static GByteArray *
+serialize_state (RetroCore  *self,
+                 GError    **error)
+{
+  RetroSerializeSize serialize_size = NULL;
+  RetroSerialize serialize = NULL;
+  g_autoptr (GByteArray) data = NULL;
+  gsize size;
+
+  serialize_size = retro_module_get_serialize_size (self->module);
+  size = serialize_size ();
+
+  if (size <= 0) {
+    g_set_error_literal (error,
+                         RETRO_CORE_ERROR,
+                         RETRO_CORE_ERROR_SERIALIZATION_NOT_SUPPORTED,
+                         "Couldn't serialize the internal state: serialization not supported.");
+
+    return NULL;
+  }
+
+  /* Reuse the buffer of the previous save unless it is still being written,
+   * this avoids allocating the whole state each time. */
+  data = g_steal_pointer (&self->state_buffer);
+  if (data == NULL)
+    data = g_byte_array_sized_new (size);
+
+  g_byte_array_set_size (data, size);
+  memset (data->data, 0, size);
+
+  serialize = retro_module_get_serialize (self->module);
+
+  if (!serialize (data->data, size)) {
+    g_set_error_literal (error,
+                         RETRO_CORE_ERROR,
+                         RETRO_CORE_ERROR_COULDNT_SERIALIZE,
+                         "Couldn't serialize the internal state: serialization failed.");
+
+    self->state_buffer = g_steal_pointer (&data);
+
+    return NULL;
+  }
+
+  return g_steal_pointer (&data);
+}
+
+static void
+release_state_buffer (RetroCore  *self,
+                      GByteArray *data)
+{
+  if (self->state_buffer == NULL)
+    self->state_buffer = data;
+  else
+    g_byte_array_unref (data);
+}
+
+static gboolean
+write_state (const gchar             *filename,
+             const RetroStateHeader  *header,
+             GByteArray              *data,
+             GError                 **error)
+{
+  retro_try ({
+    retro_state_save (filename, header, data->data, data->len, &catch);
+  }, catch, {
+    g_set_error (error,
+                 RETRO_CORE_ERROR,
+                 RETRO_CORE_ERROR_COULDNT_ACCESS_FILE,
+                 "Couldn't serialize the internal state: %s",
+                 catch->message);
+
+    return FALSE;
+  });
+
+  return TRUE;
+}
+
+/* This runs in a worker thread, it must not access the core. */
+static void
+save_state_thread (GTask         *task,
+                   RetroCore     *self,
+                   SaveStateData *data,
+                   GCancellable  *cancellable)
+{
+  GError *error = NULL;
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  if (!write_state (data->filename, &data->header, data->data, &error)) {
+    g_task_return_error (task, error);
+
+    return;
+  }
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static RetroSavedMemory *
+get_saved_memory (RetroCore       *self,
+                  RetroMemoryType  memory_type)
+{
+  /* Core specific memory types aren't tracked. */
+  if (memory_type >= RETRO_MEMORY_TYPE_COUNT)
+    return NULL;
+
+  return &self->saved_memory[memory_type];
+}
+
+static gboolean
+saved_memory_matches (RetroSavedMemory *saved,
+                      const gchar      *filename,
+                      const guint8     *data,
+                      gsize             size)
+{
+  return saved != NULL &&
+         saved->shadow != NULL &&
+         saved->size == size &&
+         g_strcmp0 (saved->filename, filename) == 0 &&
+         memcmp (saved->shadow, data, size) == 0;
+}
+
+static void
+saved_memory_update (RetroSavedMemory *saved,
+                     const gchar      *filename,
+                     const guint8     *data,
+                     gsize             size)
+{
+  if (saved == NULL)
+    return;
+
+  g_clear_pointer (&saved->filename, g_free);
+
+  if (data == NULL || size == 0) {
+    g_clear_pointer (&saved->shadow, g_free);
+    saved->size = 0;
+
+    return;
+  }
+
+  if (saved->size != size) {
+    g_free (saved->shadow);
+    saved->shadow = g_malloc (size);
+    saved->size = size;
+  }
+
+  memcpy (saved->shadow, data, size);
+  saved->filename = g_strdup (filename);
+}
+
+static void
+close_memory_mirror (RetroSavedMemory *saved)
+{
+  if (saved->mirror == NULL)
+    return;
+
+  if (msync (saved->mirror, saved->mirror_size, MS_SYNC) != 0)
+    g_warning ("Couldn't sync memory region %d to %s: %s",
+               saved->memory_type, saved->mirror_filename, g_strerror (errno));
+
+  munmap (saved->mirror, saved->mirror_size);
+  saved->mirror = NULL;
+  saved->mirror_size = 0;
+  saved->mirror_dirty = FALSE;
+  g_clear_pointer (&saved->mirror_filename, g_free);
+}
+
+static void
+update_memory_mirror (RetroCore        *self,
+                      RetroSavedMemory *saved)
+{
+  RetroGetMemoryData get_mem_data;
+  RetroGetMemorySize get_mem_size;
+  guint8 *data;
+  gsize size;
+
+  get_mem_data = retro_module_get_get_memory_data (self->module);
+  get_mem_size = retro_module_get_get_memory_size (self->module);
+  data = get_mem_data (saved->memory_type);
+  size = MIN (get_mem_size (saved->memory_type), saved->mirror_size);
+
+  if (G_UNLIKELY (data == NULL))
+    return;
+
+  for (gsize offset = 0; offset < size; offset += MEMORY_MIRROR_CHUNK_SIZE) {
+    gsize length = MIN (MEMORY_MIRROR_CHUNK_SIZE, size - offset);
+
+    if (memcmp (saved->mirror + offset, data + offset, length) == 0)
+      continue;
+
+    memcpy (saved->mirror + offset, data + offset, length);
+    saved->mirror_dirty = TRUE;
+  }
+}
+
+static void
+update_memory_mirrors (RetroCore *self)
+{
+  for (RetroMemoryType type = 0; type < RETRO_MEMORY_TYPE_COUNT; type++)
+    if (self->saved_memory[type].mirror != NULL)
+      update_memory_mirror (self, &self->saved_memory[type]);
+}
+
+static gboolean
+sync_memory_mirrors_cb (RetroCore *self)
+{
+  gboolean has_mirror = FALSE;
+
+  for (RetroMemoryType type = 0; type < RETRO_MEMORY_TYPE_COUNT; type++) {
+    RetroSavedMemory *saved = &self->saved_memory[type];
+
+    if (saved->mirror == NULL)
+      continue;
+
+    has_mirror = TRUE;
+
+    if (!saved->mirror_dirty)
+      continue;
+
+    /* Schedule the write back without blocking the emulation, the mapped
+     * pages survive the runner crashing anyway. */
+    if (msync (saved->mirror, saved->mirror_size, MS_ASYNC) != 0)
+      g_warning ("Couldn't sync memory region %d to %s: %s",
+                 type, saved->mirror_filename, g_strerror (errno));
+
+    saved->mirror_dirty = FALSE;
+  }
+
+  if (has_mirror)
+    return G_SOURCE_CONTINUE;
+
+  self->memory_mirror_sync_id = 0;
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+saved_memory_clear (RetroSavedMemory *saved)
+{
+  close_memory_mirror (saved);
+  remove_source (saved->core, &saved->autosave_id);
+  g_clear_pointer (&saved->filename, g_free);
+  g_clear_pointer (&saved->shadow, g_free);
+  g_clear_pointer (&saved->autosave_filename, g_free);
+  saved->size = 0;
+}
+
+static gboolean
+autosave_memory_cb (RetroSavedMemory *saved)
+{
+  g_autoptr (GError) error = NULL;
+
+  /* Never overwrite a save with an empty region. */
+  if (!retro_core_get_game_loaded (saved->core) ||
+      retro_core_get_memory_size (saved->core, saved->memory_type) == 0)
+    return G_SOURCE_CONTINUE;
+
+  retro_core_save_memory (saved->core, saved->memory_type,
+                          saved->autosave_filename, &error);
+
+  if (error)
+    g_warning ("Couldn't autosave memory region %d: %s",
+               saved->memory_type, error->message);
+
+  return G_SOURCE_CONTINUE;
+}
+
 /* FIXME: this is partially copied from retro_option_new() */
 static gchar *
 get_default_value (const gchar *description)
@@ -998,6 +1481,74 @@ retro_core_get_framebuffer_fd (RetroCore *self)
   return retro_framebuffer_get_fd (self->framebuffer);
 }
 
+gint
+retro_core_get_pipeline_stats_fd (RetroCore *self)
+{
+  g_return_val_if_fail (RETRO_IS_CORE (self), 0);
+
+  return retro_pipeline_stats_get_fd (self->pipeline_stats);
+}
+
+/**
+ * retro_core_benchmark:
+ * @self: a #RetroCore
+ * @n_frames: the number of frames to run
+ * @flags: the outputs to consume
+ * @benchmark: (out caller-allocates): return location for the results
+ *
+ * Runs @n_frames frames back to back, as fast as possible, and measures how
+ * long they take. The video output isn't sent while benchmarking, and the audio
+ * isn't played.
+ */
+void
+retro_core_benchmark (RetroCore           *self,
+                      guint64              n_frames,
+                      RetroBenchmarkFlags  flags,
+                      RetroBenchmark      *benchmark)
+{
+  gboolean was_running, block_video_signal;
+  gint64 start_time, frame_start_time, time;
+
+  g_return_if_fail (RETRO_IS_CORE (self));
+  g_return_if_fail (benchmark != NULL);
+
+  retro_core_assert_thread (self);
+
+  memset (benchmark, 0, sizeof (RetroBenchmark));
+  benchmark->flags = flags;
+
+  was_running = self->main_loop >= 0;
+  retro_core_stop (self);
+
+  block_video_signal = self->block_video_signal;
+  self->block_video_signal = TRUE;
+  self->benchmark = benchmark;
+
+  start_time = retro_frame_times_get_monotonic_time ();
+  time = start_time;
+
+  for (guint64 i = 0; i < n_frames; i++) {
+    frame_start_time = time;
+
+    retro_core_iteration (self);
+
+    time = retro_frame_times_get_monotonic_time ();
+    retro_frame_times_add (&benchmark->frame_times,
+                           (time - frame_start_time) / 1000);
+  }
+
+  benchmark->total_time = time - start_time;
+  benchmark->core_time = benchmark->total_time -
+                         benchmark->video_time -
+                         benchmark->audio_time;
+
+  self->benchmark = NULL;
+  self->block_video_signal = block_video_signal;
+
+  if (was_running)
+    retro_core_run (self);
+}
+
 /* Public */
 
 /**
@@ -1289,6 +1840,8 @@ retro_core_boot (RetroCore  *self,
 
   g_return_if_fail (RETRO_IS_CORE (self));
 
+  retro_core_assert_thread (self);
+
   retro_core_set_environment_interface (self);
 
   init = retro_module_get_init (self->module);
@@ -1319,11 +1872,58 @@ retro_core_set_medias (RetroCore           *self,
   g_return_if_fail (!retro_core_get_is_initiated (self));
 
   g_clear_pointer (&self->media_uris, g_strfreev);
+  g_clear_pointer (&self->media_fds, g_array_unref);
   self->media_uris = g_strdupv ((gchar **) uris);
 }
 
+static void
+close_media_fd (gint *fd)
+{
+  if (*fd >= 0)
+    close (*fd);
+}
+
 /**
- * retro_core_set_current_media:
+ * retro_core_set_media_fd:
+ * @self: a #RetroCore
+ * @media_index: the media index
+ * @fd: a file descriptor holding the media, or -1
+ *
+ * Sets the file descriptor to read the media at @media_index from instead of
+ * opening its URI, the URI then only names the media. @self takes ownership of
+ * @fd.
+ *
+ * You can use this before booting the core, after setting the medias.
+ */
+void
+retro_core_set_media_fd (RetroCore *self,
+                         guint      media_index,
+                         gint       fd)
+{
+  gint *media_fd;
+
+  g_return_if_fail (RETRO_IS_CORE (self));
+  g_return_if_fail (!retro_core_get_is_initiated (self));
+  g_return_if_fail (self->media_uris != NULL);
+  g_return_if_fail (media_index < g_strv_length (self->media_uris));
+
+  if (self->media_fds == NULL) {
+    gint no_fd = -1;
+
+    self->media_fds = g_array_new (FALSE, FALSE, sizeof (gint));
+    g_array_set_clear_func (self->media_fds, (GDestroyNotify) close_media_fd);
+
+    for (gsize i = g_strv_length (self->media_uris); i > 0; i--)
+      g_array_append_val (self->media_fds, no_fd);
+  }
+
+  media_fd = &g_array_index (self->media_fds, gint, media_index);
+  close_media_fd (media_fd);
+  *media_fd = fd;
+}
+
+/**
+ * retro_core_set_current_media:
  * @self: a #RetroCore
  * @media_index: the media index
  * @error: return location for a #GError, or %NULL
@@ -1362,34 +1962,27 @@ retro_core_set_current_media (RetroCore  *self,
 }
 
 void
-retro_core_set_default_controller (RetroCore *self,
-                                   gint       fd)
+retro_core_set_controller_state (RetroCore *self,
+                                 gint       fd)
 {
   g_return_if_fail (RETRO_IS_CORE (self));
 
   /* We cannot use g_set_object() because it would reference the new object,
    * leaking its initial reference.
    */
-  g_clear_object (&self->default_controller);
-  self->default_controller = retro_controller_state_new (fd);
+  g_clear_object (&self->controller_state);
+  self->controller_state = retro_controller_state_new (fd);
 }
 
 void
 retro_core_set_controller (RetroCore           *self,
                            guint                port,
-                           RetroControllerType  controller_type,
-                           gint                 fd)
+                           RetroControllerType  controller_type)
 {
   RetroSetControllerPortDevice set_controller_port_device;
 
   g_return_if_fail (RETRO_IS_CORE (self));
 
-  if (controller_type == RETRO_CONTROLLER_TYPE_NONE)
-    g_hash_table_remove (self->controllers, GUINT_TO_POINTER (port));
-  else
-    g_hash_table_insert (self->controllers, GUINT_TO_POINTER (port),
-                         retro_controller_state_new (fd));
-
   set_controller_port_device = retro_module_get_set_controller_port_device (self->module);
   set_controller_port_device (port, controller_type);
 }
@@ -1398,17 +1991,13 @@ gboolean
 retro_core_get_controller_supports_rumble (RetroCore *self,
                                            guint      port)
 {
-  RetroControllerState *controller;
-
   g_return_val_if_fail (RETRO_IS_CORE (self), FALSE);
 
-  if (!g_hash_table_contains (self->controllers, GUINT_TO_POINTER (port)))
+  if (self->controller_state == NULL ||
+      port >= RETRO_CONTROLLER_STATE_N_PORTS)
     return FALSE;
 
-  controller = g_hash_table_lookup (self->controllers, GUINT_TO_POINTER (port));
-  g_return_val_if_fail (controller != NULL, FALSE);
-
-  return retro_controller_state_get_supports_rumble (controller);
+  return retro_controller_state_get_supports_rumble (self->controller_state, port);
 }
 
 void
@@ -1426,6 +2015,20 @@ retro_core_send_input_key_event (RetroCore                *self,
   self->keyboard_callback.callback (down, keycode, character, key_modifiers);
 }
 
+static gdouble
+get_pacing_rate (RetroCore *self)
+{
+  gdouble rate;
+
+  rate = retro_core_get_frames_per_second (self) * self->speed_rate;
+
+  if (self->display_refresh_rate > 0 &&
+      fabs (rate / self->display_refresh_rate - 1.0) < MAX_DISPLAY_REFRESH_RATE_DEVIATION)
+    return self->display_refresh_rate;
+
+  return rate;
+}
+
 static gboolean
 run_main_loop (RetroCore *self)
 {
@@ -1437,6 +2040,16 @@ run_main_loop (RetroCore *self)
   return TRUE;
 }
 
+/* Keyboard events are only drained when the core polls its input, drop the
+ * ones queued while it wasn't running so they don't replay all at once, and
+ * so the queue has room for new ones. */
+static void
+flush_keyboard_events (RetroCore *self)
+{
+  if (self->controller_state != NULL)
+    retro_controller_state_flush_keyboard_events (self->controller_state);
+}
+
 /**
  * retro_core_run:
  * @self: a #RetroCore
@@ -1447,7 +2060,7 @@ run_main_loop (RetroCore *self)
 void
 retro_core_run (RetroCore *self)
 {
-  gdouble fps;
+  gdouble rate;
   g_autoptr (GSource) source = NULL;
 
   g_return_if_fail (RETRO_IS_CORE (self));
@@ -1455,15 +2068,17 @@ retro_core_run (RetroCore *self)
   if (self->main_loop >= 0 || self->speed_rate <= 0)
     return;
 
+  flush_keyboard_events (self);
+
   // TODO What if fps <= 0?
-  fps = retro_core_get_frames_per_second (self);
+  rate = get_pacing_rate (self);
   /* Do not make the timeout source hold a reference on the RetroCore, so
    * destroying the RetroCore while it is still running will stop it instead
    * of leaking a reference.
    */
-  source = retro_main_loop_source_new (fps * self->speed_rate);
+  source = retro_main_loop_source_new (rate, &self->frame_times);
   g_source_set_callback (source, (GSourceFunc) run_main_loop, self, NULL);
-  self->main_loop = g_source_attach (source, g_main_context_default ());
+  self->main_loop = g_source_attach (source, self->context);
 }
 
 /**
@@ -1475,12 +2090,16 @@ retro_core_run (RetroCore *self)
 void
 retro_core_stop (RetroCore *self)
 {
+  GSource *source;
+
   g_return_if_fail (RETRO_IS_CORE (self));
 
   if (self->main_loop < 0)
     return;
 
-  g_source_remove (self->main_loop);
+  source = g_main_context_find_source_by_id (self->context, self->main_loop);
+  if (source != NULL)
+    g_source_destroy (source);
   self->main_loop = -1;
 }
 
@@ -1497,6 +2116,8 @@ retro_core_reset (RetroCore *self)
 
   g_return_if_fail (RETRO_IS_CORE (self));
 
+  flush_keyboard_events (self);
+
   reset = retro_module_get_reset (self->module);
   reset ();
 }
@@ -1504,18 +2125,29 @@ retro_core_reset (RetroCore *self)
 static inline void
 emit_iterated (RetroCore **self)
 {
-  if (*self)
-    g_signal_emit (*self, signals[SIGNAL_ITERATED], 0);
+  if (!*self)
+    return;
+
+  /* Mirror the memory regions at frame boundaries. */
+  update_memory_mirrors (*self);
+
+  g_signal_emit (*self, signals[SIGNAL_ITERATED], 0);
 }
 
-/**
- * retro_core_iteration:
- * @self: a #RetroCore
- *
- * Iterate @self for a frame.
- */
-void
-retro_core_iteration (RetroCore *self)
+static inline void
+timed_run (RetroCore *self,
+           RetroRun   run)
+{
+  gint64 start_time = retro_frame_times_get_monotonic_time ();
+
+  run ();
+
+  retro_pipeline_stats_add (self->pipeline_stats, RETRO_PIPELINE_STAGE_RUN,
+                            retro_frame_times_get_monotonic_time () - start_time);
+}
+
+static void
+run_iteration (RetroCore *self)
 {
   RetroRun run;
   RetroSerializeSize serialize_size = NULL;
@@ -1527,16 +2159,15 @@ retro_core_iteration (RetroCore *self)
   gboolean success;
   RetroCore *iterated __attribute__((cleanup(emit_iterated))) = NULL;
 
-  g_return_if_fail (RETRO_IS_CORE (self));
-
   self->has_run = TRUE;
+  self->frame_count++;
 
   iterated = self;
   run = retro_module_get_run (self->module);
 
   if (self->runahead == 0) {
     self->run_remaining = 0;
-    run ();
+    timed_run (self, run);
 
     return;
   }
@@ -1546,7 +2177,7 @@ retro_core_iteration (RetroCore *self)
 
   if (size == 0) {
     self->run_remaining = 0;
-    run ();
+    timed_run (self, run);
 
     g_critical ("Couldn't run ahead: serialization not supported.");
 
@@ -1554,7 +2185,7 @@ retro_core_iteration (RetroCore *self)
   }
 
   self->run_remaining = self->runahead;
-  run ();
+  timed_run (self, run);
 
   self->run_remaining--;
 
@@ -1581,7 +2212,7 @@ retro_core_iteration (RetroCore *self)
   }
 
   for (; self->run_remaining >= 0; self->run_remaining--)
-    run ();
+    timed_run (self, run);
 
   new_size = serialize_size ();
 
@@ -1603,6 +2234,26 @@ retro_core_iteration (RetroCore *self)
   }
 }
 
+/**
+ * retro_core_iteration:
+ * @self: a #RetroCore
+ *
+ * Iterate @self for a frame.
+ */
+void
+retro_core_iteration (RetroCore *self)
+{
+  gint64 begin_time;
+
+  g_return_if_fail (RETRO_IS_CORE (self));
+
+  retro_core_assert_thread (self);
+
+  begin_time = retro_profiler_get_time ();
+  run_iteration (self);
+  retro_profiler_add_mark (begin_time, "Iteration", NULL);
+}
+
 /**
  * retro_core_get_can_access_state:
  * @self: a #RetroCore
@@ -1638,52 +2289,92 @@ retro_core_save_state (RetroCore    *self,
                        const gchar  *filename,
                        GError      **error)
 {
-  RetroSerializeSize serialize_size = NULL;
-  RetroSerialize serialize = NULL;
-  g_autofree guint8 *data = NULL;
-  gsize size;
-  gboolean success;
+  g_auto (RetroStateHeader) header = { NULL };
+  g_autoptr (GByteArray) data = NULL;
 
   g_return_if_fail (RETRO_IS_CORE (self));
   g_return_if_fail (filename != NULL);
 
-  serialize_size = retro_module_get_serialize_size (self->module);
-  size = serialize_size ();
+  retro_try_propagate ({
+    data = serialize_state (self, &catch);
+  }, catch, error);
 
-  if (size <= 0) {
-    g_set_error_literal (error,
-                         RETRO_CORE_ERROR,
-                         RETRO_CORE_ERROR_SERIALIZATION_NOT_SUPPORTED,
-                         "Couldn't serialize the internal state: serialization not supported.");
+  get_state_header (self, &header);
+  write_state (filename, &header, data, error);
 
-    return;
-  }
+  release_state_buffer (self, g_steal_pointer (&data));
+}
 
-  serialize = retro_module_get_serialize (self->module);
-  data = g_new0 (guint8, size);
+/**
+ * retro_core_save_state_async:
+ * @self: a #RetroCore
+ * @filename: the file to save the state to
+ * @cancellable: (nullable): a #GCancellable
+ * @callback: a #GAsyncReadyCallback to call when the state is saved
+ * @user_data: the data to pass to @callback
+ *
+ * Serializes the state of @self immediately, then compresses and writes it to
+ * @filename in a worker thread so the emulation isn't blocked by the file I/O.
+ */
+void
+retro_core_save_state_async (RetroCore           *self,
+                             const gchar         *filename,
+                             GCancellable        *cancellable,
+                             GAsyncReadyCallback  callback,
+                             gpointer             user_data)
+{
+  g_autoptr (GTask) task = NULL;
+  SaveStateData *data;
+  GError *error = NULL;
 
-  success = serialize (data, size);
+  g_return_if_fail (RETRO_IS_CORE (self));
+  g_return_if_fail (filename != NULL);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
 
-  if (!success) {
-    g_set_error_literal (error,
-                         RETRO_CORE_ERROR,
-                         RETRO_CORE_ERROR_COULDNT_SERIALIZE,
-                         "Couldn't serialize the internal state: serialization failed.");
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, retro_core_save_state_async);
+
+  data = g_new0 (SaveStateData, 1);
+  data->filename = g_strdup (filename);
+  g_task_set_task_data (task, data, (GDestroyNotify) save_state_data_free);
+
+  data->data = serialize_state (self, &error);
+  if (data->data == NULL) {
+    g_task_return_error (task, error);
 
     return;
   }
 
-  retro_try ({
-    g_file_set_contents (filename, (gchar *) data, size, &catch);
-  }, catch, {
-    g_set_error (error,
-                 RETRO_CORE_ERROR,
-                 RETRO_CORE_ERROR_COULDNT_ACCESS_FILE,
-                 "Couldn't serialize the internal state: %s",
-                 catch->message);
+  get_state_header (self, &data->header);
 
-    return;
-  });
+  g_task_run_in_thread (task, (GTaskThreadFunc) save_state_thread);
+}
+
+/**
+ * retro_core_save_state_finish:
+ * @self: a #RetroCore
+ * @result: a #GAsyncResult
+ * @error: return location for a #GError, or %NULL
+ *
+ * Finishes an operation started with retro_core_save_state_async().
+ *
+ * Returns: whether the state was saved
+ */
+gboolean
+retro_core_save_state_finish (RetroCore     *self,
+                              GAsyncResult  *result,
+                              GError       **error)
+{
+  SaveStateData *data;
+
+  g_return_val_if_fail (RETRO_IS_CORE (self), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+
+  data = g_task_get_task_data (G_TASK (result));
+  if (data->data != NULL)
+    release_state_buffer (self, g_steal_pointer (&data->data));
+
+  return g_task_propagate_boolean (G_TASK (result), error);
 }
 
 /**
@@ -1701,25 +2392,14 @@ retro_core_load_state (RetroCore    *self,
 {
   RetroSerializeSize serialize_size = NULL;
   RetroUnserialize unserialize = NULL;
+  g_auto (RetroStateHeader) header = { NULL };
   gsize expected_size, data_size;
-  g_autofree gchar *data = NULL;
+  g_autofree guint8 *data = NULL;
   gboolean success;
 
   g_return_if_fail (RETRO_IS_CORE (self));
   g_return_if_fail (filename != NULL);
 
-  retro_try ({
-    g_file_get_contents (filename, &data, &data_size, &catch);
-  }, catch, {
-    g_set_error (error,
-                 RETRO_CORE_ERROR,
-                 RETRO_CORE_ERROR_COULDNT_ACCESS_FILE,
-                 "Couldn't deserialize the internal state: %s",
-                 catch->message);
-
-    return;
-  });
-
   /* Some cores, such as MAME and ParaLLEl N64, can only properly restore the
    * state after at least one frame has been run. */
   if (!self->has_run) {
@@ -1746,15 +2426,53 @@ retro_core_load_state (RetroCore    *self,
     return;
   }
 
-  if (data_size != expected_size)
-    g_critical ("%s expects %"G_GSIZE_FORMAT" bytes for its internal state, but %"
-                G_GSIZE_FORMAT" bytes were passed.",
-                retro_core_get_name (self),
-                expected_size,
-                data_size);
+  retro_try ({
+    data = retro_state_load (filename, expected_size, &header, &data_size, &catch);
+  }, catch, {
+    if (catch->domain == RETRO_CORE_ERROR) {
+      g_propagate_error (error, g_steal_pointer (&catch));
+
+      return;
+    }
+
+    g_set_error (error,
+                 RETRO_CORE_ERROR,
+                 RETRO_CORE_ERROR_COULDNT_ACCESS_FILE,
+                 "Couldn't deserialize the internal state: %s",
+                 catch->message);
+
+    return;
+  });
+
+  /* Raw states saved by older versions have no header. */
+  if (header.core_name == NULL) {
+    if (data_size != expected_size)
+      g_critical ("%s expects %"G_GSIZE_FORMAT" bytes for its internal state, but %"
+                  G_GSIZE_FORMAT" bytes were passed.",
+                  retro_core_get_name (self),
+                  expected_size,
+                  data_size);
+  } else {
+    if (g_strcmp0 (header.core_name, retro_core_get_name (self)) != 0) {
+      g_set_error (error,
+                   RETRO_CORE_ERROR,
+                   RETRO_CORE_ERROR_COULDNT_DESERIALIZE,
+                   "Couldn't deserialize the internal state: the state was saved by %s, not %s.",
+                   header.core_name,
+                   retro_core_get_name (self));
+
+      return;
+    }
+
+    if (get_content_hash (self) != NULL && *header.content_hash != '\0' &&
+        g_strcmp0 (header.content_hash, get_content_hash (self)) != 0)
+      g_warning ("The state was saved for a different content than the one loaded.");
+
+    self->frame_count = header.frame_count;
+  }
 
   unserialize = retro_module_get_unserialize (self->module);
-  success = unserialize ((guint8 *) data, data_size);
+  success = unserialize (data, data_size);
 
   if (!success) {
     g_set_error_literal (error,
@@ -1803,6 +2521,7 @@ retro_core_save_memory (RetroCore        *self,
 {
   RetroGetMemoryData get_mem_data;
   RetroGetMemorySize get_mem_size;
+  RetroSavedMemory *saved;
   gchar *data;
   gsize size;
 
@@ -1814,6 +2533,33 @@ retro_core_save_memory (RetroCore        *self,
   data = get_mem_data (memory_type);
   size = get_mem_size (memory_type);
 
+  saved = get_saved_memory (self, memory_type);
+
+  /* Replacing the file would detach it from its mapping, sync it instead. */
+  if (saved != NULL && saved->mirror != NULL &&
+      g_strcmp0 (saved->mirror_filename, filename) == 0) {
+    update_memory_mirror (self, saved);
+
+    if (msync (saved->mirror, saved->mirror_size, MS_SYNC) != 0)
+      g_set_error (error,
+                   RETRO_CORE_ERROR,
+                   RETRO_CORE_ERROR_COULDNT_ACCESS_FILE,
+                   "Couldn't save the memory state: %s",
+                   g_strerror (errno));
+
+    saved->mirror_dirty = FALSE;
+
+    return;
+  }
+
+  /* Frontends flush often, skip the write if the region didn't change since
+   * it was last written to or read from this file. */
+  if (saved_memory_matches (saved, filename, (guint8 *) data, size)) {
+    retro_debug ("Memory region %d didn't change, skipping the save", memory_type);
+
+    return;
+  }
+
   retro_try ({
     g_file_set_contents (filename, data, size, &catch);
   }, catch, {
@@ -1825,6 +2571,8 @@ retro_core_save_memory (RetroCore        *self,
 
     return;
   });
+
+  saved_memory_update (saved, filename, (guint8 *) data, size);
 }
 
 /**
@@ -1917,6 +2665,179 @@ retro_core_load_memory (RetroCore        *self,
 
   memcpy (memory_region, data, data_size);
   memset (memory_region + data_size, 0, memory_region_size - data_size);
+
+  /* The file only matches the region if it wasn't padded. */
+  if (memory_region_size == data_size)
+    saved_memory_update (get_saved_memory (self, memory_type), filename,
+                         memory_region, memory_region_size);
+  else
+    saved_memory_update (get_saved_memory (self, memory_type), NULL, NULL, 0);
+}
+
+/**
+ * retro_core_set_memory_mirror:
+ * @self: a #RetroCore
+ * @memory_type: the type of memory
+ * @filename: (nullable): a file to mirror the data to, or %NULL to disable
+ * @error: return location for a #GError, or %NULL
+ *
+ * Continuously mirrors a memory region of @self to @filename, which is mapped
+ * in memory. The region is loaded from @filename if it exists, then the
+ * changes are copied to the mapping at each frame and periodically synced to
+ * the disk, so they persist even if the runner crashes.
+ */
+void
+retro_core_set_memory_mirror (RetroCore        *self,
+                              RetroMemoryType   memory_type,
+                              const gchar      *filename,
+                              GError          **error)
+{
+  RetroGetMemoryData get_mem_data;
+  RetroGetMemorySize get_mem_size;
+  RetroSavedMemory *saved;
+  guint8 *data;
+  gsize size;
+  gpointer mirror;
+  struct stat st;
+  gint fd;
+
+  g_return_if_fail (RETRO_IS_CORE (self));
+
+  saved = get_saved_memory (self, memory_type);
+  if (saved == NULL) {
+    g_set_error (error,
+                 RETRO_CORE_ERROR,
+                 RETRO_CORE_ERROR_NO_MEMORY_REGION,
+                 "Couldn't mirror memory region %d: unknown memory region",
+                 memory_type);
+
+    return;
+  }
+
+  close_memory_mirror (saved);
+
+  if (filename == NULL)
+    return;
+
+  get_mem_data = retro_module_get_get_memory_data (self->module);
+  get_mem_size = retro_module_get_get_memory_size (self->module);
+  data = get_mem_data (memory_type);
+  size = get_mem_size (memory_type);
+
+  if (data == NULL || size == 0) {
+    g_set_error (error,
+                 RETRO_CORE_ERROR,
+                 RETRO_CORE_ERROR_NO_MEMORY_REGION,
+                 "Couldn't mirror memory region %d: %s doesn't have it",
+                 memory_type,
+                 retro_core_get_name (self));
+
+    return;
+  }
+
+  if (g_file_test (filename, G_FILE_TEST_EXISTS))
+    retro_try_propagate ({
+      retro_core_load_memory (self, memory_type, filename, &catch);
+    }, catch, error);
+
+  fd = g_open (filename, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    g_set_error (error,
+                 RETRO_CORE_ERROR,
+                 RETRO_CORE_ERROR_COULDNT_ACCESS_FILE,
+                 "Couldn't mirror memory region %d: %s",
+                 memory_type,
+                 g_strerror (errno));
+
+    return;
+  }
+
+  /* Only ever extend the file: a larger existing save keeps its tail, and
+   * only the first size bytes get mapped. */
+  if (fstat (fd, &st) != 0 ||
+      (st.st_size < (goffset) size && ftruncate (fd, size) != 0)) {
+    g_set_error (error,
+                 RETRO_CORE_ERROR,
+                 RETRO_CORE_ERROR_COULDNT_ACCESS_FILE,
+                 "Couldn't mirror memory region %d: %s",
+                 memory_type,
+                 g_strerror (errno));
+    close (fd);
+
+    return;
+  }
+
+  mirror = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);
+
+  if (mirror == MAP_FAILED) {
+    g_set_error (error,
+                 RETRO_CORE_ERROR,
+                 RETRO_CORE_ERROR_COULDNT_ACCESS_FILE,
+                 "Couldn't mirror memory region %d: %s",
+                 memory_type,
+                 g_strerror (errno));
+
+    return;
+  }
+
+  saved->mirror_filename = g_strdup (filename);
+  saved->mirror = mirror;
+  saved->mirror_size = size;
+
+  memcpy (saved->mirror, data, size);
+  saved->mirror_dirty = TRUE;
+
+  if (self->memory_mirror_sync_id == 0)
+    self->memory_mirror_sync_id =
+      add_timeout_seconds (self, MEMORY_MIRROR_SYNC_INTERVAL,
+                           (GSourceFunc) sync_memory_mirrors_cb,
+                           self);
+}
+
+/**
+ * retro_core_set_memory_autosave:
+ * @self: a #RetroCore
+ * @memory_type: the type of memory
+ * @filename: (nullable): a file to save the data to, or %NULL to disable
+ * @interval: the interval between saves in seconds, or 0 to disable
+ * @error: return location for a #GError, or %NULL
+ *
+ * Periodically saves a memory region of @self to @filename. The file is only
+ * written if the region changed since it was last saved.
+ */
+void
+retro_core_set_memory_autosave (RetroCore        *self,
+                                RetroMemoryType   memory_type,
+                                const gchar      *filename,
+                                guint             interval,
+                                GError          **error)
+{
+  RetroSavedMemory *saved;
+
+  g_return_if_fail (RETRO_IS_CORE (self));
+
+  saved = get_saved_memory (self, memory_type);
+  if (saved == NULL) {
+    g_set_error (error,
+                 RETRO_CORE_ERROR,
+                 RETRO_CORE_ERROR_NO_MEMORY_REGION,
+                 "Couldn't autosave memory region %d: unknown memory region",
+                 memory_type);
+
+    return;
+  }
+
+  remove_source (self, &saved->autosave_id);
+  g_clear_pointer (&saved->autosave_filename, g_free);
+
+  if (filename == NULL || interval == 0)
+    return;
+
+  saved->autosave_filename = g_strdup (filename);
+  saved->autosave_id = add_timeout_seconds (self, interval,
+                                            (GSourceFunc) autosave_memory_cb,
+                                            saved);
 }
 
 /**
@@ -1928,23 +2849,56 @@ retro_core_load_memory (RetroCore        *self,
 void
 retro_core_poll_controllers (RetroCore *self)
 {
-  GHashTableIter iter;
-  gpointer port;
-  RetroControllerState *controller;
+  RetroKeyboardEvent event;
+  gint64 time;
 
   g_return_if_fail (RETRO_IS_CORE (self));
 
-  retro_controller_state_lock (self->default_controller);
-  retro_controller_state_snapshot (self->default_controller);
-  retro_controller_state_unlock (self->default_controller);
+  if (self->controller_state == NULL)
+    return;
 
-  g_hash_table_iter_init (&iter, self->controllers);
+  retro_controller_state_snapshot (self->controller_state);
 
-  while (g_hash_table_iter_next (&iter, &port, (gpointer *) &controller)) {
-    retro_controller_state_lock (controller);
-    retro_controller_state_snapshot (controller);
-    retro_controller_state_unlock (controller);
-  }
+  /* Only deliver the keyboard events which happened before this frame's poll,
+   * in the order they happened. */
+  time = g_get_monotonic_time ();
+  while (retro_controller_state_pop_keyboard_event (self->controller_state,
+                                                    time, &event))
+    retro_core_send_input_key_event (self, event.down, event.keycode,
+                                     event.character, event.modifiers);
+}
+
+/**
+ * retro_core_get_controller_joypad_mask:
+ * @self: a #RetroCore
+ * @port: the port number
+ *
+ * Gets the pressed joypad buttons of the controller plugged into the given
+ * port of @self as a bitmask, falling back to the default joypad.
+ *
+ * Returns: the joypad bitmask
+ */
+guint16
+retro_core_get_controller_joypad_mask (RetroCore *self,
+                                       guint      port)
+{
+  g_return_val_if_fail (RETRO_IS_CORE (self), 0);
+
+  if (self->controller_state == NULL)
+    return 0;
+
+  if (port < RETRO_CONTROLLER_STATE_N_PORTS &&
+      retro_controller_state_has_type (self->controller_state, port,
+                                       RETRO_CONTROLLER_TYPE_JOYPAD))
+    return retro_controller_state_get_joypad_mask (self->controller_state, port);
+
+  if (retro_controller_state_has_type (self->controller_state,
+                                       RETRO_CONTROLLER_STATE_DEFAULT_PORT,
+                                       RETRO_CONTROLLER_TYPE_JOYPAD))
+    return retro_controller_state_get_joypad_mask (self->controller_state,
+                                                   RETRO_CONTROLLER_STATE_DEFAULT_PORT);
+
+  return 0;
 }
 
 /**
@@ -1964,18 +2918,23 @@ retro_core_get_controller_input_state (RetroCore  *self,
                                        RetroInput *input)
 {
   RetroControllerType type;
-  RetroControllerState *controller;
 
   g_return_val_if_fail (RETRO_IS_CORE (self), 0);
 
+  if (self->controller_state == NULL)
+    return 0;
+
   type = retro_input_get_controller_type (input) & RETRO_CONTROLLER_TYPE_TYPE_MASK;
 
-  controller = g_hash_table_lookup (self->controllers, GUINT_TO_POINTER (port));
-  if (controller && retro_controller_state_has_type (controller, type))
-    return retro_controller_state_get_input (controller, input);
+  if (port < RETRO_CONTROLLER_STATE_N_PORTS &&
+      retro_controller_state_has_type (self->controller_state, port, type))
+    return retro_controller_state_get_input (self->controller_state, port, input);
 
-  if (self->default_controller && retro_controller_state_has_type (self->default_controller, type))
-    return retro_controller_state_get_input (self->default_controller, input);
+  if (retro_controller_state_has_type (self->controller_state,
+                                       RETRO_CONTROLLER_STATE_DEFAULT_PORT, type))
+    return retro_controller_state_get_input (self->controller_state,
+                                             RETRO_CONTROLLER_STATE_DEFAULT_PORT,
+                                             input);
 
   return 0;
 }
@@ -2063,6 +3022,79 @@ retro_core_set_speed_rate (RetroCore *self,
   restart (self);
 }
 
+/**
+ * retro_core_get_display_refresh_rate:
+ * @self: a #RetroCore
+ *
+ * Gets the refresh rate of the display, or 0 if unknown.
+ *
+ * Returns: the display refresh rate
+ */
+gdouble
+retro_core_get_display_refresh_rate (RetroCore *self)
+{
+  g_return_val_if_fail (RETRO_IS_CORE (self), 0.0);
+
+  return self->display_refresh_rate;
+}
+
+/**
+ * retro_core_set_display_refresh_rate:
+ * @self: a #RetroCore
+ * @display_refresh_rate: a refresh rate, or 0 if unknown
+ *
+ * Sets the refresh rate of the display. If the core runs close enough to it,
+ * the frames will be paced at the display refresh rate.
+ */
+void
+retro_core_set_display_refresh_rate (RetroCore *self,
+                                     gdouble    display_refresh_rate)
+{
+  g_return_if_fail (RETRO_IS_CORE (self));
+
+  if (self->display_refresh_rate == display_refresh_rate)
+    return;
+
+  self->display_refresh_rate = display_refresh_rate;
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_DISPLAY_REFRESH_RATE]);
+
+  restart (self);
+}
+
+/**
+ * retro_core_get_frame_statistics:
+ * @self: a #RetroCore
+ * @n_frames: (out) (optional): return location for the number of frames
+ * @mean: (out) (optional): return location for the mean frame time
+ * @p99: (out) (optional): return location for the 99th percentile frame time
+ * @missed_deadlines: (out) (optional): return location for the number of
+ *   missed deadlines
+ *
+ * Gets the statistics of the frames run by the main loop of @self, frame times
+ * are in milliseconds.
+ */
+void
+retro_core_get_frame_statistics (RetroCore *self,
+                                 guint64   *n_frames,
+                                 gdouble   *mean,
+                                 gdouble   *p99,
+                                 guint64   *missed_deadlines)
+{
+  g_return_if_fail (RETRO_IS_CORE (self));
+
+  if (n_frames)
+    *n_frames = self->frame_times.n_frames;
+
+  if (mean)
+    *mean = retro_frame_times_get_mean (&self->frame_times);
+
+  if (p99)
+    *p99 = retro_frame_times_get_percentile (&self->frame_times, 99.0);
+
+  if (missed_deadlines)
+    *missed_deadlines = self->frame_times.missed_deadlines;
+}
+
 /**
  * retro_core_override_variable_default:
  * @self: a #RetroCore
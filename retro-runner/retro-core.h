@@ -6,6 +6,7 @@
 # error "Only <retro-gtk.h> can be included directly."
 #endif
 
+#include <gio/gio.h>
 #include "retro-controller-type.h"
 #include "retro-keyboard-key-private.h"
 #include "retro-memory-type.h"
@@ -39,6 +40,9 @@ void retro_core_boot (RetroCore  *self,
                       GError    **error);
 void retro_core_set_medias (RetroCore           *self,
                             const gchar * const *uris);
+void retro_core_set_media_fd (RetroCore *self,
+                              guint      media_index,
+                              gint       fd);
 void retro_core_set_current_media (RetroCore  *self,
                                    guint       media_index,
                                    GError    **error);
@@ -50,6 +54,14 @@ gboolean retro_core_get_can_access_state (RetroCore *self);
 void retro_core_save_state (RetroCore    *self,
                             const gchar  *filename,
                             GError      **error);
+void retro_core_save_state_async (RetroCore           *self,
+                                  const gchar         *filename,
+                                  GCancellable        *cancellable,
+                                  GAsyncReadyCallback  callback,
+                                  gpointer             user_data);
+gboolean retro_core_save_state_finish (RetroCore     *self,
+                                       GAsyncResult  *result,
+                                       GError       **error);
 void retro_core_load_state (RetroCore    *self,
                             const gchar  *filename,
                             GError      **error);
@@ -63,12 +75,20 @@ void retro_core_load_memory (RetroCore        *self,
                              RetroMemoryType   memory_type,
                              const gchar      *filename,
                              GError          **error);
-void retro_core_set_default_controller (RetroCore *self,
-                                        gint       fd);
+void retro_core_set_memory_autosave (RetroCore        *self,
+                                     RetroMemoryType   memory_type,
+                                     const gchar      *filename,
+                                     guint             interval,
+                                     GError          **error);
+void retro_core_set_memory_mirror (RetroCore        *self,
+                                   RetroMemoryType   memory_type,
+                                   const gchar      *filename,
+                                   GError          **error);
+void retro_core_set_controller_state (RetroCore *self,
+                                      gint       fd);
 void retro_core_set_controller (RetroCore           *self,
                                 guint                port,
-                                RetroControllerType  controller_type,
-                                gint                 fd);
+                                RetroControllerType  controller_type);
 gboolean retro_core_get_controller_supports_rumble (RetroCore *self,
                                                     guint      port);
 void retro_core_send_input_key_event (RetroCore                *self,
@@ -82,6 +102,14 @@ void retro_core_set_runahead (RetroCore *self,
 gdouble retro_core_get_speed_rate (RetroCore *self);
 void retro_core_set_speed_rate (RetroCore *self,
                                 gdouble    speed_rate);
+gdouble retro_core_get_display_refresh_rate (RetroCore *self);
+void retro_core_set_display_refresh_rate (RetroCore *self,
+                                          gdouble    display_refresh_rate);
+void retro_core_get_frame_statistics (RetroCore *self,
+                                      guint64   *n_frames,
+                                      gdouble   *mean,
+                                      gdouble   *p99,
+                                      guint64   *missed_deadlines);
 void retro_core_override_variable_default (RetroCore   *self,
                                            const gchar *key,
                                            const gchar *value);
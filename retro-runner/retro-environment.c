@@ -3,9 +3,11 @@
 #include "retro-environment-private.h"
 
 #include <stdbool.h>
+#include "retro-controller-codes-private.h"
 #include "retro-core-private.h"
 #include "retro-debug-private.h"
 #include "retro-input-private.h"
+#include "retro-profiler-private.h"
 #include "retro-gl-renderer-private.h"
 #include "retro-hw-render-callback-private.h"
 #include "retro-rumble-effect.h"
@@ -280,6 +282,21 @@ get_input_device_capabilities (RetroCore *self,
   return TRUE;
 }
 
+static gboolean
+get_input_bitmasks (RetroCore *self,
+                    bool      *bitmasks)
+{
+  g_assert (self);
+
+  /* Some cores pass no data and only check the returned value. */
+  if (bitmasks)
+    *bitmasks = TRUE;
+
+  retro_debug ("Get input bitmasks: true");
+
+  return TRUE;
+}
+
 static gboolean
 get_language (RetroCore *self,
               unsigned  *language)
@@ -767,6 +784,9 @@ environment_core_command (RetroCore *self,
   case RETRO_ENVIRONMENT_GET_INPUT_DEVICE_CAPABILITIES:
     return get_input_device_capabilities (self, (guint64 *) data);
 
+  case RETRO_ENVIRONMENT_GET_INPUT_BITMASKS:
+    return get_input_bitmasks (self, (bool *) data);
+
   case RETRO_ENVIRONMENT_GET_LANGUAGE:
     return get_language (self, (unsigned *) data);
 
@@ -841,7 +861,6 @@ environment_core_command (RetroCore *self,
   RETRO_UNIMPLEMENTED_ENVIRONMENT (RETRO_ENVIRONMENT_GET_FASTFORWARDING);
   RETRO_UNIMPLEMENTED_ENVIRONMENT (RETRO_ENVIRONMENT_GET_GAME_INFO_EXT);
   RETRO_UNIMPLEMENTED_ENVIRONMENT (RETRO_ENVIRONMENT_GET_HW_RENDER_INTERFACE);
-  RETRO_UNIMPLEMENTED_ENVIRONMENT (RETRO_ENVIRONMENT_GET_INPUT_BITMASKS);
   RETRO_UNIMPLEMENTED_ENVIRONMENT (RETRO_ENVIRONMENT_GET_INPUT_MAX_USERS);
   RETRO_UNIMPLEMENTED_ENVIRONMENT (RETRO_ENVIRONMENT_GET_LED_INTERFACE);
   RETRO_UNIMPLEMENTED_ENVIRONMENT (RETRO_ENVIRONMENT_GET_LOCATION_INTERFACE);
@@ -895,21 +914,20 @@ environment_interface_cb (unsigned cmd,
 }
 
 static void
-video_refresh_cb (guint8 *data,
-                  guint   width,
-                  guint   height,
-                  gsize   pitch)
+set_video_data (RetroCore *self,
+                guint8    *data,
+                guint      width,
+                guint      height,
+                gsize      pitch)
 {
-  RetroCore *self = retro_core_get_instance ();
-
-  if (data == NULL)
-    return;
-
-  if (retro_core_is_running_ahead (self))
-    return;
+  gint64 start_time = retro_frame_times_get_monotonic_time ();
 
   retro_framebuffer_lock (self->framebuffer);
 
+  retro_pipeline_stats_add (self->pipeline_stats,
+                            RETRO_PIPELINE_STAGE_FRAMEBUFFER_LOCK,
+                            retro_frame_times_get_monotonic_time () - start_time);
+
   if (self->renderer) {
     gint pixel_size;
 
@@ -917,11 +935,16 @@ video_refresh_cb (guint8 *data,
       g_critical ("Video data must be NULL or RETRO_HW_FRAME_BUFFER_VALID if "
                   "rendering to hardware.");
 
+      retro_framebuffer_unlock (self->framebuffer);
+
       return;
     }
 
-    if (!retro_pixel_format_to_gl (self->pixel_format, NULL, NULL, &pixel_size))
+    if (!retro_pixel_format_to_gl (self->pixel_format, NULL, NULL, &pixel_size)) {
+      retro_framebuffer_unlock (self->framebuffer);
+
       return;
+    }
 
     pitch = width * pixel_size;
 
@@ -937,11 +960,67 @@ video_refresh_cb (guint8 *data,
                                 width, height, self->aspect_ratio, data);
 
   retro_framebuffer_unlock (self->framebuffer);
+}
+
+static void
+video_refresh_cb (guint8 *data,
+                  guint   width,
+                  guint   height,
+                  gsize   pitch)
+{
+  RetroCore *self = retro_core_get_instance ();
+  gint64 start_time, begin_time;
+
+  if (data == NULL)
+    return;
+
+  if (retro_core_is_running_ahead (self))
+    return;
+
+  if (self->benchmark) {
+    if (!(self->benchmark->flags & RETRO_BENCHMARK_FLAGS_VIDEO))
+      return;
+
+    start_time = retro_frame_times_get_monotonic_time ();
+    set_video_data (self, data, width, height, pitch);
+    self->benchmark->video_time += retro_frame_times_get_monotonic_time () - start_time;
+
+    return;
+  }
+
+  begin_time = retro_profiler_get_time ();
+  start_time = retro_frame_times_get_monotonic_time ();
+  set_video_data (self, data, width, height, pitch);
+  retro_pipeline_stats_add (self->pipeline_stats,
+                            RETRO_PIPELINE_STAGE_VIDEO_REFRESH,
+                            retro_frame_times_get_monotonic_time () - start_time);
+  retro_profiler_add_mark (begin_time, "Video refresh", NULL);
 
   if (!self->block_video_signal)
     g_signal_emit_by_name (self, "video-output");
 }
 
+static void
+emit_audio_output (RetroCore *self,
+                   gint16    *data,
+                   gint       length)
+{
+  gint64 start_time;
+
+  if (self->benchmark) {
+    if (!(self->benchmark->flags & RETRO_BENCHMARK_FLAGS_AUDIO))
+      return;
+
+    start_time = retro_frame_times_get_monotonic_time ();
+    g_signal_emit_by_name (self, "audio_output", data, length, self->sample_rate);
+    self->benchmark->audio_time += retro_frame_times_get_monotonic_time () - start_time;
+
+    return;
+  }
+
+  g_signal_emit_by_name (self, "audio_output", data, length, self->sample_rate);
+}
+
 static void
 audio_sample_cb (gint16 left,
                  gint16 right)
@@ -955,7 +1034,7 @@ audio_sample_cb (gint16 left,
   if (self->sample_rate <= 0.0)
     return;
 
-  g_signal_emit_by_name (self, "audio_output", samples, 2, self->sample_rate);
+  emit_audio_output (self, samples, 2);
 }
 
 static gsize
@@ -970,7 +1049,7 @@ audio_sample_batch_cb (gint16 *data,
   if (self->sample_rate <= 0.0)
     return 0;
 
-  g_signal_emit_by_name (self, "audio_output", data, frames * 2, self->sample_rate);
+  emit_audio_output (self, data, frames * 2);
 
   return frames;
 }
@@ -992,6 +1071,10 @@ input_state_cb (guint port,
   RetroCore *self = retro_core_get_instance ();
   RetroInput input;
 
+  if ((device & RETRO_CONTROLLER_TYPE_TYPE_MASK) == RETRO_CONTROLLER_TYPE_JOYPAD &&
+      id == RETRO_JOYPAD_ID_MASK)
+    return (gint16) retro_core_get_controller_joypad_mask (self, port);
+
   retro_input_init (&input, device, id, index);
 
   return retro_core_get_controller_input_state (self, port, &input);
@@ -0,0 +1,34 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#pragma once
+
+#if !defined(__RETRO_GTK_INSIDE__) && !defined(RETRO_GTK_COMPILATION)
+# error "Only <retro-gtk.h> can be included directly."
+#endif
+
+#include <glib.h>
+#include "retro-frame-histogram.h"
+
+G_BEGIN_DECLS
+
+typedef struct _RetroFrameTimes RetroFrameTimes;
+
+struct _RetroFrameTimes
+{
+  guint64 n_frames;
+  guint64 total_time;
+  guint64 missed_deadlines;
+  guint32 buckets[RETRO_FRAME_HISTOGRAM_N_BUCKETS];
+};
+
+gint64 retro_frame_times_get_monotonic_time (void);
+
+void retro_frame_times_reset (RetroFrameTimes *self);
+void retro_frame_times_add (RetroFrameTimes *self,
+                            gint64           frame_time);
+void retro_frame_times_add_missed_deadline (RetroFrameTimes *self);
+gdouble retro_frame_times_get_mean (RetroFrameTimes *self);
+gdouble retro_frame_times_get_percentile (RetroFrameTimes *self,
+                                          gdouble          percentile);
+
+G_END_DECLS
@@ -0,0 +1,104 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#include "retro-frame-times-private.h"
+
+#include <string.h>
+#include <time.h>
+
+/**
+ * retro_frame_times_get_monotonic_time:
+ *
+ * Gets the time of CLOCK_MONOTONIC with a better precision than
+ * g_get_monotonic_time(), which is needed to time the short sections of a
+ * frame.
+ *
+ * Returns: the monotonic time in nanoseconds
+ */
+gint64
+retro_frame_times_get_monotonic_time (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * G_GINT64_CONSTANT (1000000000) + ts.tv_nsec;
+}
+
+void
+retro_frame_times_reset (RetroFrameTimes *self)
+{
+  g_return_if_fail (self != NULL);
+
+  memset (self, 0, sizeof (RetroFrameTimes));
+}
+
+/**
+ * retro_frame_times_add:
+ * @self: a #RetroFrameTimes
+ * @frame_time: the duration of the frame in microseconds
+ *
+ * Records the duration of a frame.
+ */
+void
+retro_frame_times_add (RetroFrameTimes *self,
+                       gint64           frame_time)
+{
+  gint64 bucket;
+
+  g_return_if_fail (self != NULL);
+
+  bucket = CLAMP (frame_time / RETRO_FRAME_HISTOGRAM_BUCKET_USEC,
+                  0, RETRO_FRAME_HISTOGRAM_N_BUCKETS - 1);
+
+  self->n_frames++;
+  self->total_time += MAX (frame_time, 0);
+  self->buckets[bucket]++;
+}
+
+void
+retro_frame_times_add_missed_deadline (RetroFrameTimes *self)
+{
+  g_return_if_fail (self != NULL);
+
+  self->missed_deadlines++;
+}
+
+/**
+ * retro_frame_times_get_mean:
+ * @self: a #RetroFrameTimes
+ *
+ * Gets the mean frame time.
+ *
+ * Returns: the mean frame time in milliseconds
+ */
+gdouble
+retro_frame_times_get_mean (RetroFrameTimes *self)
+{
+  g_return_val_if_fail (self != NULL, 0.0);
+
+  if (self->n_frames == 0)
+    return 0.0;
+
+  return (gdouble) self->total_time / self->n_frames / 1000.0;
+}
+
+/**
+ * retro_frame_times_get_percentile:
+ * @self: a #RetroFrameTimes
+ * @percentile: the percentile, between 0 and 100
+ *
+ * Gets the frame time under which @percentile percents of the frames are, with
+ * the precision of a bucket.
+ *
+ * Returns: the frame time in milliseconds
+ */
+gdouble
+retro_frame_times_get_percentile (RetroFrameTimes *self,
+                                  gdouble          percentile)
+{
+  g_return_val_if_fail (self != NULL, 0.0);
+
+  return retro_frame_histogram_get_percentile (self->buckets,
+                                               RETRO_FRAME_HISTOGRAM_N_BUCKETS,
+                                               percentile);
+}
@@ -16,18 +16,31 @@ typedef struct _RetroGameInfo RetroGameInfo;
 
 struct _RetroGameInfo
 {
+  /* These fields match struct retro_game_info, it is passed as is to the
+   * core. */
   gchar *path;
   gpointer data;
   gsize size;
   gchar *meta;
+
+  /*< private >*/
+  grefcount ref_count;
+  GMappedFile *mapped_file;
+  gint fd;
+  gchar *name;
+  gchar *link_dir;
 };
 
 RetroGameInfo *retro_game_info_new (const gchar  *uri,
                                     gboolean      needs_full_path,
                                     GError      **error);
-RetroGameInfo *retro_game_info_copy (RetroGameInfo *self);
-void retro_game_info_free (RetroGameInfo *self);
-
-G_DEFINE_AUTOPTR_CLEANUP_FUNC (RetroGameInfo, retro_game_info_free)
+RetroGameInfo *retro_game_info_new_for_fd (const gchar  *uri,
+                                           gint          fd,
+                                           gboolean      needs_full_path,
+                                           GError      **error);
+RetroGameInfo *retro_game_info_ref (RetroGameInfo *self);
+void retro_game_info_unref (RetroGameInfo *self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (RetroGameInfo, retro_game_info_unref)
 
 G_END_DECLS
@@ -2,10 +2,161 @@
 
 #include "retro-game-info-private.h"
 
+#include <errno.h>
 #include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "retro-archive-private.h"
 #include "retro-error-private.h"
 
-G_DEFINE_BOXED_TYPE (RetroGameInfo, retro_game_info, retro_game_info_copy, retro_game_info_free)
+G_DEFINE_BOXED_TYPE (RetroGameInfo, retro_game_info, retro_game_info_ref, retro_game_info_unref)
+
+static RetroGameInfo *
+game_info_alloc (void)
+{
+  RetroGameInfo *self = g_slice_new0 (RetroGameInfo);
+
+  g_ref_count_init (&self->ref_count);
+  self->fd = -1;
+
+  return self;
+}
+
+static void
+set_mapped_file (RetroGameInfo *self,
+                 GMappedFile   *mapped_file)
+{
+  if (mapped_file == NULL)
+    return;
+
+  self->mapped_file = mapped_file;
+  self->data = g_mapped_file_get_contents (mapped_file);
+  self->size = g_mapped_file_get_length (mapped_file);
+
+  /* Cores typically parse their content from start to end. */
+  if (self->size > 0 && madvise (self->data, self->size, MADV_SEQUENTIAL) != 0)
+    g_debug ("Couldn't advise the kernel on the content access pattern: %s",
+             g_strerror (errno));
+}
+
+/* Cores needing the full path open the content themselves and often pick
+ * how to load it from its extension, which /proc/self/fd/N lacks. Link the
+ * file descriptor under the basename of @name in a private directory, which
+ * is removed with the game info. */
+static gboolean
+link_fd (RetroGameInfo  *self,
+         gint            fd,
+         GError        **error)
+{
+  g_autofree gchar *fd_path = g_strdup_printf ("/proc/self/fd/%d", fd);
+  g_autofree gchar *basename = NULL;
+  g_autofree gchar *link_path = NULL;
+
+  if (self->name == NULL) {
+    self->path = g_steal_pointer (&fd_path);
+
+    return TRUE;
+  }
+
+  self->link_dir = g_dir_make_tmp ("retro-runner-XXXXXX", error);
+  if (self->link_dir == NULL)
+    return FALSE;
+
+  basename = g_path_get_basename (self->name);
+  link_path = g_build_filename (self->link_dir, basename, NULL);
+  if (symlink (fd_path, link_path) != 0) {
+    int errsv = errno;
+
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                 "Couldn't link the content file descriptor: %s",
+                 g_strerror (errsv));
+
+    return FALSE;
+  }
+
+  self->path = g_steal_pointer (&link_path);
+
+  return TRUE;
+}
+
+/* @name only names the content, it is read from @fd. */
+static RetroGameInfo *
+game_info_new_for_fd (gchar     *name,
+                      gint       fd,
+                      gboolean   needs_full_path,
+                      GError   **error)
+{
+  g_autoptr (RetroGameInfo) self = game_info_alloc ();
+
+  self->name = name;
+
+  if (needs_full_path) {
+    if (!link_fd (self, fd, error))
+      return NULL;
+
+    return g_steal_pointer (&self);
+  }
+
+  self->path = g_strdup (name);
+
+  retro_try_propagate_val ({
+    set_mapped_file (self, g_mapped_file_new_from_fd (fd, FALSE, &catch));
+  }, catch, error, NULL);
+
+  return g_steal_pointer (&self);
+}
+
+/* A fragment in the URI names a member of the archive the URI points to,
+ * e.g. file:///games/game.zip#game.sfc. */
+static RetroGameInfo *
+game_info_new_for_archive_member (const gchar  *uri,
+                                  const gchar  *fragment,
+                                  gboolean      needs_full_path,
+                                  GError      **error)
+{
+  g_autoptr (RetroGameInfo) self = NULL;
+  g_autoptr (GFile) file = NULL;
+  g_autofree gchar *archive_uri = NULL;
+  g_autofree gchar *archive_path = NULL;
+  g_autofree gchar *member = NULL;
+  gint fd;
+
+  archive_uri = g_strndup (uri, fragment - uri);
+  member = g_uri_unescape_string (fragment + 1, NULL);
+  file = g_file_new_for_uri (archive_uri);
+  archive_path = g_file_get_path (file);
+
+  if (archive_path == NULL || member == NULL) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                 "Invalid archive member URI: %s", uri);
+
+    return NULL;
+  }
+
+  fd = retro_archive_open_member (archive_path, member, error);
+  if (fd < 0)
+    return NULL;
+
+  /* Name the member like other frontends do, so cores can get its extension. */
+  self = game_info_new_for_fd (g_strconcat (archive_path, "#", member, NULL),
+                               fd, needs_full_path, error);
+  if (self == NULL) {
+    close (fd);
+
+    return NULL;
+  }
+
+  /* The mapping outlives the file descriptor, keep it only if the core opens
+   * it. */
+  if (needs_full_path)
+    self->fd = fd;
+  else
+    close (fd);
+
+  return g_steal_pointer (&self);
+}
 
 RetroGameInfo *
 retro_game_info_new (const gchar  *uri,
@@ -14,48 +165,82 @@ retro_game_info_new (const gchar  *uri,
 {
   g_autoptr (RetroGameInfo) self = NULL;
   g_autoptr (GFile) file = NULL;
+  const gchar *fragment;
 
   g_return_val_if_fail (uri != NULL, NULL);
 
-  self = g_slice_new0 (RetroGameInfo);
+  fragment = strchr (uri, '#');
+  if (fragment != NULL)
+    return game_info_new_for_archive_member (uri, fragment, needs_full_path, error);
+
+  self = game_info_alloc ();
 
   file = g_file_new_for_uri (uri);
   self->path = g_file_get_path (file);
+  self->name = g_strdup (self->path);
   if (needs_full_path)
-    self->data = g_new0 (guint8, 0);
-  else
-    retro_try_propagate_val ({
-      g_file_get_contents (self->path, (gchar **) &self->data, &self->size, &catch);
-    }, catch, error, NULL);
+    return g_steal_pointer (&self);
+
+  /* Map the content rather than reading it, so it is paged in as the core
+   * reads it and the pages can be reclaimed, instead of taking the whole
+   * file's size from the heap before the core even starts. */
+  retro_try_propagate_val ({
+    set_mapped_file (self, g_mapped_file_new (self->path, FALSE, &catch));
+  }, catch, error, NULL);
 
   return g_steal_pointer (&self);
 }
 
+/* The content is read from @fd rather than from @uri, which only names it. @fd
+ * must stay open as long as the game info is used. */
 RetroGameInfo *
-retro_game_info_copy (RetroGameInfo *self)
+retro_game_info_new_for_fd (const gchar  *uri,
+                            gint          fd,
+                            gboolean      needs_full_path,
+                            GError      **error)
 {
-  RetroGameInfo *copy;
+  g_autoptr (GFile) file = NULL;
 
-  g_return_val_if_fail (self, NULL);
+  g_return_val_if_fail (uri != NULL, NULL);
+  g_return_val_if_fail (fd >= 0, NULL);
+
+  file = g_file_new_for_uri (uri);
+
+  return game_info_new_for_fd (g_file_get_path (file), fd, needs_full_path, error);
+}
 
-  copy = g_slice_new0 (RetroGameInfo);
+RetroGameInfo *
+retro_game_info_ref (RetroGameInfo *self)
+{
+  g_return_val_if_fail (self, NULL);
 
-  copy->path = g_strdup (self->path);
-  copy->data = g_memdup2 (self, self->size);
-  copy->size = self->size;
-  copy->meta = g_strdup (self->meta);
+  g_ref_count_inc (&self->ref_count);
 
-  return copy;
+  return self;
 }
 
 void
-retro_game_info_free (RetroGameInfo *self)
+retro_game_info_unref (RetroGameInfo *self)
 {
   g_return_if_fail (self);
 
+  if (!g_ref_count_dec (&self->ref_count))
+    return;
+
+  if (self->link_dir != NULL) {
+    if (self->path != NULL)
+      g_unlink (self->path);
+    g_rmdir (self->link_dir);
+    g_free (self->link_dir);
+  }
+
   g_free (self->path);
-  g_free (self->data);
+  g_clear_pointer (&self->mapped_file, g_mapped_file_unref);
   g_free (self->meta);
+  g_free (self->name);
+
+  if (self->fd >= 0)
+    close (self->fd);
 
   g_slice_free (RetroGameInfo, self);
 }
@@ -3,9 +3,11 @@
 #pragma once
 
 #include <glib.h>
+#include "retro-frame-times-private.h"
 
 G_BEGIN_DECLS
 
-GSource *retro_main_loop_source_new (gdouble framerate);
+GSource *retro_main_loop_source_new (gdouble          framerate,
+                                     RetroFrameTimes *frame_times);
 
 G_END_DECLS
@@ -2,25 +2,51 @@
 
 #include "retro-main-loop-source-private.h"
 
+#include <errno.h>
 #include <math.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
 
+#define NSEC_PER_SEC G_GINT64_CONSTANT (1000000000)
+#define NSEC_PER_USEC 1000
+
+/* The frames are scheduled with a timerfd on CLOCK_MONOTONIC with absolute
+ * deadlines in nanoseconds. Each deadline is computed from the start time
+ * rather than from the previous deadline so the rounding errors don't
+ * accumulate, and the frames don't drift. */
 typedef struct {
   GSource parent;
-  gdouble delay;
-  gint64 next_time;
-  gdouble rounding_error;
+  gint fd;
+  gdouble period;
+  gint64 start_time;
+  guint64 n_frames;
+  gint64 deadline;
+  gint64 last_dispatch_time;
+  RetroFrameTimes *frame_times;
 } RetroMainLoopSource;
 
-static gboolean
-retro_main_loop_source_prepare (GSource *source,
-                                gint    *timeout)
+static void
+schedule (RetroMainLoopSource *self,
+          gint64               deadline)
 {
-  RetroMainLoopSource *self = (RetroMainLoopSource *) source;
-  gint64 delay = self->next_time - g_get_monotonic_time ();
+  struct itimerspec spec = {{ 0 }};
 
-  *timeout = MAX (0, (gint) floor (delay / 1000.0) - 1);
+  self->deadline = deadline;
 
-  return delay <= 0;
+  spec.it_value.tv_sec = deadline / NSEC_PER_SEC;
+  spec.it_value.tv_nsec = deadline % NSEC_PER_SEC;
+
+  if (timerfd_settime (self->fd, TFD_TIMER_ABSTIME, &spec, NULL) != 0)
+    g_critical ("Couldn't schedule the next frame: %s", g_strerror (errno));
+}
+
+static void
+restart (RetroMainLoopSource *self,
+         gint64               time)
+{
+  self->start_time = time;
+  self->n_frames = 0;
 }
 
 static gboolean
@@ -30,46 +56,77 @@ retro_main_loop_source_dispatch (GSource     *source,
 {
   RetroMainLoopSource *self = (RetroMainLoopSource *) source;
   gboolean result;
-  gint64 time = g_source_get_time (source);
-  gdouble delay;
+  guint64 expirations;
+  gint64 time, deadline;
 
   if (!callback)
     return G_SOURCE_REMOVE;
 
+  /* Acknowledge the expiration, the number of expirations doesn't matter as
+   * deadlines aren't periodic. */
+  if (read (self->fd, &expirations, sizeof (guint64)) < 0 && errno != EAGAIN)
+    g_critical ("Couldn't read the frame timer: %s", g_strerror (errno));
+
+  time = retro_frame_times_get_monotonic_time ();
+
+  if (self->frame_times && self->last_dispatch_time != 0)
+    retro_frame_times_add (self->frame_times,
+                           (time - self->last_dispatch_time) / NSEC_PER_USEC);
+
+  self->last_dispatch_time = time;
+
   result = callback (user_data);
 
-  delay = round (self->delay);
+  self->n_frames++;
+  deadline = self->start_time + (gint64) llround (self->n_frames * self->period);
+  time = retro_frame_times_get_monotonic_time ();
 
-  self->rounding_error += (delay - self->delay);
-  if (self->rounding_error >= 1) {
-    delay--;
-    self->rounding_error--;
-  } else if (self->rounding_error <= -1) {
-    delay++;
-    self->rounding_error++;
-  }
+  /* If the frame took longer than its time budget, start over from now rather
+   * than running a burst of frames to catch up. */
+  if (deadline <= time) {
+    if (self->frame_times)
+      retro_frame_times_add_missed_deadline (self->frame_times);
 
-  if (self->next_time == 0 || self->next_time + delay <= time)
-    self->next_time = time;
+    restart (self, time);
+    self->n_frames++;
+    deadline = time + (gint64) llround (self->period);
+  }
 
-  self->next_time += delay;
-  g_source_set_ready_time (source, self->next_time);
+  schedule (self, deadline);
 
   return result;
 }
 
+static void
+retro_main_loop_source_finalize (GSource *source)
+{
+  RetroMainLoopSource *self = (RetroMainLoopSource *) source;
+
+  close (self->fd);
+}
+
 static GSourceFuncs retro_main_loop_source_funcs =
   {
-    retro_main_loop_source_prepare,
+    NULL, /* prepare */
     NULL, /* check */
     retro_main_loop_source_dispatch,
-    NULL, /* finalize */
+    retro_main_loop_source_finalize,
     NULL,
     NULL,
   };
 
+/**
+ * retro_main_loop_source_new:
+ * @framerate: the number of frames per second
+ * @frame_times: (nullable): a #RetroFrameTimes to record the frame times to
+ *
+ * Creates a source dispatched at @framerate with sub-millisecond precision.
+ *
+ * Returns: (transfer full): a new #GSource
+ */
 GSource *
-retro_main_loop_source_new (gdouble framerate)
+retro_main_loop_source_new (gdouble          framerate,
+                            RetroFrameTimes *frame_times)
 {
   RetroMainLoopSource *self;
   GSource *source;
@@ -77,10 +134,22 @@ retro_main_loop_source_new (gdouble framerate)
   source = g_source_new (&retro_main_loop_source_funcs,
                          sizeof (RetroMainLoopSource));
   self = (RetroMainLoopSource *) source;
-  self->delay = 1000000.0 / framerate;
-  g_source_set_priority (source, G_PRIORITY_DEFAULT_IDLE);
-  g_source_set_ready_time (source, 0);
+  self->period = NSEC_PER_SEC / framerate;
+  self->frame_times = frame_times;
+
+  self->fd = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (self->fd < 0)
+    g_critical ("Couldn't create the frame timer: %s", g_strerror (errno));
+
+  g_source_add_unix_fd (source, self->fd, G_IO_IN);
+
+  /* Frames must not be delayed by less time critical sources. */
+  g_source_set_priority (source, G_PRIORITY_HIGH);
   g_source_set_name (source, "RetroMainLoopSource");
 
+  /* Run the first frame right away. */
+  restart (self, retro_frame_times_get_monotonic_time ());
+  schedule (self, self->start_time);
+
   return source;
 }
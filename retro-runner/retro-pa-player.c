@@ -5,6 +5,7 @@
 #include "retro-pa-player-private.h"
 
 #include "retro-core-private.h"
+#include "retro-profiler-private.h"
 #include <pulse/simple.h>
 #include <pulse/pulseaudio.h>
 #include <samplerate.h>
@@ -146,6 +147,7 @@ iterated_cb (RetroCore     *core,
              RetroPaPlayer *self)
 {
   gdouble sample_rate, speed_rate;
+  gint64 start_time, time, begin_time;
 
   if (retro_core_is_running_ahead (self->core))
     return;
@@ -166,18 +168,44 @@ iterated_cb (RetroCore     *core,
     return;
   }
 
+  /* Benchmarks consume the audio as fast as it's produced, playing it would
+   * pace them. */
+  if (self->core->benchmark) {
+    start_time = retro_frame_times_get_monotonic_time ();
+
+    resample (self, 1 / speed_rate);
+    g_array_set_size (self->buffer, 0);
+
+    self->core->benchmark->audio_time += retro_frame_times_get_monotonic_time () - start_time;
+
+    return;
+  }
+
   if (self->simple == NULL || sample_rate != self->sample_rate)
     prepare_for_sample_rate (self, sample_rate);
 
   if (self->simple == NULL)
     return;
 
+  begin_time = retro_profiler_get_time ();
+  start_time = retro_frame_times_get_monotonic_time ();
   resample (self, 1 / speed_rate);
-
+  time = retro_frame_times_get_monotonic_time ();
+  retro_pipeline_stats_add (self->core->pipeline_stats,
+                            RETRO_PIPELINE_STAGE_AUDIO_RESAMPLE,
+                            time - start_time);
+  retro_profiler_add_mark (begin_time, "Resample", NULL);
+
+  begin_time = retro_profiler_get_time ();
+  start_time = time;
   pa_simple_write (self->simple,
                    self->buffer->data,
                    self->buffer->len * sizeof (gint16),
                    NULL);
+  retro_pipeline_stats_add (self->core->pipeline_stats,
+                            RETRO_PIPELINE_STAGE_AUDIO_WRITE,
+                            retro_frame_times_get_monotonic_time () - start_time);
+  retro_profiler_add_mark (begin_time, "PulseAudio write", NULL);
 
   g_array_set_size (self->buffer, 0);
 }
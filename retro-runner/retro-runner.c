@@ -18,6 +18,51 @@
 
 #define RETRO_RUNNER_PRGNAME "retro-runner"
 
+typedef struct {
+  const gchar *filename;
+  GMainContext *context;
+  GMainLoop *loop;
+  GAsyncQueue *ready;
+} EmulationData;
+
+/* Libretro cores must be driven from a single thread: the core is created,
+ * run and destroyed on the emulation thread, which only runs its own context.
+ * The main thread only runs the D-Bus connection.
+ */
+static gpointer
+run_emulation_thread (EmulationData *data)
+{
+  g_autoptr(IpcRunnerImpl) runner = NULL;
+  RetroCore *core;
+
+  g_main_context_push_thread_default (data->context);
+
+  core = retro_core_new (data->filename);
+  runner = ipc_runner_impl_new (core);
+
+  g_async_queue_push (data->ready, g_object_ref (runner));
+
+  g_debug ("Running emulation loop");
+
+  g_main_loop_run (data->loop);
+
+  /* Drop the last reference from this thread so the core is deinitialized
+   * where it ran. */
+  g_clear_object (&runner);
+
+  g_main_context_pop_thread_default (data->context);
+
+  return NULL;
+}
+
+static gboolean
+quit_emulation_loop_cb (GMainLoop *loop)
+{
+  g_main_loop_quit (loop);
+
+  return G_SOURCE_REMOVE;
+}
+
 static gboolean
 run_main_loop (GMainLoop        *loop,
                GDBusConnection  *connection,
@@ -25,25 +70,53 @@ run_main_loop (GMainLoop        *loop,
                GError          **error)
 {
   g_autoptr(IpcRunnerImpl) runner = NULL;
+  g_autoptr(GSource) quit_source = NULL;
+  GThread *thread;
+  EmulationData data = { filename };
   RetroCore *core;
+  gboolean success;
 
-  core = retro_core_new (filename);
-  runner = ipc_runner_impl_new (core);
+  data.context = g_main_context_new ();
+  data.loop = g_main_loop_new (data.context, FALSE);
+  data.ready = g_async_queue_new ();
+
+  thread = g_thread_new ("retro-core", (GThreadFunc) run_emulation_thread, &data);
+  runner = g_async_queue_pop (data.ready);
+
+  g_object_get (runner, "core", &core, NULL);
   g_signal_connect_swapped (core, "shutdown", G_CALLBACK (g_main_loop_quit), loop);
+  g_object_unref (core);
+
+  success = g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (runner),
+                                              connection,
+                                              "/org/gnome/Retro/Runner",
+                                              error);
+
+  if (success) {
+    g_dbus_connection_start_message_processing (connection);
+
+    g_debug ("Running main loop");
+
+    g_main_loop_run (loop);
+
+    g_dbus_interface_skeleton_unexport (G_DBUS_INTERFACE_SKELETON (runner));
+  }
 
-  if (!g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (runner),
-                                         connection,
-                                         "/org/gnome/Retro/Runner",
-                                         error))
-    return FALSE;
+  g_signal_handlers_disconnect_by_data (core, loop);
+  g_clear_object (&runner);
 
-  g_dbus_connection_start_message_processing (connection);
+  /* Quit from the emulation context, in case its loop isn't running yet. */
+  quit_source = g_idle_source_new ();
+  g_source_set_callback (quit_source, (GSourceFunc) quit_emulation_loop_cb, data.loop, NULL);
+  g_source_attach (quit_source, data.context);
 
-  g_debug ("Running main loop");
+  g_thread_join (thread);
 
-  g_main_loop_run (loop);
+  g_main_loop_unref (data.loop);
+  g_main_context_unref (data.context);
+  g_async_queue_unref (data.ready);
 
-  return TRUE;
+  return success;
 }
 
 static void
@@ -0,0 +1,40 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#pragma once
+
+#if !defined(__RETRO_GTK_INSIDE__) && !defined(RETRO_GTK_COMPILATION)
+# error "Only <retro-gtk.h> can be included directly."
+#endif
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _RetroStateHeader RetroStateHeader;
+
+struct _RetroStateHeader
+{
+  gchar *core_name;
+  gchar *core_version;
+  gchar *content_hash;
+  guint64 frame_count;
+  gint64 timestamp;
+  gchar *thumbnail;
+};
+
+void retro_state_header_clear (RetroStateHeader *self);
+
+gboolean retro_state_save (const gchar             *filename,
+                           const RetroStateHeader  *header,
+                           const guint8            *data,
+                           gsize                    size,
+                           GError                 **error);
+guint8 *retro_state_load (const gchar       *filename,
+                          gsize              expected_size,
+                          RetroStateHeader  *header,
+                          gsize             *size,
+                          GError           **error);
+
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC (RetroStateHeader, retro_state_header_clear)
+
+G_END_DECLS
@@ -0,0 +1,406 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#include "retro-state-private.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <gio/gunixoutputstream.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "retro-core-error-private.h"
+#include "retro-error-private.h"
+
+/* A state file starts with a preamble containing a magic string, the version
+ * of the format and the size of the header. The header is a little-endian
+ * serialized GVariant describing the state, it is followed by the state itself
+ * compressed with zlib.
+ *
+ * Files not starting with the magic string are raw states from older versions
+ * and are loaded as is.
+ */
+#define RETRO_STATE_MAGIC "RETROST"
+#define RETRO_STATE_MAGIC_SIZE 8
+#define RETRO_STATE_VERSION 1
+#define RETRO_STATE_HEADER_TYPE "(ssstxsts)"
+#define RETRO_STATE_MAX_HEADER_SIZE (64 * 1024)
+/* States are saved often and can be large, favor speed over size. */
+#define RETRO_STATE_COMPRESSION_LEVEL 1
+
+typedef struct {
+  gchar magic[RETRO_STATE_MAGIC_SIZE];
+  guint32 version;
+  guint32 header_size;
+} RetroStatePreamble;
+
+static GVariant *
+header_to_variant (const RetroStateHeader *header,
+                   gsize                   size,
+                   const gchar            *checksum)
+{
+  g_autoptr (GVariant) variant = NULL;
+
+  variant = g_variant_new (RETRO_STATE_HEADER_TYPE,
+                           header->core_name ? header->core_name : "",
+                           header->core_version ? header->core_version : "",
+                           header->content_hash ? header->content_hash : "",
+                           header->frame_count,
+                           header->timestamp,
+                           header->thumbnail ? header->thumbnail : "",
+                           (guint64) size,
+                           checksum);
+  g_variant_ref_sink (variant);
+
+  if (G_BYTE_ORDER == G_BIG_ENDIAN)
+    return g_variant_byteswap (variant);
+
+  return g_steal_pointer (&variant);
+}
+
+static gboolean
+write_to_stream (GOutputStream  *stream,
+                 GVariant       *header,
+                 const guint8   *data,
+                 gsize           size,
+                 GError        **error)
+{
+  g_autoptr (GConverter) compressor = NULL;
+  g_autoptr (GOutputStream) compressed_stream = NULL;
+  RetroStatePreamble preamble = {{ 0 }};
+  gsize header_size;
+
+  header_size = g_variant_get_size (header);
+
+  memcpy (preamble.magic, RETRO_STATE_MAGIC, RETRO_STATE_MAGIC_SIZE);
+  preamble.version = GUINT32_TO_LE (RETRO_STATE_VERSION);
+  preamble.header_size = GUINT32_TO_LE (header_size);
+
+  retro_try_propagate_val ({
+    g_output_stream_write_all (stream, &preamble, sizeof (RetroStatePreamble),
+                               NULL, NULL, &catch);
+  }, catch, error, FALSE);
+
+  retro_try_propagate_val ({
+    g_output_stream_write_all (stream, g_variant_get_data (header),
+                               header_size, NULL, NULL, &catch);
+  }, catch, error, FALSE);
+
+  compressor = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_ZLIB,
+                                                   RETRO_STATE_COMPRESSION_LEVEL));
+  compressed_stream = g_converter_output_stream_new (stream, compressor);
+  g_filter_output_stream_set_close_base_stream (G_FILTER_OUTPUT_STREAM (compressed_stream),
+                                                FALSE);
+
+  retro_try_propagate_val ({
+    g_output_stream_write_all (compressed_stream, data, size,
+                               NULL, NULL, &catch);
+  }, catch, error, FALSE);
+
+  /* Closing the converter flushes the compressor. */
+  retro_try_propagate_val ({
+    g_output_stream_close (compressed_stream, NULL, &catch);
+  }, catch, error, FALSE);
+
+  return TRUE;
+}
+
+static gboolean
+read_header (GInputStream      *stream,
+             gsize              header_size,
+             RetroStateHeader  *header,
+             guint64           *size,
+             gchar            **checksum,
+             GError           **error)
+{
+  g_autofree guint8 *data = NULL;
+  g_autoptr (GBytes) bytes = NULL;
+  g_autoptr (GVariant) variant = NULL;
+  gsize bytes_read;
+
+  if (header_size > RETRO_STATE_MAX_HEADER_SIZE) {
+    g_set_error_literal (error,
+                         RETRO_CORE_ERROR,
+                         RETRO_CORE_ERROR_COULDNT_DESERIALIZE,
+                         "Couldn't deserialize the internal state: invalid header.");
+
+    return FALSE;
+  }
+
+  data = g_malloc (header_size);
+
+  retro_try_propagate_val ({
+    g_input_stream_read_all (stream, data, header_size, &bytes_read,
+                             NULL, &catch);
+  }, catch, error, FALSE);
+
+  if (bytes_read != header_size) {
+    g_set_error_literal (error,
+                         RETRO_CORE_ERROR,
+                         RETRO_CORE_ERROR_COULDNT_DESERIALIZE,
+                         "Couldn't deserialize the internal state: truncated header.");
+
+    return FALSE;
+  }
+
+  bytes = g_bytes_new_take (g_steal_pointer (&data), header_size);
+  variant = g_variant_new_from_bytes (G_VARIANT_TYPE (RETRO_STATE_HEADER_TYPE),
+                                      bytes, FALSE);
+  g_variant_ref_sink (variant);
+
+  if (G_BYTE_ORDER == G_BIG_ENDIAN) {
+    GVariant *swapped = g_variant_byteswap (variant);
+
+    g_variant_unref (variant);
+    variant = swapped;
+  }
+
+  if (!g_variant_is_normal_form (variant)) {
+    g_set_error_literal (error,
+                         RETRO_CORE_ERROR,
+                         RETRO_CORE_ERROR_COULDNT_DESERIALIZE,
+                         "Couldn't deserialize the internal state: invalid header.");
+
+    return FALSE;
+  }
+
+  g_variant_get (variant, RETRO_STATE_HEADER_TYPE,
+                 &header->core_name,
+                 &header->core_version,
+                 &header->content_hash,
+                 &header->frame_count,
+                 &header->timestamp,
+                 &header->thumbnail,
+                 size,
+                 checksum);
+
+  return TRUE;
+}
+
+static guint8 *
+read_payload (GInputStream  *stream,
+              gsize          size,
+              const gchar   *checksum,
+              GError       **error)
+{
+  g_autoptr (GConverter) decompressor = NULL;
+  g_autoptr (GInputStream) compressed_stream = NULL;
+  g_autofree guint8 *data = NULL;
+  g_autofree gchar *actual_checksum = NULL;
+  gsize bytes_read;
+
+  decompressor = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_ZLIB));
+  compressed_stream = g_converter_input_stream_new (stream, decompressor);
+
+  /* Decompress straight into the buffer passed to the core. */
+  data = g_malloc (size);
+
+  retro_try_propagate_val ({
+    g_input_stream_read_all (compressed_stream, data, size, &bytes_read,
+                             NULL, &catch);
+  }, catch, error, NULL);
+
+  if (bytes_read != size) {
+    g_set_error_literal (error,
+                         RETRO_CORE_ERROR,
+                         RETRO_CORE_ERROR_COULDNT_DESERIALIZE,
+                         "Couldn't deserialize the internal state: truncated state.");
+
+    return NULL;
+  }
+
+  actual_checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA256, data, size);
+  if (g_strcmp0 (checksum, actual_checksum) != 0) {
+    g_set_error_literal (error,
+                         RETRO_CORE_ERROR,
+                         RETRO_CORE_ERROR_COULDNT_DESERIALIZE,
+                         "Couldn't deserialize the internal state: checksum mismatch.");
+
+    return NULL;
+  }
+
+  return g_steal_pointer (&data);
+}
+
+void
+retro_state_header_clear (RetroStateHeader *self)
+{
+  g_return_if_fail (self != NULL);
+
+  g_clear_pointer (&self->core_name, g_free);
+  g_clear_pointer (&self->core_version, g_free);
+  g_clear_pointer (&self->content_hash, g_free);
+  g_clear_pointer (&self->thumbnail, g_free);
+  self->frame_count = 0;
+  self->timestamp = 0;
+}
+
+/**
+ * retro_state_save:
+ * @filename: the file to save the state to
+ * @header: the #RetroStateHeader describing the state
+ * @data: (array length=size): the state
+ * @size: the size of @data
+ * @error: return location for a #GError, or %NULL
+ *
+ * Compresses the state and writes it to @filename along with its header. The
+ * state is written to a temporary file next to @filename, which replaces it
+ * only once completely written, so @filename is never left partially written.
+ *
+ * This doesn't access the core and can be called from any thread.
+ *
+ * Returns: whether the state was saved
+ */
+gboolean
+retro_state_save (const gchar             *filename,
+                  const RetroStateHeader  *header,
+                  const guint8            *data,
+                  gsize                    size,
+                  GError                 **error)
+{
+  g_autoptr (GOutputStream) stream = NULL;
+  g_autoptr (GVariant) variant = NULL;
+  g_autofree gchar *checksum = NULL;
+  g_autofree gchar *tmp_filename = NULL;
+  gint fd;
+
+  g_return_val_if_fail (filename != NULL, FALSE);
+  g_return_val_if_fail (header != NULL, FALSE);
+  g_return_val_if_fail (data != NULL, FALSE);
+
+  checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA256, data, size);
+  variant = header_to_variant (header, size, checksum);
+
+  tmp_filename = g_strconcat (filename, ".XXXXXX", NULL);
+  fd = g_mkstemp_full (tmp_filename, O_WRONLY | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    int errsv = errno;
+
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                 "Couldn't create %s: %s", tmp_filename, g_strerror (errsv));
+
+    return FALSE;
+  }
+
+  stream = g_unix_output_stream_new (fd, TRUE);
+
+  retro_try ({
+    write_to_stream (stream, variant, data, size, &catch);
+  }, catch, {
+    g_output_stream_close (stream, NULL, NULL);
+    g_unlink (tmp_filename);
+    g_propagate_error (error, g_steal_pointer (&catch));
+
+    return FALSE;
+  });
+
+  /* Make sure the state is on disk before replacing the previous one. */
+  if (fsync (fd) != 0 || g_rename (tmp_filename, filename) != 0) {
+    int errsv = errno;
+
+    g_output_stream_close (stream, NULL, NULL);
+    g_unlink (tmp_filename);
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                 "Couldn't save the state to %s: %s", filename, g_strerror (errsv));
+
+    return FALSE;
+  }
+
+  retro_try_propagate_val ({
+    g_output_stream_close (stream, NULL, &catch);
+  }, catch, error, FALSE);
+
+  return TRUE;
+}
+
+/**
+ * retro_state_load:
+ * @filename: the file to load the state from
+ * @expected_size: the state size the core expects
+ * @header: (out caller-allocates): return location for the #RetroStateHeader
+ * @size: (out): return location for the size of the state
+ * @error: return location for a #GError, or %NULL
+ *
+ * Reads the state from @filename, decompressing it and checking its integrity.
+ * States not matching @expected_size are rejected before being decompressed.
+ *
+ * If the file is a raw state saved by an older version, it is returned as is
+ * and the fields of @header are left unset.
+ *
+ * Returns: (transfer full): the state, or %NULL on error
+ */
+guint8 *
+retro_state_load (const gchar       *filename,
+                  gsize              expected_size,
+                  RetroStateHeader  *header,
+                  gsize             *size,
+                  GError           **error)
+{
+  g_autoptr (GFile) file = NULL;
+  g_autoptr (GFileInputStream) stream = NULL;
+  g_autofree gchar *checksum = NULL;
+  RetroStatePreamble preamble = {{ 0 }};
+  guint64 payload_size;
+  gsize bytes_read;
+  guint8 *data;
+
+  g_return_val_if_fail (filename != NULL, NULL);
+  g_return_val_if_fail (header != NULL, NULL);
+  g_return_val_if_fail (size != NULL, NULL);
+
+  file = g_file_new_for_path (filename);
+
+  retro_try_propagate_val ({
+    stream = g_file_read (file, NULL, &catch);
+  }, catch, error, NULL);
+
+  retro_try_propagate_val ({
+    g_input_stream_read_all (G_INPUT_STREAM (stream), &preamble,
+                             sizeof (RetroStatePreamble), &bytes_read,
+                             NULL, &catch);
+  }, catch, error, NULL);
+
+  if (bytes_read < sizeof (RetroStatePreamble) ||
+      memcmp (preamble.magic, RETRO_STATE_MAGIC, RETRO_STATE_MAGIC_SIZE) != 0) {
+    retro_try_propagate_val ({
+      g_file_get_contents (filename, (gchar **) &data, size, &catch);
+    }, catch, error, NULL);
+
+    return data;
+  }
+
+  if (GUINT32_FROM_LE (preamble.version) > RETRO_STATE_VERSION) {
+    g_set_error (error,
+                 RETRO_CORE_ERROR,
+                 RETRO_CORE_ERROR_COULDNT_DESERIALIZE,
+                 "Couldn't deserialize the internal state: unsupported format version %u.",
+                 GUINT32_FROM_LE (preamble.version));
+
+    return NULL;
+  }
+
+  retro_try_propagate_val ({
+    read_header (G_INPUT_STREAM (stream), GUINT32_FROM_LE (preamble.header_size),
+                 header, &payload_size, &checksum, &catch);
+  }, catch, error, NULL);
+
+  if (payload_size != expected_size) {
+    g_set_error (error,
+                 RETRO_CORE_ERROR,
+                 RETRO_CORE_ERROR_SIZE_MISMATCH,
+                 "Couldn't deserialize the internal state: expected %"
+                 G_GSIZE_FORMAT" bytes, but the state has %"G_GUINT64_FORMAT" bytes.",
+                 expected_size,
+                 payload_size);
+
+    return NULL;
+  }
+
+  retro_try_propagate_val ({
+    data = read_payload (G_INPUT_STREAM (stream), payload_size, checksum, &catch);
+  }, catch, error, NULL);
+
+  *size = payload_size;
+
+  return data;
+}
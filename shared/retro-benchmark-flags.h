@@ -0,0 +1,28 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#pragma once
+
+#if !defined(__RETRO_GTK_INSIDE__) && !defined(RETRO_GTK_COMPILATION)
+# error "Only <retro-gtk.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/**
+ * RetroBenchmarkFlags:
+ * @RETRO_BENCHMARK_FLAGS_NONE: only run the core, discarding its output
+ * @RETRO_BENCHMARK_FLAGS_VIDEO: copy the video frames to the framebuffer
+ * @RETRO_BENCHMARK_FLAGS_AUDIO: resample the audio as for playback
+ *
+ * Represents which outputs of the core are consumed while benchmarking it.
+ */
+typedef enum
+{
+  RETRO_BENCHMARK_FLAGS_NONE = 0,
+  RETRO_BENCHMARK_FLAGS_VIDEO = 1 << 0,
+  RETRO_BENCHMARK_FLAGS_AUDIO = 1 << 1,
+} RetroBenchmarkFlags;
+
+G_END_DECLS
@@ -17,4 +17,8 @@ G_BEGIN_DECLS
 #define RETRO_MOUSE_ID_COUNT (RETRO_MOUSE_ID_BUTTON_5 + 1)
 #define RETRO_POINTER_ID_COUNT (RETRO_POINTER_ID_PRESSED + 1)
 
+/* Querying this joypad id returns the state of all the buttons as a bitmask,
+ * see RETRO_ENVIRONMENT_GET_INPUT_BITMASKS. */
+#define RETRO_JOYPAD_ID_MASK 256
+
 G_END_DECLS
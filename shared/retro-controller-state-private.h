@@ -8,9 +8,23 @@
 
 #include <glib-object.h>
 #include "retro-input.h"
+#include "retro-keyboard-key-private.h"
 
 G_BEGIN_DECLS
 
+typedef struct {
+  gint64 time;
+  guint32 character;
+  guint16 keycode;
+  guint16 modifiers;
+  gboolean down;
+} RetroKeyboardEvent;
+
+/* The number of ports which can have a controller plugged in. The default
+ * controller uses an extra slot after them. */
+#define RETRO_CONTROLLER_STATE_N_PORTS 32
+#define RETRO_CONTROLLER_STATE_DEFAULT_PORT RETRO_CONTROLLER_STATE_N_PORTS
+
 #define RETRO_TYPE_CONTROLLER_STATE (retro_controller_state_get_type())
 
 G_DECLARE_FINAL_TYPE (RetroControllerState, retro_controller_state, RETRO, CONTROLLER_STATE, GObject)
@@ -19,32 +33,57 @@ RetroControllerState *retro_controller_state_new (gint fd);
 
 gint retro_controller_state_get_fd (RetroControllerState *self);
 
-void retro_controller_state_lock (RetroControllerState *self);
-void retro_controller_state_unlock (RetroControllerState *self);
-
 #ifdef RETRO_RUNNER_COMPILATION
 
 gboolean retro_controller_state_has_type (RetroControllerState *self,
+                                          guint                 port,
                                           RetroControllerType   type);
 gint16 retro_controller_state_get_input (RetroControllerState *self,
+                                         guint                 port,
                                          RetroInput           *input);
 
-gboolean retro_controller_state_get_supports_rumble (RetroControllerState *self);
+guint16 retro_controller_state_get_joypad_mask (RetroControllerState *self,
+                                                guint                 port);
+
+gboolean retro_controller_state_get_supports_rumble (RetroControllerState *self,
+                                                     guint                 port);
 
 void retro_controller_state_snapshot (RetroControllerState *self);
 
+gboolean retro_controller_state_pop_keyboard_event (RetroControllerState *self,
+                                                    gint64                before,
+                                                    RetroKeyboardEvent   *event);
+void retro_controller_state_flush_keyboard_events (RetroControllerState *self);
+
 #else
 
-void retro_controller_state_set_for_type (RetroControllerState *self,
-                                          RetroControllerType   type,
-                                          gint16               *state,
-                                          gsize                 n_items);
+void retro_controller_state_set_port_plugged (RetroControllerState *self,
+                                              guint                 port,
+                                              gboolean              plugged);
+
+void retro_controller_state_begin_update (RetroControllerState *self,
+                                          guint                 port);
+void retro_controller_state_end_update (RetroControllerState *self,
+                                        guint                 port);
+
+void retro_controller_state_set_input (RetroControllerState *self,
+                                       guint                 port,
+                                       RetroInput           *input,
+                                       gint16                value);
 void retro_controller_state_clear_type (RetroControllerState *self,
+                                        guint                 port,
                                         RetroControllerType   type);
 
 void retro_controller_state_set_supports_rumble (RetroControllerState *self,
+                                                 guint                 port,
                                                  gboolean              supports_rumble);
 
+gboolean retro_controller_state_push_keyboard_event (RetroControllerState     *self,
+                                                     gboolean                  down,
+                                                     RetroKeyboardKey          keycode,
+                                                     guint32                   character,
+                                                     RetroKeyboardModifierKey  modifiers);
+
 #endif
 
 G_END_DECLS
@@ -2,7 +2,6 @@
 
 #include "retro-controller-state-private.h"
 
-#include <semaphore.h>
 #include <errno.h>
 #include <sys/mman.h>
 #include <unistd.h>
@@ -11,9 +10,14 @@
 #include "retro-input-private.h"
 
 #define RETRO_CONTROLLER_TYPE_COUNT (RETRO_CONTROLLER_TYPE_POINTER + 1)
+#define CACHE_LINE_SIZE 64
+#define N_SLOTS (RETRO_CONTROLLER_STATE_N_PORTS + 1)
+/* How many times to try copying a slot the UI keeps writing before keeping
+ * the previous snapshot, e.g. because the UI died in the middle of a write. */
+#define MAX_SNAPSHOT_ATTEMPTS 64
 
 typedef struct {
-  gboolean is_dirty;
+  guint32 generations[RETRO_CONTROLLER_TYPE_COUNT];
   gboolean supports_rumble;
   gint64 available_types;
   gint16 joypad_data[RETRO_JOYPAD_ID_COUNT];
@@ -24,9 +28,35 @@ typedef struct {
   gint16 pointer_data[RETRO_POINTER_ID_COUNT];
 } RetroControllerStateData;
 
+/* Keyboard events are queued in a single-producer single-consumer ring: the UI
+ * only writes the head and the runner only writes the tail. The size must be a
+ * power of two. */
+#define KEYBOARD_EVENT_QUEUE_SIZE 256
+
+typedef struct {
+  guint32 head __attribute__((aligned (CACHE_LINE_SIZE)));
+  guint32 tail __attribute__((aligned (CACHE_LINE_SIZE)));
+  RetroKeyboardEvent events[KEYBOARD_EVENT_QUEUE_SIZE];
+} RetroKeyboardEventQueue;
+
+/* The UI is the only writer and the runner the only reader. Writes to a slot
+ * are bracketed by a sequence counter which is odd while the UI is writing,
+ * and the runner retries its copy if the counter changed meanwhile, so the UI
+ * never waits for the runner. Each controller type has a generation counter
+ * bumped whenever its data changes, so the runner only copies the types which
+ * changed. Slots start on their own cache line so writing a port doesn't
+ * disturb reading another one. */
 typedef struct {
-  sem_t semaphore;
+  guint32 sequence;
   RetroControllerStateData data;
+} __attribute__((aligned (CACHE_LINE_SIZE))) RetroControllerStateSlot;
+
+/* All the ports and the default controller share a single block. A port's slot
+ * is only used if its bit is set in @ports. */
+typedef struct {
+  guint32 ports;
+  RetroKeyboardEventQueue keyboard_events;
+  RetroControllerStateSlot slots[N_SLOTS];
 } RetroControllerStateSharedData;
 
 struct _RetroControllerState
@@ -36,7 +66,11 @@ struct _RetroControllerState
   gint fd;
   RetroControllerStateSharedData *shared_data;
 #ifdef RETRO_RUNNER_COMPILATION
-  RetroControllerStateData snapshot;
+  guint32 snapshot_ports;
+  RetroControllerStateData snapshots[N_SLOTS];
+  RetroControllerStateData scratch;
+  guint32 snapshot_sequences[N_SLOTS];
+  guint16 joypad_masks[N_SLOTS];
 #endif
 };
 
@@ -79,6 +113,13 @@ get_data_for_type (RetroControllerStateData *data,
   }
 }
 
+static gsize
+get_data_size_for_type (RetroControllerType type)
+{
+  return retro_controller_type_get_id_count (type) *
+         retro_controller_type_get_index_count (type);
+}
+
 static void
 retro_controller_state_constructed (GObject *object)
 {
@@ -91,11 +132,6 @@ retro_controller_state_constructed (GObject *object)
 
   self->shared_data = mmap (NULL, sizeof (RetroControllerStateSharedData),
                             PROT_READ | PROT_WRITE, MAP_SHARED, self->fd, 0);
-
-#ifndef RETRO_RUNNER_COMPILATION
-  if (sem_init (&self->shared_data->semaphore, 1, 1) != 0)
-    g_critical ("Couldn't init semaphore: %s", g_strerror (errno));
-#endif
 }
 
 static void
@@ -103,11 +139,6 @@ retro_controller_state_finalize (GObject *object)
 {
   RetroControllerState *self = (RetroControllerState *)object;
 
-#ifndef RETRO_RUNNER_COMPILATION
-  if (sem_destroy (&self->shared_data->semaphore) != 0)
-    g_critical ("Couldn't destroy semaphore: %s", g_strerror (errno));
-#endif
-
   if (self->shared_data) {
     munmap (self->shared_data, sizeof (RetroControllerStateSharedData));
     self->shared_data = NULL;
@@ -203,28 +234,34 @@ retro_controller_state_get_fd (RetroControllerState *self)
   return self->fd;
 }
 
-void
-retro_controller_state_lock (RetroControllerState *self)
-{
-  g_return_if_fail (RETRO_IS_CONTROLLER_STATE (self));
-
-  if (sem_wait (&self->shared_data->semaphore) != 0)
-    g_critical ("Couldn't lock: %s", g_strerror (errno));
-}
+#ifdef RETRO_RUNNER_COMPILATION
 
-void
-retro_controller_state_unlock (RetroControllerState *self)
+static gboolean
+has_port (RetroControllerState *self,
+          guint                 port)
 {
-  g_return_if_fail (RETRO_IS_CONTROLLER_STATE (self));
+  if (port == RETRO_CONTROLLER_STATE_DEFAULT_PORT)
+    return TRUE;
 
-  if (sem_post (&self->shared_data->semaphore) != 0)
-    g_critical ("Couldn't unlock: %s", g_strerror (errno));
-}
+  if (port >= RETRO_CONTROLLER_STATE_N_PORTS)
+    return FALSE;
 
-#ifdef RETRO_RUNNER_COMPILATION
+  return (self->snapshot_ports & (1u << port)) != 0;
+}
 
+/**
+ * retro_controller_state_has_type:
+ * @self: a #RetroControllerState
+ * @port: the port, or %RETRO_CONTROLLER_STATE_DEFAULT_PORT
+ * @type: a #RetroControllerType
+ *
+ * Gets whether a controller is plugged into @port and supports @type.
+ *
+ * Returns: whether @port has @type
+ */
 gboolean
 retro_controller_state_has_type (RetroControllerState *self,
+                                 guint                 port,
                                  RetroControllerType   type)
 {
   gint64 available_types;
@@ -233,13 +270,17 @@ retro_controller_state_has_type (RetroControllerState *self,
   g_return_val_if_fail (type > RETRO_CONTROLLER_TYPE_NONE, FALSE);
   g_return_val_if_fail (type < RETRO_CONTROLLER_TYPE_COUNT, FALSE);
 
-  available_types = self->snapshot.available_types;
+  if (!has_port (self, port))
+    return FALSE;
+
+  available_types = self->snapshots[port].available_types;
 
   return (available_types & (1 << type)) > 0;
 }
 
 gint16
 retro_controller_state_get_input (RetroControllerState *self,
+                                  guint                 port,
                                   RetroInput           *input)
 {
   RetroControllerType type;
@@ -247,92 +288,424 @@ retro_controller_state_get_input (RetroControllerState *self,
   gint16 *data;
 
   g_return_val_if_fail (RETRO_IS_CONTROLLER_STATE (self), 0);
+  g_return_val_if_fail (port < N_SLOTS, 0);
   g_return_val_if_fail (input != NULL, 0);
 
-  type = input->any.type;
+  type = input->any.type & RETRO_CONTROLLER_TYPE_TYPE_MASK;
   id = input->any.id;
   index = input->any.index;
 
   stride = retro_controller_type_get_id_count (type);
 
-  if (id > stride || index > retro_controller_type_get_index_count (type))
+  if (id >= stride || index >= retro_controller_type_get_index_count (type))
     return 0;
 
-  data = get_data_for_type (&self->snapshot, type);
+  data = get_data_for_type (&self->snapshots[port], type);
 
   return data[index * stride + id];
 }
 
+/**
+ * retro_controller_state_get_joypad_mask:
+ * @self: a #RetroControllerState
+ * @port: the port, or %RETRO_CONTROLLER_STATE_DEFAULT_PORT
+ *
+ * Gets the pressed joypad buttons of @port as a bitmask where each bit index
+ * is a #RetroJoypadId. It is computed when the snapshot is taken.
+ *
+ * Returns: the joypad bitmask of @port
+ */
+guint16
+retro_controller_state_get_joypad_mask (RetroControllerState *self,
+                                        guint                 port)
+{
+  g_return_val_if_fail (RETRO_IS_CONTROLLER_STATE (self), 0);
+  g_return_val_if_fail (port < N_SLOTS, 0);
+
+  return self->joypad_masks[port];
+}
+
 gboolean
-retro_controller_state_get_supports_rumble (RetroControllerState *self)
+retro_controller_state_get_supports_rumble (RetroControllerState *self,
+                                            guint                 port)
 {
   g_return_val_if_fail (RETRO_IS_CONTROLLER_STATE (self), FALSE);
 
-  return self->snapshot.supports_rumble;
+  if (!has_port (self, port))
+    return FALSE;
+
+  return self->snapshots[port].supports_rumble;
 }
 
+static void
+snapshot_slot (RetroControllerState *self,
+               guint                 port)
+{
+  RetroControllerStateSlot *slot = &self->shared_data->slots[port];
+  RetroControllerStateData *snapshot = &self->snapshots[port];
+  RetroControllerStateData *scratch = &self->scratch;
+  guint32 generations[RETRO_CONTROLLER_TYPE_COUNT];
+  guint32 begin, end;
+  guint attempts = 0;
+
+  /* Copy to the scratch data first, so giving up leaves the previous snapshot
+   * untouched rather than torn. */
+  do {
+    if (attempts == MAX_SNAPSHOT_ATTEMPTS) {
+      g_debug ("Couldn't snapshot the state of port %u, keeping the previous one", port);
+
+      return;
+    }
+
+    if (attempts++ > 0)
+      g_thread_yield ();
+
+    begin = __atomic_load_n (&slot->sequence, __ATOMIC_ACQUIRE);
+    if (begin == self->snapshot_sequences[port])
+      return;
+
+    if (begin & 1) {
+      end = begin + 1;
+
+      continue;
+    }
+
+    scratch->supports_rumble = slot->data.supports_rumble;
+    scratch->available_types = slot->data.available_types;
+
+    for (RetroControllerType type = 1; type < RETRO_CONTROLLER_TYPE_COUNT; type++) {
+      generations[type] = slot->data.generations[type];
+      if (generations[type] == snapshot->generations[type])
+        continue;
+
+      memcpy (get_data_for_type (scratch, type),
+              get_data_for_type (&slot->data, type),
+              get_data_size_for_type (type) * sizeof (gint16));
+    }
+
+    __atomic_thread_fence (__ATOMIC_ACQUIRE);
+    end = __atomic_load_n (&slot->sequence, __ATOMIC_RELAXED);
+  } while (begin != end);
+
+  snapshot->supports_rumble = scratch->supports_rumble;
+  snapshot->available_types = scratch->available_types;
+
+  for (RetroControllerType type = 1; type < RETRO_CONTROLLER_TYPE_COUNT; type++) {
+    if (generations[type] == snapshot->generations[type])
+      continue;
+
+    memcpy (get_data_for_type (snapshot, type),
+            get_data_for_type (scratch, type),
+            get_data_size_for_type (type) * sizeof (gint16));
+  }
+
+  if (generations[RETRO_CONTROLLER_TYPE_JOYPAD] !=
+      snapshot->generations[RETRO_CONTROLLER_TYPE_JOYPAD]) {
+    guint16 mask = 0;
+
+    for (gsize i = 0; i < RETRO_JOYPAD_ID_COUNT; i++)
+      if (snapshot->joypad_data[i] != 0)
+        mask |= 1 << i;
+
+    self->joypad_masks[port] = mask;
+  }
+
+  for (RetroControllerType type = 1; type < RETRO_CONTROLLER_TYPE_COUNT; type++)
+    snapshot->generations[type] = generations[type];
+
+  self->snapshot_sequences[port] = end;
+}
+
+/**
+ * retro_controller_state_snapshot:
+ * @self: a #RetroControllerState
+ *
+ * Copies the state written by the UI for the default controller and for every
+ * plugged port, so it can be read consistently for the whole frame. Only the
+ * controller types which changed since the last snapshot are copied. This
+ * never blocks the UI, but it retries a bounded number of times while the UI
+ * is writing, keeping the previous snapshot of a port if it has to give up.
+ */
 void
 retro_controller_state_snapshot (RetroControllerState *self)
 {
+  guint32 ports;
+
   g_return_if_fail (RETRO_IS_CONTROLLER_STATE (self));
 
-  if (!self->shared_data->data.is_dirty)
-    return;
+  ports = __atomic_load_n (&self->shared_data->ports, __ATOMIC_ACQUIRE);
+  self->snapshot_ports = ports;
 
-  self->shared_data->data.is_dirty = FALSE;
+  snapshot_slot (self, RETRO_CONTROLLER_STATE_DEFAULT_PORT);
 
-  memcpy (&self->snapshot, &self->shared_data->data, sizeof (RetroControllerStateData));
+  for (guint port = 0; ports != 0; port++, ports >>= 1)
+    if (ports & 1)
+      snapshot_slot (self, port);
+}
+
+/**
+ * retro_controller_state_pop_keyboard_event:
+ * @self: a #RetroControllerState
+ * @before: the monotonic time in microseconds before which the event must have
+ *   been pushed
+ * @event: (out caller-allocates): return location for the event
+ *
+ * Takes the oldest queued keyboard event, unless it was pushed at or after
+ * @before, in which case it is left for a later frame.
+ *
+ * Returns: whether an event was taken
+ */
+gboolean
+retro_controller_state_pop_keyboard_event (RetroControllerState *self,
+                                           gint64                before,
+                                           RetroKeyboardEvent   *event)
+{
+  RetroKeyboardEventQueue *queue;
+  RetroKeyboardEvent *queued;
+  guint32 head, tail;
+
+  g_return_val_if_fail (RETRO_IS_CONTROLLER_STATE (self), FALSE);
+  g_return_val_if_fail (event != NULL, FALSE);
+
+  queue = &self->shared_data->keyboard_events;
+
+  tail = queue->tail;
+  head = __atomic_load_n (&queue->head, __ATOMIC_ACQUIRE);
+
+  if (head == tail)
+    return FALSE;
+
+  queued = &queue->events[tail % KEYBOARD_EVENT_QUEUE_SIZE];
+  if (queued->time >= before)
+    return FALSE;
+
+  *event = *queued;
+
+  __atomic_store_n (&queue->tail, tail + 1, __ATOMIC_RELEASE);
+
+  return TRUE;
+}
+
+/**
+ * retro_controller_state_flush_keyboard_events:
+ * @self: a #RetroControllerState
+ *
+ * Drops all the queued keyboard events.
+ */
+void
+retro_controller_state_flush_keyboard_events (RetroControllerState *self)
+{
+  RetroKeyboardEventQueue *queue;
+
+  g_return_if_fail (RETRO_IS_CONTROLLER_STATE (self));
+
+  queue = &self->shared_data->keyboard_events;
+
+  __atomic_store_n (&queue->tail,
+                    __atomic_load_n (&queue->head, __ATOMIC_ACQUIRE),
+                    __ATOMIC_RELEASE);
 }
 
 #else
 
+/**
+ * retro_controller_state_set_port_plugged:
+ * @self: a #RetroControllerState
+ * @port: the port
+ * @plugged: whether a controller is plugged into @port
+ *
+ * Sets whether the runner should use the slot of @port.
+ */
 void
-retro_controller_state_set_for_type (RetroControllerState *self,
-                                     RetroControllerType   type,
-                                     gint16               *state,
-                                     gsize                 n_items)
+retro_controller_state_set_port_plugged (RetroControllerState *self,
+                                         guint                 port,
+                                         gboolean              plugged)
 {
-  gint16 *data;
+  g_return_if_fail (RETRO_IS_CONTROLLER_STATE (self));
+  g_return_if_fail (port < RETRO_CONTROLLER_STATE_N_PORTS);
+
+  if (plugged)
+    __atomic_or_fetch (&self->shared_data->ports, 1u << port, __ATOMIC_RELEASE);
+  else
+    __atomic_and_fetch (&self->shared_data->ports, ~(1u << port), __ATOMIC_RELEASE);
+}
+
+/**
+ * retro_controller_state_begin_update:
+ * @self: a #RetroControllerState
+ * @port: the port, or %RETRO_CONTROLLER_STATE_DEFAULT_PORT
+ *
+ * Starts writing the state of @port. The runner won't use what is written
+ * until retro_controller_state_end_update() is called.
+ */
+void
+retro_controller_state_begin_update (RetroControllerState *self,
+                                     guint                 port)
+{
+  RetroControllerStateSlot *slot;
+  guint32 sequence;
+
+  g_return_if_fail (RETRO_IS_CONTROLLER_STATE (self));
+  g_return_if_fail (port < N_SLOTS);
+
+  slot = &self->shared_data->slots[port];
+  sequence = slot->sequence;
+
+  g_return_if_fail ((sequence & 1) == 0);
+
+  __atomic_store_n (&slot->sequence, sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+}
+
+/**
+ * retro_controller_state_end_update:
+ * @self: a #RetroControllerState
+ * @port: the port, or %RETRO_CONTROLLER_STATE_DEFAULT_PORT
+ *
+ * Publishes what was written for @port since
+ * retro_controller_state_begin_update().
+ */
+void
+retro_controller_state_end_update (RetroControllerState *self,
+                                   guint                 port)
+{
+  RetroControllerStateSlot *slot;
+  guint32 sequence;
 
   g_return_if_fail (RETRO_IS_CONTROLLER_STATE (self));
-  g_return_if_fail (state != NULL);
+  g_return_if_fail (port < N_SLOTS);
 
-  data = get_data_for_type (&self->shared_data->data, type);
+  slot = &self->shared_data->slots[port];
+  sequence = slot->sequence;
 
-  memcpy (data, state, n_items * sizeof (gint16));
-  self->shared_data->data.available_types |= (1 << type);
-  self->shared_data->data.is_dirty = TRUE;
+  g_return_if_fail ((sequence & 1) == 1);
+
+  __atomic_store_n (&slot->sequence, sequence + 1, __ATOMIC_RELEASE);
 }
 
-static gsize
-get_data_size_for_type (RetroControllerType type)
+/**
+ * retro_controller_state_set_input:
+ * @self: a #RetroControllerState
+ * @port: the port, or %RETRO_CONTROLLER_STATE_DEFAULT_PORT
+ * @input: a #RetroInput
+ * @value: the state of @input
+ *
+ * Writes the state of a single input and marks its controller type as
+ * available. The type is only copied again by the runner if the value changed.
+ */
+void
+retro_controller_state_set_input (RetroControllerState *self,
+                                  guint                 port,
+                                  RetroInput           *input,
+                                  gint16                value)
 {
-  return retro_controller_type_get_id_count (type) *
-         retro_controller_type_get_index_count (type);
+  RetroControllerStateData *shared;
+  RetroControllerType type;
+  guint id, index, stride;
+  gint16 *data;
+
+  g_return_if_fail (RETRO_IS_CONTROLLER_STATE (self));
+  g_return_if_fail (port < N_SLOTS);
+  g_return_if_fail (input != NULL);
+
+  type = input->any.type;
+  id = input->any.id;
+  index = input->any.index;
+
+  g_return_if_fail (type > RETRO_CONTROLLER_TYPE_NONE);
+  g_return_if_fail (type < RETRO_CONTROLLER_TYPE_COUNT);
+
+  stride = retro_controller_type_get_id_count (type);
+
+  if (id >= stride || index >= retro_controller_type_get_index_count (type))
+    return;
+
+  shared = &self->shared_data->slots[port].data;
+  shared->available_types |= (1 << type);
+
+  data = get_data_for_type (shared, type);
+
+  if (data[index * stride + id] == value)
+    return;
+
+  data[index * stride + id] = value;
+  shared->generations[type]++;
 }
 
 void
 retro_controller_state_clear_type (RetroControllerState *self,
+                                   guint                 port,
                                    RetroControllerType   type)
 {
+  RetroControllerStateData *shared;
   gint16 *data;
 
   g_return_if_fail (RETRO_IS_CONTROLLER_STATE (self));
+  g_return_if_fail (port < N_SLOTS);
 
-  data = get_data_for_type (&self->shared_data->data, type);
+  shared = &self->shared_data->slots[port].data;
+  data = get_data_for_type (shared, type);
   memset (data, 0, get_data_size_for_type (type) * sizeof (gint16));
 
-  self->shared_data->data.available_types &= ~(1 << type);
-  self->shared_data->data.is_dirty = TRUE;
+  shared->available_types &= ~(1 << type);
+  shared->generations[type]++;
 }
 
 void
 retro_controller_state_set_supports_rumble (RetroControllerState *self,
+                                            guint                 port,
                                             gboolean              supports_rumble)
 {
   g_return_if_fail (RETRO_IS_CONTROLLER_STATE (self));
+  g_return_if_fail (port < N_SLOTS);
+
+  self->shared_data->slots[port].data.supports_rumble = supports_rumble;
+}
+
+/**
+ * retro_controller_state_push_keyboard_event:
+ * @self: a #RetroControllerState
+ * @down: whether the key is pressed
+ * @keycode: the key
+ * @character: the character typed by the key, or 0
+ * @modifiers: the active modifier keys
+ *
+ * Queues a keyboard event for the runner, timestamped with the current
+ * monotonic time. The event is dropped if the queue is full.
+ *
+ * Returns: whether the event was queued
+ */
+gboolean
+retro_controller_state_push_keyboard_event (RetroControllerState     *self,
+                                            gboolean                  down,
+                                            RetroKeyboardKey          keycode,
+                                            guint32                   character,
+                                            RetroKeyboardModifierKey  modifiers)
+{
+  RetroKeyboardEventQueue *queue;
+  RetroKeyboardEvent *event;
+  guint32 head, tail;
+
+  g_return_val_if_fail (RETRO_IS_CONTROLLER_STATE (self), FALSE);
+
+  queue = &self->shared_data->keyboard_events;
+
+  head = queue->head;
+  tail = __atomic_load_n (&queue->tail, __ATOMIC_ACQUIRE);
+
+  if (head - tail >= KEYBOARD_EVENT_QUEUE_SIZE)
+    return FALSE;
+
+  event = &queue->events[head % KEYBOARD_EVENT_QUEUE_SIZE];
+  event->time = g_get_monotonic_time ();
+  event->down = down;
+  event->keycode = keycode;
+  event->character = character;
+  event->modifiers = modifiers;
+
+  __atomic_store_n (&queue->head, head + 1, __ATOMIC_RELEASE);
 
-  self->shared_data->data.supports_rumble = supports_rumble;
+  return TRUE;
 }
 
 #endif
@@ -25,4 +25,6 @@ enum {
   RETRO_CORE_ERROR_SIZE_MISMATCH,
 };
 
+GQuark retro_core_error_quark (void);
+
 G_END_DECLS
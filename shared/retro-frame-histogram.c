@@ -0,0 +1,53 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+/**
+ * SECTION:retro-frame-histogram
+ * @short_description: Frame time histograms
+ * @title: Frame time histograms
+ * @See_also: retro_core_benchmark()
+ *
+ * Frame times are counted in buckets of %RETRO_FRAME_HISTOGRAM_BUCKET_USEC
+ * microseconds, there are at most %RETRO_FRAME_HISTOGRAM_N_BUCKETS of them.
+ */
+
+#include "retro-frame-histogram.h"
+
+/**
+ * retro_frame_histogram_get_percentile:
+ * @buckets: (array length=n_buckets): the buckets of the histogram
+ * @n_buckets: the number of buckets
+ * @percentile: the percentile, between 0 and 100
+ *
+ * Gets the frame time under which @percentile percents of the frames counted
+ * in @buckets are, with the precision of a bucket.
+ *
+ * Returns: the frame time in milliseconds
+ */
+gdouble
+retro_frame_histogram_get_percentile (const guint32 *buckets,
+                                      gsize          n_buckets,
+                                      gdouble        percentile)
+{
+  guint64 n_frames = 0, rank, count = 0;
+
+  g_return_val_if_fail (buckets != NULL || n_buckets == 0, 0.0);
+  g_return_val_if_fail (percentile >= 0.0 && percentile <= 100.0, 0.0);
+
+  for (gsize i = 0; i < n_buckets; i++)
+    n_frames += buckets[i];
+
+  if (n_frames == 0)
+    return 0.0;
+
+  rank = (guint64) ((percentile / 100.0) * n_frames);
+  rank = CLAMP (rank, 1, n_frames);
+
+  for (gsize i = 0; i < n_buckets; i++) {
+    count += buckets[i];
+
+    if (count >= rank)
+      return (i + 1) * RETRO_FRAME_HISTOGRAM_BUCKET_USEC / 1000.0;
+  }
+
+  g_assert_not_reached ();
+}
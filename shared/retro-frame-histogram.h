@@ -0,0 +1,32 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#pragma once
+
+#if !defined(__RETRO_GTK_INSIDE__) && !defined(RETRO_GTK_COMPILATION)
+# error "Only <retro-gtk.h> can be included directly."
+#endif
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * RETRO_FRAME_HISTOGRAM_BUCKET_USEC:
+ *
+ * The width of a bucket of a frame time histogram, in microseconds.
+ */
+#define RETRO_FRAME_HISTOGRAM_BUCKET_USEC 100
+
+/**
+ * RETRO_FRAME_HISTOGRAM_N_BUCKETS:
+ *
+ * The maximum number of buckets of a frame time histogram, the last one also
+ * counting any slower frame.
+ */
+#define RETRO_FRAME_HISTOGRAM_N_BUCKETS 1000
+
+gdouble retro_frame_histogram_get_percentile (const guint32 *buckets,
+                                              gsize          n_buckets,
+                                              gdouble        percentile);
+
+G_END_DECLS
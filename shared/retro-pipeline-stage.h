@@ -0,0 +1,34 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#pragma once
+
+#if !defined(__RETRO_GTK_INSIDE__) && !defined(RETRO_GTK_COMPILATION)
+# error "Only <retro-gtk.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/**
+ * RetroPipelineStage:
+ * @RETRO_PIPELINE_STAGE_RUN: running a frame of the core
+ * @RETRO_PIPELINE_STAGE_VIDEO_REFRESH: copying a video frame to the framebuffer
+ * @RETRO_PIPELINE_STAGE_FRAMEBUFFER_LOCK: waiting for the framebuffer to be
+ *   released by the display
+ * @RETRO_PIPELINE_STAGE_AUDIO_RESAMPLE: resampling the audio of a frame
+ * @RETRO_PIPELINE_STAGE_AUDIO_WRITE: writing the audio of a frame to the sound
+ *   server
+ *
+ * Represents the measured stages of the pipeline running a core.
+ */
+typedef enum
+{
+  RETRO_PIPELINE_STAGE_RUN,
+  RETRO_PIPELINE_STAGE_VIDEO_REFRESH,
+  RETRO_PIPELINE_STAGE_FRAMEBUFFER_LOCK,
+  RETRO_PIPELINE_STAGE_AUDIO_RESAMPLE,
+  RETRO_PIPELINE_STAGE_AUDIO_WRITE,
+} RetroPipelineStage;
+
+G_END_DECLS
@@ -0,0 +1,41 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#pragma once
+
+#if !defined(__RETRO_GTK_INSIDE__) && !defined(RETRO_GTK_COMPILATION)
+# error "Only <retro-gtk.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+#include "retro-pipeline-stage.h"
+
+G_BEGIN_DECLS
+
+#define RETRO_PIPELINE_STAGE_COUNT (RETRO_PIPELINE_STAGE_AUDIO_WRITE + 1)
+
+#define RETRO_TYPE_PIPELINE_STATS (retro_pipeline_stats_get_type())
+
+G_DECLARE_FINAL_TYPE (RetroPipelineStats, retro_pipeline_stats, RETRO, PIPELINE_STATS, GObject)
+
+RetroPipelineStats *retro_pipeline_stats_new (gint fd);
+
+gint retro_pipeline_stats_get_fd (RetroPipelineStats *self);
+
+#ifdef RETRO_RUNNER_COMPILATION
+
+void retro_pipeline_stats_add (RetroPipelineStats *self,
+                               RetroPipelineStage  stage,
+                               gint64              time);
+
+#else
+
+void retro_pipeline_stats_get (RetroPipelineStats *self,
+                               RetroPipelineStage  stage,
+                               guint64            *count,
+                               gdouble            *mean,
+                               gdouble            *p99,
+                               gdouble            *max);
+
+#endif
+
+G_END_DECLS
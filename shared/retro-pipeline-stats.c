@@ -0,0 +1,282 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#include "retro-pipeline-stats-private.h"
+
+#include <errno.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* The durations are counted in buckets growing exponentially: a duration
+ * shorter than a microsecond is counted in the first bucket, and a duration of
+ * n microseconds is counted in the bucket g_bit_storage (n). */
+#define N_BUCKETS 32
+
+/* The runner is the only writer and the UI the only reader. Each counter is
+ * updated and read atomically without any lock, so recording a duration never
+ * blocks the runner. A reader can see a duration partially recorded, which
+ * only skews the statistics of a single sample. */
+typedef struct {
+  guint64 count;
+  guint64 total_time;
+  guint64 max_time;
+  guint64 buckets[N_BUCKETS];
+} RetroPipelineStageData;
+
+typedef struct {
+  RetroPipelineStageData stages[RETRO_PIPELINE_STAGE_COUNT];
+} RetroPipelineStatsData;
+
+struct _RetroPipelineStats
+{
+  GObject parent_instance;
+
+  gint fd;
+  RetroPipelineStatsData *data;
+};
+
+G_DEFINE_TYPE (RetroPipelineStats, retro_pipeline_stats, G_TYPE_OBJECT)
+
+enum {
+  PROP_0,
+  PROP_FD,
+  N_PROPS,
+};
+
+static GParamSpec *properties [N_PROPS];
+
+static void
+retro_pipeline_stats_constructed (GObject *object)
+{
+  RetroPipelineStats *self = RETRO_PIPELINE_STATS (object);
+  gpointer data;
+
+  G_OBJECT_CLASS (retro_pipeline_stats_parent_class)->constructed (object);
+
+#ifdef RETRO_RUNNER_COMPILATION
+  if (ftruncate (self->fd, sizeof (RetroPipelineStatsData)) != 0)
+    g_critical ("Couldn't truncate pipeline statistics: %s", g_strerror (errno));
+#endif
+
+  data = mmap (NULL, sizeof (RetroPipelineStatsData),
+               PROT_READ | PROT_WRITE, MAP_SHARED, self->fd, 0);
+
+  if (data == MAP_FAILED) {
+    g_critical ("Couldn't map pipeline statistics: %s", g_strerror (errno));
+
+    return;
+  }
+
+  self->data = data;
+}
+
+static void
+retro_pipeline_stats_finalize (GObject *object)
+{
+  RetroPipelineStats *self = (RetroPipelineStats *)object;
+
+  if (self->data) {
+    munmap (self->data, sizeof (RetroPipelineStatsData));
+    self->data = NULL;
+  }
+
+  close (self->fd);
+
+  G_OBJECT_CLASS (retro_pipeline_stats_parent_class)->finalize (object);
+}
+
+static void
+retro_pipeline_stats_get_property (GObject    *object,
+                                   guint       prop_id,
+                                   GValue     *value,
+                                   GParamSpec *pspec)
+{
+  RetroPipelineStats *self = RETRO_PIPELINE_STATS (object);
+
+  switch (prop_id) {
+  case PROP_FD:
+    g_value_set_int (value, self->fd);
+
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+
+    break;
+  }
+}
+
+static void
+retro_pipeline_stats_set_property (GObject      *object,
+                                   guint         prop_id,
+                                   const GValue *value,
+                                   GParamSpec   *pspec)
+{
+  RetroPipelineStats *self = RETRO_PIPELINE_STATS (object);
+
+  switch (prop_id) {
+  case PROP_FD:
+    self->fd = g_value_get_int (value);
+
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+
+    break;
+  }
+}
+
+static void
+retro_pipeline_stats_class_init (RetroPipelineStatsClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->constructed = retro_pipeline_stats_constructed;
+  object_class->finalize = retro_pipeline_stats_finalize;
+  object_class->get_property = retro_pipeline_stats_get_property;
+  object_class->set_property = retro_pipeline_stats_set_property;
+
+  properties[PROP_FD] =
+    g_param_spec_int ("fd",
+                      "File descriptor",
+                      "The file descriptor backing shared memory.",
+                      -1,
+                      G_MAXINT,
+                      -1,
+                      G_PARAM_READWRITE |
+                      G_PARAM_CONSTRUCT_ONLY |
+                      G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (object_class, N_PROPS, properties);
+}
+
+static void
+retro_pipeline_stats_init (RetroPipelineStats *self)
+{
+}
+
+RetroPipelineStats *
+retro_pipeline_stats_new (gint fd)
+{
+  return g_object_new (RETRO_TYPE_PIPELINE_STATS, "fd", fd, NULL);
+}
+
+gint
+retro_pipeline_stats_get_fd (RetroPipelineStats *self)
+{
+  g_return_val_if_fail (RETRO_IS_PIPELINE_STATS (self), -1);
+
+  return self->fd;
+}
+
+#ifdef RETRO_RUNNER_COMPILATION
+
+/**
+ * retro_pipeline_stats_add:
+ * @self: a #RetroPipelineStats
+ * @stage: the stage of the pipeline
+ * @time: the duration of the stage in nanoseconds
+ *
+ * Records a duration of @stage.
+ */
+void
+retro_pipeline_stats_add (RetroPipelineStats *self,
+                          RetroPipelineStage  stage,
+                          gint64              time)
+{
+  RetroPipelineStageData *data;
+  guint64 duration, bucket;
+
+  g_return_if_fail (RETRO_IS_PIPELINE_STATS (self));
+  g_return_if_fail (stage < RETRO_PIPELINE_STAGE_COUNT);
+
+  if (G_UNLIKELY (self->data == NULL))
+    return;
+
+  data = &self->data->stages[stage];
+  duration = MAX (time, 0);
+  bucket = MIN (g_bit_storage (duration / 1000), N_BUCKETS - 1);
+
+  __atomic_fetch_add (&data->buckets[bucket], 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add (&data->total_time, duration, __ATOMIC_RELAXED);
+  if (duration > __atomic_load_n (&data->max_time, __ATOMIC_RELAXED))
+    __atomic_store_n (&data->max_time, duration, __ATOMIC_RELAXED);
+  __atomic_fetch_add (&data->count, 1, __ATOMIC_RELEASE);
+}
+
+#else
+
+/**
+ * retro_pipeline_stats_get:
+ * @self: a #RetroPipelineStats
+ * @stage: the stage of the pipeline
+ * @count: (out) (optional): return location for the number of samples
+ * @mean: (out) (optional): return location for the mean duration
+ * @p99: (out) (optional): return location for the 99th percentile duration
+ * @max: (out) (optional): return location for the longest duration
+ *
+ * Gets the statistics of @stage. Durations are in milliseconds, the 99th
+ * percentile is rounded up to the next power of two microseconds.
+ */
+void
+retro_pipeline_stats_get (RetroPipelineStats *self,
+                          RetroPipelineStage  stage,
+                          guint64            *count,
+                          gdouble            *mean,
+                          gdouble            *p99,
+                          gdouble            *max)
+{
+  RetroPipelineStageData *data;
+  guint64 buckets[N_BUCKETS];
+  guint64 tmp_count, total_time, n_samples = 0, rank, seen = 0;
+  gdouble tmp_p99 = 0.0;
+
+  g_return_if_fail (RETRO_IS_PIPELINE_STATS (self));
+  g_return_if_fail (stage < RETRO_PIPELINE_STAGE_COUNT);
+
+  if (G_UNLIKELY (self->data == NULL)) {
+    if (count)
+      *count = 0;
+    if (mean)
+      *mean = 0.0;
+    if (p99)
+      *p99 = 0.0;
+    if (max)
+      *max = 0.0;
+
+    return;
+  }
+
+  data = &self->data->stages[stage];
+
+  tmp_count = __atomic_load_n (&data->count, __ATOMIC_ACQUIRE);
+  total_time = __atomic_load_n (&data->total_time, __ATOMIC_RELAXED);
+
+  for (gsize i = 0; i < N_BUCKETS; i++) {
+    buckets[i] = __atomic_load_n (&data->buckets[i], __ATOMIC_RELAXED);
+    n_samples += buckets[i];
+  }
+
+  rank = n_samples - n_samples / 100;
+  for (gsize i = 0; i < N_BUCKETS && n_samples > 0; i++) {
+    seen += buckets[i];
+
+    if (seen >= rank) {
+      tmp_p99 = (G_GUINT64_CONSTANT (1) << i) / 1000.0;
+
+      break;
+    }
+  }
+
+  if (count)
+    *count = tmp_count;
+
+  if (mean)
+    *mean = tmp_count > 0 ? total_time / 1000000.0 / tmp_count : 0.0;
+
+  if (p99)
+    *p99 = tmp_p99;
+
+  if (max)
+    *max = __atomic_load_n (&data->max_time, __ATOMIC_RELAXED) / 1000000.0;
+}
+
+#endif
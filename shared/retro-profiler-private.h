@@ -0,0 +1,44 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#pragma once
+
+#if !defined(__RETRO_GTK_INSIDE__) && !defined(RETRO_GTK_COMPILATION)
+# error "Only <retro-gtk.h> can be included directly."
+#endif
+
+#include <glib.h>
+
+#ifdef SYSPROF_ENABLED
+#include <sysprof-capture.h>
+#endif
+
+G_BEGIN_DECLS
+
+/* Sysprof marks are timed with CLOCK_MONOTONIC, so the marks of the UI and of
+ * the runner processes share the same timeline. They compile to nothing
+ * unless the sysprof build option is enabled.
+ */
+
+static inline gint64
+retro_profiler_get_time (void)
+{
+#ifdef SYSPROF_ENABLED
+  return SYSPROF_CAPTURE_CURRENT_TIME;
+#else
+  return 0;
+#endif
+}
+
+static inline void
+retro_profiler_add_mark (gint64       begin_time,
+                         const gchar *name,
+                         const gchar *message)
+{
+#ifdef SYSPROF_ENABLED
+  sysprof_collector_mark (begin_time,
+                          SYSPROF_CAPTURE_CURRENT_TIME - begin_time,
+                          G_LOG_DOMAIN, name, message);
+#endif
+}
+
+G_END_DECLS
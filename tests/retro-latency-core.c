@@ -0,0 +1,230 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+/* A core reacting to the B button of the first joypad LAG frames after it
+ * observed it, like most games do. The whole frame is black when the delayed
+ * button is pressed and white otherwise. The state can be serialized so the
+ * core can be run ahead.
+ *
+ * Built with LATENCY_JOYPAD_MASK defined, it reads the button through the
+ * joypad bitmask of a subclassed joypad instead. */
+
+#include <stdint.h>
+#include <libretro.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FPS 60.0
+#define SAMPLE_RATE 30000.0
+#define WIDTH 16
+#define HEIGHT 16
+#define ASPECT_RATIO (((float) WIDTH) / ((float) HEIGHT))
+#define LAG 2
+
+typedef struct {
+  uint32_t frame;
+  uint8_t history[LAG + 1];
+} LatencyState;
+
+static retro_video_refresh_t video_cb;
+static retro_audio_sample_t audio_cb;
+static retro_audio_sample_batch_t audio_batch_cb;
+static retro_environment_t environment_cb;
+static retro_input_poll_t input_poll_cb;
+static retro_input_state_t input_state_cb;
+static uint16_t frame_buffer[WIDTH * HEIGHT];
+static enum retro_pixel_format pixel_format = RETRO_PIXEL_FORMAT_RGB565;
+static LatencyState state;
+
+void
+retro_init (void)
+{
+  memset (&state, 0, sizeof (LatencyState));
+}
+
+void
+retro_deinit (void)
+{
+}
+
+unsigned
+retro_api_version (void)
+{
+  return RETRO_API_VERSION;
+}
+
+void
+retro_set_controller_port_device (unsigned port,
+                                  unsigned device)
+{
+}
+
+void
+retro_get_system_info (struct retro_system_info *info)
+{
+  memset (info, 0, sizeof (struct retro_system_info));
+  info->library_name = "";
+  info->library_version = "";
+  info->need_fullpath = false;
+  info->valid_extensions = "";
+}
+
+void
+retro_get_system_av_info (struct retro_system_av_info *info)
+{
+  info->timing.fps = FPS;
+  info->timing.sample_rate = SAMPLE_RATE;
+
+  info->geometry.base_width = WIDTH;
+  info->geometry.base_height = HEIGHT;
+  info->geometry.max_width = WIDTH;
+  info->geometry.max_height = HEIGHT;
+  info->geometry.aspect_ratio = ASPECT_RATIO;
+}
+
+void
+retro_set_environment (retro_environment_t cb)
+{
+  environment_cb = cb;
+
+  environment_cb (RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &pixel_format);
+}
+
+void
+retro_set_audio_sample (retro_audio_sample_t cb)
+{
+  audio_cb = cb;
+}
+
+void
+retro_set_audio_sample_batch (retro_audio_sample_batch_t cb)
+{
+  audio_batch_cb = cb;
+}
+
+void
+retro_set_input_poll (retro_input_poll_t cb)
+{
+  input_poll_cb = cb;
+}
+
+void
+retro_set_input_state (retro_input_state_t cb)
+{
+  input_state_cb = cb;
+}
+
+void
+retro_set_video_refresh (retro_video_refresh_t cb)
+{
+  video_cb = cb;
+}
+
+void
+retro_reset (void)
+{
+  memset (&state, 0, sizeof (LatencyState));
+}
+
+void
+retro_run (void)
+{
+  bool pressed, observed = false;
+
+  input_poll_cb ();
+#ifdef LATENCY_JOYPAD_MASK
+  pressed = (input_state_cb (0, RETRO_DEVICE_SUBCLASS (RETRO_DEVICE_JOYPAD, 0), 0,
+                             RETRO_DEVICE_ID_JOYPAD_MASK) &
+             (1 << RETRO_DEVICE_ID_JOYPAD_B)) != 0;
+#else
+  pressed = input_state_cb (0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_B) != 0;
+#endif
+
+  state.history[state.frame % (LAG + 1)] = pressed;
+  if (state.frame >= LAG)
+    observed = state.history[(state.frame - LAG) % (LAG + 1)];
+  state.frame++;
+
+  for (size_t i = 0; i < WIDTH * HEIGHT; i++)
+    frame_buffer[i] = observed ? 0x0000 : 0xffff;
+
+  video_cb (frame_buffer, WIDTH, HEIGHT, WIDTH * sizeof (uint16_t));
+}
+
+bool
+retro_load_game (const struct retro_game_info *info)
+{
+  return true;
+}
+
+void
+retro_unload_game (void)
+{
+}
+
+unsigned
+retro_get_region (void)
+{
+  return RETRO_REGION_NTSC;
+}
+
+bool
+retro_load_game_special (unsigned                      type,
+                         const struct retro_game_info *info,
+                         size_t                        num)
+{
+  return true;
+}
+
+size_t
+retro_serialize_size (void)
+{
+  return sizeof (LatencyState);
+}
+
+bool
+retro_serialize (void   *data,
+                 size_t  size)
+{
+  if (size < sizeof (LatencyState))
+    return false;
+
+  memcpy (data, &state, sizeof (LatencyState));
+
+  return true;
+}
+
+bool
+retro_unserialize (const void *data,
+                   size_t      size)
+{
+  if (size < sizeof (LatencyState))
+    return false;
+
+  memcpy (&state, data, sizeof (LatencyState));
+
+  return true;
+}
+
+void *
+retro_get_memory_data (unsigned id)
+{
+  return NULL;
+}
+
+size_t
+retro_get_memory_size (unsigned id)
+{
+  return 0;
+}
+
+void
+retro_cheat_reset (void)
+{
+}
+
+void
+retro_cheat_set (unsigned    idx,
+                 bool        enabled,
+                 const char *code)
+{
+}
@@ -0,0 +1,350 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+/* Measures the latency from a controller state change in the UI process to
+ * the video output showing the core reacted to it.
+ *
+ * The core must be retro-latency-core, or any core turning its whole frame
+ * black once it reacted to the B button of the first joypad. The button is
+ * pressed once the output is white again, and the number of video outputs and
+ * the time until the output turns black are recorded. */
+
+#include "retro-test-controller.h"
+#include <stdlib.h>
+
+/* How many white frames to wait for before pressing the button again. */
+#define SETTLE_FRAMES 3
+/* The display refresh rate used in display mode, relative to the core's. */
+#define DISPLAY_RATE_RATIO 1.005
+/* How many frames a sample can take before the measurement fails, in case the
+ * core never reacts. */
+#define MAX_FRAMES_PER_SAMPLE 100
+
+typedef enum {
+  LATENCY_MODE_ITERATION,
+  LATENCY_MODE_RUN,
+  LATENCY_MODE_DISPLAY,
+  LATENCY_MODE_COUNT,
+} LatencyMode;
+
+static const gchar *mode_names[LATENCY_MODE_COUNT] = {
+  "iteration",
+  "run",
+  "display",
+};
+
+typedef struct {
+  RetroCore *core;
+  RetroTestController *controller;
+  GMainLoop *loop;
+  gboolean pressed;
+  guint settled_frames;
+  gint64 press_time;
+  guint frames;
+  GArray *frame_counts;
+  GArray *times;
+  gboolean timed_out;
+} LatencyData;
+
+static gint max_runahead = 2;
+static gint n_samples = 10;
+static gint expected_lag = -1;
+static gchar *only_mode = NULL;
+
+static GOptionEntry entries[] = {
+  { "runahead", 'r', 0, G_OPTION_ARG_INT, &max_runahead, "Measure with runahead from 0 to N", "N" },
+  { "samples", 's', 0, G_OPTION_ARG_INT, &n_samples, "Number of presses per measurement", "N" },
+  { "lag", 'l', 0, G_OPTION_ARG_INT, &expected_lag, "Fail if the frame latency in iteration mode doesn't match a core lagging N frames", "N" },
+  { "mode", 'm', 0, G_OPTION_ARG_STRING, &only_mode, "Only measure the iteration, run or display mode", "MODE" },
+  { NULL }
+};
+
+static void
+crashed_cb (RetroCore   *core,
+            const gchar *message)
+{
+  g_printerr ("The core crashed: %s\n", message);
+
+  exit (EXIT_FAILURE);
+}
+
+static gboolean
+get_is_black (RetroPixdata *pixdata)
+{
+  g_autoptr (GdkPixbuf) pixbuf = retro_pixdata_to_pixbuf (pixdata);
+  const guint8 *pixels = gdk_pixbuf_read_pixels (pixbuf);
+
+  return pixels[0] < 0x80;
+}
+
+static void
+set_pressed (LatencyData *data,
+             gboolean     pressed)
+{
+  RetroControllerState state = {
+    RETRO_CONTROLLER_TYPE_JOYPAD,
+    RETRO_JOYPAD_ID_B,
+    0,
+    pressed ? G_MAXINT16 : 0,
+  };
+
+  data->pressed = pressed;
+  retro_test_controller_set_input_state (data->controller, &state);
+}
+
+static void
+video_output_cb (LatencyData  *data,
+                 RetroPixdata *pixdata)
+{
+  gint64 time;
+
+  if (pixdata == NULL)
+    return;
+
+  if (!data->pressed) {
+    if (get_is_black (pixdata))
+      data->settled_frames = 0;
+    else if (++data->settled_frames >= SETTLE_FRAMES) {
+      data->frames = 0;
+      data->press_time = g_get_monotonic_time ();
+      set_pressed (data, TRUE);
+    }
+
+    return;
+  }
+
+  data->frames++;
+
+  if (!get_is_black (pixdata))
+    return;
+
+  time = g_get_monotonic_time () - data->press_time;
+
+  g_array_append_val (data->frame_counts, data->frames);
+  g_array_append_val (data->times, time);
+
+  data->settled_frames = 0;
+  set_pressed (data, FALSE);
+
+  if (data->frame_counts->len >= n_samples)
+    g_main_loop_quit (data->loop);
+}
+
+static gboolean
+timeout_cb (LatencyData *data)
+{
+  data->timed_out = TRUE;
+  g_main_loop_quit (data->loop);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gint
+compare_times (gconstpointer a,
+               gconstpointer b)
+{
+  gint64 time_a = *(const gint64 *) a;
+  gint64 time_b = *(const gint64 *) b;
+
+  return (time_a > time_b) - (time_a < time_b);
+}
+
+static gboolean
+measure (LatencyData *data,
+         LatencyMode  mode,
+         guint        runahead)
+{
+  gdouble fps = retro_core_get_frames_per_second (data->core);
+  guint64 max_frames = (guint64) n_samples * MAX_FRAMES_PER_SAMPLE;
+  guint timeout_id;
+
+  g_array_set_size (data->frame_counts, 0);
+  g_array_set_size (data->times, 0);
+  data->settled_frames = 0;
+  data->timed_out = FALSE;
+  set_pressed (data, FALSE);
+
+  retro_core_set_runahead (data->core, runahead);
+
+  switch (mode) {
+  case LATENCY_MODE_ITERATION:
+    /* retro_core_iteration() emits the video output before returning. */
+    for (guint64 i = 0; data->frame_counts->len < n_samples; i++) {
+      if (i == max_frames) {
+        data->timed_out = TRUE;
+
+        break;
+      }
+
+      retro_core_iteration (data->core);
+    }
+
+    break;
+  case LATENCY_MODE_RUN:
+  case LATENCY_MODE_DISPLAY:
+    retro_core_set_display_refresh_rate (data->core,
+                                         mode == LATENCY_MODE_DISPLAY ?
+                                           fps * DISPLAY_RATE_RATIO : 0.0);
+    timeout_id = g_timeout_add ((guint) (max_frames * 1000 / fps),
+                                (GSourceFunc) timeout_cb, data);
+    retro_core_run (data->core);
+    g_main_loop_run (data->loop);
+    retro_core_stop (data->core);
+    if (!data->timed_out)
+      g_source_remove (timeout_id);
+
+    break;
+  default:
+    g_assert_not_reached ();
+  }
+
+  if (data->timed_out)
+    g_printerr ("The core didn't react within %u frames in %s mode with runahead %u\n",
+                MAX_FRAMES_PER_SAMPLE, mode_names[mode], runahead);
+
+  return !data->timed_out;
+}
+
+static gboolean
+report (LatencyData *data,
+        LatencyMode  mode,
+        guint        runahead)
+{
+  guint max_frames = 0, total_frames = 0, expected_frames;
+  gint64 total_time = 0;
+  gboolean success = TRUE;
+
+  for (gsize i = 0; i < data->frame_counts->len; i++) {
+    guint frames = g_array_index (data->frame_counts, guint, i);
+
+    max_frames = MAX (max_frames, frames);
+    total_frames += frames;
+    total_time += g_array_index (data->times, gint64, i);
+  }
+
+  g_array_sort (data->times, compare_times);
+
+  g_print ("%-9s %8u %8.2f %6u %9.3f %9.3f %9.3f\n",
+           mode_names[mode], runahead,
+           (gdouble) total_frames / data->frame_counts->len, max_frames,
+           total_time / 1000.0 / data->times->len,
+           g_array_index (data->times, gint64, data->times->len / 2) / 1000.0,
+           g_array_index (data->times, gint64, data->times->len - 1) / 1000.0);
+
+  if (expected_lag < 0 || mode != LATENCY_MODE_ITERATION)
+    return TRUE;
+
+  /* The frame in which the button is pressed counts as the first one, and
+   * each frame run ahead hides a frame of the core's lag. */
+  expected_frames = MAX (expected_lag - (gint) runahead, 0) + 1;
+
+  for (gsize i = 0; i < data->frame_counts->len; i++) {
+    guint frames = g_array_index (data->frame_counts, guint, i);
+
+    if (frames == expected_frames)
+      continue;
+
+    g_printerr ("Expected a latency of %u frames with runahead %u, got %u\n",
+                expected_frames, runahead, frames);
+    success = FALSE;
+  }
+
+  return success;
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_autoptr (GOptionContext) context = NULL;
+  g_autoptr (RetroCore) core = NULL;
+  g_autoptr (RetroTestController) controller = NULL;
+  g_autoptr (GMainLoop) loop = NULL;
+  g_autoptr (GArray) frame_counts = NULL;
+  g_autoptr (GArray) times = NULL;
+  g_autoptr (GError) error = NULL;
+  g_autoptr (GFile) file = NULL;
+  g_autofree gchar *module_path = NULL;
+  LatencyData data = { 0 };
+  LatencyMode first_mode = 0, last_mode = LATENCY_MODE_COUNT - 1;
+  gboolean success = TRUE;
+
+  g_setenv ("GDK_RENDERING", "image", FALSE);
+  g_set_prgname ("retro-latency");
+
+  context = g_option_context_new ("CORE");
+  g_option_context_set_summary (context,
+                                "Measures the latency from a controller "
+                                "state change to the video output.");
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error)) {
+    g_printerr ("%s\n", error->message);
+
+    return EXIT_FAILURE;
+  }
+
+  if (only_mode != NULL) {
+    for (first_mode = 0; first_mode < LATENCY_MODE_COUNT; first_mode++)
+      if (g_str_equal (only_mode, mode_names[first_mode]))
+        break;
+
+    if (first_mode == LATENCY_MODE_COUNT) {
+      g_printerr ("Unknown mode %s, expected iteration, run or display\n", only_mode);
+
+      return EXIT_FAILURE;
+    }
+
+    last_mode = first_mode;
+  }
+
+  if (argc != 2 || max_runahead < 0 || n_samples <= 0) {
+    g_autofree gchar *help = g_option_context_get_help (context, TRUE, NULL);
+
+    g_printerr ("%s", help);
+
+    return EXIT_FAILURE;
+  }
+
+  file = g_file_new_for_commandline_arg (argv[1]);
+  module_path = g_file_get_path (file);
+  core = retro_core_new (module_path);
+  controller = retro_test_controller_new (RETRO_CONTROLLER_TYPE_JOYPAD);
+  loop = g_main_loop_new (NULL, FALSE);
+  frame_counts = g_array_new (FALSE, FALSE, sizeof (guint));
+  times = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+  g_signal_connect (core, "crashed", G_CALLBACK (crashed_cb), NULL);
+  retro_core_set_controller (core, 0, RETRO_CONTROLLER (controller));
+
+  retro_core_boot (core, &error);
+  if (error != NULL) {
+    g_printerr ("Couldn't boot the core: %s\n", error->message);
+
+    return EXIT_FAILURE;
+  }
+
+  data.core = core;
+  data.controller = controller;
+  data.loop = loop;
+  data.frame_counts = frame_counts;
+  data.times = times;
+
+  g_signal_connect_swapped (core, "video-output", G_CALLBACK (video_output_cb), &data);
+
+  g_print ("%-9s %8s %8s %6s %9s %9s %9s\n",
+           "Mode", "Runahead", "Frames", "Max", "Mean ms", "p50 ms", "Max ms");
+
+  for (LatencyMode mode = first_mode; mode <= last_mode; mode++) {
+    for (guint runahead = 0; runahead <= max_runahead; runahead++) {
+      if (!measure (&data, mode, runahead)) {
+        success = FALSE;
+
+        continue;
+      }
+
+      success &= report (&data, mode, runahead);
+    }
+  }
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -224,7 +224,8 @@ retro_test_controller_set_input_state (RetroTestController  *self,
     return;
 
   self->state[type][RETRO_ID_INDEX (id_count, state->id, state->index)] = state->value;
-  retro_controller_emit_state_changed (RETRO_CONTROLLER (self));
+  retro_controller_emit_input_changed (RETRO_CONTROLLER (self), type,
+                                       state->id, state->index);
 }
 
 guint16
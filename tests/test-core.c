@@ -17,10 +17,12 @@
  */
 
 #include <retro-gtk.h>
+#include <fcntl.h>
 #include <glib/gstdio.h>
 
 static gchar *arg_core_filename = NULL;
 static gchar *tmp_filename = NULL;
+static gchar *tmp_dirname = NULL;
 
 static void
 test_setup (RetroCore     **core_pointer,
@@ -80,6 +82,131 @@ tmp_file_test_teardown (RetroCore     **core_pointer,
   tmp_filename = NULL;
 }
 
+#ifdef LIBARCHIVE_ENABLED
+static void
+remove_tree (const gchar *path)
+{
+  g_autoptr (GDir) dir = g_dir_open (path, 0, NULL);
+  const gchar *name;
+
+  while (dir != NULL && (name = g_dir_read_name (dir)) != NULL) {
+    g_autofree gchar *child = g_build_filename (path, name, NULL);
+
+    if (g_file_test (child, G_FILE_TEST_IS_DIR) &&
+        !g_file_test (child, G_FILE_TEST_IS_SYMLINK))
+      remove_tree (child);
+    else
+      g_unlink (child);
+  }
+
+  g_rmdir (path);
+}
+
+static guint
+count_dir_entries (const gchar *path)
+{
+  g_autoptr (GDir) dir = g_dir_open (path, 0, NULL);
+  guint n_entries = 0;
+
+  while (dir != NULL && g_dir_read_name (dir) != NULL)
+    n_entries++;
+
+  return n_entries;
+}
+
+static void
+cache_test_setup (RetroCore     **core_pointer,
+                  gconstpointer   core_filename)
+{
+  g_autoptr (GError) error = NULL;
+
+  g_assert_null (tmp_dirname);
+
+  tmp_dirname = g_dir_make_tmp ("retro-test-core-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  /* The runners inherit the environment when they are spawned. */
+  g_setenv ("XDG_CACHE_HOME", tmp_dirname, TRUE);
+  g_setenv ("RETRO_CONTENT_CACHE_SIZE", "1", TRUE);
+
+  test_setup (core_pointer, core_filename);
+}
+
+static void
+cache_test_teardown (RetroCore     **core_pointer,
+                     gconstpointer   data)
+{
+  test_teardown (core_pointer, data);
+
+  g_unsetenv ("RETRO_CONTENT_CACHE_SIZE");
+  g_unsetenv ("XDG_CACHE_HOME");
+
+  g_assert_nonnull (tmp_dirname);
+  remove_tree (tmp_dirname);
+
+  g_clear_pointer (&tmp_dirname, g_free);
+}
+
+static gchar *
+get_archive_member_uri (void)
+{
+  g_autofree gchar *path = NULL;
+  g_autoptr (GFile) file = NULL;
+  g_autofree gchar *uri = NULL;
+
+  path = g_test_build_filename (G_TEST_DIST, "retro-dummy.zip", NULL);
+  file = g_file_new_for_path (path);
+  uri = g_file_get_uri (file);
+
+  return g_strconcat (uri, "#retro-dummy.bin", NULL);
+}
+
+static void
+boot_archive_member (RetroCore *core)
+{
+  g_autofree gchar *uri = get_archive_member_uri ();
+  const gchar *uris[2] = { uri, NULL };
+  GError *error = NULL;
+
+  retro_core_set_medias (core, uris);
+  retro_core_boot (core, &error);
+  g_assert_no_error (error);
+  g_assert_true (retro_core_get_game_loaded (core));
+}
+
+static void
+test_boot_with_archive_member (RetroCore     **core_pointer,
+                               gconstpointer   data)
+{
+  boot_archive_member (*core_pointer);
+}
+
+static void
+test_boot_with_cached_archive_member (RetroCore     **core_pointer,
+                                      gconstpointer   data)
+{
+  g_autoptr (RetroCore) cached_core = NULL;
+  g_autofree gchar *cache_dir = NULL;
+  g_autofree gchar *keys_dir = NULL;
+
+  cache_dir = g_build_filename (tmp_dirname, "retro-gtk", "content", NULL);
+  keys_dir = g_build_filename (cache_dir, "keys", NULL);
+
+  boot_archive_member (*core_pointer);
+
+  /* The decompressed member and the link of its key. */
+  g_assert_cmpuint (count_dir_entries (cache_dir), ==, 2);
+  g_assert_cmpuint (count_dir_entries (keys_dir), ==, 1);
+
+  /* The second runner loads the member from the cache. */
+  cached_core = retro_core_new (retro_core_get_filename (*core_pointer));
+  boot_archive_member (cached_core);
+
+  g_assert_cmpuint (count_dir_entries (cache_dir), ==, 2);
+  g_assert_cmpuint (count_dir_entries (keys_dir), ==, 1);
+}
+#endif
+
 static void
 test_boot (RetroCore     **core_pointer,
            gconstpointer   data)
@@ -91,6 +218,93 @@ test_boot (RetroCore     **core_pointer,
   g_assert_no_error (error);
 }
 
+static void
+boot_async_cb (RetroCore     *core,
+               GAsyncResult  *result,
+               GAsyncResult **result_pointer)
+{
+  *result_pointer = g_object_ref (result);
+}
+
+static void
+test_boot_async (RetroCore     **core_pointer,
+                 gconstpointer   data)
+{
+  RetroCore *core = *core_pointer;
+  g_autoptr (GAsyncResult) result = NULL;
+  GError *error = NULL;
+
+  retro_core_boot_async (core, NULL,
+                         (GAsyncReadyCallback) boot_async_cb,
+                         &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_true (retro_core_boot_finish (core, result, &error));
+  g_assert_no_error (error);
+  g_assert_true (retro_core_get_is_initiated (core));
+}
+
+static void
+test_boot_from_runner_pool (RetroCore     **core_pointer,
+                            gconstpointer   data)
+{
+  RetroCore *core = *core_pointer;
+  const gchar *filename = retro_core_get_filename (core);
+  g_autoptr (RetroRunnerPool) pool = retro_runner_pool_new (1);
+  GError *error = NULL;
+
+  retro_runner_pool_prepare (pool, filename);
+
+  while (retro_runner_pool_get_n_idle (pool, filename) < 1)
+    g_main_context_iteration (NULL, TRUE);
+
+  retro_core_set_runner_pool (core, pool);
+  retro_core_boot (core, &error);
+  g_assert_no_error (error);
+  g_assert_true (retro_core_get_is_initiated (core));
+  g_assert_cmpuint (retro_runner_pool_get_n_idle (pool, filename), ==, 0);
+
+  /* The claimed runner is replaced in the background. */
+  while (retro_runner_pool_get_n_idle (pool, filename) < 1)
+    g_main_context_iteration (NULL, TRUE);
+}
+
+static void
+test_boot_with_media_fd (RetroCore     **core_pointer,
+                         gconstpointer   data)
+{
+  RetroCore *core = *core_pointer;
+  g_autoptr (GFile) file = NULL;
+  g_autofree gchar *uri = NULL;
+  const gchar *uris[2] = { NULL, NULL };
+  GError *error = NULL;
+  gint fd;
+
+  g_file_set_contents (tmp_filename, "content", -1, &error);
+  g_assert_no_error (error);
+
+  file = g_file_new_for_path (tmp_filename);
+  uri = g_file_get_uri (file);
+  uris[0] = uri;
+  retro_core_set_medias (core, uris);
+
+  fd = g_open (tmp_filename, O_RDONLY, 0);
+  g_assert_cmpint (fd, >=, 0);
+
+  retro_core_set_media_fd (core, 0, fd, &error);
+  g_assert_no_error (error);
+  g_close (fd, NULL);
+
+  /* The file isn't opened again by the runner, remove it to be sure. */
+  g_remove (tmp_filename);
+
+  retro_core_boot (core, &error);
+  g_assert_no_error (error);
+  g_assert_true (retro_core_get_game_loaded (core));
+}
+
 static void
 test_get_api_version (RetroCore     **core_pointer,
                       gconstpointer   data)
@@ -156,6 +370,96 @@ test_get_frames_per_second (RetroCore     **core_pointer,
   g_assert_cmpfloat (retro_core_get_frames_per_second (core), ==, 60.0);
 }
 
+static void
+test_get_frame_statistics (RetroCore     **core_pointer,
+                           gconstpointer   data)
+{
+  RetroCore *core = *core_pointer;
+  GError *error = NULL;
+  guint64 n_frames, missed_deadlines;
+  gdouble mean, p99;
+
+  retro_core_boot (core, &error);
+  g_assert_no_error (error);
+
+  retro_core_set_display_refresh_rate (core, 60.0);
+  g_assert_cmpfloat (retro_core_get_display_refresh_rate (core), ==, 60.0);
+
+  retro_core_get_frame_statistics (core, &n_frames, &mean, &p99, &missed_deadlines);
+  g_assert_cmpuint (n_frames, ==, 0);
+  g_assert_cmpfloat (mean, ==, 0.0);
+  g_assert_cmpfloat (p99, ==, 0.0);
+  g_assert_cmpuint (missed_deadlines, ==, 0);
+}
+
+static void
+test_benchmark (RetroCore     **core_pointer,
+                gconstpointer   data)
+{
+  RetroCore *core = *core_pointer;
+  GError *error = NULL;
+  g_autoptr(GArray) histogram = NULL;
+  gdouble total_time, core_time, video_time, audio_time;
+  guint64 n_frames = 0;
+
+  retro_core_boot (core, &error);
+  g_assert_no_error (error);
+
+  retro_core_benchmark (core, 10,
+                        RETRO_BENCHMARK_FLAGS_VIDEO | RETRO_BENCHMARK_FLAGS_AUDIO,
+                        &total_time, &core_time, &video_time, &audio_time,
+                        &histogram, &error);
+  g_assert_no_error (error);
+
+  g_assert_cmpfloat (total_time, >, 0.0);
+  g_assert_cmpfloat (core_time, >=, 0.0);
+  g_assert_cmpfloat (video_time, >=, 0.0);
+  g_assert_cmpfloat (audio_time, >=, 0.0);
+
+  for (gsize i = 0; i < histogram->len; i++)
+    n_frames += g_array_index (histogram, guint32, i);
+  g_assert_cmpuint (n_frames, ==, 10);
+
+  g_assert_cmpfloat (retro_frame_histogram_get_percentile ((guint32 *) histogram->data,
+                                                           histogram->len, 50.0),
+                     <=,
+                     retro_frame_histogram_get_percentile ((guint32 *) histogram->data,
+                                                           histogram->len, 100.0));
+  g_assert_cmpfloat (retro_frame_histogram_get_percentile ((guint32 *) histogram->data,
+                                                           histogram->len, 100.0),
+                     ==,
+                     histogram->len * RETRO_FRAME_HISTOGRAM_BUCKET_USEC / 1000.0);
+}
+
+static void
+test_get_pipeline_statistics (RetroCore     **core_pointer,
+                              gconstpointer   data)
+{
+  RetroCore *core = *core_pointer;
+  GError *error = NULL;
+  guint64 count;
+  gdouble mean, p99, max;
+
+  retro_core_boot (core, &error);
+  g_assert_no_error (error);
+
+  retro_core_get_pipeline_statistics (core, RETRO_PIPELINE_STAGE_RUN,
+                                      &count, &mean, &p99, &max);
+  g_assert_cmpuint (count, ==, 0);
+  g_assert_cmpfloat (mean, ==, 0.0);
+  g_assert_cmpfloat (p99, ==, 0.0);
+  g_assert_cmpfloat (max, ==, 0.0);
+
+  retro_core_benchmark (core, 10, RETRO_BENCHMARK_FLAGS_NONE,
+                        NULL, NULL, NULL, NULL, NULL, &error);
+  g_assert_no_error (error);
+
+  retro_core_get_pipeline_statistics (core, RETRO_PIPELINE_STAGE_RUN,
+                                      &count, &mean, &p99, &max);
+  g_assert_cmpuint (count, ==, 10);
+  g_assert_cmpfloat (mean, <=, max);
+}
+
 static void
 test_get_can_access_state (RetroCore     **core_pointer,
                            gconstpointer   data)
@@ -191,6 +495,39 @@ test_save_state (RetroCore     **core_pointer,
   g_assert_no_error (error);
 }
 
+static void
+save_state_async_cb (RetroCore     *core,
+                     GAsyncResult  *result,
+                     GAsyncResult **result_pointer)
+{
+  *result_pointer = g_object_ref (result);
+}
+
+static void
+test_save_state_async (RetroCore     **core_pointer,
+                       gconstpointer   data)
+{
+  RetroCore *core = *core_pointer;
+  g_autoptr (GAsyncResult) result = NULL;
+  GError *error = NULL;
+
+  retro_core_boot (core, &error);
+  g_assert_no_error (error);
+
+  retro_core_save_state_async (core, tmp_filename, NULL,
+                               (GAsyncReadyCallback) save_state_async_cb,
+                               &result);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_false (retro_core_save_state_finish (core, result, &error));
+
+  /* g_assert_error() should be used but the expected error domain is private. */
+  g_assert_nonnull (error);
+  g_clear_error (&error);
+}
+
 static void
 test_load_state (RetroCore     **core_pointer,
                  gconstpointer   data)
@@ -296,6 +633,47 @@ test_load_memory (RetroCore     **core_pointer,
   g_assert_no_error (error);
 }
 
+static void
+test_set_memory_mirror (RetroCore     **core_pointer,
+                        gconstpointer   data)
+{
+  RetroCore *core = *core_pointer;
+  GError *error = NULL;
+
+  retro_core_boot (core, &error);
+  g_assert_no_error (error);
+
+  retro_core_set_memory_mirror (core, RETRO_MEMORY_TYPE_SAVE_RAM, tmp_filename, &error);
+  /* g_assert_error() should be used but the expected error domain is private. */
+  g_assert_nonnull (error);
+  g_clear_error (&error);
+
+  retro_core_set_memory_mirror (core, RETRO_MEMORY_TYPE_SAVE_RAM, NULL, &error);
+  g_assert_no_error (error);
+}
+
+static void
+test_set_memory_autosave (RetroCore     **core_pointer,
+                          gconstpointer   data)
+{
+  RetroCore *core = *core_pointer;
+  GError *error = NULL;
+
+  retro_core_boot (core, &error);
+  g_assert_no_error (error);
+
+  retro_core_set_memory_autosave (core, RETRO_MEMORY_TYPE_SAVE_RAM, tmp_filename, 1, &error);
+  g_assert_no_error (error);
+
+  retro_core_set_memory_autosave (core, RETRO_MEMORY_TYPE_SAVE_RAM, NULL, 0, &error);
+  g_assert_no_error (error);
+
+  retro_core_set_memory_autosave (core, RETRO_MEMORY_TYPE_VIDEO_RAM + 1, tmp_filename, 1, &error);
+  /* g_assert_error() should be used but the expected error domain is private. */
+  g_assert_nonnull (error);
+  g_clear_error (&error);
+}
+
 static void
 test_has_option (RetroCore     **core_pointer,
                  gconstpointer   data)
@@ -329,17 +707,30 @@ main (int   argc,
   arg_core_filename = argv[1];
 
   g_test_add ("/RetroCore/boot", RetroCore *, arg_core_filename, test_setup, test_boot, test_teardown);
+  g_test_add ("/RetroCore/boot_async", RetroCore *, arg_core_filename, test_setup, test_boot_async, test_teardown);
+  g_test_add ("/RetroCore/boot_from_runner_pool", RetroCore *, arg_core_filename, test_setup, test_boot_from_runner_pool, test_teardown);
+  g_test_add ("/RetroCore/boot_with_media_fd", RetroCore *, arg_core_filename, tmp_file_test_setup, test_boot_with_media_fd, tmp_file_test_teardown);
+#ifdef LIBARCHIVE_ENABLED
+  g_test_add ("/RetroCore/boot_with_archive_member", RetroCore *, arg_core_filename, test_setup, test_boot_with_archive_member, test_teardown);
+  g_test_add ("/RetroCore/boot_with_cached_archive_member", RetroCore *, arg_core_filename, cache_test_setup, test_boot_with_cached_archive_member, cache_test_teardown);
+#endif
   g_test_add ("/RetroCore/get_api_version", RetroCore *, arg_core_filename, test_setup, test_get_api_version, test_teardown);
   g_test_add ("/RetroCore/get_filename", RetroCore *, arg_core_filename, test_setup, test_get_filename, test_teardown);
   g_test_add ("/RetroCore/get_game_loaded", RetroCore *, arg_core_filename, test_setup, test_get_game_loaded, test_teardown);
   g_test_add ("/RetroCore/get_support_no_game", RetroCore *, arg_core_filename, test_setup, test_get_support_no_game, test_teardown);
   g_test_add ("/RetroCore/get_frames_per_second", RetroCore *, arg_core_filename, test_setup, test_get_frames_per_second, test_teardown);
+  g_test_add ("/RetroCore/get_frame_statistics", RetroCore *, arg_core_filename, test_setup, test_get_frame_statistics, test_teardown);
+  g_test_add ("/RetroCore/benchmark", RetroCore *, arg_core_filename, test_setup, test_benchmark, test_teardown);
+  g_test_add ("/RetroCore/get_pipeline_statistics", RetroCore *, arg_core_filename, test_setup, test_get_pipeline_statistics, test_teardown);
   g_test_add ("/RetroCore/get_can_access_state", RetroCore *, arg_core_filename, test_setup, test_get_can_access_state, test_teardown);
   g_test_add ("/RetroCore/save_state", RetroCore *, arg_core_filename, tmp_file_test_setup, test_save_state, tmp_file_test_teardown);
+  g_test_add ("/RetroCore/save_state_async", RetroCore *, arg_core_filename, tmp_file_test_setup, test_save_state_async, tmp_file_test_teardown);
   g_test_add ("/RetroCore/load_state", RetroCore *, arg_core_filename, tmp_file_test_setup, test_load_state, tmp_file_test_teardown);
   g_test_add ("/RetroCore/get_memory_size", RetroCore *, arg_core_filename, test_setup, test_get_memory_size, test_teardown);
   g_test_add ("/RetroCore/save_memory", RetroCore *, arg_core_filename, tmp_file_test_setup, test_save_memory, tmp_file_test_teardown);
   g_test_add ("/RetroCore/load_memory", RetroCore *, arg_core_filename, tmp_file_test_setup, test_load_memory, tmp_file_test_teardown);
+  g_test_add ("/RetroCore/set_memory_mirror", RetroCore *, arg_core_filename, tmp_file_test_setup, test_set_memory_mirror, tmp_file_test_teardown);
+  g_test_add ("/RetroCore/set_memory_autosave", RetroCore *, arg_core_filename, tmp_file_test_setup, test_set_memory_autosave, tmp_file_test_teardown);
   g_test_add ("/RetroCore/has_option", RetroCore *, arg_core_filename, test_setup, test_has_option, test_teardown);
 
   return g_test_run();
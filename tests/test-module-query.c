@@ -0,0 +1,426 @@
+// This file is part of retro-gtk. License: GPL-3.0+.
+
+#include <retro-gtk.h>
+#include <fcntl.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* The lookup paths also contain the system ones, the test cores use a MIME
+ * type and a platform no installed core supports. */
+#define TEST_MIME_TYPE "application/x-retro-test"
+#define TEST_PLATFORM "RetroTest"
+
+static gchar *
+get_plugin_directory (void)
+{
+  return g_build_filename (g_get_user_data_dir (), "libretro", NULL);
+}
+
+static gchar *
+get_descriptor_path (const gchar *basename)
+{
+  g_autofree gchar *plugin_directory = get_plugin_directory ();
+
+  return g_build_filename (plugin_directory, basename, NULL);
+}
+
+static gchar *
+build_descriptor (const gchar *name,
+                  gboolean     needs_firmware)
+{
+  return g_strdup_printf ("[Libretro]\n"
+                          "Type=Emulator\n"
+                          "Name=%s\n"
+                          "Module=retro-test.so\n"
+                          "LibretroVersion=v1\n"
+                          "\n"
+                          "[Platform:" TEST_PLATFORM "]\n"
+                          "MimeType=" TEST_MIME_TYPE ";\n"
+                          "%s",
+                          name,
+                          needs_firmware ?
+                            "Firmwares=BIOS;\n"
+                            "\n"
+                            "[Firmware:BIOS]\n"
+                            "Path=bios.bin\n"
+                            "Mandatory=true\n" :
+                            "");
+}
+
+static void
+write_descriptor (const gchar *path,
+                  const gchar *name,
+                  gboolean     needs_firmware)
+{
+  g_autofree gchar *contents = build_descriptor (name, needs_firmware);
+  GError *error = NULL;
+
+  g_file_set_contents (path, contents, -1, &error);
+  g_assert_no_error (error);
+}
+
+/* Unlike g_file_set_contents(), this keeps the inode of the file. */
+static void
+overwrite_descriptor (const gchar *path,
+                      const gchar *name)
+{
+  g_autofree gchar *contents = build_descriptor (name, FALSE);
+  gsize length = strlen (contents);
+  gint fd;
+
+  fd = g_open (path, O_WRONLY | O_TRUNC, 0);
+  g_assert_cmpint (fd, >=, 0);
+  g_assert_cmpint (write (fd, contents, length), ==, length);
+  g_close (fd, NULL);
+}
+
+static void
+set_mtime (const gchar           *path,
+           const struct timespec *mtime)
+{
+  struct timespec times[2] = { { 0, UTIME_OMIT }, *mtime };
+
+  g_assert_cmpint (utimensat (AT_FDCWD, path, times, 0), ==, 0);
+}
+
+static RetroCoreDescriptor *
+get_descriptor (GListModel  *model,
+                const gchar *path)
+{
+  guint n_items = g_list_model_get_n_items (model);
+
+  for (guint i = 0; i < n_items; i++) {
+    g_autoptr (RetroCoreDescriptor) descriptor = g_list_model_get_item (model, i);
+
+    if (g_strcmp0 (retro_core_descriptor_get_filename (descriptor), path) == 0)
+      return g_steal_pointer (&descriptor);
+  }
+
+  return NULL;
+}
+
+static gchar *
+get_descriptor_name (GListModel  *model,
+                     const gchar *path)
+{
+  g_autoptr (RetroCoreDescriptor) descriptor = get_descriptor (model, path);
+
+  g_assert_nonnull (descriptor);
+
+  return retro_core_descriptor_get_name (descriptor, NULL);
+}
+
+static gchar *
+get_item_name (GListModel *model,
+               guint       position)
+{
+  g_autoptr (RetroCoreDescriptor) descriptor = g_list_model_get_item (model, position);
+
+  return retro_core_descriptor_get_name (descriptor, NULL);
+}
+
+/* Walks through the lookup paths, which loads and saves the index. */
+static GListModel *
+iterate (RetroModuleQuery *query)
+{
+  g_autoptr (RetroModuleIterator) iterator = retro_module_query_iterator (query);
+  GListStore *store = g_list_store_new (RETRO_TYPE_CORE_DESCRIPTOR);
+
+  while (retro_module_iterator_next (iterator)) {
+    g_autoptr (RetroCoreDescriptor) descriptor = retro_module_iterator_get (iterator);
+
+    g_list_store_append (store, descriptor);
+  }
+
+  return G_LIST_MODEL (store);
+}
+
+static void
+find_cb (RetroModuleQuery  *query,
+         GAsyncResult      *result,
+         GAsyncResult     **result_pointer)
+{
+  *result_pointer = g_object_ref (result);
+}
+
+static GListModel *
+find (RetroModuleQuery *query)
+{
+  g_autoptr (GListModel) model = NULL;
+  g_autoptr (GAsyncResult) result = NULL;
+  GError *error = NULL;
+
+  retro_module_query_find_async (query, NULL,
+                                 (GAsyncReadyCallback) find_cb,
+                                 &result);
+  model = g_object_ref (retro_module_query_get_descriptors (query));
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_true (retro_module_query_find_finish (query, result, &error));
+  g_assert_no_error (error);
+
+  return g_steal_pointer (&model);
+}
+
+static void
+test_setup (RetroModuleQuery **query_pointer,
+            gconstpointer      data)
+{
+  g_autofree gchar *plugin_directory = get_plugin_directory ();
+
+  g_assert_cmpint (g_mkdir_with_parents (plugin_directory, 0755), ==, 0);
+  g_setenv ("LIBRETRO_PLUGIN_PATH", plugin_directory, TRUE);
+
+  *query_pointer = retro_module_query_new (FALSE);
+}
+
+static void
+test_teardown (RetroModuleQuery **query_pointer,
+               gconstpointer      data)
+{
+  g_object_unref (*query_pointer);
+  g_unsetenv ("LIBRETRO_PLUGIN_PATH");
+}
+
+static void
+test_find_async (RetroModuleQuery **query_pointer,
+                 gconstpointer      data)
+{
+  RetroModuleQuery *query = *query_pointer;
+  g_autofree gchar *alpha_path = get_descriptor_path ("alpha.libretro");
+  g_autofree gchar *beta_path = get_descriptor_path ("beta.libretro");
+  g_autoptr (GListModel) model = NULL;
+  g_autoptr (GListModel) shared_model = NULL;
+  g_autoptr (GAsyncResult) result = NULL;
+  g_autoptr (RetroCoreDescriptor) alpha = NULL;
+  g_autoptr (RetroCoreDescriptor) beta = NULL;
+  GError *error = NULL;
+
+  write_descriptor (alpha_path, "Alpha", FALSE);
+  write_descriptor (beta_path, "Beta", FALSE);
+
+  model = find (query);
+  alpha = get_descriptor (model, alpha_path);
+  beta = get_descriptor (model, beta_path);
+  g_assert_nonnull (alpha);
+  g_assert_nonnull (beta);
+
+  /* The queries started while walking share the walk and its model. */
+  retro_module_query_find_async (query, NULL,
+                                 (GAsyncReadyCallback) find_cb,
+                                 &result);
+  shared_model = g_object_ref (retro_module_query_get_descriptors (query));
+  g_clear_object (&model);
+  model = find (query);
+  g_assert_true (model == shared_model);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_true (retro_module_query_find_finish (query, result, &error));
+  g_assert_no_error (error);
+}
+
+static void
+test_index (RetroModuleQuery **query_pointer,
+            gconstpointer      data)
+{
+  g_autofree gchar *path = get_descriptor_path ("alpha.libretro");
+  g_autoptr (GListModel) model = NULL;
+  g_autofree gchar *name = NULL;
+  GStatBuf buf;
+
+  write_descriptor (path, "Alpha", FALSE);
+
+  model = iterate (*query_pointer);
+  name = get_descriptor_name (model, path);
+  g_assert_cmpstr (name, ==, "Alpha");
+
+  g_assert_cmpint (g_stat (path, &buf), ==, 0);
+
+  /* The index is reused by other queries while the file looks unchanged. */
+  {
+    g_autoptr (RetroModuleQuery) query = retro_module_query_new (FALSE);
+
+    overwrite_descriptor (path, "Gamma");
+    set_mtime (path, &buf.st_mtim);
+
+    g_clear_object (&model);
+    g_clear_pointer (&name, g_free);
+    model = iterate (query);
+    name = get_descriptor_name (model, path);
+    g_assert_cmpstr (name, ==, "Alpha");
+  }
+
+  /* A different modification time invalidates the entry. */
+  {
+    g_autoptr (RetroModuleQuery) query = retro_module_query_new (FALSE);
+    struct timespec mtime = buf.st_mtim;
+
+    mtime.tv_sec++;
+    set_mtime (path, &mtime);
+
+    g_clear_object (&model);
+    g_clear_pointer (&name, g_free);
+    model = iterate (query);
+    name = get_descriptor_name (model, path);
+    g_assert_cmpstr (name, ==, "Gamma");
+  }
+
+  /* So does a different inode. */
+  {
+    g_autoptr (RetroModuleQuery) query = retro_module_query_new (FALSE);
+    GStatBuf new_buf;
+
+    g_assert_cmpint (g_stat (path, &buf), ==, 0);
+    write_descriptor (path, "Delta", FALSE);
+    set_mtime (path, &buf.st_mtim);
+
+    g_assert_cmpint (g_stat (path, &new_buf), ==, 0);
+    g_assert_cmpuint (new_buf.st_ino, !=, buf.st_ino);
+    g_assert_cmpuint (new_buf.st_size, ==, buf.st_size);
+
+    g_clear_object (&model);
+    g_clear_pointer (&name, g_free);
+    model = iterate (query);
+    name = get_descriptor_name (model, path);
+    g_assert_cmpstr (name, ==, "Delta");
+  }
+}
+
+static void
+test_lookup (RetroModuleQuery **query_pointer,
+             gconstpointer      data)
+{
+  RetroModuleQuery *query = *query_pointer;
+  g_autofree gchar *alpha_path = get_descriptor_path ("alpha.libretro");
+  g_autofree gchar *beta_path = get_descriptor_path ("beta.libretro");
+  g_autofree gchar *system_directory = NULL;
+  g_autofree gchar *firmware_path = NULL;
+  g_autoptr (GListModel) model = NULL;
+  g_autoptr (GListModel) cores = NULL;
+  g_autoptr (RetroCoreDescriptor) alpha = NULL;
+  g_autofree gchar *first = NULL;
+  g_autofree gchar *second = NULL;
+  GError *error = NULL;
+
+  system_directory = g_build_filename (g_get_user_data_dir (), "system", NULL);
+  firmware_path = g_build_filename (system_directory, "bios.bin", NULL);
+  g_assert_cmpint (g_mkdir_with_parents (system_directory, 0755), ==, 0);
+  retro_module_query_set_system_directory (query, system_directory);
+
+  write_descriptor (alpha_path, "Alpha", TRUE);
+  write_descriptor (beta_path, "Beta", FALSE);
+
+  /* Nothing is found before a query completes. */
+  cores = retro_module_query_lookup_for_mime_type (query, TEST_MIME_TYPE);
+  g_assert_cmpuint (g_list_model_get_n_items (cores), ==, 0);
+
+  /* The cores missing a mandatory firmware come last. */
+  model = find (query);
+  alpha = get_descriptor (model, alpha_path);
+  g_assert_false (retro_module_query_get_is_platform_ready (query, alpha, TEST_PLATFORM));
+
+  g_clear_object (&cores);
+  cores = retro_module_query_lookup_for_mime_type (query, TEST_MIME_TYPE);
+  g_assert_cmpuint (g_list_model_get_n_items (cores), ==, 2);
+  first = get_item_name (cores, 0);
+  second = get_item_name (cores, 1);
+  g_assert_cmpstr (first, ==, "Beta");
+  g_assert_cmpstr (second, ==, "Alpha");
+
+  /* The returned models are copies. */
+  g_list_store_remove_all (G_LIST_STORE (cores));
+  g_clear_object (&cores);
+  cores = retro_module_query_lookup_for_platform (query, TEST_PLATFORM);
+  g_assert_cmpuint (g_list_model_get_n_items (cores), ==, 2);
+
+  /* The firmwares are checked again when querying again. */
+  g_file_set_contents (firmware_path, "firmware", -1, &error);
+  g_assert_no_error (error);
+
+  g_clear_object (&model);
+  g_clear_object (&alpha);
+  model = find (query);
+  alpha = get_descriptor (model, alpha_path);
+  g_assert_true (retro_module_query_get_is_platform_ready (query, alpha, TEST_PLATFORM));
+
+  g_clear_object (&cores);
+  g_clear_pointer (&first, g_free);
+  g_clear_pointer (&second, g_free);
+  cores = retro_module_query_lookup_for_platform (query, TEST_PLATFORM);
+  g_assert_cmpuint (g_list_model_get_n_items (cores), ==, 2);
+  first = get_item_name (cores, 0);
+  second = get_item_name (cores, 1);
+  g_assert_cmpstr (first, ==, "Alpha");
+  g_assert_cmpstr (second, ==, "Beta");
+}
+
+static void
+core_changed_cb (RetroModuleQuery     *query,
+                 RetroCoreDescriptor  *descriptor,
+                 RetroCoreDescriptor **descriptor_pointer)
+{
+  g_set_object (descriptor_pointer, descriptor);
+}
+
+static void
+test_monitored (RetroModuleQuery **query_pointer,
+                gconstpointer      data)
+{
+  RetroModuleQuery *query = *query_pointer;
+  g_autofree gchar *path = get_descriptor_path ("alpha.libretro");
+  g_autoptr (GListModel) model = NULL;
+  g_autoptr (RetroCoreDescriptor) added = NULL;
+  g_autoptr (RetroCoreDescriptor) removed = NULL;
+  g_autoptr (RetroCoreDescriptor) descriptor = NULL;
+
+  model = find (query);
+  g_assert_null (get_descriptor (model, path));
+
+  g_signal_connect (query, "core-added", G_CALLBACK (core_changed_cb), &added);
+  g_signal_connect (query, "core-removed", G_CALLBACK (core_changed_cb), &removed);
+  retro_module_query_set_monitored (query, TRUE);
+
+  write_descriptor (path, "Alpha", FALSE);
+
+  while (added == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_cmpstr (retro_core_descriptor_get_filename (added), ==, path);
+  descriptor = get_descriptor (model, path);
+  g_assert_nonnull (descriptor);
+
+  g_remove (path);
+
+  while (removed == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_cmpstr (retro_core_descriptor_get_filename (removed), ==, path);
+  g_clear_object (&descriptor);
+  descriptor = get_descriptor (model, path);
+  g_assert_null (descriptor);
+
+  retro_module_query_set_monitored (query, FALSE);
+  g_signal_handlers_disconnect_by_func (query, core_changed_cb, &added);
+  g_signal_handlers_disconnect_by_func (query, core_changed_cb, &removed);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  /* Each test gets its own user directories, hence its own index. */
+  g_test_init (&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+
+  g_test_add ("/RetroModuleQuery/find_async", RetroModuleQuery *, NULL, test_setup, test_find_async, test_teardown);
+  g_test_add ("/RetroModuleQuery/index", RetroModuleQuery *, NULL, test_setup, test_index, test_teardown);
+  g_test_add ("/RetroModuleQuery/lookup", RetroModuleQuery *, NULL, test_setup, test_lookup, test_teardown);
+  g_test_add ("/RetroModuleQuery/monitored", RetroModuleQuery *, NULL, test_setup, test_monitored, test_teardown);
+
+  return g_test_run();
+}